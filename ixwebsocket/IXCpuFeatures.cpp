@@ -0,0 +1,64 @@
+/*
+ *  IXCpuFeatures.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ */
+
+#include "IXCpuFeatures.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#if !defined(__GNUC__) && !defined(__clang__) && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace ix
+{
+    bool cpuSupportsSSSE3()
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("ssse3") != 0;
+#else
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0;
+#endif
+    }
+
+    bool cpuSupportsAVX2()
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+#else
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+
+        // The OS must also save the ymm registers (OSXSAVE + XCR0 bits 1 and 2)
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx) return false;
+        if ((_xgetbv(0) & 0x6) != 0x6) return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#endif
+    }
+} // namespace ix
+#else
+namespace ix
+{
+    bool cpuSupportsSSSE3()
+    {
+        return false;
+    }
+
+    bool cpuSupportsAVX2()
+    {
+        return false;
+    }
+} // namespace ix
+#endif
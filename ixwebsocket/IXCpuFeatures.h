@@ -0,0 +1,16 @@
+/*
+ *  IXCpuFeatures.h
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ *
+ *  Runtime detection of the x86 instruction sets used by the vectorized kernels.
+ */
+
+#pragma once
+
+namespace ix
+{
+    // Both return false on other architectures
+    bool cpuSupportsSSSE3();
+    bool cpuSupportsAVX2();
+} // namespace ix
@@ -8,9 +8,57 @@
 
 #include "IXCancellationRequest.h"
 #include "IXGzipCodec.h"
+#include "IXNetSystem.h"
 #include "IXSocket.h"
+#include <fcntl.h>
 #include <sstream>
+#include <sys/stat.h>
+#include <sys/types.h>
 #include <vector>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+    bool openResponseBodyFile(const std::string& path, int& fd, uint64_t& size)
+    {
+#ifdef _WIN32
+        fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+        if (fd < 0) return false;
+
+        struct _stat64 st;
+        if (_fstat64(fd, &st) != 0 || (st.st_mode & _S_IFMT) != _S_IFREG)
+        {
+            _close(fd);
+            return false;
+        }
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            ::close(fd);
+            return false;
+        }
+#endif
+        size = (uint64_t) st.st_size;
+        return true;
+    }
+
+    void closeResponseBodyFile(int fd)
+    {
+#ifdef _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+    }
+} // namespace
 
 namespace ix
 {
@@ -194,6 +242,38 @@ namespace ix
     }
 
     bool Http::sendResponse(HttpResponsePtr response, std::unique_ptr<Socket>& socket)
+    {
+        int fileFd = -1;
+        uint64_t contentLength = response->body.size();
+        if (!response->bodyFile.empty() &&
+            !openResponseBodyFile(response->bodyFile, fileFd, contentLength))
+        {
+            // The file went away after the handler checked it, the client still
+            // gets a status line
+            WebSocketHttpHeaders headers;
+            headers["Content-Type"] = "text/plain";
+            auto errorResponse = std::make_shared<HttpResponse>(
+                500, "Internal Server Error", HttpErrorCode::Ok, headers,
+                std::string("Cannot open the response body file"));
+            sendResponseHeaders(errorResponse, errorResponse->body.size(), socket);
+            socket->writeBytes(errorResponse->body, nullptr);
+            return false;
+        }
+
+        bool success = sendResponseHeaders(response, contentLength, socket);
+        if (fileFd != -1)
+        {
+            success = success && socket->writeFile(fileFd, contentLength, nullptr);
+            closeResponseBodyFile(fileFd);
+            return success;
+        }
+
+        return success && (response->body.empty() || socket->writeBytes(response->body, nullptr));
+    }
+
+    bool Http::sendResponseHeaders(HttpResponsePtr response,
+                                   uint64_t contentLength,
+                                   std::unique_ptr<Socket>& socket)
     {
         // Write the response to the socket
         std::stringstream ss;
@@ -210,18 +290,13 @@ namespace ix
 
         // Write headers
         ss.str("");
-        ss << "Content-Length: " << response->body.size() << "\r\n";
+        ss << "Content-Length: " << contentLength << "\r\n";
         for (auto&& it : response->headers)
         {
             ss << it.first << ": " << it.second << "\r\n";
         }
         ss << "\r\n";
 
-        if (!socket->writeBytes(ss.str(), nullptr))
-        {
-            return false;
-        }
-
-        return response->body.empty() ? true : socket->writeBytes(response->body, nullptr);
+        return socket->writeBytes(ss.str(), nullptr);
     }
 } // namespace ix
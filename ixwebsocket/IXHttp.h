@@ -47,6 +47,10 @@ namespace ix
         uint64_t uploadSize;
         uint64_t downloadSize;
 
+        // Server responses only: the body is this file instead of body, sent with
+        // sendfile() when the socket allows it
+        std::string bodyFile;
+
         HttpResponse(int s = 0,
                      const std::string& des = std::string(),
                      const HttpErrorCode& c = HttpErrorCode::Ok,
@@ -131,5 +135,10 @@ namespace ix
         static std::tuple<std::string, std::string, std::string> parseRequestLine(
             const std::string& line);
         static std::string trim(const std::string& str);
+
+    private:
+        static bool sendResponseHeaders(HttpResponsePtr response,
+                                        uint64_t contentLength,
+                                        std::unique_ptr<Socket>& socket);
     };
 } // namespace ix
@@ -15,33 +15,57 @@
 #include <cstring>
 #include <fstream>
 #include <sstream>
+#include <sys/stat.h>
+#include <sys/types.h>
 #include <vector>
 
 namespace
 {
-    std::pair<bool, std::vector<uint8_t>> load(const std::string& path)
+    // Directories and other special files are not served, only regular files
+    bool openRegularFile(const std::string& path, std::ifstream& file, uint64_t& size)
     {
-        std::vector<uint8_t> memblock;
+#ifdef _WIN32
+        struct _stat64 st;
+        if (_stat64(path.c_str(), &st) != 0 || (st.st_mode & _S_IFMT) != _S_IFREG) return false;
+#else
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+#endif
+        size = (uint64_t) st.st_size;
+        file.open(path, std::ios::binary);
+        return file.is_open();
+    }
 
-        std::ifstream file(path);
-        if (!file.is_open()) return std::make_pair(false, memblock);
+#ifdef IXWEBSOCKET_USE_ZLIB
+    // Only the files sent compressed are loaded in memory. They are read from the
+    // stream opened by openRegularFile, so a file removed in the meantime is still
+    // read entirely.
+    std::pair<bool, std::vector<uint8_t>> load(std::ifstream& file)
+    {
+        std::vector<uint8_t> memblock;
 
         file.seekg(0, file.end);
         std::streamoff size = file.tellg();
         file.seekg(0, file.beg);
 
+        if (size < 0) return std::make_pair(false, memblock);
+
         memblock.resize((size_t) size);
-        file.read((char*) &memblock.front(), static_cast<std::streamsize>(size));
+        if (size > 0)
+        {
+            file.read((char*) &memblock.front(), static_cast<std::streamsize>(size));
+        }
 
-        return std::make_pair(true, memblock);
+        return std::make_pair((bool) file, memblock);
     }
 
-    std::pair<bool, std::string> readAsString(const std::string& path)
+    std::pair<bool, std::string> readAsString(std::ifstream& file)
     {
-        auto res = load(path);
+        auto res = load(file);
         auto vec = res.second;
         return std::make_pair(res.first, std::string(vec.begin(), vec.end()));
     }
+#endif
 
     std::string response_head_file(const std::string& file_name){
 
@@ -89,6 +113,11 @@ namespace ix
         _onConnectionCallback = callback;
     }
 
+    bool HttpServer::enableEventLoop(size_t /*threads*/)
+    {
+        return false;
+    }
+
     void HttpServer::handleConnection(std::unique_ptr<Socket> socket,
                                       std::shared_ptr<ConnectionState> connectionState)
     {
@@ -136,21 +165,33 @@ namespace ix
                 headers["Content-Type"] = response_head_file(uri);
 
                 std::string path("." + uri);
-                auto res = readAsString(path);
-                bool found = res.first;
-                if (!found)
+                bool compressed = false;
+                std::string content;
+                uint64_t size = 0;
+
+                std::ifstream file;
+                if (!openRegularFile(path, file, size))
                 {
                     return std::make_shared<HttpResponse>(
                         404, "Not Found", HttpErrorCode::Ok, WebSocketHttpHeaders(), std::string());
                 }
 
-                std::string content = res.second;
-
 #ifdef IXWEBSOCKET_USE_ZLIB
                 std::string acceptEncoding = request->headers["Accept-encoding"];
                 if (acceptEncoding == "*" || acceptEncoding.find("gzip") != std::string::npos)
                 {
-                    content = gzipCompress(content);
+                    auto res = readAsString(file);
+                    if (!res.first)
+                    {
+                        return std::make_shared<HttpResponse>(500,
+                                                              "Internal Server Error",
+                                                              HttpErrorCode::Ok,
+                                                              WebSocketHttpHeaders(),
+                                                              std::string());
+                    }
+                    content = gzipCompress(res.second);
+                    size = content.size();
+                    compressed = true;
                     headers["Content-Encoding"] = "gzip";
                 }
                 headers["Accept-Encoding"] = "gzip";
@@ -160,15 +201,19 @@ namespace ix
                 std::stringstream ss;
                 ss << connectionState->getRemoteIp() << ":" << connectionState->getRemotePort()
                    << " " << request->method << " " << request->headers["User-Agent"] << " "
-                   << request->uri << " " << content.size();
+                   << request->uri << " " << size;
                 logInfo(ss.str());
 
                 // FIXME: check extensions to set the content type
                 // headers["Content-Type"] = "application/octet-stream";
                 headers["Accept-Ranges"] = "none";
 
-                return std::make_shared<HttpResponse>(
+                auto response = std::make_shared<HttpResponse>(
                     200, "OK", HttpErrorCode::Ok, headers, content);
+                // Files sent as they are are not read here, they are handed to the
+                // kernel by Http::sendResponse
+                if (!compressed) response->bodyFile = path;
+                return response;
             });
     }
 
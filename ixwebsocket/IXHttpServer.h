@@ -41,6 +41,9 @@ namespace ix
 
         int getTimeoutSecs();
 
+        // HTTP requests are served by a thread per connection, returns false
+        virtual bool enableEventLoop(size_t threads = 0) final;
+
     private:
         // Member variables
         OnConnectionCallback _onConnectionCallback;
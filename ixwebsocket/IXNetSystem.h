@@ -76,6 +76,7 @@ struct pollfd
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #endif
 
@@ -83,8 +84,16 @@ namespace ix
 {
 #ifdef _WIN32
     typedef SOCKET socket_t;
+
+    // Same layout as the POSIX iovec, used by Socket::sendv
+    struct iovec
+    {
+        void* iov_base;
+        size_t iov_len;
+    };
 #else
     typedef int socket_t;
+    using ::iovec;
 #endif
 
     bool initNetSystem();
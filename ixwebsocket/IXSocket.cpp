@@ -19,6 +19,9 @@
 #include <string.h>
 #include <sys/types.h>
 #include <vector>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 
 #ifdef min
 #undef min
@@ -28,6 +31,9 @@ namespace ix
 {
     const int Socket::kDefaultPollNoTimeout = -1; // No poll timeout by default
     const int Socket::kDefaultPollTimeout = kDefaultPollNoTimeout;
+    const size_t Socket::kSendvCoalesceSize = 16 * 1024; // Max TLS record payload
+    const size_t Socket::kSendFileChunkSize = 1024 * 1024;
+    const int Socket::kSendFilePollTimeoutMs = 100;
 
     Socket::Socket(int fd)
         : _sockfd(fd)
@@ -207,6 +213,16 @@ namespace ix
         return _selectInterrupt->getFd() != -1 || _selectInterrupt->getEvent() != nullptr;
     }
 
+    void Socket::setSelectInterrupt(SelectInterruptPtr selectInterrupt)
+    {
+        _selectInterrupt = std::move(selectInterrupt);
+    }
+
+    socket_t Socket::getFd() const
+    {
+        return _sockfd;
+    }
+
     bool Socket::accept(std::string& errMsg)
     {
         if (_sockfd == -1)
@@ -259,6 +275,97 @@ namespace ix
         return send((char*) &buffer[0], buffer.size());
     }
 
+    std::ptrdiff_t Socket::sendv(const iovec* iov, int iovcnt)
+    {
+#ifdef _WIN32
+        std::vector<WSABUF> buffers(iovcnt);
+        for (int i = 0; i < iovcnt; ++i)
+        {
+            buffers[i].buf = static_cast<char*>(iov[i].iov_base);
+            buffers[i].len = static_cast<ULONG>(iov[i].iov_len);
+        }
+
+        DWORD sent = 0;
+        if (WSASend(_sockfd, buffers.data(), (DWORD) iovcnt, &sent, 0, nullptr, nullptr) ==
+            SOCKET_ERROR)
+        {
+            return -1;
+        }
+        return static_cast<std::ptrdiff_t>(sent);
+#else
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = const_cast<iovec*>(iov);
+        msg.msg_iovlen = iovcnt;
+
+        int flags = 0;
+#ifdef MSG_NOSIGNAL
+        flags = MSG_NOSIGNAL;
+#endif
+
+        return ::sendmsg(_sockfd, &msg, flags);
+#endif
+    }
+
+    std::ptrdiff_t Socket::sendFile(int fileFd, uint64_t offset, size_t length)
+    {
+#ifdef __linux__
+        off_t fileOffset = (off_t) offset;
+        return ::sendfile(_sockfd, fileFd, &fileOffset, length);
+#else
+        return sendFileCopy(fileFd, offset, length);
+#endif
+    }
+
+    std::ptrdiff_t Socket::sendFileCopy(int fileFd, uint64_t offset, size_t length)
+    {
+        _sendvBuffer.resize(std::min(length, kSendvCoalesceSize));
+
+#ifdef _WIN32
+        if (_lseeki64(fileFd, (__int64) offset, SEEK_SET) < 0) return -1;
+        std::ptrdiff_t bytesRead =
+            _read(fileFd, _sendvBuffer.data(), (unsigned int) _sendvBuffer.size());
+#else
+        std::ptrdiff_t bytesRead =
+            ::pread(fileFd, _sendvBuffer.data(), _sendvBuffer.size(), (off_t) offset);
+#endif
+        if (bytesRead <= 0) return bytesRead;
+
+        // A partial send is retried from the same offset, with the same bytes
+        return send(_sendvBuffer.data(), (size_t) bytesRead);
+    }
+
+    bool Socket::isSessionResumed() const
+    {
+        return false;
+    }
+
+    bool Socket::isKernelTLSActive() const
+    {
+        return false;
+    }
+
+    std::ptrdiff_t Socket::sendvCoalesced(const iovec* iov, int iovcnt)
+    {
+        if (iovcnt <= 0) return 0;
+
+        // Nothing to gather, or the first buffer fills a record on its own
+        if (iovcnt == 1 || iov[0].iov_len >= kSendvCoalesceSize)
+        {
+            return send(static_cast<char*>(iov[0].iov_base), iov[0].iov_len);
+        }
+
+        _sendvBuffer.clear();
+        for (int i = 0; i < iovcnt && _sendvBuffer.size() < kSendvCoalesceSize; ++i)
+        {
+            const char* data = static_cast<const char*>(iov[i].iov_base);
+            size_t size = std::min(iov[i].iov_len, kSendvCoalesceSize - _sendvBuffer.size());
+            _sendvBuffer.insert(_sendvBuffer.end(), data, data + size);
+        }
+
+        return send(_sendvBuffer.data(), _sendvBuffer.size());
+    }
+
     std::ptrdiff_t Socket::recv(void* buffer, size_t length)
     {
         int flags = 0;
@@ -372,6 +479,38 @@ namespace ix
         }
     }
 
+    bool Socket::writeFile(int fileFd,
+                           uint64_t length,
+                           const CancellationRequest& isCancellationRequested)
+    {
+        uint64_t offset = 0;
+
+        while (offset < length)
+        {
+            if (isCancellationRequested && isCancellationRequested()) return false;
+
+            size_t chunk = (size_t) std::min<uint64_t>(length - offset, kSendFileChunkSize);
+            std::ptrdiff_t ret = sendFile(fileFd, offset, chunk);
+
+            if (ret > 0)
+            {
+                offset += ret;
+            }
+            // The socket buffer is full, wait for it to drain instead of spinning
+            else if (ret < 0 && Socket::isWaitNeeded())
+            {
+                isReadyToWrite(kSendFilePollTimeoutMs);
+            }
+            // There was an error, or the file is shorter than expected
+            else
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
     bool Socket::readByte(void* buffer, const CancellationRequest& isCancellationRequested)
     {
         while (true)
@@ -13,6 +13,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include "IXCancellationRequest.h"
 #include "IXNetSystem.h"
@@ -43,6 +44,12 @@ namespace ix
         bool wakeUpFromPoll(uint64_t wakeUpCode);
         bool isWakeUpFromPollSupported();
 
+        // Replace the object notified by wakeUpFromPoll(), for sockets polled by an
+        // event loop instead of poll()
+        void setSelectInterrupt(SelectInterruptPtr selectInterrupt);
+
+        socket_t getFd() const;
+
         PollResultType isReadyToWrite(int timeoutMs);
         PollResultType isReadyToRead(int timeoutMs);
 
@@ -59,10 +66,29 @@ namespace ix
         std::ptrdiff_t send(const std::string& buffer);
         virtual std::ptrdiff_t recv(void* buffer, size_t length);
 
+        // Gather write of iovcnt buffers. Like send, it can write less than the total size
+        // of the buffers, and returns the number of bytes written.
+        virtual std::ptrdiff_t sendv(const iovec* iov, int iovcnt);
+
+        // Send up to length bytes of an open file, starting at offset. Like send, it can
+        // send less than length, and returns the number of bytes sent. The file is handed
+        // to the kernel with sendfile() by plain sockets and kernel TLS sockets.
+        virtual std::ptrdiff_t sendFile(int fileFd, uint64_t offset, size_t length);
+
+        // Whether the TLS handshake resumed a previous session instead of a full handshake
+        virtual bool isSessionResumed() const;
+
+        // Whether the TLS records are encrypted and written by the kernel (kTLS), see
+        // SocketTLSOptions::enable_ktls
+        virtual bool isKernelTLSActive() const;
+
         // Blocking and cancellable versions, working with socket that can be set
         // to non blocking mode. Used during HTTP upgrade.
         bool readByte(void* buffer, const CancellationRequest& isCancellationRequested);
         bool writeBytes(const std::string& str, const CancellationRequest& isCancellationRequested);
+        bool writeFile(int fileFd,
+                       uint64_t length,
+                       const CancellationRequest& isCancellationRequested);
 
         std::pair<bool, std::string> readLine(const CancellationRequest& isCancellationRequested);
         std::pair<bool, std::string> readBytes(size_t length,
@@ -88,10 +114,23 @@ namespace ix
         static bool readSelectInterruptRequest(const SelectInterruptPtr& selectInterrupt,
                                                PollResultType* pollResult);
 
+        // sendv for sockets which cannot hand the buffers to the kernel directly (TLS). The
+        // buffers are gathered into one send of at most a TLS record.
+        std::ptrdiff_t sendvCoalesced(const iovec* iov, int iovcnt);
+
+        // sendFile for sockets which cannot hand the file to the kernel (TLS). A record
+        // worth of the file is read and sent with send().
+        std::ptrdiff_t sendFileCopy(int fileFd, uint64_t offset, size_t length);
+
     private:
         static const int kDefaultPollTimeout;
         static const int kDefaultPollNoTimeout;
+        static const size_t kSendvCoalesceSize;
+        static const size_t kSendFileChunkSize;
+        static const int kSendFilePollTimeoutMs;
 
         SelectInterruptPtr _selectInterrupt;
+
+        std::vector<char> _sendvBuffer;
     };
 } // namespace ix
@@ -280,6 +280,16 @@ namespace ix
         return -1;
     }
 
+    std::ptrdiff_t SocketAppleSSL::sendv(const iovec* iov, int iovcnt)
+    {
+        return sendvCoalesced(iov, iovcnt);
+    }
+
+    std::ptrdiff_t SocketAppleSSL::sendFile(int fileFd, uint64_t offset, size_t length)
+    {
+        return sendFileCopy(fileFd, offset, length);
+    }
+
     // No wait support
     std::ptrdiff_t SocketAppleSSL::recv(void* buf, size_t nbyte)
     {
@@ -31,6 +31,8 @@ namespace ix
         virtual void close() final;
 
         virtual std::ptrdiff_t send(char* buffer, size_t length) final;
+        virtual std::ptrdiff_t sendv(const iovec* iov, int iovcnt) final;
+        virtual std::ptrdiff_t sendFile(int fileFd, uint64_t offset, size_t length) final;
         virtual std::ptrdiff_t recv(void* buffer, size_t length) final;
 
     private:
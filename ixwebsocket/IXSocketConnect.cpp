@@ -126,19 +126,22 @@ namespace ix
     }
 
     // FIXME: configure is a terrible name
-    void SocketConnect::configure(socket_t sockfd)
+    void SocketConnect::configure(socket_t sockfd, bool isNonBlocking)
     {
         // 1. disable Nagle's algorithm
         int flag = 1;
         setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (char*) &flag, sizeof(flag));
 
         // 2. make socket non blocking
+        if (!isNonBlocking)
+        {
 #ifdef _WIN32
-        unsigned long nonblocking = 1;
-        ioctlsocket(sockfd, FIONBIO, &nonblocking);
+            unsigned long nonblocking = 1;
+            ioctlsocket(sockfd, FIONBIO, &nonblocking);
 #else
-        fcntl(sockfd, F_SETFL, O_NONBLOCK); // make socket non blocking
+            fcntl(sockfd, F_SETFL, O_NONBLOCK); // make socket non blocking
 #endif
+        }
 
         // 3. (apple) prevent SIGPIPE from being emitted when the remote end disconnect
 #ifdef SO_NOSIGPIPE
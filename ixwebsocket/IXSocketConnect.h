@@ -22,7 +22,9 @@ namespace ix
                            std::string& errMsg,
                            const CancellationRequest& isCancellationRequested);
 
-        static void configure(socket_t sockfd);
+        // The fcntl call is skipped when the socket is already non blocking, for
+        // example when it was created by accept4
+        static void configure(socket_t sockfd, bool isNonBlocking = false);
 
     private:
         static int connectToAddress(const struct addrinfo* address,
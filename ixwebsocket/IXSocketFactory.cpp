@@ -28,9 +28,11 @@ namespace ix
     std::unique_ptr<Socket> createSocket(bool tls,
                                          int fd,
                                          std::string& errorMsg,
-                                         const SocketTLSOptions& tlsOptions)
+                                         const SocketTLSOptions& tlsOptions,
+                                         const SocketTLSContextPtr& tlsContext)
     {
         (void) tlsOptions;
+        (void) tlsContext;
         errorMsg.clear();
         std::unique_ptr<Socket> socket;
 
@@ -42,9 +44,9 @@ namespace ix
         {
 #ifdef IXWEBSOCKET_USE_TLS
 #if defined(IXWEBSOCKET_USE_MBED_TLS)
-            socket = ix::make_unique<SocketMbedTLS>(tlsOptions, fd);
+            socket = ix::make_unique<SocketMbedTLS>(tlsOptions, fd, tlsContext);
 #elif defined(IXWEBSOCKET_USE_OPEN_SSL) || defined(IXWEBSOCKET_USE_LIBRE_SSL)
-            socket = ix::make_unique<SocketOpenSSL>(tlsOptions, fd);
+            socket = ix::make_unique<SocketOpenSSL>(tlsOptions, fd, tlsContext);
 #elif defined(__APPLE__)
             socket = ix::make_unique<SocketAppleSSL>(tlsOptions, fd);
 #endif
@@ -61,4 +63,20 @@ namespace ix
 
         return socket;
     }
+
+    SocketTLSContextPtr createServerTLSContext(const SocketTLSOptions& tlsOptions,
+                                               std::string& errorMsg)
+    {
+        (void) tlsOptions;
+        errorMsg.clear();
+
+#ifdef IXWEBSOCKET_USE_TLS
+#if defined(IXWEBSOCKET_USE_MBED_TLS)
+        return SocketMbedTLS::createServerContext(tlsOptions, errorMsg);
+#elif defined(IXWEBSOCKET_USE_OPEN_SSL) || defined(IXWEBSOCKET_USE_LIBRE_SSL)
+        return SocketOpenSSL::createServerContext(tlsOptions, errorMsg);
+#endif
+#endif
+        return nullptr;
+    }
 } // namespace ix
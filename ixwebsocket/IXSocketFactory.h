@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include "IXSocketTLSContext.h"
 #include "IXSocketTLSOptions.h"
 #include <memory>
 #include <string>
@@ -14,8 +15,17 @@
 namespace ix
 {
     class Socket;
+
+    // Server sockets accepted with a tlsContext use it instead of building their own
     std::unique_ptr<Socket> createSocket(bool tls,
                                          int fd,
                                          std::string& errorMsg,
-                                         const SocketTLSOptions& tlsOptions);
+                                         const SocketTLSOptions& tlsOptions,
+                                         const SocketTLSContextPtr& tlsContext = nullptr);
+
+    // Build the TLS context shared by the sockets accepted by a server. Returns nullptr
+    // with an empty errorMsg when the TLS backend does not support shared contexts, the
+    // sockets then build their own.
+    SocketTLSContextPtr createServerTLSContext(const SocketTLSOptions& tlsOptions,
+                                               std::string& errorMsg);
 } // namespace ix
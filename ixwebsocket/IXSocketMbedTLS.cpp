@@ -14,6 +14,7 @@
 #include "IXNetSystem.h"
 #include "IXSocket.h"
 #include "IXSocketConnect.h"
+#include "IXSocketTLSSessionCache.h"
 #include <cstdint>
 #include <string.h>
 
@@ -24,23 +25,10 @@
 
 namespace ix
 {
-    SocketMbedTLS::SocketMbedTLS(const SocketTLSOptions& tlsOptions, int fd)
-        : Socket(fd)
-        , _tlsOptions(tlsOptions)
-    {
-        initMBedTLS();
-    }
-
-    SocketMbedTLS::~SocketMbedTLS()
-    {
-        SocketMbedTLS::close();
-    }
+    const int SocketMbedTLSContext::kSessionLifetimeSecs(3600);
 
-    void SocketMbedTLS::initMBedTLS()
+    SocketMbedTLSContext::SocketMbedTLSContext()
     {
-        std::lock_guard<std::mutex> lock(_mutex);
-
-        mbedtls_ssl_init(&_ssl);
         mbedtls_ssl_config_init(&_conf);
 #if MBEDTLS_VERSION_MAJOR < 4
         mbedtls_ctr_drbg_init(&_ctr_drbg);
@@ -49,14 +37,48 @@ namespace ix
         mbedtls_x509_crt_init(&_cacert);
         mbedtls_x509_crt_init(&_cert);
         mbedtls_pk_init(&_pkey);
-        // Initialize the PSA Crypto API for mbedTLS 3.6+ and all 4.x releases.
-        // See: https://github.com/Mbed-TLS/mbedtls/blob/development/docs/use-psa-crypto.md
-#if MBEDTLS_VERSION_MAJOR >= 4 || (MBEDTLS_VERSION_MAJOR == 3 && MBEDTLS_VERSION_MINOR >= 6)
-        psa_crypto_init();
+#if defined(MBEDTLS_SSL_CACHE_C) && defined(MBEDTLS_THREADING_C)
+        mbedtls_ssl_cache_init(&_cache);
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C) && defined(MBEDTLS_THREADING_C) && MBEDTLS_VERSION_MAJOR < 4
+        mbedtls_ssl_ticket_init(&_ticket);
 #endif
     }
 
-    bool SocketMbedTLS::loadSystemCertificates(std::string& errorMsg)
+    SocketMbedTLSContext::~SocketMbedTLSContext()
+    {
+        mbedtls_ssl_config_free(&_conf);
+#if MBEDTLS_VERSION_MAJOR < 4
+        mbedtls_ctr_drbg_free(&_ctr_drbg);
+        mbedtls_entropy_free(&_entropy);
+#endif
+        mbedtls_x509_crt_free(&_cacert);
+        mbedtls_x509_crt_free(&_cert);
+        mbedtls_pk_free(&_pkey);
+#if defined(MBEDTLS_SSL_CACHE_C) && defined(MBEDTLS_THREADING_C)
+        mbedtls_ssl_cache_free(&_cache);
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C) && defined(MBEDTLS_THREADING_C) && MBEDTLS_VERSION_MAJOR < 4
+        mbedtls_ssl_ticket_free(&_ticket);
+#endif
+    }
+
+    const mbedtls_ssl_config* SocketMbedTLSContext::getConfig() const
+    {
+        return &_conf;
+    }
+
+#if MBEDTLS_VERSION_MAJOR < 4
+    int SocketMbedTLSContext::random(void* context, unsigned char* output, size_t length)
+    {
+        auto self = static_cast<SocketMbedTLSContext*>(context);
+
+        std::lock_guard<std::mutex> lock(self->_rngMutex);
+        return mbedtls_ctr_drbg_random(&self->_ctr_drbg, output, length);
+    }
+#endif
+
+    bool SocketMbedTLSContext::loadSystemCertificates(std::string& errorMsg)
     {
 #ifdef _WIN32
         DWORD flags = CERT_STORE_READONLY_FLAG | CERT_STORE_OPEN_EXISTING_FLAG |
@@ -106,11 +128,84 @@ namespace ix
 #endif
     }
 
-    bool SocketMbedTLS::init(const std::string& host, bool isClient, std::string& errMsg)
+    bool SocketMbedTLSContext::enableSessionResumption(std::string& errMsg)
     {
-        initMBedTLS();
-        std::lock_guard<std::mutex> lock(_mutex);
+        (void) errMsg;
+#if defined(MBEDTLS_SSL_CACHE_C) && defined(MBEDTLS_THREADING_C)
+        mbedtls_ssl_cache_set_timeout(&_cache, kSessionLifetimeSecs);
+        mbedtls_ssl_conf_session_cache(
+            &_conf, &_cache, mbedtls_ssl_cache_get, mbedtls_ssl_cache_set);
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C) && defined(MBEDTLS_THREADING_C) && MBEDTLS_VERSION_MAJOR < 4
+        // The ticket keys are replaced once per lifetime, the tickets of the previous
+        // key are still accepted
+        if (mbedtls_ssl_ticket_setup(&_ticket,
+                                     &SocketMbedTLSContext::random,
+                                     this,
+                                     MBEDTLS_CIPHER_AES_256_GCM,
+                                     kSessionLifetimeSecs) != 0)
+        {
+            errMsg = "Setting up session tickets failed";
+            return false;
+        }
+        mbedtls_ssl_conf_session_tickets_cb(
+            &_conf, mbedtls_ssl_ticket_write, mbedtls_ssl_ticket_parse, &_ticket);
+#endif
+        return true;
+    }
+
+    bool SocketMbedTLSContext::useCertAndKeyFromMemory(const SocketTLSOptions& tlsOptions,
+                                                       std::string& errMsg)
+    {
+        std::string certChain;
+        std::string key;
+        if (!tlsOptions.loadCertAndKey(certChain, key, errMsg))
+        {
+            return false;
+        }
+
+        // PEM data is parsed with its null terminating character, DER data without
+        size_t certSize = certChain.size();
+        if (certChain.find("-----BEGIN ") != std::string::npos) ++certSize;
+        size_t keySize = key.size();
+        if (key.find("-----BEGIN ") != std::string::npos) ++keySize;
+
+        if (mbedtls_x509_crt_parse(&_cert, (const unsigned char*) certChain.c_str(), certSize) <
+            0)
+        {
+            errMsg = "Cannot parse the certificate chain from memory";
+            return false;
+        }
+#if MBEDTLS_VERSION_MAJOR == 3
+        int ret = mbedtls_pk_parse_key(&_pkey,
+                                       (const unsigned char*) key.c_str(),
+                                       keySize,
+                                       nullptr,
+                                       0,
+                                       mbedtls_ctr_drbg_random,
+                                       &_ctr_drbg);
+#else
+        int ret =
+            mbedtls_pk_parse_key(&_pkey, (const unsigned char*) key.c_str(), keySize, nullptr, 0);
+#endif
+        mbedtls_platform_zeroize(&key[0], key.size());
+        if (ret < 0)
+        {
+            errMsg = "Cannot parse the key from memory";
+            return false;
+        }
+        if (mbedtls_ssl_conf_own_cert(&_conf, &_cert, &_pkey) < 0)
+        {
+            errMsg = "Problem configuring the certificate from memory";
+            return false;
+        }
+        return true;
+    }
 
+    bool SocketMbedTLSContext::init(const SocketTLSOptions& tlsOptions,
+                                    bool isClient,
+                                    std::string& errMsg)
+    {
 #if MBEDTLS_VERSION_MAJOR < 4
         const char* pers = "IXSocketMbedTLS";
         if (mbedtls_ctr_drbg_seed(&_ctr_drbg,
@@ -134,33 +229,40 @@ namespace ix
         }
 
 #if MBEDTLS_VERSION_MAJOR < 4
-        mbedtls_ssl_conf_rng(&_conf, mbedtls_ctr_drbg_random, &_ctr_drbg);
+        mbedtls_ssl_conf_rng(&_conf, &SocketMbedTLSContext::random, this);
 #endif
 
-        if (_tlsOptions.hasCertAndKey())
+        if (tlsOptions.isUsingInMemoryCertAndKey())
+        {
+            if (!useCertAndKeyFromMemory(tlsOptions, errMsg))
+            {
+                return false;
+            }
+        }
+        else if (tlsOptions.hasCertAndKey())
         {
-            if (mbedtls_x509_crt_parse_file(&_cert, _tlsOptions.certFile.c_str()) < 0)
+            if (mbedtls_x509_crt_parse_file(&_cert, tlsOptions.certFile.c_str()) < 0)
             {
-                errMsg = "Cannot parse cert file '" + _tlsOptions.certFile + "'";
+                errMsg = "Cannot parse cert file '" + tlsOptions.certFile + "'";
                 return false;
             }
 #if MBEDTLS_VERSION_MAJOR == 3
-            if (mbedtls_pk_parse_keyfile(&_pkey, _tlsOptions.keyFile.c_str(), "", mbedtls_ctr_drbg_random, &_ctr_drbg) < 0)
+            if (mbedtls_pk_parse_keyfile(&_pkey, tlsOptions.keyFile.c_str(), "", mbedtls_ctr_drbg_random, &_ctr_drbg) < 0)
 #else
-            if (mbedtls_pk_parse_keyfile(&_pkey, _tlsOptions.keyFile.c_str(), "") < 0)
+            if (mbedtls_pk_parse_keyfile(&_pkey, tlsOptions.keyFile.c_str(), "") < 0)
 #endif
             {
-                errMsg = "Cannot parse key file '" + _tlsOptions.keyFile + "'";
+                errMsg = "Cannot parse key file '" + tlsOptions.keyFile + "'";
                 return false;
             }
             if (mbedtls_ssl_conf_own_cert(&_conf, &_cert, &_pkey) < 0)
             {
-                errMsg = "Problem configuring cert '" + _tlsOptions.certFile + "'";
+                errMsg = "Problem configuring cert '" + tlsOptions.certFile + "'";
                 return false;
             }
         }
 
-        if (_tlsOptions.isPeerVerifyDisabled())
+        if (tlsOptions.isPeerVerifyDisabled())
         {
             mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_NONE);
         }
@@ -169,7 +271,7 @@ namespace ix
             // FIXME: should we call mbedtls_ssl_conf_verify ?
             mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
 
-            if (_tlsOptions.isUsingSystemDefaults())
+            if (tlsOptions.isUsingSystemDefaults())
             {
                 if (!loadSystemCertificates(errMsg))
                 {
@@ -178,12 +280,12 @@ namespace ix
             }
             else
             {
-                if (_tlsOptions.isUsingInMemoryCAs())
+                if (tlsOptions.isUsingInMemoryCAs())
                 {
-                    const char* buffer = _tlsOptions.caFile.c_str();
+                    const char* buffer = tlsOptions.caFile.c_str();
                     size_t bufferSize =
-                        _tlsOptions.caFile.size() + 1; // Needs to include null terminating
-                                                       // character otherwise mbedtls will fail.
+                        tlsOptions.caFile.size() + 1; // Needs to include null terminating
+                                                      // character otherwise mbedtls will fail.
                     if (mbedtls_x509_crt_parse(
                             &_cacert, (const unsigned char*) buffer, bufferSize) < 0)
                     {
@@ -191,9 +293,9 @@ namespace ix
                         return false;
                     }
                 }
-                else if (mbedtls_x509_crt_parse_file(&_cacert, _tlsOptions.caFile.c_str()) < 0)
+                else if (mbedtls_x509_crt_parse_file(&_cacert, tlsOptions.caFile.c_str()) < 0)
                 {
-                    errMsg = "Cannot parse CA file '" + _tlsOptions.caFile + "'";
+                    errMsg = "Cannot parse CA file '" + tlsOptions.caFile + "'";
                     return false;
                 }
             }
@@ -201,7 +303,88 @@ namespace ix
             mbedtls_ssl_conf_ca_chain(&_conf, &_cacert, NULL);
         }
 
-        if (mbedtls_ssl_setup(&_ssl, &_conf) != 0)
+        if (tlsOptions.disable_session_resumption)
+        {
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+            mbedtls_ssl_conf_session_tickets(&_conf, MBEDTLS_SSL_SESSION_TICKETS_DISABLED);
+#endif
+        }
+        else if (isClient)
+        {
+            // TLS 1.3 tickets arrive after the handshake, and are only handed over to
+            // the application when asked for
+#if defined(MBEDTLS_SSL_PROTO_TLS1_3) && defined(MBEDTLS_SSL_SESSION_TICKETS) && \
+    MBEDTLS_VERSION_NUMBER >= 0x03060100
+            mbedtls_ssl_conf_tls13_enable_signal_new_session_tickets(
+                &_conf, MBEDTLS_SSL_TLS1_3_SIGNAL_NEW_SESSION_TICKETS_ENABLED);
+#endif
+        }
+        else if (!enableSessionResumption(errMsg))
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    SocketMbedTLS::SocketMbedTLS(const SocketTLSOptions& tlsOptions,
+                                 int fd,
+                                 const SocketTLSContextPtr& tlsContext)
+        : Socket(fd)
+        , _tlsContext(std::static_pointer_cast<SocketMbedTLSContext>(tlsContext))
+        , _sharedContext(tlsContext != nullptr)
+        , _tlsOptions(tlsOptions)
+    {
+        initMBedTLS();
+    }
+
+    SocketMbedTLS::~SocketMbedTLS()
+    {
+        SocketMbedTLS::close();
+    }
+
+    SocketTLSContextPtr SocketMbedTLS::createServerContext(const SocketTLSOptions& tlsOptions,
+                                                           std::string& errMsg)
+    {
+#if MBEDTLS_VERSION_MAJOR >= 4 || (MBEDTLS_VERSION_MAJOR == 3 && MBEDTLS_VERSION_MINOR >= 6)
+        psa_crypto_init();
+#endif
+        auto context = std::make_shared<SocketMbedTLSContext>();
+
+        bool isClient = false;
+        if (!context->init(tlsOptions, isClient, errMsg)) return nullptr;
+
+        return context;
+    }
+
+    void SocketMbedTLS::initMBedTLS()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        mbedtls_ssl_init(&_ssl);
+        // Initialize the PSA Crypto API for mbedTLS 3.6+ and all 4.x releases.
+        // See: https://github.com/Mbed-TLS/mbedtls/blob/development/docs/use-psa-crypto.md
+#if MBEDTLS_VERSION_MAJOR >= 4 || (MBEDTLS_VERSION_MAJOR == 3 && MBEDTLS_VERSION_MINOR >= 6)
+        psa_crypto_init();
+#endif
+    }
+
+    bool SocketMbedTLS::init(const std::string& host, bool isClient, std::string& errMsg)
+    {
+        initMBedTLS();
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (!_tlsContext)
+        {
+            auto context = std::make_shared<SocketMbedTLSContext>();
+            if (!context->init(_tlsOptions, isClient, errMsg))
+            {
+                return false;
+            }
+            _tlsContext = context;
+        }
+
+        if (mbedtls_ssl_setup(&_ssl, _tlsContext->getConfig()) != 0)
         {
             errMsg = "SSL setup failed";
             return false;
@@ -219,6 +402,48 @@ namespace ix
         return true;
     }
 
+    void SocketMbedTLS::resumeSession()
+    {
+        std::string serialized;
+        if (!SocketTLSSessionCache::getClientCache().get(_sessionKey, serialized)) return;
+
+        mbedtls_ssl_session session;
+        mbedtls_ssl_session_init(&session);
+
+        // The server decides whether the session is resumed, a full handshake is done
+        // otherwise
+        if (mbedtls_ssl_session_load(
+                &session, (const unsigned char*) serialized.data(), serialized.size()) == 0)
+        {
+            mbedtls_ssl_set_session(&_ssl, &session);
+        }
+        mbedtls_ssl_session_free(&session);
+    }
+
+    void SocketMbedTLS::saveSession()
+    {
+        if (_sessionKey.empty()) return;
+
+        mbedtls_ssl_session session;
+        mbedtls_ssl_session_init(&session);
+
+        if (mbedtls_ssl_get_session(&_ssl, &session) == 0)
+        {
+            size_t length = 0;
+            mbedtls_ssl_session_save(&session, nullptr, 0, &length);
+
+            std::string serialized(length, '\0');
+            if (length != 0 && mbedtls_ssl_session_save(&session,
+                                                        (unsigned char*) &serialized[0],
+                                                        serialized.size(),
+                                                        &length) == 0)
+            {
+                SocketTLSSessionCache::getClientCache().put(_sessionKey, serialized);
+            }
+        }
+        mbedtls_ssl_session_free(&session);
+    }
+
     bool SocketMbedTLS::accept(std::string& errMsg)
     {
         bool isClient = false;
@@ -282,6 +507,13 @@ namespace ix
             return false;
         }
 
+        if (!_tlsOptions.disable_session_resumption)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _sessionKey = SocketTLSSessionCache::makeKey(host, port, _tlsOptions);
+            resumeSession();
+        }
+
         mbedtls_ssl_set_bio(&_ssl, &_sockfd, mbedtls_net_send, mbedtls_net_recv, NULL);
 
         int res;
@@ -308,10 +540,22 @@ namespace ix
             errMsg = "error in handshake : ";
             errMsg += buf;
 
+            // The session might be the reason
+            if (!_sessionKey.empty())
+            {
+                SocketTLSSessionCache::getClientCache().remove(_sessionKey);
+            }
+
             close();
             return false;
         }
 
+        // TLS 1.2 sessions are known once the handshake is done
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            saveSession();
+        }
+
         return true;
     }
 
@@ -320,17 +564,15 @@ namespace ix
         std::lock_guard<std::mutex> lock(_mutex);
 
         mbedtls_ssl_free(&_ssl);
-        mbedtls_ssl_config_free(&_conf);
-#if MBEDTLS_VERSION_MAJOR < 4
-        mbedtls_ctr_drbg_free(&_ctr_drbg);
-        mbedtls_entropy_free(&_entropy);
-#endif
-        mbedtls_x509_crt_free(&_cacert);
-        mbedtls_x509_crt_free(&_cert);
-        mbedtls_pk_free(&_pkey);
+
+        // A shared context is still used by the other sockets of the server
+        if (!_sharedContext)
+        {
+            _tlsContext.reset();
 #if MBEDTLS_VERSION_MAJOR >= 4 || (MBEDTLS_VERSION_MAJOR == 3 && MBEDTLS_VERSION_MINOR >= 6)
-        mbedtls_psa_crypto_free();
+            mbedtls_psa_crypto_free();
 #endif
+        }
 
         Socket::close();
     }
@@ -356,6 +598,16 @@ namespace ix
         }
     }
 
+    std::ptrdiff_t SocketMbedTLS::sendv(const iovec* iov, int iovcnt)
+    {
+        return sendvCoalesced(iov, iovcnt);
+    }
+
+    std::ptrdiff_t SocketMbedTLS::sendFile(int fileFd, uint64_t offset, size_t length)
+    {
+        return sendFileCopy(fileFd, offset, length);
+    }
+
     std::ptrdiff_t SocketMbedTLS::recv(void* buf, size_t nbyte)
     {
         while (true)
@@ -375,6 +627,7 @@ namespace ix
 #if defined(MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET)
             if (res == MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET)
             {
+                saveSession();
                 continue;
             }
 #endif
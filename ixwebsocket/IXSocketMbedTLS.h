@@ -8,6 +8,7 @@
 #pragma once
 
 #include "IXSocket.h"
+#include "IXSocketTLSContext.h"
 #include "IXSocketTLSOptions.h"
 #include <mbedtls/version.h>
 #if MBEDTLS_VERSION_MAJOR < 4
@@ -18,18 +19,70 @@
 #include <mbedtls/error.h>
 #include <mbedtls/net_sockets.h>
 #include <mbedtls/platform.h>
+#include <mbedtls/platform_util.h>
+#include <mbedtls/ssl_cache.h>
+#include <mbedtls/ssl_ticket.h>
 #include <mbedtls/x509.h>
 #include <mbedtls/x509_crt.h>
+#include <memory>
 #include <mutex>
 
 namespace ix
 {
+    // The configuration, certificates and random generator shared by the SSL contexts
+    class SocketMbedTLSContext final : public SocketTLSContext
+    {
+    public:
+        SocketMbedTLSContext();
+        ~SocketMbedTLSContext();
+
+        bool init(const SocketTLSOptions& tlsOptions, bool isClient, std::string& errMsg);
+
+        const mbedtls_ssl_config* getConfig() const;
+
+        // Lifetime of the sessions kept by a server, and of its ticket keys
+        const static int kSessionLifetimeSecs;
+
+    private:
+        mbedtls_ssl_config _conf;
+#if MBEDTLS_VERSION_MAJOR < 4
+        mbedtls_entropy_context _entropy;
+        mbedtls_ctr_drbg_context _ctr_drbg;
+
+        // ctr_drbg is not thread safe, and the handshakes of a server run concurrently
+        std::mutex _rngMutex;
+        static int random(void* context, unsigned char* output, size_t length);
+#endif
+        mbedtls_x509_crt _cacert;
+        mbedtls_x509_crt _cert;
+        mbedtls_pk_context _pkey;
+
+        // The session cache and the ticket keys are shared by the handshakes of a
+        // server, they need the mbedtls locks
+#if defined(MBEDTLS_SSL_CACHE_C) && defined(MBEDTLS_THREADING_C)
+        mbedtls_ssl_cache_context _cache;
+#endif
+#if defined(MBEDTLS_SSL_TICKET_C) && defined(MBEDTLS_THREADING_C) && MBEDTLS_VERSION_MAJOR < 4
+        mbedtls_ssl_ticket_context _ticket;
+#endif
+
+        bool loadSystemCertificates(std::string& errMsg);
+        bool enableSessionResumption(std::string& errMsg);
+        bool useCertAndKeyFromMemory(const SocketTLSOptions& tlsOptions, std::string& errMsg);
+    };
+
     class SocketMbedTLS final : public Socket
     {
     public:
-        SocketMbedTLS(const SocketTLSOptions& tlsOptions, int fd = -1);
+        SocketMbedTLS(const SocketTLSOptions& tlsOptions,
+                      int fd = -1,
+                      const SocketTLSContextPtr& tlsContext = nullptr);
         ~SocketMbedTLS();
 
+        // Build a server context from the options, see createServerTLSContext()
+        static SocketTLSContextPtr createServerContext(const SocketTLSOptions& tlsOptions,
+                                                       std::string& errMsg);
+
         virtual bool accept(std::string& errMsg) final;
 
         virtual bool connect(const std::string& host,
@@ -39,25 +92,27 @@ namespace ix
         virtual void close() final;
 
         virtual std::ptrdiff_t send(char* buffer, size_t length) final;
+        virtual std::ptrdiff_t sendv(const iovec* iov, int iovcnt) final;
+        virtual std::ptrdiff_t sendFile(int fileFd, uint64_t offset, size_t length) final;
         virtual std::ptrdiff_t recv(void* buffer, size_t length) final;
 
     private:
         mbedtls_ssl_context _ssl;
-        mbedtls_ssl_config _conf;
-#if MBEDTLS_VERSION_MAJOR < 4
-        mbedtls_entropy_context _entropy;
-        mbedtls_ctr_drbg_context _ctr_drbg;
-#endif
-        mbedtls_x509_crt _cacert;
-        mbedtls_x509_crt _cert;
-        mbedtls_pk_context _pkey;
+
+        // Client sessions, see SocketTLSSessionCache
+        void resumeSession();
+        void saveSession();
+        std::string _sessionKey;
+
+        // Given by the server, or built by the socket when it connects
+        std::shared_ptr<SocketMbedTLSContext> _tlsContext;
+        bool _sharedContext;
 
         std::mutex _mutex;
         SocketTLSOptions _tlsOptions;
 
         bool init(const std::string& host, bool isClient, std::string& errMsg);
         void initMBedTLS();
-        bool loadSystemCertificates(std::string& errMsg);
     };
 
 } // namespace ix
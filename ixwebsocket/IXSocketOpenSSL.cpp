@@ -11,10 +11,16 @@
 
 #include "IXNetSystem.h"
 #include "IXSocketConnect.h"
+#include "IXSocketTLSSessionCache.h"
 #include "IXUniquePtr.h"
 #include <cassert>
+#include <cstring>
 #include <errno.h>
+#include <openssl/rand.h>
 #include <vector>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(LIBRESSL_VERSION_NUMBER)
+#include <openssl/core_names.h>
+#endif
 #ifdef _WIN32
 #include <shlwapi.h>
 #else
@@ -96,13 +102,170 @@ namespace ix
     std::once_flag SocketOpenSSL::_openSSLInitFlag;
     std::vector<std::unique_ptr<std::mutex>> openSSLMutexes;
 
-    SocketOpenSSL::SocketOpenSSL(const SocketTLSOptions& tlsOptions, int fd)
+    const int SocketOpenSSLContext::kTicketKeyLifetimeSecs(3600);
+
+    // Sessions resumed from the cache of the server must have been created by the same
+    // application
+    const std::string kSessionIdContext("IXWebSocket");
+
+    SocketOpenSSLContext::SocketOpenSSLContext(SSL_CTX* ctx)
+        : _ctx(ctx)
+        , _ticketKey()
+        , _previousTicketKey()
+        , _hasPreviousTicketKey(false)
+    {
+        ;
+    }
+
+    SocketOpenSSLContext::~SocketOpenSSLContext()
+    {
+        SSL_CTX_free(_ctx);
+    }
+
+    SSL_CTX* SocketOpenSSLContext::get() const
+    {
+        return _ctx;
+    }
+
+    bool SocketOpenSSLContext::enableTicketKeyRotation(std::string& errMsg)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_ticketKeysMutex);
+            if (!rotateTicketKeys(std::chrono::steady_clock::now()))
+            {
+                errMsg = "OpenSSL failed - cannot generate the session ticket keys";
+                return false;
+            }
+            _hasPreviousTicketKey = false;
+        }
+
+        SSL_CTX_set_app_data(_ctx, this);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(LIBRESSL_VERSION_NUMBER)
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(_ctx, &SocketOpenSSLContext::ticketKeyCallback);
+#else
+        SSL_CTX_set_tlsext_ticket_key_cb(_ctx, &SocketOpenSSLContext::ticketKeyCallback);
+#endif
+        return true;
+    }
+
+    bool SocketOpenSSLContext::rotateTicketKeys(std::chrono::steady_clock::time_point now)
+    {
+        TicketKey key;
+        if (RAND_bytes(key.name, sizeof(key.name)) != 1 ||
+            RAND_bytes(key.hmacKey, sizeof(key.hmacKey)) != 1 ||
+            RAND_bytes(key.aesKey, sizeof(key.aesKey)) != 1)
+        {
+            return false;
+        }
+        key.createdAt = now;
+
+        // The tickets encrypted with the current key are valid for another lifetime
+        auto lifetime = std::chrono::seconds(kTicketKeyLifetimeSecs);
+        _previousTicketKey = _ticketKey;
+        _hasPreviousTicketKey = now - _ticketKey.createdAt < 2 * lifetime;
+        _ticketKey = key;
+        return true;
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(LIBRESSL_VERSION_NUMBER)
+    int SocketOpenSSLContext::ticketKeyCallback(SSL* ssl,
+                                                unsigned char* keyName,
+                                                unsigned char* iv,
+                                                EVP_CIPHER_CTX* cipherContext,
+                                                EVP_MAC_CTX* macContext,
+                                                int encrypt)
+#else
+    int SocketOpenSSLContext::ticketKeyCallback(SSL* ssl,
+                                                unsigned char* keyName,
+                                                unsigned char* iv,
+                                                EVP_CIPHER_CTX* cipherContext,
+                                                HMAC_CTX* macContext,
+                                                int encrypt)
+#endif
+    {
+        SSL_CTX* ctx = SSL_get_SSL_CTX(ssl);
+        auto self = static_cast<SocketOpenSSLContext*>(SSL_CTX_get_app_data(ctx));
+        if (self == nullptr) return -1;
+
+        TicketKey key;
+        bool renew = false;
+        {
+            std::lock_guard<std::mutex> lock(self->_ticketKeysMutex);
+
+            auto now = std::chrono::steady_clock::now();
+            if (now - self->_ticketKey.createdAt >= std::chrono::seconds(kTicketKeyLifetimeSecs))
+            {
+                self->rotateTicketKeys(now);
+            }
+
+            if (encrypt)
+            {
+                key = self->_ticketKey;
+            }
+            else if (memcmp(keyName, self->_ticketKey.name, sizeof(key.name)) == 0)
+            {
+                key = self->_ticketKey;
+            }
+            else if (self->_hasPreviousTicketKey &&
+                     memcmp(keyName, self->_previousTicketKey.name, sizeof(key.name)) == 0)
+            {
+                key = self->_previousTicketKey;
+                renew = true;
+            }
+            else
+            {
+                // Unknown or expired key, fall back to a full handshake
+                return 0;
+            }
+        }
+
+        const EVP_CIPHER* cipher = EVP_aes_256_cbc();
+        if (encrypt)
+        {
+            if (RAND_bytes(iv, EVP_CIPHER_iv_length(cipher)) != 1) return -1;
+            memcpy(keyName, key.name, sizeof(key.name));
+
+            if (EVP_EncryptInit_ex(cipherContext, cipher, nullptr, key.aesKey, iv) != 1)
+            {
+                return -1;
+            }
+        }
+        else if (EVP_DecryptInit_ex(cipherContext, cipher, nullptr, key.aesKey, iv) != 1)
+        {
+            return -1;
+        }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(LIBRESSL_VERSION_NUMBER)
+        OSSL_PARAM params[3];
+        params[0] = OSSL_PARAM_construct_octet_string(
+            OSSL_MAC_PARAM_KEY, key.hmacKey, sizeof(key.hmacKey));
+        params[1] =
+            OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char*) "SHA256", 0);
+        params[2] = OSSL_PARAM_construct_end();
+        if (EVP_MAC_CTX_set_params(macContext, params) != 1) return -1;
+#else
+        if (HMAC_Init_ex(macContext, key.hmacKey, sizeof(key.hmacKey), EVP_sha256(), nullptr) !=
+            1)
+        {
+            return -1;
+        }
+#endif
+
+        // A ticket of the previous key is accepted, and replaced by a new one
+        return renew ? 2 : 1;
+    }
+
+    SocketOpenSSL::SocketOpenSSL(const SocketTLSOptions& tlsOptions,
+                                 int fd,
+                                 const SocketTLSContextPtr& tlsContext)
         : Socket(fd)
+        , _kernelTLSSend(false)
         , _ssl_connection(nullptr)
         , _ssl_context(nullptr)
         , _tlsOptions(tlsOptions)
+        , _tlsContext(tlsContext)
     {
-        std::call_once(_openSSLInitFlag, &SocketOpenSSL::openSSLInitialize, this);
+        std::call_once(_openSSLInitFlag, &SocketOpenSSL::openSSLInitialize);
     }
 
     SocketOpenSSL::~SocketOpenSSL()
@@ -225,10 +388,49 @@ namespace ix
         return ctx;
     }
 
-    bool SocketOpenSSL::openSSLAddCARootsFromString(const std::string roots)
+    void SocketOpenSSL::openSSLResumeSession()
+    {
+        std::string serialized;
+        if (!SocketTLSSessionCache::getClientCache().get(_sessionKey, serialized)) return;
+
+        const unsigned char* data = (const unsigned char*) serialized.data();
+        SSL_SESSION* session = d2i_SSL_SESSION(nullptr, &data, (long) serialized.size());
+        if (session == nullptr) return;
+
+        // The server decides whether the session is resumed, a full handshake is done
+        // otherwise
+        SSL_set_session(_ssl_connection, session);
+        SSL_SESSION_free(session);
+    }
+
+    int SocketOpenSSL::openSSLNewSessionCallback(SSL* ssl, SSL_SESSION* session)
+    {
+        // Called during the handshake (TLS 1.2), or when reading a ticket sent after
+        // the handshake (TLS 1.3)
+        auto self = static_cast<SocketOpenSSL*>(SSL_get_app_data(ssl));
+        if (self == nullptr) return 0;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined(LIBRESSL_VERSION_NUMBER)
+        if (!SSL_SESSION_is_resumable(session)) return 0;
+#endif
+
+        int length = i2d_SSL_SESSION(session, nullptr);
+        if (length <= 0) return 0;
+
+        std::string serialized(length, '\0');
+        unsigned char* data = (unsigned char*) &serialized[0];
+        if (i2d_SSL_SESSION(session, &data) != length) return 0;
+
+        SocketTLSSessionCache::getClientCache().put(self->_sessionKey, serialized);
+
+        // The session is not kept by us, OpenSSL keeps its reference
+        return 0;
+    }
+
+    bool SocketOpenSSL::openSSLAddCARootsFromString(SSL_CTX* ctx, const std::string roots)
     {
         // Create certificate store
-        X509_STORE* certificate_store = SSL_CTX_get_cert_store(_ssl_context);
+        X509_STORE* certificate_store = SSL_CTX_get_cert_store(ctx);
         if (certificate_store == nullptr) return false;
 
         // Configure to allow intermediate certs
@@ -285,6 +487,121 @@ namespace ix
         return success;
     }
 
+    bool SocketOpenSSL::openSSLUseCertAndKeyFromMemory(SSL_CTX* ctx,
+                                                       const SocketTLSOptions& tlsOptions,
+                                                       std::string& errMsg)
+    {
+        std::string certChain;
+        std::string key;
+        if (!tlsOptions.loadCertAndKey(certChain, key, errMsg))
+        {
+            return false;
+        }
+
+        // The leaf certificate comes first, followed by the intermediates
+        std::vector<X509*> certs;
+        if (certChain.find("-----BEGIN ") != std::string::npos)
+        {
+            BIO* buffer =
+                BIO_new_mem_buf((void*) certChain.c_str(), static_cast<int>(certChain.size()));
+            if (buffer == nullptr)
+            {
+                errMsg = "OpenSSL failed - BIO_new_mem_buf failed";
+                return false;
+            }
+
+            X509* cert = PEM_read_bio_X509_AUX(buffer, nullptr, nullptr, (void*) "");
+            while (cert != nullptr)
+            {
+                certs.push_back(cert);
+                cert = PEM_read_bio_X509(buffer, nullptr, nullptr, (void*) "");
+            }
+            BIO_free(buffer);
+        }
+        else
+        {
+            const unsigned char* data = (const unsigned char*) certChain.data();
+            const unsigned char* end = data + certChain.size();
+            while (data < end)
+            {
+                X509* cert = d2i_X509(nullptr, &data, static_cast<long>(end - data));
+                if (cert == nullptr) break;
+                certs.push_back(cert);
+            }
+        }
+        ERR_clear_error();
+
+        if (certs.empty())
+        {
+            errMsg = "OpenSSL failed - cannot parse the certificate chain from memory";
+            return false;
+        }
+
+        bool success = SSL_CTX_use_certificate(ctx, certs[0]) == 1;
+        X509_free(certs[0]);
+        for (size_t i = 1; i < certs.size(); ++i)
+        {
+            // The context takes ownership of the extra certificates
+            if (!success || SSL_CTX_add_extra_chain_cert(ctx, certs[i]) != 1)
+            {
+                success = false;
+                X509_free(certs[i]);
+            }
+        }
+        if (!success)
+        {
+            auto sslErr = ERR_get_error();
+            errMsg = "OpenSSL failed - SSL_CTX_use_certificate failed: ";
+            errMsg += ERR_error_string(sslErr, nullptr);
+            return false;
+        }
+
+        EVP_PKEY* pkey = nullptr;
+        if (key.find("-----BEGIN ") != std::string::npos)
+        {
+            BIO* buffer = BIO_new_mem_buf((void*) key.c_str(), static_cast<int>(key.size()));
+            if (buffer != nullptr)
+            {
+                pkey = PEM_read_bio_PrivateKey(buffer, nullptr, nullptr, (void*) "");
+                BIO_free(buffer);
+            }
+        }
+        else
+        {
+            const unsigned char* data = (const unsigned char*) key.data();
+            pkey = d2i_AutoPrivateKey(nullptr, &data, static_cast<long>(key.size()));
+        }
+        OPENSSL_cleanse(&key[0], key.size());
+
+        if (pkey == nullptr)
+        {
+            auto sslErr = ERR_get_error();
+            errMsg = "OpenSSL failed - cannot parse the key from memory: ";
+            errMsg += ERR_error_string(sslErr, nullptr);
+            return false;
+        }
+
+        success = SSL_CTX_use_PrivateKey(ctx, pkey) == 1;
+        EVP_PKEY_free(pkey);
+        if (!success)
+        {
+            auto sslErr = ERR_get_error();
+            errMsg = "OpenSSL failed - SSL_CTX_use_PrivateKey failed: ";
+            errMsg += ERR_error_string(sslErr, nullptr);
+            return false;
+        }
+
+        if (!SSL_CTX_check_private_key(ctx))
+        {
+            auto sslErr = ERR_get_error();
+            errMsg = "OpenSSL failed - cert/key mismatch: ";
+            errMsg += ERR_error_string(sslErr, nullptr);
+            return false;
+        }
+
+        return true;
+    }
+
     /**
      * Check whether a hostname matches a pattern
      */
@@ -464,7 +781,14 @@ namespace ix
     bool SocketOpenSSL::handleTLSOptions(std::string& errMsg)
     {
         ERR_clear_error();
-        if (_tlsOptions.hasCertAndKey())
+        if (_tlsOptions.isUsingInMemoryCertAndKey())
+        {
+            if (!openSSLUseCertAndKeyFromMemory(_ssl_context, _tlsOptions, errMsg))
+            {
+                return false;
+            }
+        }
+        else if (_tlsOptions.hasCertAndKey())
         {
             if (SSL_CTX_use_certificate_chain_file(_ssl_context, _tlsOptions.certFile.c_str()) != 1)
             {
@@ -515,7 +839,7 @@ namespace ix
                 if (_tlsOptions.isUsingInMemoryCAs())
                 {
                     // Load from memory
-                    openSSLAddCARootsFromString(_tlsOptions.caFile);
+                    openSSLAddCARootsFromString(_ssl_context, _tlsOptions.caFile);
                 }
                 else
                 {
@@ -564,134 +888,202 @@ namespace ix
         return true;
     }
 
-    bool SocketOpenSSL::accept(std::string& errMsg)
+    SSL_CTX* SocketOpenSSL::openSSLCreateServerContext(const SocketTLSOptions& tlsOptions,
+                                                       std::string& errMsg)
     {
-        bool handshakeSuccessful = false;
+        const SSL_METHOD* method = SSLv23_server_method();
+        if (method == nullptr)
         {
-            std::lock_guard<std::mutex> lock(_mutex);
+            errMsg = "SSLv23_server_method failure";
+            return nullptr;
+        }
 
-            if (!_openSSLInitializationSuccessful)
-            {
-                errMsg = "OPENSSL_init_ssl failure";
-                return false;
-            }
+        SSL_CTX* ctx = SSL_CTX_new(method);
+        if (ctx == nullptr)
+        {
+            errMsg = "OpenSSL failed - SSL_CTX_new failed";
+            return nullptr;
+        }
 
-            if (_sockfd == -1)
+        SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE);
+        SSL_CTX_set_mode(ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+        SSL_CTX_set_options(ctx, SSL_OP_ALL | SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3);
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+        if (tlsOptions.enable_ktls)
+        {
+            SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+        }
+#endif
+
+        if (tlsOptions.disable_session_resumption)
+        {
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+            SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+        }
+        else
+        {
+            // Sessions are resumed from the cache of the context, or from a ticket
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+            SSL_CTX_set_session_id_context(ctx,
+                                           (const unsigned char*) kSessionIdContext.c_str(),
+                                           (unsigned int) kSessionIdContext.size());
+            SSL_CTX_set_timeout(ctx, SocketOpenSSLContext::kTicketKeyLifetimeSecs);
+        }
+
+        ERR_clear_error();
+        if (tlsOptions.isUsingInMemoryCertAndKey())
+        {
+            if (!openSSLUseCertAndKeyFromMemory(ctx, tlsOptions, errMsg))
             {
-                return false;
+                SSL_CTX_free(ctx);
+                return nullptr;
             }
-
+        }
+        else if (tlsOptions.hasCertAndKey())
+        {
+            if (SSL_CTX_use_certificate_chain_file(ctx, tlsOptions.certFile.c_str()) != 1)
             {
-                const SSL_METHOD* method = SSLv23_server_method();
-                if (method == nullptr)
-                {
-                    errMsg = "SSLv23_server_method failure";
-                    _ssl_context = nullptr;
-                }
-                else
-                {
-                    _ssl_method = method;
-
-                    _ssl_context = SSL_CTX_new(_ssl_method);
-                    if (_ssl_context)
-                    {
-                        SSL_CTX_set_mode(_ssl_context, SSL_MODE_ENABLE_PARTIAL_WRITE);
-                        SSL_CTX_set_mode(_ssl_context, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
-                        SSL_CTX_set_options(_ssl_context,
-                                            SSL_OP_ALL | SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3);
-                    }
-                }
+                auto sslErr = ERR_get_error();
+                errMsg = "OpenSSL failed - SSL_CTX_use_certificate_chain_file(\"" +
+                         tlsOptions.certFile + "\") failed: ";
+                errMsg += ERR_error_string(sslErr, nullptr);
+                SSL_CTX_free(ctx);
+                return nullptr;
             }
-
-            if (_ssl_context == nullptr)
+            else if (SSL_CTX_use_PrivateKey_file(
+                         ctx, tlsOptions.keyFile.c_str(), SSL_FILETYPE_PEM) != 1)
             {
-                return false;
+                auto sslErr = ERR_get_error();
+                errMsg = "OpenSSL failed - SSL_CTX_use_PrivateKey_file(\"" + tlsOptions.keyFile +
+                         "\") failed: ";
+                errMsg += ERR_error_string(sslErr, nullptr);
+                SSL_CTX_free(ctx);
+                return nullptr;
             }
+        }
 
-            ERR_clear_error();
-            if (_tlsOptions.hasCertAndKey())
+        ERR_clear_error();
+        if (!tlsOptions.isPeerVerifyDisabled())
+        {
+            if (tlsOptions.isUsingSystemDefaults())
             {
-                if (SSL_CTX_use_certificate_chain_file(_ssl_context,
-                                                       _tlsOptions.certFile.c_str()) != 1)
-                {
-                    auto sslErr = ERR_get_error();
-                    errMsg = "OpenSSL failed - SSL_CTX_use_certificate_chain_file(\"" +
-                             _tlsOptions.certFile + "\") failed: ";
-                    errMsg += ERR_error_string(sslErr, nullptr);
-                }
-                else if (SSL_CTX_use_PrivateKey_file(
-                             _ssl_context, _tlsOptions.keyFile.c_str(), SSL_FILETYPE_PEM) != 1)
+                if (SSL_CTX_set_default_verify_paths(ctx) == 0)
                 {
                     auto sslErr = ERR_get_error();
-                    errMsg = "OpenSSL failed - SSL_CTX_use_PrivateKey_file(\"" +
-                             _tlsOptions.keyFile + "\") failed: ";
+                    errMsg = "OpenSSL failed - SSL_CTX_default_verify_paths loading failed: ";
                     errMsg += ERR_error_string(sslErr, nullptr);
+                    SSL_CTX_free(ctx);
+                    return nullptr;
                 }
             }
-
-
-            ERR_clear_error();
-            if (!_tlsOptions.isPeerVerifyDisabled())
+            else
             {
-                if (_tlsOptions.isUsingSystemDefaults())
+                if (tlsOptions.isUsingInMemoryCAs())
                 {
-                    if (SSL_CTX_set_default_verify_paths(_ssl_context) == 0)
-                    {
-                        auto sslErr = ERR_get_error();
-                        errMsg = "OpenSSL failed - SSL_CTX_default_verify_paths loading failed: ";
-                        errMsg += ERR_error_string(sslErr, nullptr);
-                    }
+                    // Load from memory
+                    openSSLAddCARootsFromString(ctx, tlsOptions.caFile);
                 }
                 else
                 {
-                    if (_tlsOptions.isUsingInMemoryCAs())
+                    const char* root_ca_file = tlsOptions.caFile.c_str();
+                    STACK_OF(X509_NAME) * rootCAs;
+                    rootCAs = SSL_load_client_CA_file(root_ca_file);
+                    if (rootCAs == NULL)
                     {
-                        // Load from memory
-                        openSSLAddCARootsFromString(_tlsOptions.caFile);
+                        auto sslErr = ERR_get_error();
+                        errMsg = "OpenSSL failed - SSL_load_client_CA_file('" +
+                                 tlsOptions.caFile + "') failed: ";
+                        errMsg += ERR_error_string(sslErr, nullptr);
+                        SSL_CTX_free(ctx);
+                        return nullptr;
                     }
-                    else
+
+                    SSL_CTX_set_client_CA_list(ctx, rootCAs);
+                    if (SSL_CTX_load_verify_locations(ctx, root_ca_file, nullptr) != 1)
                     {
-                        const char* root_ca_file = _tlsOptions.caFile.c_str();
-                        STACK_OF(X509_NAME) * rootCAs;
-                        rootCAs = SSL_load_client_CA_file(root_ca_file);
-                        if (rootCAs == NULL)
-                        {
-                            auto sslErr = ERR_get_error();
-                            errMsg = "OpenSSL failed - SSL_load_client_CA_file('" +
-                                     _tlsOptions.caFile + "') failed: ";
-                            errMsg += ERR_error_string(sslErr, nullptr);
-                        }
-                        else
-                        {
-                            SSL_CTX_set_client_CA_list(_ssl_context, rootCAs);
-                            if (SSL_CTX_load_verify_locations(
-                                    _ssl_context, root_ca_file, nullptr) != 1)
-                            {
-                                auto sslErr = ERR_get_error();
-                                errMsg = "OpenSSL failed - SSL_CTX_load_verify_locations(\"" +
-                                         _tlsOptions.caFile + "\") failed: ";
-                                errMsg += ERR_error_string(sslErr, nullptr);
-                            }
-                        }
+                        auto sslErr = ERR_get_error();
+                        errMsg = "OpenSSL failed - SSL_CTX_load_verify_locations(\"" +
+                                 tlsOptions.caFile + "\") failed: ";
+                        errMsg += ERR_error_string(sslErr, nullptr);
+                        SSL_CTX_free(ctx);
+                        return nullptr;
                     }
                 }
+            }
+
+            SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, nullptr);
+            SSL_CTX_set_verify_depth(ctx, 4);
+        }
+        else
+        {
+            SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr);
+        }
+
+        const std::string& ciphers =
+            (tlsOptions.isUsingDefaultCiphers()) ? kDefaultCiphers : tlsOptions.ciphers;
+        if (SSL_CTX_set_cipher_list(ctx, ciphers.c_str()) != 1)
+        {
+            auto sslErr = ERR_get_error();
+            errMsg = "OpenSSL failed - SSL_CTX_set_cipher_list(\"" + ciphers + "\") failed: ";
+            errMsg += ERR_error_string(sslErr, nullptr);
+            SSL_CTX_free(ctx);
+            return nullptr;
+        }
+
+        return ctx;
+    }
+
+    SocketTLSContextPtr SocketOpenSSL::createServerContext(const SocketTLSOptions& tlsOptions,
+                                                           std::string& errMsg)
+    {
+        std::call_once(_openSSLInitFlag, &SocketOpenSSL::openSSLInitialize);
+        if (!_openSSLInitializationSuccessful)
+        {
+            errMsg = "OPENSSL_init_ssl failure";
+            return nullptr;
+        }
 
-                SSL_CTX_set_verify(
-                    _ssl_context, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, nullptr);
-                SSL_CTX_set_verify_depth(_ssl_context, 4);
+        SSL_CTX* ctx = openSSLCreateServerContext(tlsOptions, errMsg);
+        if (ctx == nullptr) return nullptr;
+
+        // The tickets of a shared context outlive the connections, their keys are rotated
+        auto context = std::make_shared<SocketOpenSSLContext>(ctx);
+        if (!tlsOptions.disable_session_resumption && !context->enableTicketKeyRotation(errMsg))
+        {
+            return nullptr;
+        }
+
+        return context;
+    }
+
+    bool SocketOpenSSL::accept(std::string& errMsg)
+    {
+        bool handshakeSuccessful = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (!_openSSLInitializationSuccessful)
+            {
+                errMsg = "OPENSSL_init_ssl failure";
+                return false;
             }
-            else
+
+            if (_sockfd == -1)
             {
-                SSL_CTX_set_verify(_ssl_context, SSL_VERIFY_NONE, nullptr);
+                return false;
             }
-            if (_tlsOptions.isUsingDefaultCiphers())
+
+            // The context shared by the sockets of a server is already configured
+            if (_tlsContext)
             {
-                if (SSL_CTX_set_cipher_list(_ssl_context, kDefaultCiphers.c_str()) != 1)
-                {
-                    return false;
-                }
+                _ssl_context = static_cast<SocketOpenSSLContext*>(_tlsContext.get())->get();
             }
-            else if (SSL_CTX_set_cipher_list(_ssl_context, _tlsOptions.ciphers.c_str()) != 1)
+            else
+            {
+                _ssl_context = openSSLCreateServerContext(_tlsOptions, errMsg);
+            }
+
+            if (_ssl_context == nullptr)
             {
                 return false;
             }
@@ -700,7 +1092,7 @@ namespace ix
             if (_ssl_connection == nullptr)
             {
                 errMsg = "OpenSSL failed to connect";
-                SSL_CTX_free(_ssl_context);
+                if (!_tlsContext) SSL_CTX_free(_ssl_context);
                 _ssl_context = nullptr;
                 return false;
             }
@@ -710,6 +1102,7 @@ namespace ix
             SSL_set_fd(_ssl_connection, _sockfd);
 
             handshakeSuccessful = openSSLServerHandshake(errMsg);
+            if (handshakeSuccessful) openSSLCheckKernelTLS();
         }
 
         if (!handshakeSuccessful)
@@ -750,6 +1143,13 @@ namespace ix
                 return false;
             }
 
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+            if (_tlsOptions.enable_ktls)
+            {
+                SSL_CTX_set_options(_ssl_context, SSL_OP_ENABLE_KTLS);
+            }
+#endif
+
             _ssl_connection = SSL_new(_ssl_context);
             if (_ssl_connection == nullptr)
             {
@@ -760,6 +1160,16 @@ namespace ix
             }
             SSL_set_fd(_ssl_connection, _sockfd);
 
+            if (!_tlsOptions.disable_session_resumption)
+            {
+                _sessionKey = SocketTLSSessionCache::makeKey(host, port, _tlsOptions);
+                SSL_set_app_data(_ssl_connection, this);
+                SSL_CTX_set_session_cache_mode(
+                    _ssl_context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+                SSL_CTX_sess_set_new_cb(_ssl_context, &SocketOpenSSL::openSSLNewSessionCallback);
+                openSSLResumeSession();
+            }
+
             // SNI support
             SSL_set_tlsext_host_name(_ssl_connection, host.c_str());
 
@@ -789,10 +1199,16 @@ namespace ix
             }
 #endif
             handshakeSuccessful = openSSLClientHandshake(host, errMsg, isCancellationRequested);
+            if (handshakeSuccessful) openSSLCheckKernelTLS();
         }
 
         if (!handshakeSuccessful)
         {
+            // The session might be the reason
+            if (!_sessionKey.empty())
+            {
+                SocketTLSSessionCache::getClientCache().remove(_sessionKey);
+            }
             close();
             return false;
         }
@@ -800,10 +1216,20 @@ namespace ix
         return true;
     }
 
+    void SocketOpenSSL::openSSLCheckKernelTLS()
+    {
+        // The kernel takes over once the handshake is done, when it supports the cipher
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+        _kernelTLSSend = BIO_get_ktls_send(SSL_get_wbio(_ssl_connection)) != 0;
+#endif
+    }
+
     void SocketOpenSSL::close()
     {
         std::lock_guard<std::mutex> lock(_mutex);
 
+        _kernelTLSSend = false;
+
         if (_ssl_connection != nullptr)
         {
             SSL_free(_ssl_connection);
@@ -811,7 +1237,7 @@ namespace ix
         }
         if (_ssl_context != nullptr)
         {
-            SSL_CTX_free(_ssl_context);
+            if (!_tlsContext) SSL_CTX_free(_ssl_context);
             _ssl_context = nullptr;
         }
 
@@ -827,6 +1253,11 @@ namespace ix
             return 0;
         }
 
+        if (_kernelTLSSend)
+        {
+            return Socket::send(buf, nbyte);
+        }
+
         ERR_clear_error();
         std::ptrdiff_t write_result = SSL_write(_ssl_connection, buf, (int) nbyte);
         int reason = SSL_get_error(_ssl_connection, (int) write_result);
@@ -846,6 +1277,39 @@ namespace ix
         }
     }
 
+    bool SocketOpenSSL::isKernelTLSActive() const
+    {
+        return _kernelTLSSend;
+    }
+
+    bool SocketOpenSSL::isSessionResumed() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        return _ssl_connection != nullptr && SSL_session_reused(_ssl_connection) == 1;
+    }
+
+    std::ptrdiff_t SocketOpenSSL::sendv(const iovec* iov, int iovcnt)
+    {
+        // The kernel splits the buffers into records
+        if (_kernelTLSSend)
+        {
+            return Socket::sendv(iov, iovcnt);
+        }
+
+        return sendvCoalesced(iov, iovcnt);
+    }
+
+    std::ptrdiff_t SocketOpenSSL::sendFile(int fileFd, uint64_t offset, size_t length)
+    {
+        if (_kernelTLSSend)
+        {
+            return Socket::sendFile(fileFd, offset, length);
+        }
+
+        return sendFileCopy(fileFd, offset, length);
+    }
+
     std::ptrdiff_t SocketOpenSSL::recv(void* buf, size_t nbyte)
     {
         while (true)
@@ -9,7 +9,10 @@
 
 #include "IXCancellationRequest.h"
 #include "IXSocket.h"
+#include "IXSocketTLSContext.h"
 #include "IXSocketTLSOptions.h"
+#include <atomic>
+#include <chrono>
 #include <mutex>
 #include <openssl/bio.h>
 #include <openssl/conf.h>
@@ -19,12 +22,68 @@
 
 namespace ix
 {
+    class SocketOpenSSLContext final : public SocketTLSContext
+    {
+    public:
+        explicit SocketOpenSSLContext(SSL_CTX* ctx);
+        ~SocketOpenSSLContext();
+
+        SSL_CTX* get() const;
+
+        // Encrypt the session tickets with our own keys, replaced every
+        // kTicketKeyLifetimeSecs. The tickets encrypted with the previous key are still
+        // accepted, and renewed.
+        bool enableTicketKeyRotation(std::string& errMsg);
+
+        const static int kTicketKeyLifetimeSecs;
+
+    private:
+        struct TicketKey
+        {
+            unsigned char name[16];
+            unsigned char hmacKey[32];
+            unsigned char aesKey[32];
+            std::chrono::steady_clock::time_point createdAt;
+        };
+
+        SSL_CTX* _ctx;
+
+        std::mutex _ticketKeysMutex;
+        TicketKey _ticketKey;
+        TicketKey _previousTicketKey;
+        bool _hasPreviousTicketKey;
+
+        bool rotateTicketKeys(std::chrono::steady_clock::time_point now);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(LIBRESSL_VERSION_NUMBER)
+        static int ticketKeyCallback(SSL* ssl,
+                                     unsigned char* keyName,
+                                     unsigned char* iv,
+                                     EVP_CIPHER_CTX* cipherContext,
+                                     EVP_MAC_CTX* macContext,
+                                     int encrypt);
+#else
+        static int ticketKeyCallback(SSL* ssl,
+                                     unsigned char* keyName,
+                                     unsigned char* iv,
+                                     EVP_CIPHER_CTX* cipherContext,
+                                     HMAC_CTX* macContext,
+                                     int encrypt);
+#endif
+    };
+
     class SocketOpenSSL final : public Socket
     {
     public:
-        SocketOpenSSL(const SocketTLSOptions& tlsOptions, int fd = -1);
+        SocketOpenSSL(const SocketTLSOptions& tlsOptions,
+                      int fd = -1,
+                      const SocketTLSContextPtr& tlsContext = nullptr);
         ~SocketOpenSSL();
 
+        // Build a server context from the options, see createServerTLSContext()
+        static SocketTLSContextPtr createServerContext(const SocketTLSOptions& tlsOptions,
+                                                       std::string& errMsg);
+
         virtual bool accept(std::string& errMsg) final;
 
         virtual bool connect(const std::string& host,
@@ -34,13 +93,24 @@ namespace ix
         virtual void close() final;
 
         virtual std::ptrdiff_t send(char* buffer, size_t length) final;
+        virtual std::ptrdiff_t sendv(const iovec* iov, int iovcnt) final;
         virtual std::ptrdiff_t recv(void* buffer, size_t length) final;
 
+        virtual std::ptrdiff_t sendFile(int fileFd, uint64_t offset, size_t length) final;
+
+        virtual bool isSessionResumed() const final;
+        virtual bool isKernelTLSActive() const final;
+
     private:
-        void openSSLInitialize();
+        static void openSSLInitialize();
         std::string getSSLError(int ret);
         SSL_CTX* openSSLCreateContext(std::string& errMsg);
-        bool openSSLAddCARootsFromString(const std::string roots);
+        static SSL_CTX* openSSLCreateServerContext(const SocketTLSOptions& tlsOptions,
+                                                   std::string& errMsg);
+        static bool openSSLAddCARootsFromString(SSL_CTX* ctx, const std::string roots);
+        static bool openSSLUseCertAndKeyFromMemory(SSL_CTX* ctx,
+                                                   const SocketTLSOptions& tlsOptions,
+                                                   std::string& errMsg);
         bool openSSLClientHandshake(const std::string& hostname,
                                     std::string& errMsg,
                                     const CancellationRequest& isCancellationRequested);
@@ -49,6 +119,15 @@ namespace ix
         bool handleTLSOptions(std::string& errMsg);
         bool openSSLServerHandshake(std::string& errMsg);
 
+        // Once the kernel encrypts the records, data is sent with the plain socket calls
+        void openSSLCheckKernelTLS();
+        std::atomic<bool> _kernelTLSSend;
+
+        // Client sessions, see SocketTLSSessionCache
+        void openSSLResumeSession();
+        static int openSSLNewSessionCallback(SSL* ssl, SSL_SESSION* session);
+        std::string _sessionKey;
+
         // Required for OpenSSL < 1.1
         static void openSSLLockingCallback(int mode, int type, const char* /*file*/, int /*line*/);
 
@@ -57,6 +136,9 @@ namespace ix
         const SSL_METHOD* _ssl_method;
         SocketTLSOptions _tlsOptions;
 
+        // Owns _ssl_context when it is shared with other accepted sockets
+        SocketTLSContextPtr _tlsContext;
+
         mutable std::mutex _mutex; // OpenSSL routines are not thread-safe
 
         static std::once_flag _openSSLInitFlag;
@@ -14,12 +14,59 @@
 #include "IXSocketConnect.h"
 #include "IXSocketFactory.h"
 #include <assert.h>
+#include <deque>
 #include <sstream>
 #include <stdio.h>
 #include <string.h>
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#if defined(__linux__) && defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC)
+#define IXWEBSOCKET_USE_ACCEPT4
+#endif
+
 namespace ix
 {
+    namespace
+    {
+        // accept4 sets the flags of the new socket, which saves a fcntl call
+        // for each of them
+        int acceptSocket(socket_t serverFd, struct sockaddr_storage& address, bool closeOnExec)
+        {
+            // Use sockaddr_storage to accommodate both AF_INET and AF_INET6 addresses.
+            // sockaddr_in is only 16 bytes; sockaddr_in6 is 28 bytes. On Windows, passing
+            // a too-small buffer to accept() causes WSAEFAULT (error 10014).
+            socklen_t addressLen = sizeof(address);
+            memset(&address, 0, sizeof(address));
+
+#ifdef IXWEBSOCKET_USE_ACCEPT4
+            int flags = SOCK_NONBLOCK;
+            if (closeOnExec) flags |= SOCK_CLOEXEC;
+            return accept4(serverFd, (struct sockaddr*) &address, &addressLen, flags);
+#else
+            (void) closeOnExec;
+            return static_cast<int>(accept(serverFd, (struct sockaddr*) &address, &addressLen));
+#endif
+        }
+    } // namespace
+
+    struct SocketServer::WorkerPool
+    {
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<std::pair<std::unique_ptr<Socket>, std::shared_ptr<ConnectionState>>>
+            connections;
+        bool stop = false;
+
+#ifdef _WIN32
+        std::vector<std::thread> threads;
+#else
+        std::vector<pthread_t> threads;
+#endif
+    };
+
     const int SocketServer::kDefaultPort(8080);
     const std::string SocketServer::kDefaultHost("127.0.0.1");
     const int SocketServer::kDefaultTcpBacklog(5);
@@ -33,8 +80,12 @@ namespace ix
         , _backlog(backlog)
         , _maxConnections(maxConnections)
         , _addressFamily(addressFamily)
-        , _serverFd(-1)
+        , _acceptorsCount(1)
         , _stop(false)
+        , _stopSetup(false)
+        , _workerPoolThreads(0)
+        , _workerPoolStackSize(0)
+        , _workerPoolQueuedCount(0)
         , _stopGc(false)
         , _connectionStateFactory(&ConnectionState::createConnectionState)
         , _acceptSelectInterrupt(createSelectInterrupt())
@@ -93,8 +144,27 @@ namespace ix
             return std::make_pair(false, errMsg);
         }
 
+        _acceptedConnectionsCounts = std::vector<std::atomic<uint64_t>>(_acceptorsCount);
+
+        for (size_t i = 0; i < _acceptorsCount; ++i)
+        {
+            socket_t serverFd = -1;
+            auto res = listenOnSocket(serverFd);
+            if (!res.first)
+            {
+                closeServerSockets();
+                return res;
+            }
+            _serverFds.push_back(serverFd);
+        }
+
+        return std::make_pair(true, "");
+    }
+
+    std::pair<bool, std::string> SocketServer::listenOnSocket(socket_t& serverFd)
+    {
         // Get a socket for accepting connections.
-        if ((_serverFd = socket(_addressFamily, SOCK_STREAM, 0)) < 0)
+        if ((serverFd = socket(_addressFamily, SOCK_STREAM, 0)) < 0)
         {
             std::stringstream ss;
             ss << "SocketServer::listen() error creating socket): " << strerror(Socket::getErrno());
@@ -104,30 +174,46 @@ namespace ix
 
         if (_closeOnExec)
         {
-            if (!Socket::setCloseOnExec(_serverFd))
+            if (!Socket::setCloseOnExec(serverFd))
             {
                 std::stringstream ss;
                 ss << "SocketServer::listen() error setting close on exec: "
                    << strerror(Socket::getErrno());
 
-                Socket::closeSocket(_serverFd);
-                _serverFd = -1;
+                Socket::closeSocket(serverFd);
+                serverFd = -1;
                 return std::make_pair(false, ss.str());
             }
         }
 
         // Make that socket reusable. (allow restarting this server at will)
         int enable = 1;
-        if (setsockopt(_serverFd, SOL_SOCKET, SO_REUSEADDR, (char*) &enable, sizeof(enable)) < 0)
+        if (setsockopt(serverFd, SOL_SOCKET, SO_REUSEADDR, (char*) &enable, sizeof(enable)) < 0)
         {
             std::stringstream ss;
             ss << "SocketServer::listen() error calling setsockopt(SO_REUSEADDR) "
                << "at address " << _host << ":" << _port << " : " << strerror(Socket::getErrno());
 
-            Socket::closeSocket(_serverFd);
-            _serverFd = -1;
+            Socket::closeSocket(serverFd);
+            serverFd = -1;
+            return std::make_pair(false, ss.str());
+        }
+
+#ifdef SO_REUSEPORT
+        // Let the acceptors bind to the same address, the kernel spreads the incoming
+        // connections between them
+        if (_acceptorsCount > 1 &&
+            setsockopt(serverFd, SOL_SOCKET, SO_REUSEPORT, (char*) &enable, sizeof(enable)) < 0)
+        {
+            std::stringstream ss;
+            ss << "SocketServer::listen() error calling setsockopt(SO_REUSEPORT) "
+               << "at address " << _host << ":" << _port << " : " << strerror(Socket::getErrno());
+
+            Socket::closeSocket(serverFd);
+            serverFd = -1;
             return std::make_pair(false, ss.str());
         }
+#endif
 
         if (_addressFamily == AF_INET)
         {
@@ -143,21 +229,21 @@ namespace ix
                    << "at address " << _host << ":" << _port << " : "
                    << strerror(Socket::getErrno());
 
-                Socket::closeSocket(_serverFd);
-                _serverFd = -1;
+                Socket::closeSocket(serverFd);
+                serverFd = -1;
                 return std::make_pair(false, ss.str());
             }
 
             // Bind the socket to the server address.
-            if (bind(_serverFd, (struct sockaddr*) &server, sizeof(server)) < 0)
+            if (bind(serverFd, (struct sockaddr*) &server, sizeof(server)) < 0)
             {
                 std::stringstream ss;
                 ss << "SocketServer::listen() error calling bind "
                    << "at address " << _host << ":" << _port << " : "
                    << strerror(Socket::getErrno());
 
-                Socket::closeSocket(_serverFd);
-                _serverFd = -1;
+                Socket::closeSocket(serverFd);
+                serverFd = -1;
                 return std::make_pair(false, ss.str());
             }
         }
@@ -175,21 +261,21 @@ namespace ix
                    << "at address " << _host << ":" << _port << " : "
                    << strerror(Socket::getErrno());
 
-                Socket::closeSocket(_serverFd);
-                _serverFd = -1;
+                Socket::closeSocket(serverFd);
+                serverFd = -1;
                 return std::make_pair(false, ss.str());
             }
 
             // Bind the socket to the server address.
-            if (bind(_serverFd, (struct sockaddr*) &server, sizeof(server)) < 0)
+            if (bind(serverFd, (struct sockaddr*) &server, sizeof(server)) < 0)
             {
                 std::stringstream ss;
                 ss << "SocketServer::listen() error calling bind "
                    << "at address " << _host << ":" << _port << " : "
                    << strerror(Socket::getErrno());
 
-                Socket::closeSocket(_serverFd);
-                _serverFd = -1;
+                Socket::closeSocket(serverFd);
+                serverFd = -1;
                 return std::make_pair(false, ss.str());
             }
         }
@@ -197,14 +283,14 @@ namespace ix
         //
         // Listen for connections. Specify the tcp backlog.
         //
-        if (::listen(_serverFd, _backlog) < 0)
+        if (::listen(serverFd, _backlog) < 0)
         {
             std::stringstream ss;
             ss << "SocketServer::listen() error calling listen "
                << "at address " << _host << ":" << _port << " : " << strerror(Socket::getErrno());
 
-            Socket::closeSocket(_serverFd);
-            _serverFd = -1;
+            Socket::closeSocket(serverFd);
+            serverFd = -1;
             return std::make_pair(false, ss.str());
         }
 
@@ -215,12 +301,28 @@ namespace ix
     {
         _stop = false;
 
-        if (!_thread.joinable())
+        if (_acceptThreads.empty())
         {
-            _thread = std::thread(&SocketServer::run, this);
+            _stopSetup = false;
+            for (size_t i = 0; i < _serverFds.size(); ++i)
+            {
+                _handoffQueues.emplace_back(new HandoffQueue());
+            }
+
+            for (size_t i = 0; i < _serverFds.size(); ++i)
+            {
+                _setupThreads.push_back(
+                    std::thread(&SocketServer::runSetup, this, std::ref(*_handoffQueues[i]), i));
+                _acceptThreads.push_back(std::thread(&SocketServer::run, this, _serverFds[i], i));
+            }
         }
 
-        if (!_gcThread.joinable())
+        if (_workerPoolThreads > 0)
+        {
+            // Workers are never joined one by one, no need for the gc thread
+            if (!_workerPool) startWorkerPool();
+        }
+        else if (!_gcThread.joinable())
         {
             _gcThread = std::thread(&SocketServer::runGC, this);
         }
@@ -239,20 +341,32 @@ namespace ix
 
     void SocketServer::stop()
     {
-        // Stop accepting connections, and close the 'accept' thread
-        if (_thread.joinable())
+        // Stop accepting connections, and close the 'accept' threads
+        if (!_acceptThreads.empty())
         {
             _stop = true;
-            // Wake up select
-            if (!_acceptSelectInterrupt->notify(SelectInterrupt::kCloseRequest))
+            // Wake up select, once for each thread as each of them consumes a request
+            for (size_t i = 0; i < _acceptThreads.size(); ++i)
             {
-                logError("SocketServer::stop: Cannot wake up from select");
+                if (!_acceptSelectInterrupt->notify(SelectInterrupt::kCloseRequest))
+                {
+                    logError("SocketServer::stop: Cannot wake up from select");
+                }
+            }
+
+            for (auto&& thread : _acceptThreads)
+            {
+                thread.join();
             }
+            _acceptThreads.clear();
 
-            _thread.join();
+            // _stop is still set, so the sockets left in the queues are closed
+            stopSetupThreads();
             _stop = false;
         }
 
+        stopWorkerPool();
+
         // Join all threads and make sure that all connections are terminated
         if (_gcThread.joinable())
         {
@@ -268,14 +382,167 @@ namespace ix
 
         _conditionVariable.notify_one();
 
+        closeServerSockets();
+    }
+
+    void SocketServer::closeServerSockets()
+    {
         // stop() runs again from ~WebSocketServer() and ~SocketServer(), so
-        // close the listening fd exactly once: a second close of the stale
+        // close the listening fds exactly once: a second close of the stale
         // number would destroy whatever descriptor another thread has since
         // opened with it.
-        if (_serverFd != -1)
+        for (auto serverFd : _serverFds)
         {
-            Socket::closeSocket(_serverFd);
-            _serverFd = -1;
+            Socket::closeSocket(serverFd);
+        }
+        _serverFds.clear();
+    }
+
+    void SocketServer::stopSetupThreads()
+    {
+        _stopSetup = true;
+        for (auto&& queue : _handoffQueues)
+        {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            queue->condition.notify_one();
+        }
+
+        for (auto&& thread : _setupThreads)
+        {
+            thread.join();
+        }
+        _setupThreads.clear();
+        _handoffQueues.clear();
+    }
+
+    bool SocketServer::enableReusePort(size_t acceptors)
+    {
+#ifdef SO_REUSEPORT
+        _acceptorsCount = (acceptors == 0) ? 1 : acceptors;
+        return true;
+#else
+        (void) acceptors;
+        return false;
+#endif
+    }
+
+    bool SocketServer::enableWorkerPool(size_t threads, size_t stackSize)
+    {
+        if (threads == 0) return false;
+
+        _workerPoolThreads = threads;
+        _workerPoolStackSize = stackSize;
+        return true;
+    }
+
+    void SocketServer::startWorkerPool()
+    {
+        _workerPool.reset(new WorkerPool());
+
+        for (size_t i = 0; i < _workerPoolThreads; ++i)
+        {
+#ifdef _WIN32
+            _workerPool->threads.push_back(std::thread(&SocketServer::runWorker, this));
+#else
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+
+            if (_workerPoolStackSize > 0)
+            {
+                int err = pthread_attr_setstacksize(&attr, _workerPoolStackSize);
+                if (err != 0)
+                {
+                    std::stringstream ss;
+                    ss << "SocketServer::startWorkerPool() invalid stack size "
+                       << _workerPoolStackSize << ": " << strerror(err);
+                    logError(ss.str());
+                }
+            }
+
+            pthread_t thread;
+            int err = pthread_create(&thread, &attr, &SocketServer::runWorkerThread, this);
+            pthread_attr_destroy(&attr);
+
+            if (err != 0)
+            {
+                std::stringstream ss;
+                ss << "SocketServer::startWorkerPool() cannot create worker thread: "
+                   << strerror(err);
+                logError(ss.str());
+                break;
+            }
+            _workerPool->threads.push_back(thread);
+#endif
+        }
+
+        if (_workerPool->threads.empty())
+        {
+            // Fall back to a thread per connection
+            _workerPool.reset();
+            if (!_gcThread.joinable())
+            {
+                _gcThread = std::thread(&SocketServer::runGC, this);
+            }
+        }
+    }
+
+    void SocketServer::stopWorkerPool()
+    {
+        if (!_workerPool) return;
+
+        {
+            std::lock_guard<std::mutex> lock(_workerPool->mutex);
+            _workerPool->stop = true;
+        }
+        _workerPool->condition.notify_all();
+
+        for (auto&& thread : _workerPool->threads)
+        {
+#ifdef _WIN32
+            thread.join();
+#else
+            pthread_join(thread, nullptr);
+#endif
+        }
+
+        // Drop the connections which never got a worker
+        _workerPool.reset();
+        _workerPoolQueuedCount = 0;
+    }
+
+    void* SocketServer::runWorkerThread(void* socketServer)
+    {
+        static_cast<SocketServer*>(socketServer)->runWorker();
+        return nullptr;
+    }
+
+    void SocketServer::runWorker()
+    {
+        // $ echo Srv:wk:64000 | wc -c
+        // 13
+        std::string threadName = "Srv:wk:" + std::to_string(_port);
+        setThreadName(threadName);
+        WorkerPool& pool = *_workerPool;
+
+        for (;;)
+        {
+            std::unique_ptr<Socket> socket;
+            std::shared_ptr<ConnectionState> connectionState;
+            {
+                std::unique_lock<std::mutex> lock(pool.mutex);
+                pool.condition.wait(lock, [&pool] { return pool.stop || !pool.connections.empty(); });
+                if (pool.stop) return;
+
+                socket = std::move(pool.connections.front().first);
+                connectionState = pool.connections.front().second;
+                pool.connections.pop_front();
+                --_workerPoolQueuedCount;
+            }
+
+            handleConnection(std::move(socket), connectionState);
+
+            // handleConnection can rename the thread after the connection
+            setThreadName(threadName);
         }
     }
 
@@ -314,15 +581,23 @@ namespace ix
         }
     }
 
-    void SocketServer::run()
+    void SocketServer::run(socket_t serverFd, size_t index)
     {
         // Set the socket to non blocking mode, so that accept calls are not blocking
-        SocketConnect::configure(_serverFd);
+        SocketConnect::configure(serverFd);
 
         // Use a cryptic name to stay within the 16 bytes limit thread name limitation
-        // $ echo Srv:gc:64000 | wc -c
-        // 13
-        setThreadName("Srv:ac:" + std::to_string(_port));
+        // $ echo Srv:ac:64000:99 | wc -c
+        // 16
+        std::string threadName = "Srv:ac:" + std::to_string(_port);
+        if (_serverFds.size() > 1)
+        {
+            threadName += ":" + std::to_string(index);
+        }
+        setThreadName(threadName);
+
+        HandoffQueue& queue = *_handoffQueues[index];
+        std::vector<AcceptedSocket> sockets;
 
         for (;;)
         {
@@ -337,7 +612,7 @@ namespace ix
 
             bool readyToRead = true;
             PollResultType pollResult =
-                Socket::poll(readyToRead, timeoutMs, _serverFd, _acceptSelectInterrupt);
+                Socket::poll(readyToRead, timeoutMs, serverFd, _acceptSelectInterrupt);
 
             if (pollResult == PollResultType::Error)
             {
@@ -352,44 +627,28 @@ namespace ix
                 continue;
             }
 
-            // Accept a connection.
-            // Use sockaddr_storage to accommodate both AF_INET and AF_INET6 addresses.
-            // sockaddr_in is only 16 bytes; sockaddr_in6 is 28 bytes. On Windows, passing
-            // a too-small buffer to accept() causes WSAEFAULT (error 10014).
-            struct sockaddr_storage client; // client address information (IPv4 or IPv6)
-            int clientFd;                   // socket connected to client
-            socklen_t addressLen = sizeof(client);
-            memset(&client, 0, sizeof(client));
-
-            if ((clientFd = static_cast<int>(accept(_serverFd, (struct sockaddr*) &client, &addressLen))) < 0)
+            // Accept all the pending connections, a burst of clients connecting
+            // at once is served by a single poll wake up
+            while (!_stop)
             {
-                if (!Socket::isWaitNeeded())
+                AcceptedSocket acceptedSocket;
+                int clientFd = acceptSocket(serverFd, acceptedSocket.address, _closeOnExec);
+                if (clientFd < 0)
                 {
-                    // FIXME: that error should be propagated
-                    int err = Socket::getErrno();
-                    std::stringstream ss;
-                    ss << "SocketServer::run() error accepting connection: " << err << ", "
-                       << strerror(err);
-                    logError(ss.str());
+                    if (!Socket::isWaitNeeded())
+                    {
+                        // FIXME: that error should be propagated
+                        int err = Socket::getErrno();
+                        std::stringstream ss;
+                        ss << "SocketServer::run() error accepting connection: " << err << ", "
+                           << strerror(err);
+                        logError(ss.str());
+                    }
+                    break;
                 }
-                continue;
-            }
 
-            if (getConnectedClientsCount() >= _maxConnections)
-            {
-                std::stringstream ss;
-                ss << "SocketServer::run() reached max connections = " << _maxConnections << ". "
-                   << "Not accepting connection";
-                logError(ss.str());
-
-                Socket::closeSocket(clientFd);
-
-                continue;
-            }
-
-            if (_closeOnExec)
-            {
-                if (!Socket::setCloseOnExec(clientFd))
+#ifndef IXWEBSOCKET_USE_ACCEPT4
+                if (_closeOnExec && !Socket::setCloseOnExec(clientFd))
                 {
                     int err = Socket::getErrno();
                     std::stringstream ss;
@@ -401,96 +660,226 @@ namespace ix
 
                     continue;
                 }
+#endif
+
+                acceptedSocket.fd = clientFd;
+                sockets.push_back(acceptedSocket);
             }
 
-            // Retrieve connection info, the ip address of the remote peer/client)
-            std::string remoteIp;
-            int remotePort;
+            _acceptedConnectionsCounts[index] += sockets.size();
+            handOff(queue, sockets);
+        }
+    }
+
+    std::vector<uint64_t> SocketServer::getAcceptedConnectionsCounts() const
+    {
+        std::vector<uint64_t> counts;
+        for (auto&& count : _acceptedConnectionsCounts)
+        {
+            counts.push_back(count);
+        }
+        return counts;
+    }
 
-            if (_addressFamily == AF_INET)
+    void SocketServer::handOff(HandoffQueue& queue, std::vector<AcceptedSocket>& sockets)
+    {
+        if (sockets.empty()) return;
+
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.sockets.empty())
             {
-                char remoteIp4[INET_ADDRSTRLEN];
-                auto* client4 = reinterpret_cast<struct sockaddr_in*>(&client);
-                if (ix::inet_ntop(AF_INET, &client4->sin_addr, remoteIp4, INET_ADDRSTRLEN) == nullptr)
-                {
-                    int err = Socket::getErrno();
-                    std::stringstream ss;
-                    ss << "SocketServer::run() error calling inet_ntop (ipv4): " << err << ", "
-                       << strerror(err);
-                    logError(ss.str());
+                // Swap to keep the capacity of both vectors
+                queue.sockets.swap(sockets);
+            }
+            else
+            {
+                queue.sockets.insert(queue.sockets.end(), sockets.begin(), sockets.end());
+                sockets.clear();
+            }
+        }
+        queue.condition.notify_one();
+    }
 
-                    Socket::closeSocket(clientFd);
+    void SocketServer::runSetup(HandoffQueue& queue, size_t index)
+    {
+        // $ echo Srv:su:64000:99 | wc -c
+        // 16
+        std::string threadName = "Srv:su:" + std::to_string(_port);
+        if (_serverFds.size() > 1)
+        {
+            threadName += ":" + std::to_string(index);
+        }
+        setThreadName(threadName);
 
-                    continue;
-                }
+        std::vector<AcceptedSocket> sockets;
 
-                remotePort = ix::network_to_host_short(client4->sin_port);
-                remoteIp = remoteIp4;
-            }
-            else // AF_INET6
+        for (;;)
+        {
             {
-                char remoteIp6[INET6_ADDRSTRLEN];
-                auto* client6 = reinterpret_cast<struct sockaddr_in6*>(&client);
-                if (ix::inet_ntop(AF_INET6, &client6->sin6_addr, remoteIp6, INET6_ADDRSTRLEN) ==
-                    nullptr)
-                {
-                    int err = Socket::getErrno();
-                    std::stringstream ss;
-                    ss << "SocketServer::run() error calling inet_ntop (ipv6): " << err << ", "
-                       << strerror(err);
-                    logError(ss.str());
+                std::unique_lock<std::mutex> lock(queue.mutex);
+                queue.condition.wait(lock,
+                                     [this, &queue] { return _stopSetup || !queue.sockets.empty(); });
 
-                    Socket::closeSocket(clientFd);
+                if (queue.sockets.empty()) return;
+                sockets.swap(queue.sockets);
+            }
 
+            for (auto&& acceptedSocket : sockets)
+            {
+                if (_stop)
+                {
+                    Socket::closeSocket(acceptedSocket.fd);
                     continue;
                 }
 
-                remotePort = ix::network_to_host_short(client6->sin6_port);
-                remoteIp = remoteIp6;
+                setupConnection(acceptedSocket);
             }
+            sockets.clear();
+        }
+    }
 
-            std::shared_ptr<ConnectionState> connectionState;
-            if (_connectionStateFactory)
-            {
-                connectionState = _connectionStateFactory();
-            }
-            connectionState->setOnSetTerminatedCallback([this] { onSetTerminatedCallback(); });
-            connectionState->setRemoteIp(remoteIp);
-            connectionState->setRemotePort(remotePort);
+    void SocketServer::setupConnection(const AcceptedSocket& acceptedSocket)
+    {
+        int clientFd = static_cast<int>(acceptedSocket.fd);
 
-            if (_stop) return;
+        if (getConnectedClientsCount() + _workerPoolQueuedCount >= _maxConnections)
+        {
+            std::stringstream ss;
+            ss << "SocketServer::run() reached max connections = " << _maxConnections << ". "
+               << "Not accepting connection";
+            logError(ss.str());
+
+            Socket::closeSocket(clientFd);
+
+            return;
+        }
 
-            // create socket
-            std::string errorMsg;
-            bool tls = _socketTLSOptions.tls;
-            auto socket = createSocket(tls, clientFd, errorMsg, _socketTLSOptions);
+        // Retrieve connection info, the ip address of the remote peer/client)
+        std::string remoteIp;
+        int remotePort;
 
-            if (socket == nullptr)
+        if (_addressFamily == AF_INET)
+        {
+            char remoteIp4[INET_ADDRSTRLEN];
+            auto* client4 = reinterpret_cast<const struct sockaddr_in*>(&acceptedSocket.address);
+            if (ix::inet_ntop(AF_INET, &client4->sin_addr, remoteIp4, INET_ADDRSTRLEN) == nullptr)
             {
-                logError("SocketServer::run() cannot create socket for client " + remoteIp + ":" +
-                         std::to_string(remotePort) + ": " + errorMsg);
+                int err = Socket::getErrno();
+                std::stringstream ss;
+                ss << "SocketServer::run() error calling inet_ntop (ipv4): " << err << ", "
+                   << strerror(err);
+                logError(ss.str());
+
                 Socket::closeSocket(clientFd);
-                continue;
-            }
 
-            // Set the socket to non blocking mode + other tweaks
-            SocketConnect::configure(clientFd);
+                return;
+            }
 
-            if (!socket->accept(errorMsg))
+            remotePort = ix::network_to_host_short(client4->sin_port);
+            remoteIp = remoteIp4;
+        }
+        else // AF_INET6
+        {
+            char remoteIp6[INET6_ADDRSTRLEN];
+            auto* client6 = reinterpret_cast<const struct sockaddr_in6*>(&acceptedSocket.address);
+            if (ix::inet_ntop(AF_INET6, &client6->sin6_addr, remoteIp6, INET6_ADDRSTRLEN) ==
+                nullptr)
             {
-                logError("SocketServer::run() tls accept failed for client " + remoteIp + ":" +
-                         std::to_string(remotePort) + ": " + errorMsg);
+                int err = Socket::getErrno();
+                std::stringstream ss;
+                ss << "SocketServer::run() error calling inet_ntop (ipv6): " << err << ", "
+                   << strerror(err);
+                logError(ss.str());
+
                 Socket::closeSocket(clientFd);
-                continue;
+
+                return;
             }
 
-            // Launch the handleConnection work asynchronously in its own thread.
-            std::lock_guard<std::mutex> lock(_connectionsThreadsMutex);
-            _connectionsThreads.push_back(std::make_pair(
-                connectionState,
-                std::thread(
-                    &SocketServer::handleConnection, this, std::move(socket), connectionState)));
+            remotePort = ix::network_to_host_short(client6->sin6_port);
+            remoteIp = remoteIp6;
+        }
+
+        std::shared_ptr<ConnectionState> connectionState;
+        if (_connectionStateFactory)
+        {
+            connectionState = _connectionStateFactory();
+        }
+        connectionState->setOnSetTerminatedCallback([this] { onSetTerminatedCallback(); });
+        connectionState->setRemoteIp(remoteIp);
+        connectionState->setRemotePort(remotePort);
+
+        if (_stop)
+        {
+            Socket::closeSocket(clientFd);
+            return;
         }
+
+        // create socket
+        std::string errorMsg;
+        SocketTLSOptions tlsOptions;
+        SocketTLSContextPtr tlsContext;
+        if (!getTLSContext(tlsOptions, tlsContext, errorMsg))
+        {
+            logError("SocketServer::run() cannot create the tls context for client " +
+                     remoteIp + ":" + std::to_string(remotePort) + ": " + errorMsg);
+            Socket::closeSocket(clientFd);
+            return;
+        }
+
+        bool tls = tlsOptions.tls;
+        auto socket = createSocket(tls, clientFd, errorMsg, tlsOptions, tlsContext);
+
+        if (socket == nullptr)
+        {
+            logError("SocketServer::run() cannot create socket for client " + remoteIp + ":" +
+                     std::to_string(remotePort) + ": " + errorMsg);
+            Socket::closeSocket(clientFd);
+            return;
+        }
+
+        // Set the socket to non blocking mode + other tweaks
+#ifdef IXWEBSOCKET_USE_ACCEPT4
+        SocketConnect::configure(clientFd, true);
+#else
+        SocketConnect::configure(clientFd);
+#endif
+
+        if (!socket->accept(errorMsg))
+        {
+            logError("SocketServer::run() tls accept failed for client " + remoteIp + ":" +
+                     std::to_string(remotePort) + ": " + errorMsg);
+            Socket::closeSocket(clientFd);
+            return;
+        }
+
+        dispatchConnection(std::move(socket), connectionState);
+    }
+
+    void SocketServer::dispatchConnection(std::unique_ptr<Socket> socket,
+                                          std::shared_ptr<ConnectionState> connectionState)
+    {
+        if (_workerPool)
+        {
+            // Nothing to track: the worker is done with the connection once
+            // handleConnection returns
+            {
+                std::lock_guard<std::mutex> lock(_workerPool->mutex);
+                _workerPool->connections.push_back(
+                    std::make_pair(std::move(socket), connectionState));
+                ++_workerPoolQueuedCount;
+            }
+            _workerPool->condition.notify_one();
+            return;
+        }
+
+        // Launch the handleConnection work asynchronously in its own thread.
+        std::lock_guard<std::mutex> lock(_connectionsThreadsMutex);
+        _connectionsThreads.push_back(std::make_pair(
+            connectionState,
+            std::thread(
+                &SocketServer::handleConnection, this, std::move(socket), connectionState)));
     }
 
     size_t SocketServer::getConnectionsThreadsCount()
@@ -534,7 +923,54 @@ namespace ix
 
     void SocketServer::setTLSOptions(const SocketTLSOptions& socketTLSOptions)
     {
+        std::lock_guard<std::mutex> lock(_tlsContextMutex);
         _socketTLSOptions = socketTLSOptions;
+        _tlsContext.reset();
+    }
+
+    bool SocketServer::getTLSContext(SocketTLSOptions& tlsOptions,
+                                     SocketTLSContextPtr& tlsContext,
+                                     std::string& errorMsg)
+    {
+        std::lock_guard<std::mutex> lock(_tlsContextMutex);
+        tlsOptions = _socketTLSOptions;
+
+        if (tlsOptions.tls && !_tlsContext)
+        {
+            // Backends without a shared context return none, without error, and
+            // their sockets load the options themselves
+            _tlsContext = createServerTLSContext(tlsOptions, errorMsg);
+            if (!_tlsContext && !errorMsg.empty()) return false;
+        }
+
+        tlsContext = _tlsContext;
+        return true;
+    }
+
+    std::pair<bool, std::string> SocketServer::reloadTLSContext()
+    {
+        SocketTLSOptions tlsOptions;
+        {
+            std::lock_guard<std::mutex> lock(_tlsContextMutex);
+            tlsOptions = _socketTLSOptions;
+        }
+
+        if (!tlsOptions.tls)
+        {
+            return std::make_pair(false, "TLS is not enabled on this server");
+        }
+
+        // Parse the files without blocking the connections being accepted
+        std::string errorMsg;
+        auto tlsContext = createServerTLSContext(tlsOptions, errorMsg);
+        if (!tlsContext && !errorMsg.empty())
+        {
+            return std::make_pair(false, errorMsg);
+        }
+
+        std::lock_guard<std::mutex> lock(_tlsContextMutex);
+        _tlsContext = tlsContext;
+        return std::make_pair(true, "");
     }
 
     void SocketServer::onSetTerminatedCallback()
@@ -9,6 +9,7 @@
 #include "IXConnectionState.h"
 #include "IXNetSystem.h"
 #include "IXSelectInterrupt.h"
+#include "IXSocketTLSContext.h"
 #include "IXSocketTLSOptions.h"
 #include <atomic>
 #include <condition_variable>
@@ -20,6 +21,7 @@
 #include <string>
 #include <thread>
 #include <utility> // pair
+#include <vector>
 
 namespace ix
 {
@@ -68,18 +70,40 @@ namespace ix
         const static size_t kDefaultMaxConnections;
         const static int kDefaultAddressFamily;
 
-        void start();
+        virtual void start();
         std::pair<bool, std::string> listen();
         void wait();
 
         void setTLSOptions(const SocketTLSOptions& socketTLSOptions);
 
+        // The certificate chain, private key, CA list and ciphers are loaded once, in a
+        // TLS context shared by all the accepted connections. Load them again, to pick
+        // up renewed files: the connections accepted from now on use the new context,
+        // and the current one is kept when the new one cannot be built.
+        std::pair<bool, std::string> reloadTLSContext();
+
         // Set FD_CLOEXEC on server and client file descriptors.
         void setCloseOnExec()
         {
             _closeOnExec = true;
         }
 
+        // Open that many listening sockets bound to the same address with SO_REUSEPORT,
+        // each with its own accept thread, so that the kernel spreads the incoming
+        // connections between them. Must be called before listen(). Returns false
+        // when SO_REUSEPORT is not available.
+        bool enableReusePort(size_t acceptors);
+
+        // Number of connections accepted by each acceptor since listen()
+        std::vector<uint64_t> getAcceptedConnectionsCounts() const;
+
+        // Handle the connections with a pool of that many pre-spawned threads instead
+        // of a new thread for each connection. A connection keeps its worker until it
+        // is closed, the connections accepted while all the workers are busy wait in a
+        // queue. stackSize is the stack size of the workers in bytes, 0 keeps the system
+        // default, and it is ignored on Windows. Must be called before start().
+        bool enableWorkerPool(size_t threads, size_t stackSize = 0);
+
         int getPort();
         std::string getHost();
         int getBacklog();
@@ -92,6 +116,11 @@ namespace ix
 
         void stopAcceptingConnections();
 
+        // Called on the setup thread for each new connection. By default the connection
+        // is handled by handleConnection() in its own thread.
+        virtual void dispatchConnection(std::unique_ptr<Socket> socket,
+                                        std::shared_ptr<ConnectionState> connectionState);
+
     private:
         // Member variables
         int _port;
@@ -101,19 +130,60 @@ namespace ix
         int _addressFamily;
         bool _closeOnExec = false;
 
-        // socket for accepting connections
-        socket_t _serverFd;
+        // sockets for accepting connections, one per acceptor
+        std::vector<socket_t> _serverFds;
+        size_t _acceptorsCount;
+        std::vector<std::atomic<uint64_t>> _acceptedConnectionsCounts;
+        std::pair<bool, std::string> listenOnSocket(socket_t& serverFd);
+        void closeServerSockets();
 
         std::atomic<bool> _stop;
 
         std::mutex _logMutex;
         LogCallback _logCallback; // protected by _logMutex
 
-        // background thread to wait for incoming connections
-        std::thread _thread;
-        void run();
+        // background threads to wait for incoming connections
+        std::vector<std::thread> _acceptThreads;
+        void run(socket_t serverFd, size_t index);
         void onSetTerminatedCallback();
 
+        // A socket returned by accept, not set up yet
+        struct AcceptedSocket
+        {
+            socket_t fd;
+            struct sockaddr_storage address;
+        };
+
+        // Each accept thread drains the tcp backlog and hands the sockets over to its
+        // setup thread, which formats the peer address, creates the connection state and
+        // dispatches the connection. The accept thread is back to accept() right away,
+        // and takes the queue lock once per batch of connections.
+        struct HandoffQueue
+        {
+            std::mutex mutex;
+            std::condition_variable condition;
+            std::vector<AcceptedSocket> sockets;
+        };
+        std::vector<std::unique_ptr<HandoffQueue>> _handoffQueues;
+        std::vector<std::thread> _setupThreads;
+        std::atomic<bool> _stopSetup;
+        void handOff(HandoffQueue& queue, std::vector<AcceptedSocket>& sockets);
+        void runSetup(HandoffQueue& queue, size_t index);
+        void setupConnection(const AcceptedSocket& acceptedSocket);
+        void stopSetupThreads();
+
+        // pool of threads handling the connections, see enableWorkerPool()
+        struct WorkerPool;
+        std::unique_ptr<WorkerPool> _workerPool;
+        size_t _workerPoolThreads;
+        size_t _workerPoolStackSize;
+        // connections waiting for a worker, counted against _maxConnections
+        std::atomic<size_t> _workerPoolQueuedCount;
+        void startWorkerPool();
+        void stopWorkerPool();
+        void runWorker();
+        static void* runWorkerThread(void* socketServer);
+
         // background thread to cleanup (join) terminated threads
         std::atomic<bool> _stopGc;
         std::thread _gcThread;
@@ -139,7 +209,13 @@ namespace ix
         void closeTerminatedThreads();
         size_t getConnectionsThreadsCount();
 
-        SocketTLSOptions _socketTLSOptions;
+        // TLS context shared by the accepted sockets, built on the first TLS accept
+        SocketTLSOptions _socketTLSOptions; // protected by _tlsContextMutex
+        SocketTLSContextPtr _tlsContext;    // protected by _tlsContextMutex
+        std::mutex _tlsContextMutex;
+        bool getTLSContext(SocketTLSOptions& tlsOptions,
+                           SocketTLSContextPtr& tlsContext,
+                           std::string& errorMsg);
 
         // to wake up from select
         SelectInterruptPtr _acceptSelectInterrupt;
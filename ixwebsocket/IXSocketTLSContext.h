@@ -0,0 +1,27 @@
+/*
+ *  IXSocketTLSContext.h
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ */
+
+#pragma once
+
+#include <memory>
+
+namespace ix
+{
+    //
+    // TLS configuration built once from SocketTLSOptions (certificate chain, private key,
+    // CA list, ciphers, random generator) and shared by the sockets accepted by a server,
+    // so that accepting a connection does not read and parse the files again. Each TLS
+    // backend derives its own context. A context is never modified once built, a reload
+    // builds a new one, and the sockets keep the context they were accepted with.
+    //
+    class SocketTLSContext
+    {
+    public:
+        virtual ~SocketTLSContext() = default;
+    };
+
+    using SocketTLSContextPtr = std::shared_ptr<SocketTLSContext>;
+} // namespace ix
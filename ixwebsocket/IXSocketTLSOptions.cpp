@@ -16,17 +16,43 @@ namespace ix
     const char* kTLSCAFileDisableVerify = "NONE";
     const char* kTLSCiphersUseDefault = "DEFAULT";
     const char* kTLSInMemoryMarker = "-----BEGIN CERTIFICATE-----";
+    const char* kTLSInMemoryPEMMarker = "-----BEGIN ";
+
+    namespace
+    {
+        bool isInMemoryPEM(const std::string& value)
+        {
+            return value.find(kTLSInMemoryPEMMarker) != std::string::npos;
+        }
+
+        bool readFileOrMemory(const std::string& value, std::string& content)
+        {
+            if (isInMemoryPEM(value))
+            {
+                content = value;
+                return true;
+            }
+
+            std::ifstream file(value, std::ios::binary);
+            if (!file) return false;
+
+            std::stringstream ss;
+            ss << file.rdbuf();
+            content = ss.str();
+            return (bool) file;
+        }
+    } // namespace
 
     bool SocketTLSOptions::isValid() const
     {
         if (!_validated)
         {
-            if (!certFile.empty() && !std::ifstream(certFile))
+            if (!certFile.empty() && !isInMemoryPEM(certFile) && !std::ifstream(certFile))
             {
                 _errMsg = "certFile not found: " + certFile;
                 return false;
             }
-            if (!keyFile.empty() && !std::ifstream(keyFile))
+            if (!keyFile.empty() && !isInMemoryPEM(keyFile) && !std::ifstream(keyFile))
             {
                 _errMsg = "keyFile not found: " + keyFile;
                 return false;
@@ -51,7 +77,44 @@ namespace ix
 
     bool SocketTLSOptions::hasCertAndKey() const
     {
-        return !certFile.empty() && !keyFile.empty();
+        return (!certFile.empty() && !keyFile.empty()) || certAndKeyProvider;
+    }
+
+    bool SocketTLSOptions::isUsingInMemoryCertAndKey() const
+    {
+        return certAndKeyProvider || isInMemoryPEM(certFile) || isInMemoryPEM(keyFile);
+    }
+
+    bool SocketTLSOptions::loadCertAndKey(std::string& certChain,
+                                          std::string& key,
+                                          std::string& errMsg) const
+    {
+        if (certAndKeyProvider)
+        {
+            if (!certAndKeyProvider(certChain, key, errMsg))
+            {
+                if (errMsg.empty()) errMsg = "certAndKeyProvider failed";
+                return false;
+            }
+            if (certChain.empty() || key.empty())
+            {
+                errMsg = "certAndKeyProvider returned an empty certificate or key";
+                return false;
+            }
+            return true;
+        }
+
+        if (!readFileOrMemory(certFile, certChain))
+        {
+            errMsg = "Cannot read certFile: " + certFile;
+            return false;
+        }
+        if (!readFileOrMemory(keyFile, key))
+        {
+            errMsg = "Cannot read keyFile: " + keyFile;
+            return false;
+        }
+        return true;
     }
 
     bool SocketTLSOptions::isUsingSystemDefaults() const
@@ -83,8 +146,9 @@ namespace ix
     {
         std::stringstream ss;
         ss << "TLS Options:" << std::endl;
-        ss << "  certFile = " << certFile << std::endl;
-        ss << "  keyFile  = " << keyFile << std::endl;
+        ss << "  certFile = " << (isInMemoryPEM(certFile) ? "<in memory>" : certFile)
+           << std::endl;
+        ss << "  keyFile  = " << (isInMemoryPEM(keyFile) ? "<in memory>" : keyFile) << std::endl;
         ss << "  caFile   = " << caFile << std::endl;
         ss << "  ciphers  = " << ciphers << std::endl;
         ss << "  tls      = " << tls << std::endl;
@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <functional>
 #include <string>
 
 namespace ix
@@ -16,12 +17,18 @@ namespace ix
         // check validity of the object
         bool isValid() const;
 
-        // the certificate presented to peers
+        // the certificate presented to peers, or the PEM certificate chain itself
         std::string certFile;
 
-        // the key used for signing/encryption
+        // the key used for signing/encryption, or the PEM key itself
         std::string keyFile;
 
+        // returns the certificate chain and the key in memory, PEM or DER, instead of
+        // certFile and keyFile. Called each time a server builds its TLS context, so a
+        // renewed certificate is picked up by reloadTLSContext without touching the disk
+        std::function<bool(std::string& certChain, std::string& key, std::string& errMsg)>
+            certAndKeyProvider;
+
         // the ca certificate (or certificate bundle) file containing
         // certificates to be trusted by peers; use 'SYSTEM' to
         // leverage the system defaults, use 'NONE' to disable peer verification
@@ -36,8 +43,22 @@ namespace ix
         // whether to skip validating the peer's hostname against the certificate presented
         bool disable_hostname_validation = false;
 
+        // whether to skip resuming TLS sessions: clients do a full handshake on every
+        // connection, servers do not keep sessions nor issue session tickets
+        bool disable_session_resumption = false;
+
+        // whether to let the kernel encrypt the records once the handshake is done (kTLS),
+        // when OpenSSL 3 and the kernel support it. Data and files are then sent with the
+        // plain socket calls (writev, sendfile), see Socket::isKernelTLSActive
+        bool enable_ktls = false;
+
         bool hasCertAndKey() const;
 
+        bool isUsingInMemoryCertAndKey() const;
+
+        // the certificate chain and the key, from the provider, the options or the files
+        bool loadCertAndKey(std::string& certChain, std::string& key, std::string& errMsg) const;
+
         bool isUsingSystemDefaults() const;
 
         bool isUsingInMemoryCAs() const;
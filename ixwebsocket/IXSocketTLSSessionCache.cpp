@@ -0,0 +1,99 @@
+/*
+ *  IXSocketTLSSessionCache.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ */
+
+#include "IXSocketTLSSessionCache.h"
+
+#include <functional>
+
+namespace ix
+{
+    const size_t SocketTLSSessionCache::kDefaultMaxSize(1024);
+
+    SocketTLSSessionCache::SocketTLSSessionCache(size_t maxSize)
+        : _maxSize(maxSize > 0 ? maxSize : 1)
+    {
+        ;
+    }
+
+    SocketTLSSessionCache& SocketTLSSessionCache::getClientCache()
+    {
+        static SocketTLSSessionCache cache;
+        return cache;
+    }
+
+    std::string SocketTLSSessionCache::makeKey(const std::string& host,
+                                               int port,
+                                               const SocketTLSOptions& tlsOptions)
+    {
+        // The certificate and the CA can be whole PEM bundles held in memory
+        std::string key = host + ":" + std::to_string(port);
+        key += " " + std::to_string(std::hash<std::string>()(tlsOptions.certFile));
+        key += " " + std::to_string(std::hash<std::string>()(tlsOptions.caFile));
+        if (tlsOptions.disable_hostname_validation)
+        {
+            key += " no-hostname-validation";
+        }
+        return key;
+    }
+
+    void SocketTLSSessionCache::put(const std::string& key, const std::string& session)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto it = _index.find(key);
+        if (it != _index.end())
+        {
+            it->second->second = session;
+            _entries.splice(_entries.begin(), _entries, it->second);
+            return;
+        }
+
+        if (_entries.size() >= _maxSize)
+        {
+            _index.erase(_entries.back().first);
+            _entries.pop_back();
+        }
+
+        _entries.emplace_front(key, session);
+        _index[key] = _entries.begin();
+    }
+
+    bool SocketTLSSessionCache::get(const std::string& key, std::string& session)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto it = _index.find(key);
+        if (it == _index.end()) return false;
+
+        _entries.splice(_entries.begin(), _entries, it->second);
+        session = it->second->second;
+        return true;
+    }
+
+    void SocketTLSSessionCache::remove(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto it = _index.find(key);
+        if (it == _index.end()) return;
+
+        _entries.erase(it->second);
+        _index.erase(it);
+    }
+
+    void SocketTLSSessionCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _entries.clear();
+        _index.clear();
+    }
+
+    size_t SocketTLSSessionCache::size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _entries.size();
+    }
+} // namespace ix
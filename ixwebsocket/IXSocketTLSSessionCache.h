@@ -0,0 +1,61 @@
+/*
+ *  IXSocketTLSSessionCache.h
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ *
+ *  TLS sessions kept by the clients, to resume them when reconnecting.
+ */
+
+#pragma once
+
+#include "IXSocketTLSOptions.h"
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace ix
+{
+    //
+    // Sessions are stored serialized by the TLS backend (a TLS 1.2 session or a TLS 1.3
+    // ticket), so the cache does not depend on the backend. A new session for the same
+    // key replaces the previous one, and the least recently used session is evicted when
+    // the cache is full.
+    //
+    // Resuming a session skips the verification of the server certificate, so the key
+    // includes the options the session was authenticated with, and not only the server
+    // address. This class is thread safe.
+    //
+    class SocketTLSSessionCache
+    {
+    public:
+        SocketTLSSessionCache(size_t maxSize = kDefaultMaxSize);
+
+        // The cache used by all the client sockets
+        static SocketTLSSessionCache& getClientCache();
+
+        static std::string makeKey(const std::string& host,
+                                   int port,
+                                   const SocketTLSOptions& tlsOptions);
+
+        void put(const std::string& key, const std::string& session);
+        bool get(const std::string& key, std::string& session);
+        void remove(const std::string& key);
+        void clear();
+
+        size_t size() const;
+
+        const static size_t kDefaultMaxSize;
+
+    private:
+        using Entry = std::pair<std::string, std::string>;
+
+        size_t _maxSize;
+
+        // Most recently used first
+        std::list<Entry> _entries;
+        std::unordered_map<std::string, std::list<Entry>::iterator> _index;
+        mutable std::mutex _mutex;
+    };
+} // namespace ix
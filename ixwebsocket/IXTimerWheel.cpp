@@ -0,0 +1,226 @@
+/*
+ *  IXTimerWheel.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ */
+
+#include "IXTimerWheel.h"
+
+namespace ix
+{
+    const std::chrono::milliseconds TimerWheel::kDefaultResolution(10);
+
+    TimerWheel::Timer::~Timer()
+    {
+        cancel();
+    }
+
+    void TimerWheel::Timer::setCallback(const std::function<void()>& callback)
+    {
+        _callback = callback;
+    }
+
+    bool TimerWheel::Timer::isScheduled() const
+    {
+        return _wheel != nullptr;
+    }
+
+    void TimerWheel::Timer::cancel()
+    {
+        if (_wheel != nullptr)
+        {
+            _wheel->unlink(*this);
+        }
+    }
+
+    TimerWheel::TimerWheel(std::chrono::milliseconds resolution, TimePoint now)
+        : _resolution(resolution.count() > 0 ? resolution : kDefaultResolution)
+        , _origin(now)
+        , _currentTick(0)
+        , _size(0)
+    {
+        for (auto&& level : _slots)
+        {
+            for (auto&& head : level)
+            {
+                head._prev = &head;
+                head._next = &head;
+            }
+        }
+        _levelSizes.fill(0);
+    }
+
+    uint64_t TimerWheel::getTick(TimePoint timePoint, bool roundUp) const
+    {
+        if (timePoint <= _origin) return 0;
+
+        auto elapsed = timePoint - _origin;
+        uint64_t tick = (uint64_t)(elapsed / _resolution);
+        if (roundUp && elapsed % _resolution != Clock::duration::zero())
+        {
+            tick++;
+        }
+        return tick;
+    }
+
+    TimerWheel::TimePoint TimerWheel::getTimePoint(uint64_t tick) const
+    {
+        return _origin + _resolution * tick;
+    }
+
+    void TimerWheel::schedule(Timer& timer, TimePoint deadline)
+    {
+        uint64_t expiry = getTick(deadline, true);
+
+        const uint64_t maxDelay = ((uint64_t) 1 << (kSlotBits * kLevels)) - 1;
+        if (expiry <= _currentTick)
+        {
+            expiry = _currentTick + 1;
+        }
+        else if (expiry - _currentTick > maxDelay)
+        {
+            expiry = _currentTick + maxDelay;
+        }
+
+        // Connections usually reschedule the deadline they already have
+        if (timer._wheel == this && timer._expiry == expiry) return;
+
+        timer.cancel();
+        timer._expiry = expiry;
+        link(timer);
+    }
+
+    void TimerWheel::link(Timer& timer)
+    {
+        // The level is chosen from the delay, and the slot from the expiry tick, so
+        // the slot is reached (and its timers moved down) in the tick range of the
+        // timer
+        uint64_t delay = timer._expiry - _currentTick;
+        int level = 0;
+        while (level < kLevels - 1 && delay >= ((uint64_t) 1 << (kSlotBits * (level + 1))))
+        {
+            level++;
+        }
+
+        Timer& head = _slots[level][(timer._expiry >> (kSlotBits * level)) & kSlotMask];
+        timer._prev = head._prev;
+        timer._next = &head;
+        head._prev->_next = &timer;
+        head._prev = &timer;
+
+        timer._wheel = this;
+        timer._level = level;
+        _levelSizes[level]++;
+        _size++;
+    }
+
+    void TimerWheel::unlink(Timer& timer)
+    {
+        timer._prev->_next = timer._next;
+        timer._next->_prev = timer._prev;
+        timer._prev = nullptr;
+        timer._next = nullptr;
+        timer._wheel = nullptr;
+
+        _levelSizes[timer._level]--;
+        _size--;
+    }
+
+    void TimerWheel::cascade(int level)
+    {
+        Timer& head = _slots[level][(_currentTick >> (kSlotBits * level)) & kSlotMask];
+        while (head._next != &head)
+        {
+            Timer& timer = *head._next;
+            unlink(timer);
+            link(timer);
+        }
+    }
+
+    size_t TimerWheel::advance(TimePoint now)
+    {
+        uint64_t target = getTick(now, false);
+        size_t fired = 0;
+
+        while (_currentTick < target)
+        {
+            // Skip the ticks which have nothing to do, up to the next wrap around
+            if (_levelSizes[0] == 0)
+            {
+                uint64_t nextWrap = (_currentTick | kSlotMask) + 1;
+                if (_size == 0 || nextWrap > target)
+                {
+                    _currentTick = target;
+                    break;
+                }
+                _currentTick = nextWrap;
+            }
+            else
+            {
+                _currentTick++;
+            }
+
+            // Move the timers of the next range down, starting from the highest
+            // level which wrapped around
+            if ((_currentTick & kSlotMask) == 0)
+            {
+                int level = 1;
+                while (level < kLevels - 1 &&
+                       ((_currentTick >> (kSlotBits * level)) & kSlotMask) == 0)
+                {
+                    level++;
+                }
+                for (; level > 0; --level)
+                {
+                    cascade(level);
+                }
+            }
+
+            Timer& head = _slots[0][_currentTick & kSlotMask];
+            while (head._next != &head)
+            {
+                Timer& timer = *head._next;
+                unlink(timer);
+                fired++;
+
+                if (timer._callback) timer._callback();
+            }
+        }
+
+        return fired;
+    }
+
+    int TimerWheel::getTimeoutMs(TimePoint now) const
+    {
+        if (_size == 0) return -1;
+
+        // Timers of the higher levels need to be moved down at the next wrap around
+        uint64_t nextWrap = (_currentTick | kSlotMask) + 1;
+        uint64_t nextTick = nextWrap;
+        if (_levelSizes[0] != 0)
+        {
+            for (uint64_t tick = _currentTick + 1; tick < nextWrap; ++tick)
+            {
+                const Timer& head = _slots[0][tick & kSlotMask];
+                if (head._next != &head)
+                {
+                    nextTick = tick;
+                    break;
+                }
+            }
+        }
+
+        // The tick is reached once its time point has passed, round up
+        auto delay = getTimePoint(nextTick) - now;
+        if (delay <= Clock::duration::zero()) return 0;
+
+        auto delayMs = std::chrono::duration_cast<std::chrono::milliseconds>(delay);
+        if (delayMs < delay) delayMs += std::chrono::milliseconds(1);
+        return (int) delayMs.count();
+    }
+
+    size_t TimerWheel::size() const
+    {
+        return _size;
+    }
+} // namespace ix
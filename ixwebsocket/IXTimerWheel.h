@@ -0,0 +1,108 @@
+/*
+ *  IXTimerWheel.h
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ *
+ *  Hierarchical timing wheel, to keep track of the timers of many connections.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace ix
+{
+    //
+    // Deadlines are rounded up to a tick of the wheel, so the timers expiring in the
+    // same tick fire together, from a single advance() call. Scheduling, rescheduling
+    // and cancelling a timer are O(1): timers are linked in the slots of 4 levels of 64
+    // slots each, and moved down one level when the lower level wraps around.
+    //
+    // This class is not thread safe, the timers and the wheel must be used by a single
+    // thread. A timer must be cancelled (or destroyed) before the wheel is destroyed.
+    // Deadlines more than 2^24 ticks away (46 hours with the default resolution) expire
+    // early, after 2^24 ticks.
+    //
+    class TimerWheel
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using TimePoint = Clock::time_point;
+
+        class Timer
+        {
+        public:
+            Timer() = default;
+            ~Timer();
+
+            Timer(const Timer&) = delete;
+            Timer& operator=(const Timer&) = delete;
+
+            // Called by TimerWheel::advance() once the deadline has passed. The
+            // callback can schedule or cancel any timer, including this one.
+            void setCallback(const std::function<void()>& callback);
+
+            bool isScheduled() const;
+            void cancel();
+
+        private:
+            friend class TimerWheel;
+
+            std::function<void()> _callback;
+            TimerWheel* _wheel = nullptr;
+            Timer* _prev = nullptr;
+            Timer* _next = nullptr;
+            uint64_t _expiry = 0;
+            int _level = 0;
+        };
+
+        explicit TimerWheel(std::chrono::milliseconds resolution = kDefaultResolution,
+                            TimePoint now = Clock::now());
+        ~TimerWheel() = default;
+
+        TimerWheel(const TimerWheel&) = delete;
+        TimerWheel& operator=(const TimerWheel&) = delete;
+
+        // Schedule or reschedule timer. Deadlines which already passed expire with
+        // the next tick.
+        void schedule(Timer& timer, TimePoint deadline);
+
+        // Fire the timers whose deadline is before now, returns how many fired
+        size_t advance(TimePoint now);
+
+        // How long to wait before calling advance(), -1 when there is no timer.
+        // The wait may end before the next expiry when timers must be moved to a
+        // lower level.
+        int getTimeoutMs(TimePoint now) const;
+
+        size_t size() const;
+
+        static const std::chrono::milliseconds kDefaultResolution;
+
+    private:
+        static const int kLevels = 4;
+        static const int kSlotBits = 6;
+        static const uint64_t kSlots = 1 << kSlotBits;
+        static const uint64_t kSlotMask = kSlots - 1;
+
+        uint64_t getTick(TimePoint timePoint, bool roundUp) const;
+        TimePoint getTimePoint(uint64_t tick) const;
+
+        void link(Timer& timer);
+        void unlink(Timer& timer);
+        void cascade(int level);
+
+        std::chrono::milliseconds _resolution;
+        TimePoint _origin;
+        uint64_t _currentTick;
+        size_t _size;
+
+        // Circular lists, each slot is the head of its list
+        std::array<std::array<Timer, kSlots>, kLevels> _slots;
+        std::array<size_t, kLevels> _levelSizes;
+    };
+} // namespace ix
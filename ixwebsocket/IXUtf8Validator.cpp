@@ -0,0 +1,452 @@
+/*
+ *  IXUtf8Validator.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ *
+ *  Vectorized validation, using the lookup algorithm from "Validating UTF-8 In Less
+ *  Than One Instruction Per Byte" (John Keiser, Daniel Lemire), as found in simdjson
+ *  and simdutf. The byte per byte DFA from IXUtf8Validator.h is the fallback.
+ */
+
+#include "IXUtf8Validator.h"
+
+#include "IXCpuFeatures.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#if defined(__GNUC__) || defined(__clang__)
+#define IXWEBSOCKET_UTF8_X86
+#define IXWEBSOCKET_UTF8_SSSE3_TARGET __attribute__((target("ssse3")))
+#define IXWEBSOCKET_UTF8_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER)
+#define IXWEBSOCKET_UTF8_X86
+#define IXWEBSOCKET_UTF8_SSSE3_TARGET
+#define IXWEBSOCKET_UTF8_AVX2_TARGET
+#include <immintrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define IXWEBSOCKET_UTF8_NEON
+#include <arm_neon.h>
+#endif
+
+namespace ix
+{
+    namespace
+    {
+        using Utf8Kernel = bool (*)(const uint8_t* data, size_t size);
+
+        // Validate with the DFA, skipping runs of ASCII 8 bytes at a time
+        bool validateUtf8Scalar(const uint8_t* data, size_t size)
+        {
+            Utf8Validator validator;
+
+            size_t i = 0;
+            while (i < size)
+            {
+                if (validator.complete())
+                {
+                    while (i + 8 <= size)
+                    {
+                        uint64_t w;
+                        memcpy(&w, data + i, sizeof(w));
+                        if ((w & 0x8080808080808080ULL) != 0) break;
+                        i += 8;
+                    }
+                    if (i == size) break;
+                }
+
+                if (!validator.consume(data[i++])) return false;
+            }
+
+            return validator.complete();
+        }
+
+#if defined(IXWEBSOCKET_UTF8_X86) || defined(IXWEBSOCKET_UTF8_NEON)
+        //
+        // Each byte is checked with the one before it: the high nibble of the previous
+        // byte, its low nibble, and the high nibble of the current byte each index a
+        // table giving the errors that are possible for that value. An error is found
+        // when the 3 lookups agree on one.
+        //
+        const uint8_t kUtf8TooShort = 1 << 0;   // 11______ 0_______, 11______ 11______
+        const uint8_t kUtf8TooLong = 1 << 1;    // 0_______ 10______
+        const uint8_t kUtf8Overlong3 = 1 << 2;  // 11100000 100_____
+        const uint8_t kUtf8TooLarge = 1 << 3;   // 11110100 1001____, 11110100 101_____, ...
+        const uint8_t kUtf8Surrogate = 1 << 4;  // 11101101 101_____
+        const uint8_t kUtf8Overlong2 = 1 << 5;  // 1100000_ 10______
+        const uint8_t kUtf8TooLarge1000 = 1 << 6; // 11110101 1000____, 1111011_ 1000____, ...
+        const uint8_t kUtf8Overlong4 = 1 << 6;  // 11110000 1000____
+        const uint8_t kUtf8TwoConts = 1 << 7;   // 10______ 10______
+        const uint8_t kUtf8Carry = kUtf8TooShort | kUtf8TooLong | kUtf8TwoConts;
+
+        const uint8_t kUtf8Byte1High[16] = {
+            // 0_______ ________ <ASCII in byte 1>
+            kUtf8TooLong,
+            kUtf8TooLong,
+            kUtf8TooLong,
+            kUtf8TooLong,
+            kUtf8TooLong,
+            kUtf8TooLong,
+            kUtf8TooLong,
+            kUtf8TooLong,
+            // 10______ ________ <continuation in byte 1>
+            kUtf8TwoConts,
+            kUtf8TwoConts,
+            kUtf8TwoConts,
+            kUtf8TwoConts,
+            // 1100____ ________ <two byte lead in byte 1>
+            kUtf8TooShort | kUtf8Overlong2,
+            // 1101____ ________ <two byte lead in byte 1>
+            kUtf8TooShort,
+            // 1110____ ________ <three byte lead in byte 1>
+            kUtf8TooShort | kUtf8Overlong3 | kUtf8Surrogate,
+            // 1111____ ________ <four+ byte lead in byte 1>
+            kUtf8TooShort | kUtf8TooLarge | kUtf8TooLarge1000 | kUtf8Overlong4,
+        };
+
+        const uint8_t kUtf8Byte1Low[16] = {
+            // ____0000 ________
+            kUtf8Carry | kUtf8Overlong3 | kUtf8Overlong2 | kUtf8Overlong4,
+            // ____0001 ________
+            kUtf8Carry | kUtf8Overlong2,
+            // ____001_ ________
+            kUtf8Carry,
+            kUtf8Carry,
+            // ____0100 ________
+            kUtf8Carry | kUtf8TooLarge,
+            // ____0101 ________
+            kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+            // ____011_ ________
+            kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+            kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+            // ____1___ ________
+            kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+            kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+            kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+            kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+            kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+            // ____1101 ________
+            kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000 | kUtf8Surrogate,
+            kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+            kUtf8Carry | kUtf8TooLarge | kUtf8TooLarge1000,
+        };
+
+        const uint8_t kUtf8Byte2High[16] = {
+            // ________ 0_______ <ASCII in byte 2>
+            kUtf8TooShort,
+            kUtf8TooShort,
+            kUtf8TooShort,
+            kUtf8TooShort,
+            kUtf8TooShort,
+            kUtf8TooShort,
+            kUtf8TooShort,
+            kUtf8TooShort,
+            // ________ 1000____
+            kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Overlong3 | kUtf8TooLarge1000 |
+                kUtf8Overlong4,
+            // ________ 1001____
+            kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Overlong3 | kUtf8TooLarge,
+            // ________ 101_____
+            kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Surrogate | kUtf8TooLarge,
+            kUtf8TooLong | kUtf8Overlong2 | kUtf8TwoConts | kUtf8Surrogate | kUtf8TooLarge,
+            // ________ 11______
+            kUtf8TooShort,
+            kUtf8TooShort,
+            kUtf8TooShort,
+            kUtf8TooShort,
+        };
+
+        // A block ending with one of these bytes in its last 3 positions ends in the
+        // middle of a character: input - max value is not 0 there.
+        const uint8_t kUtf8MaxValue[32] = {
+            0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+            0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+            0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xf0 - 1, 0xe0 - 1, 0xc0 - 1,
+        };
+#endif
+
+#ifdef IXWEBSOCKET_UTF8_X86
+        IXWEBSOCKET_UTF8_SSSE3_TARGET
+        bool validateUtf8SSSE3(const uint8_t* data, size_t size)
+        {
+            const __m128i byte1HighTable = _mm_loadu_si128((const __m128i*) kUtf8Byte1High);
+            const __m128i byte1LowTable = _mm_loadu_si128((const __m128i*) kUtf8Byte1Low);
+            const __m128i byte2HighTable = _mm_loadu_si128((const __m128i*) kUtf8Byte2High);
+            const __m128i maxValue = _mm_loadu_si128((const __m128i*) (kUtf8MaxValue + 16));
+            const __m128i lowNibble = _mm_set1_epi8(0x0f);
+            const __m128i thirdByte = _mm_set1_epi8((char) (0xe0 - 0x80));
+            const __m128i fourthByte = _mm_set1_epi8((char) (0xf0 - 0x80));
+            const __m128i highBit = _mm_set1_epi8((char) 0x80);
+
+            __m128i error = _mm_setzero_si128();
+            __m128i prevInput = _mm_setzero_si128();
+            __m128i prevIncomplete = _mm_setzero_si128();
+
+            for (size_t i = 0; i < size; i += 16)
+            {
+                __m128i input;
+                if (i + 16 <= size)
+                {
+                    input = _mm_loadu_si128((const __m128i*) (data + i));
+                }
+                else
+                {
+                    // Pad the last block with ASCII
+                    uint8_t tail[16] = {};
+                    memcpy(tail, data + i, size - i);
+                    input = _mm_loadu_si128((const __m128i*) tail);
+                }
+
+                if (_mm_movemask_epi8(input) == 0)
+                {
+                    // ASCII fast path, only a character cut at the end of the previous
+                    // block can be wrong
+                    error = _mm_or_si128(error, prevIncomplete);
+                }
+                else
+                {
+                    __m128i prev1 = _mm_alignr_epi8(input, prevInput, 15);
+                    __m128i prev2 = _mm_alignr_epi8(input, prevInput, 14);
+                    __m128i prev3 = _mm_alignr_epi8(input, prevInput, 13);
+
+                    __m128i byte1High = _mm_shuffle_epi8(
+                        byte1HighTable, _mm_and_si128(_mm_srli_epi16(prev1, 4), lowNibble));
+                    __m128i byte1Low =
+                        _mm_shuffle_epi8(byte1LowTable, _mm_and_si128(prev1, lowNibble));
+                    __m128i byte2High = _mm_shuffle_epi8(
+                        byte2HighTable, _mm_and_si128(_mm_srli_epi16(input, 4), lowNibble));
+                    __m128i special = _mm_and_si128(_mm_and_si128(byte1High, byte1Low), byte2High);
+
+                    // Third and fourth bytes of 3 and 4 bytes characters must be continuations
+                    __m128i must23 = _mm_or_si128(_mm_subs_epu8(prev2, thirdByte),
+                                                  _mm_subs_epu8(prev3, fourthByte));
+                    must23 = _mm_and_si128(must23, highBit);
+
+                    error = _mm_or_si128(error, _mm_xor_si128(must23, special));
+                    prevIncomplete = _mm_subs_epu8(input, maxValue);
+                }
+
+                prevInput = input;
+            }
+
+            error = _mm_or_si128(error, prevIncomplete);
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xffff;
+        }
+
+        IXWEBSOCKET_UTF8_AVX2_TARGET
+        bool validateUtf8AVX2(const uint8_t* data, size_t size)
+        {
+            const __m256i byte1HighTable =
+                _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) kUtf8Byte1High));
+            const __m256i byte1LowTable =
+                _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) kUtf8Byte1Low));
+            const __m256i byte2HighTable =
+                _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) kUtf8Byte2High));
+            const __m256i maxValue = _mm256_loadu_si256((const __m256i*) kUtf8MaxValue);
+            const __m256i lowNibble = _mm256_set1_epi8(0x0f);
+            const __m256i thirdByte = _mm256_set1_epi8((char) (0xe0 - 0x80));
+            const __m256i fourthByte = _mm256_set1_epi8((char) (0xf0 - 0x80));
+            const __m256i highBit = _mm256_set1_epi8((char) 0x80);
+
+            __m256i error = _mm256_setzero_si256();
+            __m256i prevInput = _mm256_setzero_si256();
+            __m256i prevIncomplete = _mm256_setzero_si256();
+
+            for (size_t i = 0; i < size; i += 32)
+            {
+                __m256i input;
+                if (i + 32 <= size)
+                {
+                    input = _mm256_loadu_si256((const __m256i*) (data + i));
+                }
+                else
+                {
+                    // Pad the last block with ASCII
+                    uint8_t tail[32] = {};
+                    memcpy(tail, data + i, size - i);
+                    input = _mm256_loadu_si256((const __m256i*) tail);
+                }
+
+                if (_mm256_movemask_epi8(input) == 0)
+                {
+                    // ASCII fast path, only a character cut at the end of the previous
+                    // block can be wrong
+                    error = _mm256_or_si256(error, prevIncomplete);
+                }
+                else
+                {
+                    // alignr works within 128 bits lanes, give it the previous lane
+                    __m256i prevLanes = _mm256_permute2x128_si256(prevInput, input, 0x21);
+                    __m256i prev1 = _mm256_alignr_epi8(input, prevLanes, 15);
+                    __m256i prev2 = _mm256_alignr_epi8(input, prevLanes, 14);
+                    __m256i prev3 = _mm256_alignr_epi8(input, prevLanes, 13);
+
+                    __m256i byte1High = _mm256_shuffle_epi8(
+                        byte1HighTable, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), lowNibble));
+                    __m256i byte1Low =
+                        _mm256_shuffle_epi8(byte1LowTable, _mm256_and_si256(prev1, lowNibble));
+                    __m256i byte2High = _mm256_shuffle_epi8(
+                        byte2HighTable, _mm256_and_si256(_mm256_srli_epi16(input, 4), lowNibble));
+                    __m256i special =
+                        _mm256_and_si256(_mm256_and_si256(byte1High, byte1Low), byte2High);
+
+                    // Third and fourth bytes of 3 and 4 bytes characters must be continuations
+                    __m256i must23 = _mm256_or_si256(_mm256_subs_epu8(prev2, thirdByte),
+                                                     _mm256_subs_epu8(prev3, fourthByte));
+                    must23 = _mm256_and_si256(must23, highBit);
+
+                    error = _mm256_or_si256(error, _mm256_xor_si256(must23, special));
+                    prevIncomplete = _mm256_subs_epu8(input, maxValue);
+                }
+
+                prevInput = input;
+            }
+
+            error = _mm256_or_si256(error, prevIncomplete);
+            return _mm256_testz_si256(error, error) != 0;
+        }
+#endif
+
+#ifdef IXWEBSOCKET_UTF8_NEON
+        bool validateUtf8NEON(const uint8_t* data, size_t size)
+        {
+            const uint8x16_t byte1HighTable = vld1q_u8(kUtf8Byte1High);
+            const uint8x16_t byte1LowTable = vld1q_u8(kUtf8Byte1Low);
+            const uint8x16_t byte2HighTable = vld1q_u8(kUtf8Byte2High);
+            const uint8x16_t maxValue = vld1q_u8(kUtf8MaxValue + 16);
+            const uint8x16_t lowNibble = vdupq_n_u8(0x0f);
+            const uint8x16_t thirdByte = vdupq_n_u8(0xe0 - 0x80);
+            const uint8x16_t fourthByte = vdupq_n_u8(0xf0 - 0x80);
+            const uint8x16_t highBit = vdupq_n_u8(0x80);
+
+            uint8x16_t error = vdupq_n_u8(0);
+            uint8x16_t prevInput = vdupq_n_u8(0);
+            uint8x16_t prevIncomplete = vdupq_n_u8(0);
+
+            for (size_t i = 0; i < size; i += 16)
+            {
+                uint8x16_t input;
+                if (i + 16 <= size)
+                {
+                    input = vld1q_u8(data + i);
+                }
+                else
+                {
+                    // Pad the last block with ASCII
+                    uint8_t tail[16] = {};
+                    memcpy(tail, data + i, size - i);
+                    input = vld1q_u8(tail);
+                }
+
+                if (vmaxvq_u8(input) < 0x80)
+                {
+                    // ASCII fast path, only a character cut at the end of the previous
+                    // block can be wrong
+                    error = vorrq_u8(error, prevIncomplete);
+                }
+                else
+                {
+                    uint8x16_t prev1 = vextq_u8(prevInput, input, 15);
+                    uint8x16_t prev2 = vextq_u8(prevInput, input, 14);
+                    uint8x16_t prev3 = vextq_u8(prevInput, input, 13);
+
+                    uint8x16_t byte1High = vqtbl1q_u8(byte1HighTable, vshrq_n_u8(prev1, 4));
+                    uint8x16_t byte1Low = vqtbl1q_u8(byte1LowTable, vandq_u8(prev1, lowNibble));
+                    uint8x16_t byte2High = vqtbl1q_u8(byte2HighTable, vshrq_n_u8(input, 4));
+                    uint8x16_t special = vandq_u8(vandq_u8(byte1High, byte1Low), byte2High);
+
+                    // Third and fourth bytes of 3 and 4 bytes characters must be continuations
+                    uint8x16_t must23 =
+                        vorrq_u8(vqsubq_u8(prev2, thirdByte), vqsubq_u8(prev3, fourthByte));
+                    must23 = vandq_u8(must23, highBit);
+
+                    error = vorrq_u8(error, veorq_u8(must23, special));
+                    prevIncomplete = vqsubq_u8(input, maxValue);
+                }
+
+                prevInput = input;
+            }
+
+            error = vorrq_u8(error, prevIncomplete);
+            return vmaxvq_u8(error) == 0;
+        }
+#endif
+
+        struct Utf8KernelInfo
+        {
+            Utf8Kernel kernel;
+            const char* name;
+        };
+
+        Utf8KernelInfo selectUtf8Kernel()
+        {
+#ifdef IXWEBSOCKET_UTF8_X86
+            if (cpuSupportsAVX2()) return {validateUtf8AVX2, "avx2"};
+            if (cpuSupportsSSSE3()) return {validateUtf8SSSE3, "ssse3"};
+#endif
+#ifdef IXWEBSOCKET_UTF8_NEON
+            return {validateUtf8NEON, "neon"};
+#else
+            return {validateUtf8Scalar, "scalar"};
+#endif
+        }
+
+        const Utf8KernelInfo& getUtf8Kernel()
+        {
+            static const Utf8KernelInfo info = selectUtf8Kernel();
+            return info;
+        }
+
+        // Short strings are not worth setting up the vectorized path for
+        const size_t kUtf8VectorThreshold = 32;
+    } // namespace
+
+    bool validateUtf8(const char* data, size_t size)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+
+        if (size < kUtf8VectorThreshold)
+        {
+            return validateUtf8Scalar(bytes, size);
+        }
+
+        return getUtf8Kernel().kernel(bytes, size);
+    }
+
+    bool Utf8Validator::decodeFragment(const char* data, size_t size)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+
+        // Finish the character started at the end of the previous buffer
+        size_t begin = 0;
+        while (begin < size && m_state != utf8_accept)
+        {
+            if (!consume(bytes[begin++])) return false;
+        }
+
+        // Leave a character started in the last 3 bytes to the state machine, it can
+        // be cut
+        size_t end = size;
+        for (size_t i = 1; i <= 3 && i <= size - begin; ++i)
+        {
+            uint8_t byte = bytes[size - i];
+            if ((byte & 0xc0) == 0x80) continue;
+            if (byte >= 0xc0) end = size - i;
+            break;
+        }
+
+        if (!validateUtf8(data + begin, end - begin)) return false;
+
+        for (size_t i = end; i < size; ++i)
+        {
+            if (!consume(bytes[i])) return false;
+        }
+        return true;
+    }
+
+    const char* getUtf8ValidatorKernelName()
+    {
+        return getUtf8Kernel().name;
+    }
+} // namespace ix
@@ -139,6 +139,15 @@ namespace ix
             return true;
         }
 
+        /// Advance Validator state with a buffer that can start or end in the middle of a
+        /// character, such as the payload of a message fragment
+        /**
+         * The complete characters are checked with validateUtf8, the ones cut at the
+         * boundaries of the buffer with the state machine.
+         * @return Whether or not decoding the bytes resulted in a validation error.
+         */
+        bool decodeFragment(const char* data, size_t size);
+
         /// Return whether the input sequence ended on a valid utf8 codepoint
         /**
          * @return Whether or not the input sequence ended on a valid codepoint.
@@ -162,17 +171,18 @@ namespace ix
 
     /// Validate a UTF8 string
     /**
-     * convenience function that creates a Validator, validates a complete string
-     * and returns the result.
+     * Validates a complete string and returns the result. A vectorized
+     * implementation (AVX2 or SSSE3 on x86, NEON on ARM64) is selected at runtime,
+     * the Validator above is used otherwise.
      */
+    bool validateUtf8(const char* data, size_t size);
+
+    /// Name of the implementation used by validateUtf8 (avx2, ssse3, neon or scalar)
+    const char* getUtf8ValidatorKernelName();
+
     inline bool validateUtf8(std::string const& s)
     {
-        Utf8Validator v;
-        if (!v.decode(s.begin(), s.end()))
-        {
-            return false;
-        }
-        return v.complete();
+        return validateUtf8(s.data(), s.size());
     }
 
 } // namespace ix
@@ -139,6 +139,41 @@ namespace ix
         _enablePong = false;
     }
 
+    void WebSocket::enableZeroCopyDelivery()
+    {
+        _ws.setZeroCopyDelivery(true);
+    }
+
+    void WebSocket::disableZeroCopyDelivery()
+    {
+        _ws.setZeroCopyDelivery(false);
+    }
+
+    void WebSocket::enableAsyncSend()
+    {
+        _ws.setAsyncSend(true);
+    }
+
+    void WebSocket::disableAsyncSend()
+    {
+        _ws.setAsyncSend(false);
+    }
+
+    void WebSocket::setBackpressureOptions(const WebSocketBackpressureOptions& options)
+    {
+        _ws.setBackpressureOptions(options);
+    }
+
+    void WebSocket::setOnBackpressureCallback(const OnBackpressureCallback& callback)
+    {
+        _ws.setOnBackpressureCallback(callback);
+    }
+
+    void WebSocket::setIdleMemoryReclaimDelay(int idleSecs)
+    {
+        _ws.setIdleMemoryReclaimDelay(idleSecs);
+    }
+
     void WebSocket::enablePerMessageDeflate()
     {
         std::lock_guard<std::mutex> lock(_configMutex);
@@ -257,7 +292,8 @@ namespace ix
                                                    int timeoutSecs,
                                                    bool enablePerMessageDeflate,
                                                    HttpRequestPtr request,
-                                                   int sendTimeoutSecs)
+                                                   int sendTimeoutSecs,
+                                                   bool blockingSend)
     {
         {
             std::lock_guard<std::mutex> lock(_configMutex);
@@ -265,8 +301,12 @@ namespace ix
                 _perMessageDeflateOptions, _socketTLSOptions, _enablePong, _pingIntervalSecs);
         }
 
-        WebSocketInitResult status = _ws.connectToSocket(
-            std::move(socket), timeoutSecs, enablePerMessageDeflate, request, sendTimeoutSecs);
+        WebSocketInitResult status = _ws.connectToSocket(std::move(socket),
+                                                         timeoutSecs,
+                                                         enablePerMessageDeflate,
+                                                         request,
+                                                         sendTimeoutSecs,
+                                                         blockingSend);
         if (!status.success)
         {
             return status;
@@ -399,58 +439,67 @@ namespace ix
             WebSocketTransport::PollResult pollResult = _ws.poll();
 
             // 3. Dispatch the incoming messages
-            _ws.dispatch(
-                pollResult,
-                [this](const std::string& msg,
-                       size_t wireSize,
-                       bool decompressionError,
-                       WebSocketTransport::MessageKind messageKind)
+            dispatch(pollResult);
+        }
+    }
+
+    void WebSocket::dispatch(WebSocketTransport::PollResult pollResult)
+    {
+        _ws.dispatch(
+            pollResult,
+            [this](const std::string& msg,
+                   const char* data,
+                   size_t size,
+                   size_t wireSize,
+                   bool decompressionError,
+                   WebSocketTransport::MessageKind messageKind)
+            {
+                WebSocketMessageType webSocketMessageType {WebSocketMessageType::Error};
+                switch (messageKind)
                 {
-                    WebSocketMessageType webSocketMessageType {WebSocketMessageType::Error};
-                    switch (messageKind)
+                    case WebSocketTransport::MessageKind::MSG_TEXT:
+                    case WebSocketTransport::MessageKind::MSG_BINARY:
                     {
-                        case WebSocketTransport::MessageKind::MSG_TEXT:
-                        case WebSocketTransport::MessageKind::MSG_BINARY:
-                        {
-                            webSocketMessageType = WebSocketMessageType::Message;
-                        }
-                        break;
-
-                        case WebSocketTransport::MessageKind::PING:
-                        {
-                            webSocketMessageType = WebSocketMessageType::Ping;
-                        }
-                        break;
-
-                        case WebSocketTransport::MessageKind::PONG:
-                        {
-                            webSocketMessageType = WebSocketMessageType::Pong;
-                        }
-                        break;
-
-                        case WebSocketTransport::MessageKind::FRAGMENT:
-                        {
-                            webSocketMessageType = WebSocketMessageType::Fragment;
-                        }
-                        break;
+                        webSocketMessageType = WebSocketMessageType::Message;
                     }
+                    break;
 
-                    WebSocketErrorInfo webSocketErrorInfo;
-                    webSocketErrorInfo.decompressionError = decompressionError;
+                    case WebSocketTransport::MessageKind::PING:
+                    {
+                        webSocketMessageType = WebSocketMessageType::Ping;
+                    }
+                    break;
 
-                    bool binary = messageKind == WebSocketTransport::MessageKind::MSG_BINARY;
+                    case WebSocketTransport::MessageKind::PONG:
+                    {
+                        webSocketMessageType = WebSocketMessageType::Pong;
+                    }
+                    break;
 
-                    _onMessageCallback(ix::make_unique<WebSocketMessage>(webSocketMessageType,
-                                                                         msg,
-                                                                         wireSize,
-                                                                         webSocketErrorInfo,
-                                                                         WebSocketOpenInfo(),
-                                                                         WebSocketCloseInfo(),
-                                                                         binary));
+                    case WebSocketTransport::MessageKind::FRAGMENT:
+                    {
+                        webSocketMessageType = WebSocketMessageType::Fragment;
+                    }
+                    break;
+                }
 
-                    WebSocket::invokeTrafficTrackerCallback(wireSize, true);
-                });
-        }
+                WebSocketErrorInfo webSocketErrorInfo;
+                webSocketErrorInfo.decompressionError = decompressionError;
+
+                bool binary = messageKind == WebSocketTransport::MessageKind::MSG_BINARY;
+
+                _onMessageCallback(ix::make_unique<WebSocketMessage>(webSocketMessageType,
+                                                                     msg,
+                                                                     data,
+                                                                     size,
+                                                                     wireSize,
+                                                                     webSocketErrorInfo,
+                                                                     WebSocketOpenInfo(),
+                                                                     WebSocketCloseInfo(),
+                                                                     binary));
+
+                WebSocket::invokeTrafficTrackerCallback(wireSize, true);
+            });
     }
 
     void WebSocket::setOnMessageCallback(const OnMessageCallback& callback)
@@ -463,6 +512,22 @@ namespace ix
         return _onMessageCallback != nullptr;
     }
 
+    void WebSocket::setOnFragmentCallback(const OnFragmentCallback& callback)
+    {
+        if (!callback)
+        {
+            _ws.setOnFragmentCallback(nullptr);
+            return;
+        }
+
+        _ws.setOnFragmentCallback(
+            [callback](const char* data, size_t size, size_t wireSize, bool binary, bool fin)
+            {
+                callback(data, size, binary, fin);
+                WebSocket::invokeTrafficTrackerCallback(wireSize, true);
+            });
+    }
+
     void WebSocket::setTrafficTrackerCallback(const OnTrafficTrackerCallback& callback)
     {
         _onTrafficTrackerCallback = callback;
@@ -533,6 +598,118 @@ namespace ix
         return sendMessage(text, pingType);
     }
 
+    WebSocketSendInfo WebSocket::sendBatch(const std::vector<IXWebSocketSendData>& messages,
+                                           SendMessageKind sendMessageKind)
+    {
+        return sendBatch(messages.data(), messages.size(), sendMessageKind);
+    }
+
+    WebSocketSendInfo WebSocket::sendBatch(const IXWebSocketSendData* messages,
+                                           size_t count,
+                                           SendMessageKind sendMessageKind)
+    {
+        if (!isConnected()) return WebSocketSendInfo(false);
+
+        if (sendMessageKind == SendMessageKind::Text)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (!validateUtf8(messages[i].data(), messages[i].size()))
+                {
+                    close(WebSocketCloseConstants::kInvalidFramePayloadData,
+                          WebSocketCloseConstants::kInvalidFramePayloadDataMessage);
+                    return false;
+                }
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(_writeMutex, std::defer_lock);
+        if (!_ws.isAsyncSendEnabled())
+        {
+            lock.lock();
+        }
+
+        WebSocketSendInfo webSocketSendInfo = _ws.sendBatch(messages, count, sendMessageKind);
+
+        WebSocket::invokeTrafficTrackerCallback(webSocketSendInfo.wireSize, false);
+
+        return webSocketSendInfo;
+    }
+
+    bool WebSocket::beginMessage(bool binary)
+    {
+        if (!isConnected()) return false;
+
+        std::unique_lock<std::mutex> lock(_writeMutex, std::defer_lock);
+        if (!_ws.isAsyncSendEnabled())
+        {
+            lock.lock();
+        }
+
+        return _ws.beginMessage(binary ? SendMessageKind::Binary : SendMessageKind::Text);
+    }
+
+    WebSocketSendInfo WebSocket::appendFragment(const IXWebSocketSendData& data)
+    {
+        if (!isConnected()) return WebSocketSendInfo(false);
+
+        std::unique_lock<std::mutex> lock(_writeMutex, std::defer_lock);
+        if (!_ws.isAsyncSendEnabled())
+        {
+            lock.lock();
+        }
+
+        WebSocketSendInfo webSocketSendInfo = _ws.appendFragment(data);
+
+        WebSocket::invokeTrafficTrackerCallback(webSocketSendInfo.wireSize, false);
+
+        return webSocketSendInfo;
+    }
+
+    WebSocketSendInfo WebSocket::endMessage()
+    {
+        if (!isConnected()) return WebSocketSendInfo(false);
+
+        std::unique_lock<std::mutex> lock(_writeMutex, std::defer_lock);
+        if (!_ws.isAsyncSendEnabled())
+        {
+            lock.lock();
+        }
+
+        WebSocketSendInfo webSocketSendInfo = _ws.endMessage();
+
+        WebSocket::invokeTrafficTrackerCallback(webSocketSendInfo.wireSize, false);
+
+        return webSocketSendInfo;
+    }
+
+    WebSocketSendInfo WebSocket::sendConflatable(const std::string& key,
+                                                 const IXWebSocketSendData& data,
+                                                 bool binary)
+    {
+        if (!isConnected()) return WebSocketSendInfo(false);
+
+        if (!binary && !validateUtf8(data.data(), data.size()))
+        {
+            close(WebSocketCloseConstants::kInvalidFramePayloadData,
+                  WebSocketCloseConstants::kInvalidFramePayloadDataMessage);
+            return false;
+        }
+
+        std::unique_lock<std::mutex> lock(_writeMutex, std::defer_lock);
+        if (!_ws.isAsyncSendEnabled())
+        {
+            lock.lock();
+        }
+
+        WebSocketSendInfo webSocketSendInfo = _ws.sendConflatable(
+            key, data, binary ? SendMessageKind::Binary : SendMessageKind::Text);
+
+        WebSocket::invokeTrafficTrackerCallback(webSocketSendInfo.wireSize, false);
+
+        return webSocketSendInfo;
+    }
+
     WebSocketSendInfo WebSocket::sendMessage(const IXWebSocketSendData& message,
                                              SendMessageKind sendMessageKind,
                                              const OnProgressCallback& onProgressCallback)
@@ -548,7 +725,14 @@ namespace ix
         // with battery life), and use the system select call to notify us when
         // incoming messages are arriving / there's data to be received.
         //
-        std::lock_guard<std::mutex> lock(_writeMutex);
+        // With async send, messages are only queued here and the transport
+        // takes care of ordering them, so senders do not wait for each other.
+        //
+        std::unique_lock<std::mutex> lock(_writeMutex, std::defer_lock);
+        if (!_ws.isAsyncSendEnabled())
+        {
+            lock.lock();
+        }
         WebSocketSendInfo webSocketSendInfo;
 
         switch (sendMessageKind)
@@ -577,6 +761,29 @@ namespace ix
         return webSocketSendInfo;
     }
 
+    WebSocketSendInfo WebSocket::sendBroadcastMessage(const WebSocketBroadcastMessage& message)
+    {
+        if (!isConnected()) return WebSocketSendInfo(false);
+
+        // Hold the write lock like sendMessage(), so that the frames cannot land in
+        // the middle of a fragmented message sent by another thread
+        std::unique_lock<std::mutex> lock(_writeMutex, std::defer_lock);
+        if (!_ws.isAsyncSendEnabled())
+        {
+            lock.lock();
+        }
+
+        const auto& frames = (message.getCompressedFrames() && _ws.canSendSharedCompressedFrames())
+                                 ? message.getCompressedFrames()
+                                 : message.getFrames();
+        WebSocketSendInfo webSocketSendInfo =
+            _ws.sendSharedFrames(frames, message.getPayloadSize());
+
+        WebSocket::invokeTrafficTrackerCallback(webSocketSendInfo.wireSize, false);
+
+        return webSocketSendInfo;
+    }
+
     ReadyState WebSocket::getReadyState() const
     {
         switch (_ws.getReadyState())
@@ -621,6 +828,11 @@ namespace ix
         return _ws.bufferedAmount();
     }
 
+    size_t WebSocket::getMemoryUsage() const
+    {
+        return _ws.getMemoryUsage();
+    }
+
     void WebSocket::addSubProtocol(const std::string& subProtocol)
     {
         std::lock_guard<std::mutex> lock(_configMutex);
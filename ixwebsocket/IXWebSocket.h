@@ -11,6 +11,8 @@
 
 #include "IXProgressCallback.h"
 #include "IXSocketTLSOptions.h"
+#include "IXWebSocketBackpressure.h"
+#include "IXWebSocketBroadcastMessage.h"
 #include "IXWebSocketCloseConstants.h"
 #include "IXWebSocketErrorInfo.h"
 #include "IXWebSocketHttpHeaders.h"
@@ -25,6 +27,7 @@
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace ix
 {
@@ -40,6 +43,8 @@ namespace ix
     using OnMessageCallback = std::function<void(const WebSocketMessagePtr&)>;
 
     using OnTrafficTrackerCallback = std::function<void(size_t size, bool incoming)>;
+    using OnFragmentCallback =
+        std::function<void(const char* data, size_t size, bool binary, bool fin)>;
 
     class WebSocket
     {
@@ -61,6 +66,34 @@ namespace ix
         void disablePong();
         void enablePerMessageDeflate();
         void disablePerMessageDeflate();
+
+        // Deliver uncompressed messages as a view into the receive buffer, available with
+        // WebSocketMessage::data() and size(), instead of copying them into str. The view
+        // is only valid for the duration of the message callback.
+        void enableZeroCopyDelivery();
+        void disableZeroCopyDelivery();
+
+        // Let several threads send concurrently: messages are framed by the calling
+        // thread, queued without taking a lock, and written by the background thread.
+        // Sends then return before the data is written, even for server connections.
+        void enableAsyncSend();
+        void disableAsyncSend();
+
+        // Bound the amount of data queued for a peer which reads slowly. With a high
+        // watermark, Text and Binary sends only queue the message (even for server
+        // connections), and the policy decides what happens to the messages sent while
+        // the buffered amount is at or above it.
+        void setBackpressureOptions(const WebSocketBackpressureOptions& options);
+        void setOnBackpressureCallback(const OnBackpressureCallback& callback);
+
+        // Release the buffers of a connection which did not send nor receive anything for
+        // idleSecs, and the compression state when permessage-deflate resets its context
+        // after each message. They are allocated again when the connection is used. 0 (the
+        // default) disables it. Set before connecting.
+        void setIdleMemoryReclaimDelay(int idleSecs);
+
+        // Approximate number of bytes allocated for the buffers and the compression state
+        size_t getMemoryUsage() const;
         void addSubProtocol(const std::string& subProtocol);
         void setHandshakeTimeout(int handshakeTimeoutSecs);
 
@@ -93,11 +126,49 @@ namespace ix
                                    const OnProgressCallback& onProgressCallback = nullptr);
         WebSocketSendInfo ping(const std::string& text,SendMessageKind pingType = SendMessageKind::Ping);
 
+        // Send several Text or Binary messages at once: they are framed with a single
+        // lock acquisition and written with a single send. Text messages must be valid
+        // UTF-8, and are validated like with sendText.
+        WebSocketSendInfo sendBatch(const std::vector<IXWebSocketSendData>& messages,
+                                    SendMessageKind sendMessageKind = SendMessageKind::Binary);
+        WebSocketSendInfo sendBatch(const IXWebSocketSendData* messages,
+                                    size_t count,
+                                    SendMessageKind sendMessageKind = SendMessageKind::Binary);
+
+        // Send a message whose size is not known in advance, as the data becomes
+        // available. Each appendFragment() sends a frame (compressed data may be held back
+        // by the compressor until there is enough of it), endMessage() sends the last one.
+        // Other Text and Binary messages cannot be sent until endMessage() is called. Text
+        // fragments are not validated and must form valid UTF-8 once concatenated.
+        bool beginMessage(bool binary);
+        WebSocketSendInfo appendFragment(const IXWebSocketSendData& data);
+        WebSocketSendInfo endMessage();
+
+        // Send a message which supersedes the previous ones sent with the same key, such
+        // as the latest state of an object. With the Conflate backpressure policy, a
+        // message still queued with that key is replaced instead of being refused. Text
+        // messages are validated like with sendText.
+        WebSocketSendInfo sendConflatable(const std::string& key,
+                                          const IXWebSocketSendData& data,
+                                          bool binary = false);
+
+        // Queue a message framed once for many connections, see
+        // WebSocketServer::broadcast(). Does not wait for the data to be written to the
+        // socket, even on the server side. Server side connections only: the frames are
+        // not masked, clients get a failure.
+        WebSocketSendInfo sendBroadcastMessage(const WebSocketBroadcastMessage& message);
+
         void close(uint16_t code = WebSocketCloseConstants::kNormalClosureCode,
                    const std::string& reason = WebSocketCloseConstants::kNormalClosureMessage);
 
         void setOnMessageCallback(const OnMessageCallback& callback);
         bool isOnMessageCallbackRegistered() const;
+
+        // Stream fragmented messages: each frame is passed to the callback as soon as it is
+        // received, decompressed and validated, and the message callback does not get the
+        // reassembled message. data is only valid for the duration of the callback. Messages
+        // sent in a single frame still go to the message callback. Set it before start().
+        void setOnFragmentCallback(const OnFragmentCallback& callback);
         static void setTrafficTrackerCallback(const OnTrafficTrackerCallback& callback);
         static void resetTrafficTrackerCallback();
 
@@ -131,12 +202,16 @@ namespace ix
         void checkConnection(bool firstConnectionAttempt);
         static void invokeTrafficTrackerCallback(size_t size, bool incoming);
 
+        // Execute the callbacks for the messages received by the last poll
+        void dispatch(WebSocketTransport::PollResult pollResult);
+
         // Server
         WebSocketInitResult connectToSocket(std::unique_ptr<Socket>,
                                             int timeoutSecs,
                                             bool enablePerMessageDeflate,
                                             HttpRequestPtr request = nullptr,
-                                            int sendTimeoutSecs = -1);
+                                            int sendTimeoutSecs = -1,
+                                            bool blockingSend = true);
 
         WebSocketTransport _ws;
 
@@ -189,5 +264,6 @@ namespace ix
         bool _autoThreadName;
 
         friend class WebSocketServer;
+        friend class WebSocketEventLoop;
     };
 } // namespace ix
@@ -0,0 +1,65 @@
+/*
+ *  IXWebSocketBackpressure.h
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ *
+ *  What to do with the messages sent to a peer which does not read them fast enough.
+ */
+
+#pragma once
+
+#include "IXWebSocketCloseConstants.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace ix
+{
+    enum class BackpressurePolicy
+    {
+        // Wait until the buffered amount is back to the low watermark
+        Block,
+        // Refuse the message being sent
+        DropNewest,
+        // Drop the oldest messages which were not started yet to make room
+        DropOldest,
+        // Replace the queued message sent with the same key, or queue the message when
+        // there is none, see WebSocket::sendConflatable(). Messages without a key are
+        // refused.
+        Conflate,
+        // Close the connection with disconnectCode
+        Disconnect
+    };
+
+    enum class BackpressureEvent
+    {
+        HighWatermark,
+        LowWatermark
+    };
+
+    //
+    // The policy applies to Text and Binary messages sent while the amount of buffered
+    // data is at or above the high watermark. Control frames and messages streamed
+    // with beginMessage() are never dropped.
+    //
+    // Messages compressed with a context shared with the next messages (without
+    // client_no_context_takeover) cannot be removed once queued, DropOldest and
+    // Conflate then refuse the new message like DropNewest.
+    //
+    struct WebSocketBackpressureOptions
+    {
+        // 0 disables the watermarks
+        size_t highWatermark = 0;
+        size_t lowWatermark = 0;
+        BackpressurePolicy policy = BackpressurePolicy::Block;
+
+        // kPolicyViolationCode (1008) or kTryAgainLaterCode (1013)
+        uint16_t disconnectCode = WebSocketCloseConstants::kPolicyViolationCode;
+    };
+
+    // Called when the buffered amount reaches the high watermark, and when it is back
+    // to the low watermark. It can run on a thread which is sending on the connection,
+    // and must not send on it.
+    using OnBackpressureCallback =
+        std::function<void(BackpressureEvent event, size_t bufferedAmount)>;
+} // namespace ix
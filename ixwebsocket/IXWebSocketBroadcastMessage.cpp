@@ -0,0 +1,69 @@
+/*
+ *  IXWebSocketBroadcastMessage.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ */
+
+#include "IXWebSocketBroadcastMessage.h"
+
+#include "IXWebSocketPerMessageDeflateCodec.h"
+#include "IXWebSocketPerMessageDeflateOptions.h"
+#include "IXWebSocketTransport.h"
+#include <string>
+
+namespace ix
+{
+    WebSocketBroadcastMessage::WebSocketBroadcastMessage(const IXWebSocketSendData& message,
+                                                         bool binary,
+                                                         bool compress)
+        : _payloadSize(message.size())
+        , _binary(binary)
+    {
+        SendMessageKind kind = binary ? SendMessageKind::Binary : SendMessageKind::Text;
+
+        auto frames = std::make_shared<std::vector<uint8_t>>();
+        WebSocketTransport::frameServerMessage(kind, message, false, *frames);
+        _frames = frames;
+
+        if (!compress) return;
+
+        // A fresh compressor which resets its context after the message, so that the
+        // output does not depend on what was sent before on any connection
+        WebSocketPerMessageDeflateCompressor compressor;
+        bool noContextTakeover = true;
+        std::string compressedMessage;
+        if (!compressor.init(WebSocketPerMessageDeflateOptions::kDefaultClientMaxWindowBits,
+                             noContextTakeover) ||
+            !compressor.compress(message, compressedMessage))
+        {
+            // Every connection gets the uncompressed frames
+            return;
+        }
+
+        auto compressedFrames = std::make_shared<std::vector<uint8_t>>();
+        WebSocketTransport::frameServerMessage(
+            kind, IXWebSocketSendData(compressedMessage), true, *compressedFrames);
+        _compressedFrames = compressedFrames;
+    }
+
+    const std::shared_ptr<const std::vector<uint8_t>>& WebSocketBroadcastMessage::getFrames() const
+    {
+        return _frames;
+    }
+
+    const std::shared_ptr<const std::vector<uint8_t>>&
+    WebSocketBroadcastMessage::getCompressedFrames() const
+    {
+        return _compressedFrames;
+    }
+
+    size_t WebSocketBroadcastMessage::getPayloadSize() const
+    {
+        return _payloadSize;
+    }
+
+    bool WebSocketBroadcastMessage::isBinary() const
+    {
+        return _binary;
+    }
+} // namespace ix
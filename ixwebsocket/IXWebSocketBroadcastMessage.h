@@ -0,0 +1,48 @@
+/*
+ *  IXWebSocketBroadcastMessage.h
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ *
+ *  A message framed once and sent to many connections.
+ */
+
+#pragma once
+
+#include "IXWebSocketSendData.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ix
+{
+    //
+    // Server frames are not masked, so the same bytes can be written to every
+    // connection. The frames are built once, and each connection queues a reference
+    // to them instead of a copy. They are immutable, and freed once the last
+    // connection has written them.
+    //
+    // When compress is set the message is also compressed once, on its own. The
+    // connections which cannot take those frames (see
+    // WebSocketTransport::canSendSharedCompressedFrames()) get the uncompressed ones.
+    //
+    class WebSocketBroadcastMessage
+    {
+    public:
+        WebSocketBroadcastMessage(const IXWebSocketSendData& message, bool binary, bool compress);
+
+        const std::shared_ptr<const std::vector<uint8_t>>& getFrames() const;
+
+        // nullptr when the message is not compressed
+        const std::shared_ptr<const std::vector<uint8_t>>& getCompressedFrames() const;
+
+        size_t getPayloadSize() const;
+        bool isBinary() const;
+
+    private:
+        std::shared_ptr<const std::vector<uint8_t>> _frames;
+        std::shared_ptr<const std::vector<uint8_t>> _compressedFrames;
+        size_t _payloadSize;
+        bool _binary;
+    };
+} // namespace ix
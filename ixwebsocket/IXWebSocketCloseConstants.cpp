@@ -14,12 +14,15 @@ namespace ix
     const uint16_t WebSocketCloseConstants::kInvalidFramePayloadData(1007);
     const uint16_t WebSocketCloseConstants::kProtocolErrorCode(1002);
     const uint16_t WebSocketCloseConstants::kNoStatusCodeErrorCode(1005);
+    const uint16_t WebSocketCloseConstants::kPolicyViolationCode(1008);
+    const uint16_t WebSocketCloseConstants::kTryAgainLaterCode(1013);
 
     const std::string WebSocketCloseConstants::kNormalClosureMessage("Normal closure");
     const std::string WebSocketCloseConstants::kInternalErrorMessage("Internal error");
     const std::string WebSocketCloseConstants::kAbnormalCloseMessage("Abnormal closure");
     const std::string WebSocketCloseConstants::kPingTimeoutMessage("Ping timeout");
     const std::string WebSocketCloseConstants::kSendTimeoutMessage("Send timeout");
+    const std::string WebSocketCloseConstants::kSendBufferFullMessage("Send buffer full");
     const std::string WebSocketCloseConstants::kProtocolErrorMessage("Protocol error");
     const std::string WebSocketCloseConstants::kNoStatusCodeErrorMessage("No status code");
     const std::string WebSocketCloseConstants::kProtocolErrorReservedBitUsed("Reserved bit used");
@@ -19,12 +19,15 @@ namespace ix
         static const uint16_t kProtocolErrorCode;
         static const uint16_t kNoStatusCodeErrorCode;
         static const uint16_t kInvalidFramePayloadData;
+        static const uint16_t kPolicyViolationCode;
+        static const uint16_t kTryAgainLaterCode;
 
         static const std::string kNormalClosureMessage;
         static const std::string kInternalErrorMessage;
         static const std::string kAbnormalCloseMessage;
         static const std::string kPingTimeoutMessage;
         static const std::string kSendTimeoutMessage;
+        static const std::string kSendBufferFullMessage;
         static const std::string kProtocolErrorMessage;
         static const std::string kNoStatusCodeErrorMessage;
         static const std::string kProtocolErrorReservedBitUsed;
@@ -0,0 +1,681 @@
+/*
+ *  IXWebSocketEventLoop.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ */
+
+#include "IXWebSocketEventLoop.h"
+
+#include "IXHttp.h"
+#include "IXSelectInterrupt.h"
+#include "IXSelectInterruptFactory.h"
+#include "IXSetThreadName.h"
+#include "IXSocket.h"
+#include "IXTimerWheel.h"
+#include "IXUniquePtr.h"
+#include "IXWebSocket.h"
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <string.h>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+namespace ix
+{
+    const size_t WebSocketEventLoop::kMaxRequestSize(16 * 1024);
+
+    namespace
+    {
+        // Installed on the sockets handled by the event loop, so that the send and
+        // close requests of the transport reach the I/O thread instead of a pipe
+        // polled by a connection thread.
+        class EventLoopSelectInterrupt final : public SelectInterrupt
+        {
+        public:
+            using OnNotifyCallback = std::function<void(uint64_t value)>;
+
+            explicit EventLoopSelectInterrupt(const OnNotifyCallback& onNotifyCallback)
+                : _onNotifyCallback(onNotifyCallback)
+            {
+                ;
+            }
+
+            bool notify(uint64_t value) final
+            {
+                _onNotifyCallback(value);
+                return true;
+            }
+
+        private:
+            OnNotifyCallback _onNotifyCallback;
+        };
+
+        // Maximum number of events returned by a single epoll_wait call
+        const int kEventLoopMaxEvents = 256;
+    } // namespace
+
+    struct WebSocketEventLoop::Connection : std::enable_shared_from_this<Connection>
+    {
+        // Owned by the connection until the upgrade, then by the WebSocket
+        std::unique_ptr<Socket> socket;
+        std::shared_ptr<ConnectionState> connectionState;
+        std::shared_ptr<WebSocket> webSocket;
+
+        // The HTTP upgrade request, read without blocking
+        std::string request;
+        std::chrono::time_point<std::chrono::steady_clock> handshakeDeadline;
+        bool upgraded = false;
+
+        // Scheduled at the next deadline of the connection, in the wheel of its thread
+        TimerWheel::Timer timer;
+        bool finished = false;
+
+        // Set when the last read stopped before the socket was drained. As sockets
+        // are watched in edge triggered mode, the connection must then be processed
+        // again without waiting for an event.
+        bool readPending = false;
+
+        // Set by the transport from any thread, see EventLoopSelectInterrupt
+        std::atomic<bool> sendRequest {false};
+        std::atomic<bool> closeRequest {false};
+        std::atomic<bool> wakeUpPending {false};
+    };
+
+    // Work handed to an I/O thread by other threads
+    struct WebSocketEventLoop::Waker
+    {
+        SelectInterruptPtr selectInterrupt;
+        std::mutex mutex;
+        std::vector<std::pair<std::unique_ptr<Socket>, std::shared_ptr<ConnectionState>>> added;
+        std::vector<std::shared_ptr<Connection>> woken;
+
+        // The I/O thread is only notified when the queues stop being empty, it reads
+        // the notification before swapping them
+        void add(std::unique_ptr<Socket> socket, std::shared_ptr<ConnectionState> connectionState)
+        {
+            bool wasEmpty;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                wasEmpty = added.empty() && woken.empty();
+                added.push_back(std::make_pair(std::move(socket), connectionState));
+            }
+            if (wasEmpty) selectInterrupt->notify(SelectInterrupt::kSendRequest);
+        }
+
+        void wake(std::shared_ptr<Connection> connection)
+        {
+            bool wasEmpty;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                wasEmpty = added.empty() && woken.empty();
+                woken.push_back(std::move(connection));
+            }
+            if (wasEmpty) selectInterrupt->notify(SelectInterrupt::kSendRequest);
+        }
+    };
+
+    struct WebSocketEventLoop::IoThread
+    {
+        int epollFd = -1;
+        std::shared_ptr<Waker> waker;
+        std::thread thread;
+
+        // Only accessed by the I/O thread
+        std::unordered_map<Connection*, std::shared_ptr<Connection>> connections;
+        TimerWheel timers;
+
+        // Read once per epoll_wait call, when the connections schedule their timers
+        std::chrono::time_point<std::chrono::steady_clock> now;
+        std::vector<std::shared_ptr<Connection>> ready;
+
+        // Finished connections are released after the events of the current
+        // epoll_wait call have been processed, as some may still refer to them
+        std::vector<std::shared_ptr<Connection>> finished;
+        bool stopping = false;
+    };
+
+    WebSocketEventLoop::WebSocketEventLoop(
+        size_t threads,
+        int handshakeTimeoutSecs,
+        bool enablePerMessageDeflate,
+        int sendTimeoutSecs,
+        const OnConnectionCallback& onConnectionCallback,
+        const OnConnectionClosedCallback& onConnectionClosedCallback,
+        const SocketServer::LogCallback& logCallback)
+        : _threadsCount(threads == 0 ? 1 : threads)
+        , _handshakeTimeoutSecs(handshakeTimeoutSecs)
+        , _enablePerMessageDeflate(enablePerMessageDeflate)
+        , _sendTimeoutSecs(sendTimeoutSecs)
+        , _onConnectionCallback(onConnectionCallback)
+        , _onConnectionClosedCallback(onConnectionClosedCallback)
+        , _logCallback(logCallback)
+        , _nextThread(0)
+        , _stop(false)
+    {
+        ;
+    }
+
+    WebSocketEventLoop::~WebSocketEventLoop()
+    {
+        stop();
+    }
+
+    bool WebSocketEventLoop::isSupported()
+    {
+#ifdef __linux__
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    size_t WebSocketEventLoop::getThreadsCount() const
+    {
+        return _threadsCount;
+    }
+
+    void WebSocketEventLoop::logError(const std::string& str)
+    {
+        if (_logCallback)
+        {
+            _logCallback(LogLevel::Error, str);
+        }
+    }
+
+#ifdef __linux__
+    bool WebSocketEventLoop::start(std::string& errorMsg)
+    {
+        if (!_ioThreads.empty()) return true;
+
+        _stop = false;
+
+        for (size_t i = 0; i < _threadsCount; ++i)
+        {
+            auto ioThread = ix::make_unique<IoThread>();
+
+            ioThread->waker = std::make_shared<Waker>();
+            ioThread->waker->selectInterrupt = createSelectInterrupt();
+            if (!ioThread->waker->selectInterrupt->init(errorMsg))
+            {
+                stop();
+                return false;
+            }
+
+            ioThread->epollFd = epoll_create1(EPOLL_CLOEXEC);
+            if (ioThread->epollFd < 0)
+            {
+                errorMsg = std::string("epoll_create1 failed: ") + strerror(errno);
+                stop();
+                return false;
+            }
+
+            // The waker is level triggered, and recognized by its null pointer
+            struct epoll_event event;
+            memset(&event, 0, sizeof(event));
+            event.events = EPOLLIN;
+            event.data.ptr = nullptr;
+            if (epoll_ctl(ioThread->epollFd,
+                          EPOLL_CTL_ADD,
+                          ioThread->waker->selectInterrupt->getFd(),
+                          &event) < 0)
+            {
+                errorMsg = std::string("epoll_ctl failed: ") + strerror(errno);
+                ::close(ioThread->epollFd);
+                stop();
+                return false;
+            }
+
+            _ioThreads.push_back(std::move(ioThread));
+        }
+
+        for (size_t i = 0; i < _ioThreads.size(); ++i)
+        {
+            IoThread& ioThread = *_ioThreads[i];
+            ioThread.thread = std::thread(
+                [this, &ioThread, i]
+                {
+                    setThreadName("Srv:io:" + std::to_string(i));
+                    run(ioThread);
+                });
+        }
+
+        return true;
+    }
+
+    void WebSocketEventLoop::stop()
+    {
+        _stop = true;
+
+        for (auto&& ioThread : _ioThreads)
+        {
+            ioThread->waker->selectInterrupt->notify(SelectInterrupt::kCloseRequest);
+        }
+
+        for (auto&& ioThread : _ioThreads)
+        {
+            if (ioThread->thread.joinable()) ioThread->thread.join();
+            if (ioThread->epollFd != -1) ::close(ioThread->epollFd);
+        }
+
+        _ioThreads.clear();
+    }
+
+    void WebSocketEventLoop::add(std::unique_ptr<Socket> socket,
+                                 std::shared_ptr<ConnectionState> connectionState)
+    {
+        size_t i = _nextThread++ % _ioThreads.size();
+        _ioThreads[i]->waker->add(std::move(socket), connectionState);
+    }
+
+    void WebSocketEventLoop::run(IoThread& ioThread)
+    {
+        struct epoll_event events[kEventLoopMaxEvents];
+
+        for (;;)
+        {
+            if (_stop && !ioThread.stopping)
+            {
+                // Connections which are not upgraded yet are dropped, the others are
+                // closed and given the closing delay to receive the peer's CLOSE frame
+                ioThread.stopping = true;
+
+                std::vector<std::shared_ptr<Connection>> connections;
+                for (auto&& it : ioThread.connections)
+                {
+                    connections.push_back(it.second);
+                }
+                ioThread.now = std::chrono::steady_clock::now();
+                for (auto&& connection : connections)
+                {
+                    if (connection->upgraded)
+                    {
+                        connection->webSocket->close();
+                        scheduleTimer(ioThread, *connection);
+                    }
+                    else
+                    {
+                        finishConnection(ioThread, *connection);
+                    }
+                }
+                ioThread.finished.clear();
+            }
+
+            if (ioThread.stopping && ioThread.connections.empty()) break;
+
+            int timeoutMs = 0;
+            if (ioThread.ready.empty())
+            {
+                timeoutMs = ioThread.timers.getTimeoutMs(std::chrono::steady_clock::now());
+            }
+
+            int n = epoll_wait(ioThread.epollFd, events, kEventLoopMaxEvents, timeoutMs);
+            if (n < 0)
+            {
+                if (errno == EINTR) continue;
+
+                std::stringstream ss;
+                ss << "WebSocketEventLoop::run() error in epoll_wait: " << strerror(errno);
+                logError(ss.str());
+                break;
+            }
+            ioThread.now = std::chrono::steady_clock::now();
+
+            // Connections which could not read everything the last time they were
+            // processed, they will not get another event for the data already there
+            std::vector<std::shared_ptr<Connection>> ready;
+            ready.swap(ioThread.ready);
+            for (auto&& connection : ready)
+            {
+                connection->readPending = false;
+                processConnection(ioThread, *connection, true, false);
+            }
+
+            for (int i = 0; i < n; ++i)
+            {
+                if (events[i].data.ptr == nullptr)
+                {
+                    ioThread.waker->selectInterrupt->read();
+
+                    std::vector<std::pair<std::unique_ptr<Socket>, std::shared_ptr<ConnectionState>>>
+                        added;
+                    std::vector<std::shared_ptr<Connection>> woken;
+                    {
+                        std::lock_guard<std::mutex> lock(ioThread.waker->mutex);
+                        added.swap(ioThread.waker->added);
+                        woken.swap(ioThread.waker->woken);
+                    }
+
+                    for (auto&& it : added)
+                    {
+                        addConnection(ioThread, std::move(it.first), it.second);
+                    }
+
+                    for (auto&& connection : woken)
+                    {
+                        connection->wakeUpPending = false;
+                        processConnection(ioThread, *connection, false, false);
+                    }
+                    continue;
+                }
+
+                uint32_t flags = events[i].events;
+                bool readyToRead = (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0;
+                bool readyToWrite = (flags & EPOLLOUT) != 0;
+
+                auto connection = static_cast<Connection*>(events[i].data.ptr);
+                processConnection(ioThread, *connection, readyToRead, readyToWrite);
+            }
+
+            ioThread.now = std::chrono::steady_clock::now();
+            ioThread.timers.advance(ioThread.now);
+
+            ioThread.finished.clear();
+        }
+
+        // The remaining connections are released with the I/O thread, they may
+        // outlive it and its timer wheel
+        for (auto&& it : ioThread.connections)
+        {
+            it.second->timer.cancel();
+        }
+        ioThread.ready.clear();
+        ioThread.connections.clear();
+    }
+
+    void WebSocketEventLoop::addConnection(IoThread& ioThread,
+                                           std::unique_ptr<Socket> socket,
+                                           std::shared_ptr<ConnectionState> connectionState)
+    {
+        auto connection = std::make_shared<Connection>();
+        connection->socket = std::move(socket);
+        connection->connectionState = connectionState;
+        connection->handshakeDeadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(_handshakeTimeoutSecs);
+
+        if (ioThread.stopping)
+        {
+            connection->socket->close();
+            connectionState->setTerminated();
+            return;
+        }
+
+        connection->webSocket = _onConnectionCallback(connectionState);
+        if (!connection->webSocket)
+        {
+            // The server needs to learn about it whatever the callback did
+            connection->socket->close();
+            connectionState->setTerminated();
+            return;
+        }
+
+        // Send and close requests made by other threads are forwarded to this one
+        std::weak_ptr<Connection> weakConnection(connection);
+        std::shared_ptr<Waker> waker(ioThread.waker);
+        connection->socket->setSelectInterrupt(ix::make_unique<EventLoopSelectInterrupt>(
+            [weakConnection, waker](uint64_t value)
+            {
+                auto connection = weakConnection.lock();
+                if (!connection) return;
+
+                if (value == SelectInterrupt::kCloseRequest)
+                {
+                    connection->closeRequest = true;
+                }
+                else
+                {
+                    connection->sendRequest = true;
+                }
+
+                if (!connection->wakeUpPending.exchange(true))
+                {
+                    waker->wake(connection);
+                }
+            }));
+
+        // The socket stays registered until it is closed, which removes it from the
+        // epoll set. Modifying or removing it explicitly could race with the fd being
+        // reused by another connection.
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.ptr = connection.get();
+
+        ioThread.connections[connection.get()] = connection;
+
+        Connection* rawConnection = connection.get();
+        connection->timer.setCallback([this, &ioThread, rawConnection]
+                                      { onTimer(ioThread, *rawConnection); });
+        ioThread.timers.schedule(connection->timer, connection->handshakeDeadline);
+
+        if (epoll_ctl(ioThread.epollFd, EPOLL_CTL_ADD, connection->socket->getFd(), &event) < 0)
+        {
+            std::stringstream ss;
+            ss << "WebSocketEventLoop::addConnection() error in epoll_ctl: " << strerror(errno);
+            logError(ss.str());
+            finishConnection(ioThread, *connection);
+        }
+    }
+
+    void WebSocketEventLoop::processConnection(IoThread& ioThread,
+                                               Connection& connection,
+                                               bool readyToRead,
+                                               bool readyToWrite)
+    {
+        if (connection.finished) return;
+
+        if (!connection.upgraded)
+        {
+            if (!readyToRead) return;
+
+            if (!readRequest(connection))
+            {
+                finishConnection(ioThread, connection);
+                return;
+            }
+
+            if (connection.request.find("\r\n\r\n") == std::string::npos) return;
+
+            upgrade(ioThread, connection);
+            if (connection.finished) return;
+
+            // The request may have been followed by frames
+            readyToRead = true;
+        }
+
+        bool closeRequest = connection.closeRequest.exchange(false);
+        bool sendRequest = connection.sendRequest.exchange(false);
+
+        WebSocket& webSocket = *connection.webSocket;
+        auto pollResult = webSocket._ws.poll(readyToRead, readyToWrite || sendRequest, closeRequest);
+        webSocket.dispatch(pollResult);
+
+        if (webSocket._ws.getReadyState() == WebSocketTransport::ReadyState::CLOSED)
+        {
+            finishConnection(ioThread, connection);
+            return;
+        }
+
+        if (readyToRead && webSocket._ws.isReceivePending() && !connection.readPending)
+        {
+            connection.readPending = true;
+            ioThread.ready.push_back(connection.shared_from_this());
+        }
+
+        scheduleTimer(ioThread, connection);
+    }
+
+    bool WebSocketEventLoop::readRequest(Connection& connection)
+    {
+        char buffer[1024];
+
+        for (;;)
+        {
+            std::ptrdiff_t ret = connection.socket->recv(buffer, sizeof(buffer));
+
+            if (ret < 0 && Socket::isWaitNeeded())
+            {
+                return true;
+            }
+            else if (ret <= 0)
+            {
+                return false;
+            }
+
+            // Only look for the end of the request in the new bytes
+            size_t pos = connection.request.size() < 3 ? 0 : connection.request.size() - 3;
+            connection.request.append(buffer, (size_t) ret);
+
+            if (connection.request.find("\r\n\r\n", pos) != std::string::npos)
+            {
+                // Whatever follows is read by the transport
+                return true;
+            }
+
+            if (connection.request.size() > kMaxRequestSize)
+            {
+                std::stringstream ss;
+                ss << "WebSocketEventLoop: HTTP upgrade request from "
+                   << connection.connectionState->getRemoteIp() << ":"
+                   << connection.connectionState->getRemotePort() << " is larger than "
+                   << kMaxRequestSize << " bytes";
+                logError(ss.str());
+                return false;
+            }
+        }
+    }
+
+    void WebSocketEventLoop::upgrade(IoThread& ioThread, Connection& connection)
+    {
+        size_t end = connection.request.find("\r\n\r\n") + 4;
+        size_t lineEnd = connection.request.find("\r\n");
+
+        auto requestLine = Http::parseRequestLine(connection.request.substr(0, lineEnd));
+        auto result = parseHttpHeaders(connection.request.substr(lineEnd + 2, end - lineEnd - 2));
+
+        auto request = std::make_shared<HttpRequest>(std::get<1>(requestLine),
+                                                     std::get<0>(requestLine),
+                                                     std::get<2>(requestLine),
+                                                     std::string(),
+                                                     result.second);
+
+        // The transport writes without blocking, the event loop flushes what is left
+        bool blockingSend = false;
+        auto status = connection.webSocket->connectToSocket(std::move(connection.socket),
+                                                            _handshakeTimeoutSecs,
+                                                            _enablePerMessageDeflate,
+                                                            request,
+                                                            _sendTimeoutSecs,
+                                                            blockingSend);
+        if (!status.success)
+        {
+            std::stringstream ss;
+            ss << "WebSocketServer::handleConnection() HTTP status: " << status.http_status
+               << " error: " << status.errorStr;
+            logError(ss.str());
+
+            connection.webSocket->_ws.closeSocket();
+            finishConnection(ioThread, connection);
+            return;
+        }
+
+        connection.upgraded = true;
+
+        if (end < connection.request.size())
+        {
+            connection.webSocket->_ws.appendToReceiveBuffer(connection.request.data() + end,
+                                                            connection.request.size() - end);
+        }
+        std::string().swap(connection.request);
+    }
+
+    void WebSocketEventLoop::scheduleTimer(IoThread& ioThread, Connection& connection)
+    {
+        if (connection.finished || !connection.upgraded) return;
+
+        auto deadline = connection.webSocket->_ws.getTimersDeadline(ioThread.now);
+        if (deadline == std::chrono::time_point<std::chrono::steady_clock>::max())
+        {
+            connection.timer.cancel();
+        }
+        else
+        {
+            ioThread.timers.schedule(connection.timer, deadline);
+        }
+    }
+
+    void WebSocketEventLoop::onTimer(IoThread& ioThread, Connection& connection)
+    {
+        if (connection.finished) return;
+
+        if (!connection.upgraded)
+        {
+            std::stringstream ss;
+            ss << "WebSocketEventLoop: handshake timeout for client "
+               << connection.connectionState->getRemoteIp() << ":"
+               << connection.connectionState->getRemotePort();
+            logError(ss.str());
+            finishConnection(ioThread, connection);
+            return;
+        }
+
+        // Ping, send timeout and closing delay
+        auto& transport = connection.webSocket->_ws;
+        transport.checkTimers();
+        if (transport.getReadyState() == WebSocketTransport::ReadyState::CLOSED)
+        {
+            finishConnection(ioThread, connection);
+            return;
+        }
+
+        scheduleTimer(ioThread, connection);
+    }
+
+    void WebSocketEventLoop::finishConnection(IoThread& ioThread, Connection& connection)
+    {
+        if (connection.finished) return;
+        connection.finished = true;
+        connection.timer.cancel();
+
+        if (connection.socket)
+        {
+            connection.socket->close();
+        }
+
+        auto it = ioThread.connections.find(&connection);
+        if (it != ioThread.connections.end())
+        {
+            ioThread.finished.push_back(it->second);
+            ioThread.connections.erase(it);
+        }
+
+        _onConnectionClosedCallback(connection.webSocket, connection.connectionState);
+    }
+#else
+    struct WebSocketEventLoop::IoThread
+    {
+    };
+
+    bool WebSocketEventLoop::start(std::string& errorMsg)
+    {
+        errorMsg = "The WebSocket event loop is only supported on Linux";
+        return false;
+    }
+
+    void WebSocketEventLoop::stop()
+    {
+        ;
+    }
+
+    void WebSocketEventLoop::add(std::unique_ptr<Socket> socket,
+                                 std::shared_ptr<ConnectionState> connectionState)
+    {
+        socket->close();
+        connectionState->setTerminated();
+    }
+#endif
+} // namespace ix
@@ -0,0 +1,117 @@
+/*
+ *  IXWebSocketEventLoop.h
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ *
+ *  Serve many WebSocket connections from a fixed number of I/O threads.
+ */
+
+#pragma once
+
+#include "IXConnectionState.h"
+#include "IXSocketServer.h"
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ix
+{
+    class Socket;
+    class WebSocket;
+
+    //
+    // Each I/O thread waits for the sockets of its connections with epoll, and runs
+    // every connection as a small state machine: the HTTP upgrade request is read
+    // without blocking, then the frames are read, dispatched to the message callback
+    // and the send buffer is flushed whenever the socket is ready. Connections are
+    // assigned to the threads round robin.
+    //
+    // The handshake, ping, send and closing timeouts of the connections of a thread
+    // are kept in a timer wheel: a connection is only looked at when one of its
+    // deadlines expires, and the deadlines expiring together are handled by a single
+    // wake up.
+    //
+    // Callbacks run on the I/O threads, and must not block: they delay all the other
+    // connections handled by the same thread.
+    //
+    // Only available on Linux, see isSupported().
+    //
+    class WebSocketEventLoop
+    {
+    public:
+        // Called on the I/O thread before the handshake, returns the WebSocket object
+        // which will handle the connection, or nullptr to drop it
+        using OnConnectionCallback =
+            std::function<std::shared_ptr<WebSocket>(std::shared_ptr<ConnectionState>)>;
+
+        // Called on the I/O thread once the connection is closed
+        using OnConnectionClosedCallback = std::function<void(
+            std::shared_ptr<WebSocket>, std::shared_ptr<ConnectionState>)>;
+
+        WebSocketEventLoop(size_t threads,
+                           int handshakeTimeoutSecs,
+                           bool enablePerMessageDeflate,
+                           int sendTimeoutSecs,
+                           const OnConnectionCallback& onConnectionCallback,
+                           const OnConnectionClosedCallback& onConnectionClosedCallback,
+                           const SocketServer::LogCallback& logCallback);
+        ~WebSocketEventLoop();
+
+        WebSocketEventLoop(const WebSocketEventLoop&) = delete;
+        WebSocketEventLoop& operator=(const WebSocketEventLoop&) = delete;
+
+        static bool isSupported();
+
+        bool start(std::string& errorMsg);
+
+        // Close all the connections and join the I/O threads
+        void stop();
+
+        // Can be called from any thread. The socket must be in non blocking mode.
+        void add(std::unique_ptr<Socket> socket, std::shared_ptr<ConnectionState> connectionState);
+
+        size_t getThreadsCount() const;
+
+        // The HTTP upgrade request cannot be larger than that
+        static const size_t kMaxRequestSize;
+
+    private:
+        struct Connection;
+        struct Waker;
+        struct IoThread;
+
+        void run(IoThread& ioThread);
+
+        void addConnection(IoThread& ioThread,
+                           std::unique_ptr<Socket> socket,
+                           std::shared_ptr<ConnectionState> connectionState);
+        void processConnection(IoThread& ioThread,
+                               Connection& connection,
+                               bool readyToRead,
+                               bool readyToWrite);
+        bool readRequest(Connection& connection);
+        void upgrade(IoThread& ioThread, Connection& connection);
+        void scheduleTimer(IoThread& ioThread, Connection& connection);
+        void onTimer(IoThread& ioThread, Connection& connection);
+        void finishConnection(IoThread& ioThread, Connection& connection);
+
+        void logError(const std::string& str);
+
+        size_t _threadsCount;
+        int _handshakeTimeoutSecs;
+        bool _enablePerMessageDeflate;
+        int _sendTimeoutSecs;
+
+        OnConnectionCallback _onConnectionCallback;
+        OnConnectionClosedCallback _onConnectionClosedCallback;
+        SocketServer::LogCallback _logCallback;
+
+        std::vector<std::unique_ptr<IoThread>> _ioThreads;
+        std::atomic<size_t> _nextThread;
+        std::atomic<bool> _stop;
+    };
+} // namespace ix
@@ -386,6 +386,9 @@ namespace ix
                     false, 0, "Failed to initialize per message deflate engine");
             }
             ss << webSocketPerMessageDeflateOptions.generateHeader();
+
+            // Keep the negotiated options, the transport looks at them
+            _perMessageDeflateOptions = webSocketPerMessageDeflateOptions;
         }
 
         ss << "\r\n";
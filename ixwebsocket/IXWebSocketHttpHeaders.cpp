@@ -11,6 +11,39 @@
 
 namespace ix
 {
+    namespace
+    {
+        // line is a single header entry. split by ':', and add it to our
+        // header map. ignore lines with no colon.
+        void addHttpHeaderLine(WebSocketHttpHeaders& headers,
+                               const std::string& lineStr,
+                               int colon)
+        {
+            if (colon <= 0) return;
+
+            int start = colon + 1;
+            while (start < (int) lineStr.size() && lineStr[start] == ' ')
+            {
+                start++;
+            }
+
+            std::string name(lineStr.substr(0, colon));
+            std::string value;
+            if (start < (int) lineStr.size())
+            {
+                value = lineStr.substr(start);
+                // trim trailing whitespace (\r, \n, spaces)
+                value.erase(std::find_if(value.rbegin(),
+                                         value.rend(),
+                                         [](unsigned char c) { return !std::isspace(c); })
+                                .base(),
+                            value.end());
+            }
+
+            headers[name] = value;
+        }
+    } // namespace
+
     std::pair<bool, WebSocketHttpHeaders> parseHttpHeaders(
         std::unique_ptr<Socket>& socket, const CancellationRequest& isCancellationRequested)
     {
@@ -40,34 +73,37 @@ namespace ix
                 break;
             }
 
-            // line is a single header entry. split by ':', and add it to our
-            // header map. ignore lines with no colon.
-            if (colon > 0)
-            {
-                line[i] = '\0';
-                std::string lineStr(line);
+            line[i] = '\0';
+            addHttpHeaderLine(headers, line, colon);
+        }
 
-                int start = colon + 1;
-                while (start < (int) lineStr.size() && lineStr[start] == ' ')
-                {
-                    start++;
-                }
+        return std::make_pair(true, headers);
+    }
 
-                std::string name(lineStr.substr(0, colon));
-                std::string value;
-                if (start < (int) lineStr.size())
-                {
-                    value = lineStr.substr(start);
-                    // trim trailing whitespace (\r, \n, spaces)
-                    value.erase(std::find_if(value.rbegin(),
-                                             value.rend(),
-                                             [](unsigned char c) { return !std::isspace(c); })
-                                    .base(),
-                                value.end());
-                }
+    std::pair<bool, WebSocketHttpHeaders> parseHttpHeaders(const std::string& data)
+    {
+        WebSocketHttpHeaders headers;
 
-                headers[name] = value;
+        size_t pos = 0;
+        while (true)
+        {
+            size_t end = data.find("\r\n", pos);
+            if (end == std::string::npos)
+            {
+                // The empty line ending the headers is missing
+                return std::make_pair(false, headers);
             }
+
+            if (end == pos)
+            {
+                break;
+            }
+
+            std::string lineStr(data, pos, end - pos);
+            size_t colon = lineStr.find(':');
+            addHttpHeaderLine(headers, lineStr, colon == std::string::npos ? 0 : (int) colon);
+
+            pos = end + 2;
         }
 
         return std::make_pair(true, headers);
@@ -20,4 +20,8 @@ namespace ix
 
     std::pair<bool, WebSocketHttpHeaders> parseHttpHeaders(
         std::unique_ptr<Socket>& socket, const CancellationRequest& isCancellationRequested);
+
+    // Parse headers already read from the socket, starting after the request line and
+    // ending with the empty line
+    std::pair<bool, WebSocketHttpHeaders> parseHttpHeaders(const std::string& data);
 } // namespace ix
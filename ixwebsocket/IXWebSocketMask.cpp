@@ -0,0 +1,230 @@
+/*
+ *  IXWebSocketMask.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ */
+
+#include "IXWebSocketMask.h"
+
+#include "IXCpuFeatures.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define IXWEBSOCKET_MASK_X86
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IXWEBSOCKET_MASK_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#define IXWEBSOCKET_MASK_AVX2
+#define IXWEBSOCKET_MASK_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER)
+#define IXWEBSOCKET_MASK_AVX2
+#define IXWEBSOCKET_MASK_AVX2_TARGET
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define IXWEBSOCKET_MASK_NEON
+#include <arm_neon.h>
+#endif
+
+namespace ix
+{
+    namespace
+    {
+        // A kernel masks as many whole blocks as it can, starting at a 16 bytes
+        // aligned address, and returns the number of bytes it processed, which is
+        // always a multiple of 4 so that the key offset is unchanged.
+        // key holds the 4 bytes masking key, already rotated to the current
+        // offset, and repeated twice.
+        using MaskKernel = size_t (*)(uint8_t* data, size_t size, const uint8_t key[8]);
+
+        size_t maskWords(uint8_t* data, size_t size, const uint8_t key[8])
+        {
+            uint64_t k;
+            memcpy(&k, key, sizeof(k));
+
+            size_t n = size & ~static_cast<size_t>(7);
+            for (size_t i = 0; i < n; i += 8)
+            {
+                uint64_t w;
+                memcpy(&w, data + i, sizeof(w));
+                w ^= k;
+                memcpy(data + i, &w, sizeof(w));
+            }
+            return n;
+        }
+
+#ifdef IXWEBSOCKET_MASK_SSE2
+        size_t maskSSE2(uint8_t* data, size_t size, const uint8_t key[8])
+        {
+            int32_t k;
+            memcpy(&k, key, sizeof(k));
+            const __m128i mask = _mm_set1_epi32(k);
+
+            size_t n = size & ~static_cast<size_t>(63);
+            for (size_t i = 0; i < n; i += 64)
+            {
+                __m128i* p = reinterpret_cast<__m128i*>(data + i);
+                __m128i a = _mm_load_si128(p);
+                __m128i b = _mm_load_si128(p + 1);
+                __m128i c = _mm_load_si128(p + 2);
+                __m128i d = _mm_load_si128(p + 3);
+                _mm_store_si128(p, _mm_xor_si128(a, mask));
+                _mm_store_si128(p + 1, _mm_xor_si128(b, mask));
+                _mm_store_si128(p + 2, _mm_xor_si128(c, mask));
+                _mm_store_si128(p + 3, _mm_xor_si128(d, mask));
+            }
+
+            size_t m = size & ~static_cast<size_t>(15);
+            for (size_t i = n; i < m; i += 16)
+            {
+                __m128i* p = reinterpret_cast<__m128i*>(data + i);
+                _mm_store_si128(p, _mm_xor_si128(_mm_load_si128(p), mask));
+            }
+            return m;
+        }
+#endif
+
+#ifdef IXWEBSOCKET_MASK_AVX2
+        IXWEBSOCKET_MASK_AVX2_TARGET
+        size_t maskAVX2(uint8_t* data, size_t size, const uint8_t key[8])
+        {
+            int32_t k;
+            memcpy(&k, key, sizeof(k));
+            const __m256i mask = _mm256_set1_epi32(k);
+
+            // data is only guaranteed to be 16 bytes aligned, use unaligned
+            // loads which are as fast as aligned ones on AVX2 capable cpus.
+            size_t n = size & ~static_cast<size_t>(127);
+            for (size_t i = 0; i < n; i += 128)
+            {
+                __m256i* p = reinterpret_cast<__m256i*>(data + i);
+                __m256i a = _mm256_loadu_si256(p);
+                __m256i b = _mm256_loadu_si256(p + 1);
+                __m256i c = _mm256_loadu_si256(p + 2);
+                __m256i d = _mm256_loadu_si256(p + 3);
+                _mm256_storeu_si256(p, _mm256_xor_si256(a, mask));
+                _mm256_storeu_si256(p + 1, _mm256_xor_si256(b, mask));
+                _mm256_storeu_si256(p + 2, _mm256_xor_si256(c, mask));
+                _mm256_storeu_si256(p + 3, _mm256_xor_si256(d, mask));
+            }
+
+            size_t m = size & ~static_cast<size_t>(31);
+            for (size_t i = n; i < m; i += 32)
+            {
+                __m256i* p = reinterpret_cast<__m256i*>(data + i);
+                _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), mask));
+            }
+            return m;
+        }
+#endif
+
+#ifdef IXWEBSOCKET_MASK_NEON
+        size_t maskNEON(uint8_t* data, size_t size, const uint8_t key[8])
+        {
+            uint32_t k;
+            memcpy(&k, key, sizeof(k));
+            const uint8x16_t mask = vreinterpretq_u8_u32(vdupq_n_u32(k));
+
+            size_t n = size & ~static_cast<size_t>(63);
+            for (size_t i = 0; i < n; i += 64)
+            {
+                uint8x16_t a = vld1q_u8(data + i);
+                uint8x16_t b = vld1q_u8(data + i + 16);
+                uint8x16_t c = vld1q_u8(data + i + 32);
+                uint8x16_t d = vld1q_u8(data + i + 48);
+                vst1q_u8(data + i, veorq_u8(a, mask));
+                vst1q_u8(data + i + 16, veorq_u8(b, mask));
+                vst1q_u8(data + i + 32, veorq_u8(c, mask));
+                vst1q_u8(data + i + 48, veorq_u8(d, mask));
+            }
+
+            size_t m = size & ~static_cast<size_t>(15);
+            for (size_t i = n; i < m; i += 16)
+            {
+                vst1q_u8(data + i, veorq_u8(vld1q_u8(data + i), mask));
+            }
+            return m;
+        }
+#endif
+
+        struct MaskKernelInfo
+        {
+            MaskKernel kernel;
+            const char* name;
+        };
+
+        MaskKernelInfo selectMaskKernel()
+        {
+#ifdef IXWEBSOCKET_MASK_AVX2
+            if (cpuSupportsAVX2()) return {maskAVX2, "avx2"};
+#endif
+#ifdef IXWEBSOCKET_MASK_SSE2
+            return {maskSSE2, "sse2"};
+#elif defined(IXWEBSOCKET_MASK_NEON)
+            return {maskNEON, "neon"};
+#else
+            return {maskWords, "word"};
+#endif
+        }
+
+        const MaskKernelInfo& getMaskKernel()
+        {
+            static const MaskKernelInfo info = selectMaskKernel();
+            return info;
+        }
+
+        // Below that size the setup cost of the vectorized path is not worth it
+        const size_t kMaskVectorThreshold = 32;
+    } // namespace
+
+    size_t applyWebSocketMask(uint8_t* data,
+                              size_t size,
+                              const uint8_t maskingKey[4],
+                              size_t keyOffset)
+    {
+        keyOffset &= 0x3;
+
+        if (size >= kMaskVectorThreshold)
+        {
+            // Unaligned head, byte per byte
+            while ((reinterpret_cast<uintptr_t>(data) & 15) != 0)
+            {
+                *data++ ^= maskingKey[keyOffset];
+                keyOffset = (keyOffset + 1) & 0x3;
+                --size;
+            }
+
+            uint8_t key[8];
+            for (size_t i = 0; i < 8; ++i)
+            {
+                key[i] = maskingKey[(keyOffset + i) & 0x3];
+            }
+
+            size_t processed = getMaskKernel().kernel(data, size, key);
+            data += processed;
+            size -= processed;
+
+            // Fallback kernel for the blocks the vectorized one did not handle
+            processed = maskWords(data, size, key);
+            data += processed;
+            size -= processed;
+        }
+
+        // Tail, byte per byte
+        for (size_t i = 0; i < size; ++i)
+        {
+            data[i] ^= maskingKey[keyOffset];
+            keyOffset = (keyOffset + 1) & 0x3;
+        }
+
+        return keyOffset;
+    }
+
+    const char* getWebSocketMaskKernelName()
+    {
+        return getMaskKernel().name;
+    }
+} // namespace ix
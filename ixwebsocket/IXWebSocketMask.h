@@ -0,0 +1,35 @@
+/*
+ *  IXWebSocketMask.h
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ *
+ *  Masking / unmasking of WebSocket payloads.
+ *  https://tools.ietf.org/html/rfc6455#section-5.3
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ix
+{
+    //
+    // XOR size bytes of data in place with the 4 bytes masking key. Masking and
+    // unmasking are the same operation.
+    //
+    // keyOffset is the position in the masking key of the first byte of data,
+    // which lets a payload be processed in several pieces. The returned value
+    // is the keyOffset to use for the piece that follows.
+    //
+    // A vectorized kernel (AVX2 or SSE2 on x86, NEON on ARM, 64 bits words
+    // otherwise) is selected at runtime, the first time this is called.
+    //
+    size_t applyWebSocketMask(uint8_t* data,
+                              size_t size,
+                              const uint8_t maskingKey[4],
+                              size_t keyOffset = 0);
+
+    // Name of the kernel selected at runtime (avx2, sse2, neon or word)
+    const char* getWebSocketMaskKernelName();
+} // namespace ix
@@ -12,6 +12,9 @@
 #include "IXWebSocketOpenInfo.h"
 #include <memory>
 #include <string>
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <string_view>
+#endif
 
 namespace ix
 {
@@ -32,6 +35,25 @@ namespace ix
                          WebSocketOpenInfo o,
                          WebSocketCloseInfo c,
                          bool b = false)
+            : WebSocketMessage(t, s, s.data(), s.size(), w, e, o, c, b)
+        {
+            ;
+        }
+
+        /**
+         * @brief Message whose payload is given by a pointer and a size, which do not need to
+         * refer to s. This is used for zero copy delivery, where s is empty and the payload
+         * points directly into the receive buffer.
+         */
+        WebSocketMessage(WebSocketMessageType t,
+                         const std::string& s,
+                         const char* d,
+                         size_t n,
+                         size_t w,
+                         WebSocketErrorInfo e,
+                         WebSocketOpenInfo o,
+                         WebSocketCloseInfo c,
+                         bool b = false)
             : type(t)
             , str(s)
             , wireSize(w)
@@ -39,10 +61,34 @@ namespace ix
             , openInfo(o)
             , closeInfo(c)
             , binary(b)
+            , _data(d)
+            , _size(n)
         {
             ;
         }
 
+        /**
+         * @brief Payload of the message. It is the content of str, except when zero copy
+         * delivery is enabled (see WebSocket::enableZeroCopyDelivery). In that mode str is
+         * empty, and the payload is only valid for the duration of the message callback.
+         */
+        const char* data() const
+        {
+            return _data;
+        }
+
+        size_t size() const
+        {
+            return _size;
+        }
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+        std::string_view view() const
+        {
+            return std::string_view(_data, _size);
+        }
+#endif
+
         /**
          * @brief Deleted overload to prevent binding `str` to a temporary, which would cause
          * undefined behavior since class members don't extend lifetime beyond the constructor call.
@@ -54,6 +100,20 @@ namespace ix
                          WebSocketOpenInfo o,
                          WebSocketCloseInfo c,
                          bool b = false) = delete;
+
+        WebSocketMessage(WebSocketMessageType t,
+                         std::string&& s,
+                         const char* d,
+                         size_t n,
+                         size_t w,
+                         WebSocketErrorInfo e,
+                         WebSocketOpenInfo o,
+                         WebSocketCloseInfo c,
+                         bool b = false) = delete;
+
+    private:
+        const char* _data;
+        size_t _size;
     };
 
     using WebSocketMessagePtr = std::unique_ptr<WebSocketMessage>;
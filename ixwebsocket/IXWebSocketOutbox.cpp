@@ -0,0 +1,135 @@
+/*
+ *  IXWebSocketOutbox.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ */
+
+#include "IXWebSocketOutbox.h"
+
+#include "IXWebSocketSendQueue.h"
+
+namespace ix
+{
+    WebSocketOutbox::WebSocketOutbox()
+        : _head(&_stub)
+        , _tail(&_stub)
+        , _size(0)
+        , _wakeUpPending(false)
+    {
+        _stub.next.store(nullptr, std::memory_order_relaxed);
+    }
+
+    WebSocketOutbox::~WebSocketOutbox()
+    {
+        while (Node* node = pop())
+        {
+            delete node;
+        }
+    }
+
+    bool WebSocketOutbox::push(std::vector<uint8_t>&& frames)
+    {
+        size_t size = frames.size();
+
+        Node* node = new Node;
+        node->frames = std::move(frames);
+        return pushFrames(node, size);
+    }
+
+    bool WebSocketOutbox::push(const std::shared_ptr<const std::vector<uint8_t>>& frames)
+    {
+        Node* node = new Node;
+        node->sharedFrames = frames;
+        return pushFrames(node, frames->size());
+    }
+
+    bool WebSocketOutbox::pushFrames(Node* node, size_t size)
+    {
+        // Count the bytes first, so that the outbox never looks empty while a
+        // message is being linked
+        _size.fetch_add(size, std::memory_order_relaxed);
+
+        pushNode(node);
+
+        return !_wakeUpPending.exchange(true, std::memory_order_acq_rel);
+    }
+
+    void WebSocketOutbox::pushNode(Node* node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = _head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    WebSocketOutbox::Node* WebSocketOutbox::pop()
+    {
+        Node* tail = _tail;
+        Node* next = tail->next.load(std::memory_order_acquire);
+
+        if (tail == &_stub)
+        {
+            if (next == nullptr) return nullptr;
+
+            _tail = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next != nullptr)
+        {
+            _tail = next;
+            return tail;
+        }
+
+        // A producer swapped the head but has not linked its node yet. It will be
+        // popped by the next drain, which that producer's wake up triggers.
+        if (tail != _head.load(std::memory_order_acquire)) return nullptr;
+
+        // tail is the last node, put the stub behind it so that it can be popped
+        pushNode(&_stub);
+
+        next = tail->next.load(std::memory_order_acquire);
+        if (next != nullptr)
+        {
+            _tail = next;
+            return tail;
+        }
+
+        return nullptr;
+    }
+
+    void WebSocketOutbox::drain(WebSocketSendQueue& queue)
+    {
+        // Clear the flag before popping: a message pushed after this point either
+        // gets popped below, or asks for another wake up. A plain store could be
+        // reordered after the loads of pop(). As a read-modify-write, the exchange is
+        // ordered with the exchange of the producers: either it reads the flag they
+        // set, and acquires their links, or they read false and wake the consumer up.
+        _wakeUpPending.exchange(false, std::memory_order_acq_rel);
+
+        while (Node* node = pop())
+        {
+            if (node->sharedFrames)
+            {
+                _size.fetch_sub(node->sharedFrames->size(), std::memory_order_relaxed);
+                queue.append(node->sharedFrames);
+            }
+            else
+            {
+                _size.fetch_sub(node->frames.size(), std::memory_order_relaxed);
+                queue.append(std::move(node->frames));
+            }
+            delete node;
+        }
+    }
+
+    bool WebSocketOutbox::empty() const
+    {
+        return size() == 0;
+    }
+
+    size_t WebSocketOutbox::size() const
+    {
+        return _size.load(std::memory_order_relaxed);
+    }
+} // namespace ix
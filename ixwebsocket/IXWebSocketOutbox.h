@@ -0,0 +1,71 @@
+/*
+ *  IXWebSocketOutbox.h
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ *
+ *  Lock free queue of framed messages, filled by any thread and drained by one.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ix
+{
+    class WebSocketSendQueue;
+
+    //
+    // Multiple producers, single consumer intrusive linked list (Dmitry Vyukov's
+    // algorithm). push() is wait free, and messages pushed by one thread are
+    // drained in the order they were pushed.
+    //
+    class WebSocketOutbox
+    {
+    public:
+        WebSocketOutbox();
+        ~WebSocketOutbox();
+
+        WebSocketOutbox(const WebSocketOutbox&) = delete;
+        WebSocketOutbox& operator=(const WebSocketOutbox&) = delete;
+
+        // Can be called from any thread. Returns true when the consumer needs to be
+        // woken up, which happens once for all the messages pushed between two drains.
+        bool push(std::vector<uint8_t>&& frames);
+
+        // Same as above, for frames shared with other connections
+        bool push(const std::shared_ptr<const std::vector<uint8_t>>& frames);
+
+        // Move the queued messages at the end of queue. Calls must be serialized. The
+        // consumer must drain after each wake up, even when the outbox looks empty.
+        void drain(WebSocketSendQueue& queue);
+
+        bool empty() const;
+
+        // Number of bytes pushed and not drained yet
+        size_t size() const;
+
+    private:
+        struct Node
+        {
+            std::atomic<Node*> next;
+            std::vector<uint8_t> frames;
+            std::shared_ptr<const std::vector<uint8_t>> sharedFrames;
+        };
+
+        bool pushFrames(Node* node, size_t size);
+        void pushNode(Node* node);
+        Node* pop();
+
+        // Producers append at the head, the consumer pops from the tail
+        std::atomic<Node*> _head;
+        Node* _tail;
+        Node _stub;
+
+        std::atomic<size_t> _size;
+        std::atomic<bool> _wakeUpPending;
+    };
+} // namespace ix
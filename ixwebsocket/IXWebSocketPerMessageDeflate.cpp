@@ -90,9 +90,44 @@ namespace ix
         return _compressor->compress(in, out);
     }
 
+    bool WebSocketPerMessageDeflate::compress(const IXWebSocketSendData& in,
+                                              bool fin,
+                                              std::string& out)
+    {
+        return _compressor->compress(in, fin, out);
+    }
+
     bool WebSocketPerMessageDeflate::decompress(const std::string& in, std::string& out)
     {
         return _decompressor->decompress(in, out);
     }
 
+    bool WebSocketPerMessageDeflate::decompress(const char* data,
+                                                size_t size,
+                                                bool fin,
+                                                std::string& out)
+    {
+        return _decompressor->decompress(data, size, fin, out);
+    }
+
+    bool WebSocketPerMessageDeflate::parkCompressor()
+    {
+        return _compressor->park();
+    }
+
+    void WebSocketPerMessageDeflate::parkDecompressor()
+    {
+        _decompressor->park();
+    }
+
+    size_t WebSocketPerMessageDeflate::getCompressorMemoryUsage() const
+    {
+        return _compressor->getMemoryUsage();
+    }
+
+    size_t WebSocketPerMessageDeflate::getDecompressorMemoryUsage() const
+    {
+        return _decompressor->getMemoryUsage();
+    }
+
 } // namespace ix
@@ -53,7 +53,17 @@ namespace ix
         bool init(const WebSocketPerMessageDeflateOptions& perMessageDeflateOptions);
         bool compress(const IXWebSocketSendData& in, std::string& out);
         bool compress(const std::string& in, std::string& out);
+        bool compress(const IXWebSocketSendData& in, bool fin, std::string& out);
         bool decompress(const std::string& in, std::string& out);
+        bool decompress(const char* data, size_t size, bool fin, std::string& out);
+
+        // Release the zlib states between two messages, see the codec classes. The
+        // compressor and the decompressor are used by different threads, so they are
+        // handled separately.
+        bool parkCompressor();
+        void parkDecompressor();
+        size_t getCompressorMemoryUsage() const;
+        size_t getDecompressorMemoryUsage() const;
 
     private:
         std::unique_ptr<WebSocketPerMessageDeflateCompressor> _compressor;
@@ -8,6 +8,7 @@
 
 #include "IXWebSocketPerMessageDeflateOptions.h"
 #include <cassert>
+#include <cstdlib>
 #include <string.h>
 
 namespace
@@ -16,6 +17,36 @@ namespace
     // is treated as a char* and the null termination (\x00) makes it
     // look like an empty string.
     const std::string kEmptyUncompressedBlock = std::string("\x00\x00\xff\xff", 4);
+
+    const size_t kCodecBufferSize = 1 << 14;
+
+#ifdef IXWEBSOCKET_USE_ZLIB
+    // zlib allocations are counted in the size_t passed as opaque. The size of each
+    // block is stored in front of it, to be subtracted when it is freed.
+    const size_t kZlibBlockHeaderSize = alignof(std::max_align_t);
+
+    voidpf zlibCountingAlloc(voidpf opaque, uInt items, uInt size)
+    {
+        size_t bytes = (size_t) items * size;
+        char* block = static_cast<char*>(malloc(kZlibBlockHeaderSize + bytes));
+        if (block == nullptr) return Z_NULL;
+
+        memcpy(block, &bytes, sizeof(bytes));
+        *static_cast<size_t*>(opaque) += bytes;
+        return block + kZlibBlockHeaderSize;
+    }
+
+    void zlibCountingFree(voidpf opaque, voidpf address)
+    {
+        if (address == Z_NULL) return;
+
+        char* block = static_cast<char*>(address) - kZlibBlockHeaderSize;
+        size_t bytes;
+        memcpy(&bytes, block, sizeof(bytes));
+        *static_cast<size_t*>(opaque) -= bytes;
+        free(block);
+    }
+#endif
 } // namespace
 
 namespace ix
@@ -28,9 +59,14 @@ namespace ix
 #ifdef IXWEBSOCKET_USE_ZLIB
         memset(&_deflateState, 0, sizeof(_deflateState));
 
-        _deflateState.zalloc = Z_NULL;
-        _deflateState.zfree = Z_NULL;
-        _deflateState.opaque = Z_NULL;
+        _flush = Z_SYNC_FLUSH;
+        _deflateBits = 0;
+        _parked = true;
+        _zlibMemoryUsage = 0;
+
+        _deflateState.zalloc = zlibCountingAlloc;
+        _deflateState.zfree = zlibCountingFree;
+        _deflateState.opaque = &_zlibMemoryUsage;
 #endif
     }
 
@@ -45,25 +81,68 @@ namespace ix
                                                     bool clientNoContextTakeOver)
     {
 #ifdef IXWEBSOCKET_USE_ZLIB
+        _deflateBits = deflateBits;
+        _flush = (clientNoContextTakeOver) ? Z_FULL_FLUSH : Z_SYNC_FLUSH;
+
+        return unpark();
+#else
+        (void) deflateBits;
+        (void) clientNoContextTakeOver;
+        return false;
+#endif
+    }
+
+    bool WebSocketPerMessageDeflateCompressor::unpark()
+    {
+#ifdef IXWEBSOCKET_USE_ZLIB
+        if (!_parked) return true;
+
         int ret = deflateInit2(&_deflateState,
                                Z_DEFAULT_COMPRESSION,
                                Z_DEFLATED,
-                               -1 * deflateBits,
+                               -1 * _deflateBits,
                                4, // memory level 1-9
                                Z_DEFAULT_STRATEGY);
 
         if (ret != Z_OK) return false;
 
-        _flush = (clientNoContextTakeOver) ? Z_FULL_FLUSH : Z_SYNC_FLUSH;
+        _compressBuffer.resize(kCodecBufferSize);
+        _parked = false;
+
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool WebSocketPerMessageDeflateCompressor::park()
+    {
+#ifdef IXWEBSOCKET_USE_ZLIB
+        // With context takeover, the next message refers to the data of the previous ones
+        if (_flush != Z_FULL_FLUSH) return false;
+
+        if (!_parked)
+        {
+            deflateEnd(&_deflateState);
+            std::vector<unsigned char>().swap(_compressBuffer);
+            _parked = true;
+        }
 
         return true;
 #else
-        (void) deflateBits;
-        (void) clientNoContextTakeOver;
         return false;
 #endif
     }
 
+    size_t WebSocketPerMessageDeflateCompressor::getMemoryUsage() const
+    {
+#ifdef IXWEBSOCKET_USE_ZLIB
+        return _zlibMemoryUsage + _compressBuffer.capacity();
+#else
+        return 0;
+#endif
+    }
+
     template<typename T>
     bool WebSocketPerMessageDeflateCompressor::endsWithEmptyUnCompressedBlock(const T& value)
     {
@@ -104,6 +183,55 @@ namespace ix
         return compressData(in, out);
     }
 
+    bool WebSocketPerMessageDeflateCompressor::compress(const IXWebSocketSendData& in,
+                                                        bool fin,
+                                                        std::string& out)
+    {
+#ifdef IXWEBSOCKET_USE_ZLIB
+        // Same algorithm as compressData(), except that the message is only flushed
+        // on the last piece. Until then deflate is free to buffer input, which keeps
+        // the compression ratio of a message sent in one go.
+        out.clear();
+
+        if (!unpark()) return false;
+
+        _deflateState.avail_in = (uInt) in.size();
+        _deflateState.next_in = (Bytef*) in.data();
+
+        int flush = (fin) ? _flush : Z_NO_FLUSH;
+
+        do
+        {
+            _deflateState.avail_out = (uInt) _compressBuffer.size();
+            _deflateState.next_out = &_compressBuffer.front();
+
+            deflate(&_deflateState, flush);
+
+            size_t output = _compressBuffer.size() - _deflateState.avail_out;
+            out.append(reinterpret_cast<char*>(&_compressBuffer.front()), output);
+        } while (_deflateState.avail_out == 0);
+
+        if (fin && endsWithEmptyUnCompressedBlock(out))
+        {
+            out.resize(out.size() - 4);
+        }
+        else if (fin && out.empty())
+        {
+            // Nothing was pending since the last flush, deflate did not produce an empty
+            // block. Use the same one as for an empty message, see issue #167.
+            out.push_back((char) 0x02);
+            out.push_back((char) 0x00);
+        }
+
+        return true;
+#else
+        (void) in;
+        (void) fin;
+        (void) out;
+        return false;
+#endif
+    }
+
     template<typename T, typename S>
     bool WebSocketPerMessageDeflateCompressor::compressData(const T& in, S& out)
     {
@@ -142,6 +270,8 @@ namespace ix
             return true;
         }
 
+        if (!unpark()) return false;
+
         _deflateState.avail_in = (uInt) in.size();
         _deflateState.next_in = (Bytef*) in.data();
 
@@ -179,9 +309,14 @@ namespace ix
 #ifdef IXWEBSOCKET_USE_ZLIB
         memset(&_inflateState, 0, sizeof(_inflateState));
 
-        _inflateState.zalloc = Z_NULL;
-        _inflateState.zfree = Z_NULL;
-        _inflateState.opaque = Z_NULL;
+        _flush = Z_SYNC_FLUSH;
+        _inflateBits = 0;
+        _parked = true;
+        _zlibMemoryUsage = 0;
+
+        _inflateState.zalloc = zlibCountingAlloc;
+        _inflateState.zfree = zlibCountingFree;
+        _inflateState.opaque = &_zlibMemoryUsage;
         _inflateState.avail_in = 0;
         _inflateState.next_in = Z_NULL;
 #endif
@@ -198,23 +333,69 @@ namespace ix
                                                       bool clientNoContextTakeOver)
     {
 #ifdef IXWEBSOCKET_USE_ZLIB
-        int ret = inflateInit2(&_inflateState, -1 * inflateBits);
+        _inflateBits = inflateBits;
+        _flush = (clientNoContextTakeOver) ? Z_FULL_FLUSH : Z_SYNC_FLUSH;
+
+        return unpark();
+#else
+        (void) inflateBits;
+        (void) clientNoContextTakeOver;
+        return false;
+#endif
+    }
+
+    bool WebSocketPerMessageDeflateDecompressor::unpark()
+    {
+#ifdef IXWEBSOCKET_USE_ZLIB
+        if (!_parked) return true;
+
+        int ret = inflateInit2(&_inflateState, -1 * _inflateBits);
 
         if (ret != Z_OK) return false;
 
-        _flush = (clientNoContextTakeOver) ? Z_FULL_FLUSH : Z_SYNC_FLUSH;
+        _compressBuffer.resize(kCodecBufferSize);
+        _parked = false;
 
         return true;
 #else
-        (void) inflateBits;
-        (void) clientNoContextTakeOver;
         return false;
 #endif
     }
 
-    bool WebSocketPerMessageDeflateDecompressor::decompress(const std::string& in, std::string& out)
+    void WebSocketPerMessageDeflateDecompressor::park()
+    {
+#ifdef IXWEBSOCKET_USE_ZLIB
+        if (!_parked)
+        {
+            inflateEnd(&_inflateState);
+            std::vector<unsigned char>().swap(_compressBuffer);
+            _parked = true;
+        }
+#endif
+    }
+
+    size_t WebSocketPerMessageDeflateDecompressor::getMemoryUsage() const
     {
 #ifdef IXWEBSOCKET_USE_ZLIB
+        return _zlibMemoryUsage + _compressBuffer.capacity();
+#else
+        return 0;
+#endif
+    }
+
+    bool WebSocketPerMessageDeflateDecompressor::decompress(const std::string& in, std::string& out)
+    {
+        // Clear output
+        out.clear();
+
+        return decompress(in.data(), in.size(), true, out);
+    }
+
+    bool WebSocketPerMessageDeflateDecompressor::decompress(const char* data,
+                                                            size_t size,
+                                                            bool fin,
+                                                            std::string& out)
+    {
         //
         // 7.2.2.  Decompression
         //
@@ -225,14 +406,24 @@ namespace ix
         //
         //    2.  Decompress the resulting data using DEFLATE.
         //
-        std::string inFixed(in);
-        inFixed += kEmptyUncompressedBlock;
+        // The trailer is inflated on its own after the last frame, which avoids
+        // copying the payload to append it.
+        //
+        if (!inflateData(data, size, out)) return false;
 
-        _inflateState.avail_in = (uInt) inFixed.size();
-        _inflateState.next_in = (unsigned char*) (const_cast<char*>(inFixed.data()));
+        return !fin ||
+               inflateData(kEmptyUncompressedBlock.data(), kEmptyUncompressedBlock.size(), out);
+    }
 
-        // Clear output
-        out.clear();
+    bool WebSocketPerMessageDeflateDecompressor::inflateData(const char* data,
+                                                             size_t size,
+                                                             std::string& out)
+    {
+#ifdef IXWEBSOCKET_USE_ZLIB
+        if (!unpark()) return false;
+
+        _inflateState.avail_in = (uInt) size;
+        _inflateState.next_in = (unsigned char*) (const_cast<char*>(data));
 
         do
         {
@@ -252,7 +443,8 @@ namespace ix
 
         return true;
 #else
-        (void) in;
+        (void) data;
+        (void) size;
         (void) out;
         return false;
 #endif
@@ -9,7 +9,7 @@
 #ifdef IXWEBSOCKET_USE_ZLIB
 #include "zlib.h"
 #endif
-#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -30,17 +30,34 @@ namespace ix
         bool compress(const std::vector<uint8_t>& in, std::string& out);
         bool compress(const std::vector<uint8_t>& in, std::vector<uint8_t>& out);
 
+        // Compress one piece of a message that is sent progressively. out is set to the
+        // compressed data available so far, which may be empty. fin must be set for the
+        // last piece, to flush what is left and end the message.
+        bool compress(const IXWebSocketSendData& in, bool fin, std::string& out);
+
+        // Release the zlib state and the output buffer between two messages, they are
+        // allocated again by the next compress() call. Only possible when the context is
+        // reset after each message, returns false otherwise.
+        bool park();
+
+        // Bytes allocated by zlib and for the output buffer
+        size_t getMemoryUsage() const;
+
     private:
         template<typename T, typename S>
         bool compressData(const T& in, S& out);
         template<typename T>
         bool endsWithEmptyUnCompressedBlock(const T& value);
+        bool unpark();
 
 #ifdef IXWEBSOCKET_USE_ZLIB
         int _flush;
-        std::array<unsigned char, 1 << 14> _compressBuffer;
+        uint8_t _deflateBits;
+        bool _parked;
+        std::vector<unsigned char> _compressBuffer;
 
         z_stream _deflateState;
+        size_t _zlibMemoryUsage;
 #endif
     };
 
@@ -53,12 +70,30 @@ namespace ix
         bool init(uint8_t inflateBits, bool clientNoContextTakeOver);
         bool decompress(const std::string& in, std::string& out);
 
+        // Decompress one frame of a message and append the result to out. fin must be
+        // set for the last frame.
+        bool decompress(const char* data, size_t size, bool fin, std::string& out);
+
+        // Release the zlib state (including the window) and the output buffer between
+        // two messages, they are allocated again by the next decompress() call. The
+        // caller must make sure that the peer resets its context after each message.
+        void park();
+
+        // Bytes allocated by zlib and for the output buffer
+        size_t getMemoryUsage() const;
+
     private:
+        bool inflateData(const char* data, size_t size, std::string& out);
+        bool unpark();
+
 #ifdef IXWEBSOCKET_USE_ZLIB
         int _flush;
-        std::array<unsigned char, 1 << 14> _compressBuffer;
+        uint8_t _inflateBits;
+        bool _parked;
+        std::vector<unsigned char> _compressBuffer;
 
         z_stream _inflateState;
+        size_t _zlibMemoryUsage;
 #endif
     };
 
@@ -0,0 +1,236 @@
+/*
+ *  IXWebSocketSendQueue.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ */
+
+#include "IXWebSocketSendQueue.h"
+
+#include "IXWebSocketMask.h"
+#include <algorithm>
+#include <string.h>
+
+namespace ix
+{
+    const size_t WebSocketSendQueue::kDefaultSegmentSize(16 * 1024);
+    const size_t WebSocketSendQueue::kDefaultMaxPooledSegments(8);
+
+    WebSocketSendQueue::WebSocketSendQueue(size_t segmentSize, size_t maxPooledSegments)
+        : _segmentSize(segmentSize)
+        , _maxPooledSegments(maxPooledSegments)
+        , _size(0)
+    {
+        ;
+    }
+
+    void WebSocketSendQueue::append(const void* data, size_t size)
+    {
+        appendOwned(data, size, nullptr);
+    }
+
+    void WebSocketSendQueue::appendMasked(const void* data,
+                                          size_t size,
+                                          const uint8_t maskingKey[4])
+    {
+        appendOwned(data, size, maskingKey);
+    }
+
+    void WebSocketSendQueue::appendOwned(const void* data, size_t size, const uint8_t* maskingKey)
+    {
+        const uint8_t* src = static_cast<const uint8_t*>(data);
+        size_t keyOffset = 0;
+
+        while (size > 0)
+        {
+            // Fill the space left in the last segment before starting a new one
+            if (_segments.empty() || !_segments.back().storage ||
+                _segments.back().end == _segmentSize)
+            {
+                Segment segment;
+                segment.storage = acquireStorage();
+                segment.data = segment.storage.get();
+                segment.begin = 0;
+                segment.end = 0;
+                _segments.push_back(std::move(segment));
+            }
+
+            Segment& segment = _segments.back();
+            size_t n = std::min(size, _segmentSize - segment.end);
+            uint8_t* dst = segment.storage.get() + segment.end;
+            memcpy(dst, src, n);
+
+            if (maskingKey != nullptr)
+            {
+                keyOffset = applyWebSocketMask(dst, n, maskingKey, keyOffset);
+            }
+
+            segment.end += n;
+            _size += n;
+            src += n;
+            size -= n;
+        }
+    }
+
+    void WebSocketSendQueue::append(std::vector<uint8_t>&& buffer)
+    {
+        if (buffer.empty()) return;
+
+        Segment segment;
+        segment.buffer = std::move(buffer);
+        segment.data = segment.buffer.data();
+        segment.begin = 0;
+        segment.end = segment.buffer.size();
+        _size += segment.end;
+        _segments.push_back(std::move(segment));
+    }
+
+    void WebSocketSendQueue::append(const std::shared_ptr<const std::vector<uint8_t>>& buffer)
+    {
+        if (!buffer || buffer->empty()) return;
+
+        Segment segment;
+        segment.sharedBuffer = buffer;
+        segment.data = buffer->data();
+        segment.begin = 0;
+        segment.end = buffer->size();
+        _size += segment.end;
+        _segments.push_back(std::move(segment));
+    }
+
+    void WebSocketSendQueue::appendReference(const void* data, size_t size)
+    {
+        if (size == 0) return;
+
+        Segment segment;
+        segment.data = static_cast<const uint8_t*>(data);
+        segment.begin = 0;
+        segment.end = size;
+        _segments.push_back(std::move(segment));
+        _size += size;
+    }
+
+    void WebSocketSendQueue::materializeReferences()
+    {
+        bool hasReferences = false;
+        for (auto&& segment : _segments)
+        {
+            hasReferences |= isReference(segment);
+        }
+        if (!hasReferences) return;
+
+        // Rebuild the queue in order, copying the referenced bytes
+        std::deque<Segment> segments;
+        segments.swap(_segments);
+        _size = 0;
+
+        for (auto&& segment : segments)
+        {
+            if (isReference(segment))
+            {
+                append(segment.data + segment.begin, segment.end - segment.begin);
+            }
+            else
+            {
+                _size += segment.end - segment.begin;
+                _segments.push_back(std::move(segment));
+            }
+        }
+    }
+
+    bool WebSocketSendQueue::empty() const
+    {
+        return _size == 0;
+    }
+
+    size_t WebSocketSendQueue::size() const
+    {
+        return _size;
+    }
+
+    int WebSocketSendQueue::peek(iovec* iov, int maxIov) const
+    {
+        int n = 0;
+        for (auto it = _segments.begin(); it != _segments.end() && n < maxIov; ++it)
+        {
+            iov[n].iov_base = const_cast<uint8_t*>(it->data + it->begin);
+            iov[n].iov_len = it->end - it->begin;
+            ++n;
+        }
+        return n;
+    }
+
+    void WebSocketSendQueue::consume(size_t size)
+    {
+        size = std::min(size, _size);
+        _size -= size;
+
+        while (size > 0)
+        {
+            Segment& segment = _segments.front();
+            size_t n = std::min(size, segment.end - segment.begin);
+            segment.begin += n;
+            size -= n;
+
+            if (segment.begin == segment.end)
+            {
+                releaseStorage(std::move(segment.storage));
+                _segments.pop_front();
+            }
+        }
+    }
+
+    void WebSocketSendQueue::clear()
+    {
+        for (auto&& segment : _segments)
+        {
+            releaseStorage(std::move(segment.storage));
+        }
+        _segments.clear();
+        _size = 0;
+    }
+
+    void WebSocketSendQueue::shrink()
+    {
+        std::vector<std::unique_ptr<uint8_t[]>>().swap(_pool);
+        if (_segments.empty())
+        {
+            std::deque<Segment>().swap(_segments);
+        }
+    }
+
+    size_t WebSocketSendQueue::getMemoryUsage() const
+    {
+        size_t memoryUsage = _pool.size() * _segmentSize;
+        for (auto&& segment : _segments)
+        {
+            if (segment.storage) memoryUsage += _segmentSize;
+            memoryUsage += segment.buffer.capacity();
+        }
+        return memoryUsage;
+    }
+
+    bool WebSocketSendQueue::isReference(const Segment& segment)
+    {
+        return !segment.storage && segment.buffer.empty() && !segment.sharedBuffer;
+    }
+
+    std::unique_ptr<uint8_t[]> WebSocketSendQueue::acquireStorage()
+    {
+        if (_pool.empty())
+        {
+            return std::unique_ptr<uint8_t[]>(new uint8_t[_segmentSize]);
+        }
+
+        std::unique_ptr<uint8_t[]> storage = std::move(_pool.back());
+        _pool.pop_back();
+        return storage;
+    }
+
+    void WebSocketSendQueue::releaseStorage(std::unique_ptr<uint8_t[]> storage)
+    {
+        if (storage && _pool.size() < _maxPooledSegments)
+        {
+            _pool.push_back(std::move(storage));
+        }
+    }
+} // namespace ix
@@ -0,0 +1,101 @@
+/*
+ *  IXWebSocketSendQueue.h
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ *
+ *  Queue of the bytes waiting to be written to a socket.
+ */
+
+#pragma once
+
+#include "IXNetSystem.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace ix
+{
+    //
+    // Data is stored in fixed size segments, recycled through a small pool once they
+    // have been sent, so writing part of the queue never moves the rest of it.
+    // Segments can also refer to memory owned by the caller, which must then stay
+    // valid until it has been consumed or copied with materializeReferences().
+    //
+    // This class is not thread safe, callers need to serialize access.
+    //
+    class WebSocketSendQueue
+    {
+    public:
+        WebSocketSendQueue(size_t segmentSize = kDefaultSegmentSize,
+                           size_t maxPooledSegments = kDefaultMaxPooledSegments);
+
+        // Copy data at the end of the queue
+        void append(const void* data, size_t size);
+
+        // Copy data at the end of the queue, masked with maskingKey
+        void appendMasked(const void* data, size_t size, const uint8_t maskingKey[4]);
+
+        // Take ownership of buffer and queue it as a single segment
+        void append(std::vector<uint8_t>&& buffer);
+
+        // Queue data without copying it
+        void appendReference(const void* data, size_t size);
+
+        // Queue a buffer shared with other queues, which is kept alive until it has
+        // been consumed
+        void append(const std::shared_ptr<const std::vector<uint8_t>>& buffer);
+
+        // Copy the data of the reference segments still in the queue, so that the
+        // caller's memory is no longer needed
+        void materializeReferences();
+
+        bool empty() const;
+
+        // Number of bytes waiting to be sent
+        size_t size() const;
+
+        // Fill iov with up to maxIov buffers from the front of the queue and
+        // return how many were filled
+        int peek(iovec* iov, int maxIov) const;
+
+        // Remove size bytes from the front of the queue
+        void consume(size_t size);
+
+        void clear();
+
+        // Free the pooled segments, they are allocated again when needed
+        void shrink();
+
+        // Bytes allocated by the queue, shared buffers excluded
+        size_t getMemoryUsage() const;
+
+        static const size_t kDefaultSegmentSize;
+        static const size_t kDefaultMaxPooledSegments;
+
+    private:
+        struct Segment
+        {
+            // Pooled storage, or a buffer given to append(). All are empty for
+            // reference segments.
+            std::unique_ptr<uint8_t[]> storage;
+            std::vector<uint8_t> buffer;
+            std::shared_ptr<const std::vector<uint8_t>> sharedBuffer;
+            const uint8_t* data;
+            size_t begin;
+            size_t end;
+        };
+
+        void appendOwned(const void* data, size_t size, const uint8_t* maskingKey);
+        static bool isReference(const Segment& segment);
+        std::unique_ptr<uint8_t[]> acquireStorage();
+        void releaseStorage(std::unique_ptr<uint8_t[]> storage);
+
+        size_t _segmentSize;
+        size_t _maxPooledSegments;
+        std::deque<Segment> _segments;
+        std::vector<std::unique_ptr<uint8_t[]>> _pool;
+        size_t _size;
+    };
+} // namespace ix
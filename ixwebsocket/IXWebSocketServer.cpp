@@ -11,6 +11,7 @@
 #include "IXSocketConnect.h"
 #include "IXWebSocket.h"
 #include "IXWebSocketTransport.h"
+#include <algorithm>
 #include <future>
 #include <sstream>
 #include <string.h>
@@ -36,6 +37,9 @@ namespace ix
         , _enablePerMessageDeflate(true)
         , _pingIntervalSeconds(pingIntervalSeconds)
         , _sendTimeoutSeconds(sendTimeoutSeconds)
+        , _clients(std::make_shared<ClientsSnapshot>())
+        , _useEventLoop(false)
+        , _eventLoopThreads(0)
     {
     }
 
@@ -48,13 +52,93 @@ namespace ix
     {
         stopAcceptingConnections();
 
-        auto clients = getClients();
-        for (auto client : clients)
+        auto clients = getClientsSnapshot();
+        for (auto&& client : *clients)
         {
             client->close();
         }
 
         SocketServer::stop();
+
+        if (_eventLoop)
+        {
+            _eventLoop->stop();
+            _eventLoop.reset();
+        }
+    }
+
+    bool WebSocketServer::enableEventLoop(size_t threads)
+    {
+        if (!WebSocketEventLoop::isSupported()) return false;
+
+        _useEventLoop = true;
+        _eventLoopThreads = threads;
+        return true;
+    }
+
+    void WebSocketServer::start()
+    {
+        if (_useEventLoop && !_eventLoop)
+        {
+            size_t threads = _eventLoopThreads;
+            if (threads == 0)
+            {
+                threads = std::thread::hardware_concurrency();
+            }
+
+            _eventLoop.reset(new WebSocketEventLoop(
+                threads,
+                _handshakeTimeoutSecs,
+                _enablePerMessageDeflate,
+                _sendTimeoutSeconds,
+                [this](std::shared_ptr<ConnectionState> connectionState)
+                { return createWebSocket(connectionState); },
+                [this](std::shared_ptr<WebSocket> webSocket,
+                       std::shared_ptr<ConnectionState> connectionState)
+                {
+                    if (webSocket)
+                    {
+                        webSocket->setOnMessageCallback(nullptr);
+                        removeClient(webSocket, connectionState);
+                    }
+                    connectionState->setTerminated();
+                },
+                [this](LogLevel level, const std::string& message)
+                {
+                    if (level == LogLevel::Error)
+                    {
+                        logError(message);
+                    }
+                    else
+                    {
+                        logInfo(message);
+                    }
+                }));
+
+            std::string errorMsg;
+            if (!_eventLoop->start(errorMsg))
+            {
+                logError("WebSocketServer::start() cannot start the event loop, "
+                         "using a thread per connection: " +
+                         errorMsg);
+                _eventLoop.reset();
+            }
+        }
+
+        SocketServer::start();
+    }
+
+    void WebSocketServer::dispatchConnection(std::unique_ptr<Socket> socket,
+                                             std::shared_ptr<ConnectionState> connectionState)
+    {
+        if (_eventLoop)
+        {
+            _eventLoop->add(std::move(socket), connectionState);
+        }
+        else
+        {
+            SocketServer::dispatchConnection(std::move(socket), connectionState);
+        }
     }
 
     void WebSocketServer::enablePong()
@@ -96,6 +180,37 @@ namespace ix
     {
         setThreadName("Srv:ws:" + connectionState->getId());
 
+        auto webSocket = createWebSocket(connectionState);
+        if (!webSocket) return;
+
+        auto status = webSocket->connectToSocket(std::move(socket),
+                                                 _handshakeTimeoutSecs,
+                                                 _enablePerMessageDeflate,
+                                                 request,
+                                                 _sendTimeoutSeconds);
+        if (status.success)
+        {
+            // Process incoming messages and execute callbacks
+            // until the connection is closed
+            webSocket->run();
+        }
+        else
+        {
+            std::stringstream ss;
+            ss << "WebSocketServer::handleConnection() HTTP status: " << status.http_status
+               << " error: " << status.errorStr;
+            logError(ss.str());
+        }
+
+        webSocket->setOnMessageCallback(nullptr);
+
+        // Remove this client from our client set
+        removeClient(webSocket, connectionState);
+    }
+
+    std::shared_ptr<WebSocket> WebSocketServer::createWebSocket(
+        std::shared_ptr<ConnectionState> connectionState)
+    {
         auto webSocket = std::make_shared<WebSocket>();
 
         webSocket->setAutoThreadName(false);
@@ -111,7 +226,7 @@ namespace ix
                          "registered.");
                 logError("Missing call to setOnMessageCallback inside setOnConnectionCallback.");
                 connectionState->setTerminated();
-                return;
+                return nullptr;
             }
         }
         else if (_onClientMessageCallback)
@@ -127,7 +242,7 @@ namespace ix
                 "WebSocketServer Application developer error: No server callback is registerered.");
             logError("Missing call to setOnConnectionCallback or setOnClientMessageCallback.");
             connectionState->setTerminated();
-            return;
+            return nullptr;
         }
 
         webSocket->disableAutomaticReconnection();
@@ -144,79 +259,223 @@ namespace ix
         // Add this client to our client set
         {
             std::lock_guard<std::mutex> lock(_clientsMutex);
-            _clients.insert(webSocket);
-        }
 
-        auto status = webSocket->connectToSocket(std::move(socket),
-                                                 _handshakeTimeoutSecs,
-                                                 _enablePerMessageDeflate,
-                                                 request,
-                                                 _sendTimeoutSeconds);
-        if (status.success)
-        {
-            // Process incoming messages and execute callbacks
-            // until the connection is closed
-            webSocket->run();
-        }
-        else
-        {
-            std::stringstream ss;
-            ss << "WebSocketServer::handleConnection() HTTP status: " << status.http_status
-               << " error: " << status.errorStr;
-            logError(ss.str());
+            auto current = std::atomic_load(&_clients);
+            auto snapshot = std::make_shared<ClientsSnapshot>();
+            Clients& clients = snapshot->clients;
+            clients.reserve(current->clients.size() + 1);
+
+            // Keep the snapshot sorted by address, see findClient()
+            auto it =
+                std::lower_bound(current->clients.begin(), current->clients.end(), webSocket);
+            clients.insert(clients.end(), current->clients.begin(), it);
+            clients.push_back(webSocket);
+            clients.insert(clients.end(), it, current->clients.end());
+
+            snapshot->clientsById = current->clientsById;
+            snapshot->clientsById[connectionState->getId()] = webSocket;
+
+            std::atomic_store(&_clients,
+                              std::shared_ptr<const ClientsSnapshot>(std::move(snapshot)));
         }
 
-        webSocket->setOnMessageCallback(nullptr);
+        return webSocket;
+    }
 
-        // Remove this client from our client set
+    void WebSocketServer::removeClient(const std::shared_ptr<WebSocket>& webSocket,
+                                       std::shared_ptr<ConnectionState> connectionState)
+    {
         {
             std::lock_guard<std::mutex> lock(_clientsMutex);
-            if (_clients.erase(webSocket) != 1)
+
+            auto current = std::atomic_load(&_clients);
+            auto it =
+                std::lower_bound(current->clients.begin(), current->clients.end(), webSocket);
+            bool found = it != current->clients.end() && *it == webSocket;
+            if (!found)
             {
                 logError("Cannot delete client");
             }
+
+            auto snapshot = std::make_shared<ClientsSnapshot>();
+            Clients& clients = snapshot->clients;
+            clients.reserve(current->clients.size());
+            clients.insert(clients.end(), current->clients.begin(), it);
+            clients.insert(clients.end(), found ? it + 1 : it, current->clients.end());
+
+            // Ids are not necessarily unique with a custom ConnectionState factory, and
+            // can be changed with computeId() after the client was registered
+            ClientsById& clientsById = snapshot->clientsById;
+            clientsById = current->clientsById;
+            auto entry = clientsById.find(connectionState->getId());
+            if (entry == clientsById.end() || entry->second != webSocket)
+            {
+                entry = std::find_if(clientsById.begin(),
+                                     clientsById.end(),
+                                     [&webSocket](const ClientsById::value_type& client)
+                                     { return client.second == webSocket; });
+            }
+            if (entry != clientsById.end())
+            {
+                clientsById.erase(entry);
+            }
+
+            std::atomic_store(&_clients,
+                              std::shared_ptr<const ClientsSnapshot>(std::move(snapshot)));
         }
+
+        _topics.unsubscribeAll(webSocket.get());
+    }
+
+    bool WebSocketServer::isClient(const WebSocket& webSocket)
+    {
+        return findClient(webSocket) != nullptr;
+    }
+
+    std::shared_ptr<WebSocket> WebSocketServer::findClient(const WebSocket& webSocket)
+    {
+        auto clients = getClientsSnapshot();
+        auto it = std::lower_bound(clients->begin(),
+                                   clients->end(),
+                                   &webSocket,
+                                   [](const std::shared_ptr<WebSocket>& client,
+                                      const WebSocket* key)
+                                   { return std::less<const WebSocket*>()(client.get(), key); });
+        if (it == clients->end() || it->get() != &webSocket) return nullptr;
+
+        return *it;
     }
 
     std::set<std::shared_ptr<WebSocket>> WebSocketServer::getClients()
     {
-        std::lock_guard<std::mutex> lock(_clientsMutex);
-        return _clients;
+        auto clients = getClientsSnapshot();
+        return std::set<std::shared_ptr<WebSocket>>(clients->begin(), clients->end());
+    }
+
+    std::shared_ptr<const WebSocketServer::Clients> WebSocketServer::getClientsSnapshot()
+    {
+        // The list shares the lifetime of the whole snapshot
+        auto snapshot = std::atomic_load(&_clients);
+        return std::shared_ptr<const Clients>(snapshot, &snapshot->clients);
+    }
+
+    std::shared_ptr<WebSocket> WebSocketServer::getClient(const std::string& connectionId)
+    {
+        auto snapshot = std::atomic_load(&_clients);
+        auto it = snapshot->clientsById.find(connectionId);
+        if (it == snapshot->clientsById.end()) return nullptr;
+
+        return it->second;
     }
 
     size_t WebSocketServer::getConnectedClientsCount()
     {
-        std::lock_guard<std::mutex> lock(_clientsMutex);
-        return _clients.size();
+        return getClientsSnapshot()->size();
     }
 
     //
     // Classic servers
     //
+    size_t WebSocketServer::broadcast(const IXWebSocketSendData& message,
+                                      bool binary,
+                                      const WebSocket* except)
+    {
+        return sendToClients(*getClientsSnapshot(), message, binary, except);
+    }
+
+    size_t WebSocketServer::sendToClients(const Clients& clients,
+                                          const IXWebSocketSendData& message,
+                                          bool binary,
+                                          const WebSocket* except)
+    {
+        // Only compress when some client can take the shared compressed frames
+        bool compress = false;
+        if (_enablePerMessageDeflate)
+        {
+            for (auto&& client : clients)
+            {
+                if (client.get() != except && client->_ws.canSendSharedCompressedFrames())
+                {
+                    compress = true;
+                    break;
+                }
+            }
+        }
+
+        WebSocketBroadcastMessage broadcastMessage(message, binary, compress);
+
+        size_t count = 0;
+        for (auto&& client : clients)
+        {
+            if (client.get() == except) continue;
+
+            if (client->sendBroadcastMessage(broadcastMessage).success)
+            {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    bool WebSocketServer::subscribe(const std::shared_ptr<WebSocket>& webSocket,
+                                    const std::string& topic)
+    {
+        if (!webSocket || !isClient(*webSocket)) return false;
+
+        if (!_topics.subscribe(webSocket, topic)) return false;
+
+        // The connection may have been closed, and its subscriptions removed, since
+        // the check above
+        if (!isClient(*webSocket))
+        {
+            _topics.unsubscribe(webSocket.get(), topic);
+            return false;
+        }
+        return true;
+    }
+
+    bool WebSocketServer::subscribe(WebSocket& webSocket, const std::string& topic)
+    {
+        return subscribe(findClient(webSocket), topic);
+    }
+
+    bool WebSocketServer::unsubscribe(const WebSocket& webSocket, const std::string& topic)
+    {
+        return _topics.unsubscribe(&webSocket, topic);
+    }
+
+    size_t WebSocketServer::publish(const std::string& topic,
+                                    const IXWebSocketSendData& message,
+                                    bool binary)
+    {
+        auto subscribers = _topics.getSubscribers(topic);
+        if (!subscribers) return 0;
+
+        return sendToClients(*subscribers, message, binary, nullptr);
+    }
+
+    size_t WebSocketServer::getSubscribersCount(const std::string& topic)
+    {
+        auto subscribers = _topics.getSubscribers(topic);
+        return subscribers ? subscribers->size() : 0;
+    }
+
+    std::vector<std::string> WebSocketServer::getTopics(const WebSocket& webSocket)
+    {
+        return _topics.getTopics(&webSocket);
+    }
+
     void WebSocketServer::makeBroadcastServer()
     {
         setOnClientMessageCallback(
-            [this](std::shared_ptr<ConnectionState> connectionState,
+            [this](std::shared_ptr<ConnectionState> /*connectionState*/,
                    WebSocket& webSocket,
                    const WebSocketMessagePtr& msg)
             {
-                auto remoteIp = connectionState->getRemoteIp();
                 if (msg->type == ix::WebSocketMessageType::Message)
                 {
-                    for (auto&& client : getClients())
-                    {
-                        if (client.get() != &webSocket)
-                        {
-                            client->send(msg->str, msg->binary);
-
-                            // Make sure the OS send buffer is flushed before moving on
-                            do
-                            {
-                                std::chrono::duration<double, std::milli> duration(500);
-                                std::this_thread::sleep_for(duration);
-                            } while (client->bufferedAmount() != 0);
-                        }
-                    }
+                    broadcast(
+                        IXWebSocketSendData(msg->data(), msg->size()), msg->binary, &webSocket);
                 }
             });
     }
@@ -8,6 +8,8 @@
 
 #include "IXSocketServer.h"
 #include "IXWebSocket.h"
+#include "IXWebSocketEventLoop.h"
+#include "IXWebSocketTopics.h"
 #include <condition_variable>
 #include <functional>
 #include <memory>
@@ -15,7 +17,9 @@
 #include <set>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <utility> // pair
+#include <vector>
 
 namespace ix
 {
@@ -37,8 +41,15 @@ namespace ix
                         int pingIntervalSeconds = WebSocketServer::kPingIntervalSeconds,
                         int sendTimeoutSeconds = WebSocketServer::kSendTimeoutSeconds);
         virtual ~WebSocketServer();
+        virtual void start() override;
         virtual void stop() final;
 
+        // Serve the connections from a fixed number of I/O threads (the number of cpus
+        // when threads is 0) instead of a thread per connection. The callbacks are then
+        // called on the I/O threads, and must not block. Must be called before start().
+        // Returns false when the platform does not support it.
+        virtual bool enableEventLoop(size_t threads = 0);
+
         void enablePong();
         void disablePong();
         void disablePerMessageDeflate();
@@ -46,9 +57,46 @@ namespace ix
         void setOnConnectionCallback(const OnConnectionCallback& callback);
         void setOnClientMessageCallback(const OnClientMessageCallback& callback);
 
+        // Immutable list of the connected clients, sorted by address
+        using Clients = std::vector<std::shared_ptr<WebSocket>>;
+
         // Get all the connected clients
         std::set<std::shared_ptr<WebSocket>> getClients();
 
+        // Same as getClients(), without copying nor locking. Connecting and disconnecting
+        // clients replace the list, and do not change the snapshots which were already
+        // taken. Replacing it copies the list, which costs O(n) per connection change.
+        std::shared_ptr<const Clients> getClientsSnapshot();
+
+        // Find a client from the id its ConnectionState had when the connection was
+        // accepted, nullptr if it is not connected. Lock free, like getClientsSnapshot().
+        std::shared_ptr<WebSocket> getClient(const std::string& connectionId);
+
+        // Frame the message once, and queue it to every client but except. The clients
+        // share the frames, and write them from their own thread, so a slow client does
+        // not delay the others. Returns the number of clients the message was queued for.
+        size_t broadcast(const IXWebSocketSendData& message,
+                         bool binary = false,
+                         const WebSocket* except = nullptr);
+
+        // Publish/subscribe. A connection can be subscribed to any number of topics,
+        // and is unsubscribed from all of them once it is closed. Publishing a message
+        // frames it once for all the subscribers of the topic, like broadcast().
+        // subscribe() and unsubscribe() return false if nothing changed, or if the
+        // connection is not a client of this server.
+        bool subscribe(const std::shared_ptr<WebSocket>& webSocket, const std::string& topic);
+        bool subscribe(WebSocket& webSocket, const std::string& topic);
+        bool unsubscribe(const WebSocket& webSocket, const std::string& topic);
+
+        // Returns the number of subscribers the message was queued for
+        size_t publish(const std::string& topic,
+                       const IXWebSocketSendData& message,
+                       bool binary = false);
+
+        size_t getSubscribersCount(const std::string& topic);
+        std::vector<std::string> getTopics(const WebSocket& webSocket);
+
+        // Broadcast every message received to all the other clients
         void makeBroadcastServer();
         bool listenAndStart();
 
@@ -69,8 +117,24 @@ namespace ix
         OnConnectionCallback _onConnectionCallback;
         OnClientMessageCallback _onClientMessageCallback;
 
+        // The clients sorted by address, and indexed by connection id
+        using ClientsById = std::unordered_map<std::string, std::shared_ptr<WebSocket>>;
+        struct ClientsSnapshot
+        {
+            Clients clients;
+            ClientsById clientsById;
+        };
+
+        // Writers hold the mutex while they replace the snapshot, readers load it
+        // atomically
         std::mutex _clientsMutex;
-        std::set<std::shared_ptr<WebSocket>> _clients;
+        std::shared_ptr<const ClientsSnapshot> _clients;
+
+        WebSocketTopics _topics;
+
+        bool _useEventLoop;
+        size_t _eventLoopThreads;
+        std::unique_ptr<WebSocketEventLoop> _eventLoop;
 
         const static bool kDefaultEnablePong;
         const static int kPingIntervalSeconds;
@@ -81,7 +145,23 @@ namespace ix
                                       std::shared_ptr<ConnectionState> connectionState);
         virtual size_t getConnectedClientsCount() final;
 
+        // Create the WebSocket for a new connection, and register it as a client.
+        // Returns nullptr if the application callbacks are missing.
+        std::shared_ptr<WebSocket> createWebSocket(std::shared_ptr<ConnectionState> connectionState);
+        void removeClient(const std::shared_ptr<WebSocket>& webSocket,
+                          std::shared_ptr<ConnectionState> connectionState);
+        bool isClient(const WebSocket& webSocket);
+        std::shared_ptr<WebSocket> findClient(const WebSocket& webSocket);
+
+        size_t sendToClients(const Clients& clients,
+                             const IXWebSocketSendData& message,
+                             bool binary,
+                             const WebSocket* except);
+
     protected:
+        virtual void dispatchConnection(std::unique_ptr<Socket> socket,
+                                        std::shared_ptr<ConnectionState> connectionState) override;
+
         void handleUpgrade(std::unique_ptr<Socket> socket,
                            std::shared_ptr<ConnectionState> connectionState,
                            HttpRequestPtr request = nullptr);
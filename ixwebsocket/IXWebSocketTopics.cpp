@@ -0,0 +1,170 @@
+/*
+ *  IXWebSocketTopics.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ */
+
+#include "IXWebSocketTopics.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace ix
+{
+    const size_t WebSocketTopics::kDefaultShardsCount(64);
+
+    WebSocketTopics::WebSocketTopics(size_t shardsCount)
+    {
+        shardsCount = std::max(shardsCount, static_cast<size_t>(1));
+
+        for (size_t i = 0; i < shardsCount; ++i)
+        {
+            _topicShards.emplace_back(new TopicShard);
+            _connectionShards.emplace_back(new ConnectionShard);
+        }
+    }
+
+    WebSocketTopics::TopicShard& WebSocketTopics::getTopicShard(const std::string& topic) const
+    {
+        return *_topicShards[std::hash<std::string>()(topic) % _topicShards.size()];
+    }
+
+    WebSocketTopics::ConnectionShard& WebSocketTopics::getConnectionShard(
+        const WebSocket* webSocket) const
+    {
+        // Objects are aligned, the low bits of their address are always the same
+        size_t hash = std::hash<const WebSocket*>()(webSocket);
+        hash ^= hash >> 4;
+        return *_connectionShards[hash % _connectionShards.size()];
+    }
+
+    bool WebSocketTopics::subscribe(const std::shared_ptr<WebSocket>& webSocket,
+                                    const std::string& topic)
+    {
+        if (!webSocket) return false;
+
+        ConnectionShard& shard = getConnectionShard(webSocket.get());
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        if (!shard.topics[webSocket.get()].insert(topic).second) return false;
+
+        addSubscriber(webSocket, topic);
+        return true;
+    }
+
+    bool WebSocketTopics::unsubscribe(const WebSocket* webSocket, const std::string& topic)
+    {
+        ConnectionShard& shard = getConnectionShard(webSocket);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        auto it = shard.topics.find(webSocket);
+        if (it == shard.topics.end() || it->second.erase(topic) == 0) return false;
+
+        if (it->second.empty())
+        {
+            shard.topics.erase(it);
+        }
+
+        removeSubscriber(webSocket, topic);
+        return true;
+    }
+
+    size_t WebSocketTopics::unsubscribeAll(const WebSocket* webSocket)
+    {
+        ConnectionShard& shard = getConnectionShard(webSocket);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        auto it = shard.topics.find(webSocket);
+        if (it == shard.topics.end()) return 0;
+
+        for (auto&& topic : it->second)
+        {
+            removeSubscriber(webSocket, topic);
+        }
+
+        size_t count = it->second.size();
+        shard.topics.erase(it);
+        return count;
+    }
+
+    std::shared_ptr<const WebSocketTopics::Subscribers> WebSocketTopics::getSubscribers(
+        const std::string& topic) const
+    {
+        TopicShard& shard = getTopicShard(topic);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        auto it = shard.topics.find(topic);
+        if (it == shard.topics.end()) return nullptr;
+
+        if (!it->second.snapshot)
+        {
+            it->second.snapshot = std::make_shared<const Subscribers>(it->second.subscribers);
+        }
+        return it->second.snapshot;
+    }
+
+    std::vector<std::string> WebSocketTopics::getTopics(const WebSocket* webSocket) const
+    {
+        ConnectionShard& shard = getConnectionShard(webSocket);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        auto it = shard.topics.find(webSocket);
+        if (it == shard.topics.end()) return std::vector<std::string>();
+
+        return std::vector<std::string>(it->second.begin(), it->second.end());
+    }
+
+    size_t WebSocketTopics::getTopicsCount() const
+    {
+        size_t count = 0;
+        for (auto&& shard : _topicShards)
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            count += shard->topics.size();
+        }
+        return count;
+    }
+
+    void WebSocketTopics::addSubscriber(const std::shared_ptr<WebSocket>& webSocket,
+                                        const std::string& topic)
+    {
+        TopicShard& shard = getTopicShard(topic);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        // Publishers keep using the previous snapshot
+        Topic& subscribers = shard.topics[topic];
+        subscribers.positions[webSocket.get()] = subscribers.subscribers.size();
+        subscribers.subscribers.push_back(webSocket);
+        subscribers.snapshot.reset();
+    }
+
+    void WebSocketTopics::removeSubscriber(const WebSocket* webSocket, const std::string& topic)
+    {
+        TopicShard& shard = getTopicShard(topic);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        auto it = shard.topics.find(topic);
+        if (it == shard.topics.end()) return;
+
+        Topic& subscribers = it->second;
+        auto position = subscribers.positions.find(webSocket);
+        if (position == subscribers.positions.end()) return;
+
+        // Move the last subscriber in place of the removed one
+        size_t index = position->second;
+        subscribers.positions.erase(position);
+        if (index + 1 != subscribers.subscribers.size())
+        {
+            subscribers.subscribers[index] = std::move(subscribers.subscribers.back());
+            subscribers.positions[subscribers.subscribers[index].get()] = index;
+        }
+        subscribers.subscribers.pop_back();
+        subscribers.snapshot.reset();
+
+        // Forget about the topics nobody listens to anymore
+        if (subscribers.subscribers.empty())
+        {
+            shard.topics.erase(it);
+        }
+    }
+} // namespace ix
@@ -0,0 +1,96 @@
+/*
+ *  IXWebSocketTopics.h
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone, Inc. All rights reserved.
+ *
+ *  Index of the connections subscribed to each topic.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ix
+{
+    class WebSocket;
+
+    //
+    // Topics are spread over shards, each with its own mutex, so that operations on
+    // unrelated topics do not contend. Subscribing and unsubscribing update the
+    // subscribers of a topic in place, in constant time. Publishing takes an
+    // immutable snapshot of the list under the shard mutex, and iterates over it
+    // without any lock. The snapshot is built by the first publish following a
+    // change, so a burst of subscriptions to a large topic costs a single copy.
+    //
+    // A second index, sharded by connection, keeps the topics of every connection,
+    // so that all its subscriptions can be removed once it is closed. Its mutex is
+    // held while the topic shards are updated, which serializes the operations on a
+    // given connection.
+    //
+    class WebSocketTopics
+    {
+    public:
+        using Subscribers = std::vector<std::shared_ptr<WebSocket>>;
+
+        explicit WebSocketTopics(size_t shardsCount = kDefaultShardsCount);
+
+        WebSocketTopics(const WebSocketTopics&) = delete;
+        WebSocketTopics& operator=(const WebSocketTopics&) = delete;
+
+        // Returns false if the connection was already subscribed to the topic
+        bool subscribe(const std::shared_ptr<WebSocket>& webSocket, const std::string& topic);
+
+        // Returns false if the connection was not subscribed to the topic
+        bool unsubscribe(const WebSocket* webSocket, const std::string& topic);
+
+        // Returns the number of topics the connection was subscribed to
+        size_t unsubscribeAll(const WebSocket* webSocket);
+
+        // nullptr when nobody is subscribed to the topic
+        std::shared_ptr<const Subscribers> getSubscribers(const std::string& topic) const;
+
+        std::vector<std::string> getTopics(const WebSocket* webSocket) const;
+        size_t getTopicsCount() const;
+
+        const static size_t kDefaultShardsCount;
+
+    private:
+        struct Topic
+        {
+            Subscribers subscribers;
+
+            // Index of each subscriber in subscribers, to remove it in constant time
+            std::unordered_map<const WebSocket*, size_t> positions;
+
+            // Handed over to the publishers, null after a change
+            std::shared_ptr<const Subscribers> snapshot;
+        };
+
+        struct TopicShard
+        {
+            mutable std::mutex mutex;
+            std::unordered_map<std::string, Topic> topics;
+        };
+
+        struct ConnectionShard
+        {
+            mutable std::mutex mutex;
+            std::unordered_map<const WebSocket*, std::set<std::string>> topics;
+        };
+
+        TopicShard& getTopicShard(const std::string& topic) const;
+        ConnectionShard& getConnectionShard(const WebSocket* webSocket) const;
+
+        void addSubscriber(const std::shared_ptr<WebSocket>& webSocket, const std::string& topic);
+        void removeSubscriber(const WebSocket* webSocket, const std::string& topic);
+
+        std::vector<std::unique_ptr<TopicShard>> _topicShards;
+        std::vector<std::unique_ptr<ConnectionShard>> _connectionShards;
+    };
+} // namespace ix
@@ -41,9 +41,12 @@
 #include "IXUtf8Validator.h"
 #include "IXWebSocketHandshake.h"
 #include "IXWebSocketHttpHeaders.h"
+#include "IXWebSocketMask.h"
+#include <algorithm>
 #include <chrono>
 #include <cstdarg>
 #include <cstdlib>
+#include <limits>
 #include <sstream>
 #include <string.h>
 #include <string>
@@ -51,23 +54,53 @@
 #include <vector>
 
 
+namespace
+{
+    // Bound to the message string when the payload is delivered as a view
+    const std::string kZeroCopyEmptyPayload;
+} // namespace
+
 namespace ix
 {
     const int WebSocketTransport::kDefaultPingIntervalSecs(-1);
     const bool WebSocketTransport::kDefaultEnablePong(true);
     const int WebSocketTransport::kClosingMaximumWaitingDelayInMs(300);
     constexpr size_t WebSocketTransport::kChunkSize;
+    const size_t WebSocketTransport::kSendByReferenceMinSize(4 * 1024);
+    const int WebSocketTransport::kMaxSendSegments(16);
+    const size_t WebSocketTransport::kMaxFrameHeaderSize(14);
+    const size_t WebSocketTransport::kPendingFeedSize(64 * 1024);
 
     WebSocketTransport::WebSocketTransport()
         : _useMask(true)
         , _blockingSend(false)
         , _sendTimeoutSecs(-1)
+        , _sentBytes(0)
+        , _lastSentBytes(0)
+        , _lastSendProgressTimePoint(std::chrono::steady_clock::now())
+        , _asyncSend(false)
+        , _backpressureEnabled(false)
+        , _pendingSize(0)
+        , _aboveHighWatermark(false)
         , _receivedMessageCompressed(false)
+        , _chunksWireSize(0)
+        , _chunksDecompressionError(false)
+        , _streamingFragments(false)
+        , _zeroCopyDelivery(false)
+        , _idleMemoryReclaimDelaySecs(0)
+        , _receivedBytes(0)
+        , _lastActivityBytes(0)
+        , _lastActivityTimePoint(std::chrono::steady_clock::now())
+        , _idleMemoryReclaimed(false)
+        , _receiveMemoryUsage(0)
         , _readyState(ReadyState::CLOSED)
         , _closeCode(WebSocketCloseConstants::kInternalErrorCode)
         , _closeWireSize(0)
         , _closeRemote(false)
         , _enablePerMessageDeflate(false)
+        , _streamingSend(false)
+        , _streamingSendOpcode(wsheader_type::BINARY_FRAME)
+        , _streamingSendCompressed(false)
         , _requestInitCancellation(false)
         , _closingTimePoint(std::chrono::steady_clock::now())
         , _enablePong(kDefaultEnablePong)
@@ -81,6 +114,7 @@ namespace ix
     {
         setCloseReason(WebSocketCloseConstants::kInternalErrorMessage);
         _readbuf.resize(kChunkSize);
+        updateReceiveMemoryUsage();
     }
 
     WebSocketTransport::~WebSocketTransport()
@@ -174,13 +208,14 @@ namespace ix
                                                             int timeoutSecs,
                                                             bool enablePerMessageDeflate,
                                                             HttpRequestPtr request,
-                                                            int sendTimeoutSecs)
+                                                            int sendTimeoutSecs,
+                                                            bool blockingSend)
     {
         std::lock_guard<std::mutex> lock(_socketMutex);
 
         // Server should not mask the data it sends to the client
         _useMask = false;
-        _blockingSend = true;
+        _blockingSend = blockingSend;
         _sendTimeoutSecs = sendTimeoutSecs;
 
         _socket = std::move(socket);
@@ -232,6 +267,9 @@ namespace ix
         {
             initTimePointsAfterConnect();
             _pongReceived = false;
+
+            // A message streamed on a previous connection cannot be continued
+            _streamingSend = false;
         }
 
         _readyState = readyState;
@@ -242,6 +280,11 @@ namespace ix
         _onCloseCallback = onCloseCallback;
     }
 
+    void WebSocketTransport::setOnFragmentCallback(const OnFragmentCallback& onFragmentCallback)
+    {
+        _onFragmentCallback = onFragmentCallback;
+    }
+
     void WebSocketTransport::initTimePointsAfterConnect()
     {
         {
@@ -251,13 +294,19 @@ namespace ix
     }
 
     // Only consider send PING time points for that computation.
-    bool WebSocketTransport::pingIntervalExceeded()
+    bool WebSocketTransport::pingIntervalExceeded(
+        const std::chrono::time_point<std::chrono::steady_clock>& now)
     {
         if (_pingIntervalSecs <= 0) return false;
 
+        return now > getNextPingTimePoint();
+    }
+
+    std::chrono::time_point<std::chrono::steady_clock> WebSocketTransport::getNextPingTimePoint()
+        const
+    {
         std::lock_guard<std::mutex> lock(_lastSendPingTimePointMutex);
-        auto now = std::chrono::steady_clock::now();
-        return now - _lastSendPingTimePoint > std::chrono::seconds(_pingIntervalSecs);
+        return _lastSendPingTimePoint + std::chrono::seconds(_pingIntervalSecs);
     }
 
     void WebSocketTransport::setPingMessage(const std::string& message, SendMessageKind pingType)
@@ -267,6 +316,33 @@ namespace ix
         _pingType = pingType;
     }
 
+    void WebSocketTransport::setZeroCopyDelivery(bool enabled)
+    {
+        _zeroCopyDelivery = enabled;
+    }
+
+    void WebSocketTransport::setAsyncSend(bool enabled)
+    {
+        _asyncSend = enabled;
+    }
+
+    bool WebSocketTransport::isAsyncSendEnabled() const
+    {
+        return _asyncSend;
+    }
+
+    void WebSocketTransport::setBackpressureOptions(const WebSocketBackpressureOptions& options)
+    {
+        std::lock_guard<std::mutex> lock(_txbufMutex);
+        _backpressureOptions = options;
+        _backpressureEnabled = options.highWatermark > 0;
+    }
+
+    void WebSocketTransport::setOnBackpressureCallback(const OnBackpressureCallback& callback)
+    {
+        _onBackpressureCallback = callback;
+    }
+
     WebSocketSendInfo WebSocketTransport::sendHeartBeat(SendMessageKind pingMessage)
     {
         _pongReceived = false;
@@ -307,18 +383,25 @@ namespace ix
         return {};
     }
 
-    bool WebSocketTransport::closingDelayExceeded()
+    bool WebSocketTransport::closingDelayExceeded(
+        const std::chrono::time_point<std::chrono::steady_clock>& now)
+    {
+        return now > getClosingDeadline();
+    }
+
+    std::chrono::time_point<std::chrono::steady_clock> WebSocketTransport::getClosingDeadline()
+        const
     {
         std::lock_guard<std::mutex> lock(_closingTimePointMutex);
-        auto now = std::chrono::steady_clock::now();
-        return now - _closingTimePoint > std::chrono::milliseconds(kClosingMaximumWaitingDelayInMs);
+        return _closingTimePoint + std::chrono::milliseconds(kClosingMaximumWaitingDelayInMs);
     }
 
-    WebSocketTransport::PollResult WebSocketTransport::poll()
+    void WebSocketTransport::checkPingInterval(
+        const std::chrono::time_point<std::chrono::steady_clock>& now)
     {
         if (_readyState == ReadyState::OPEN)
         {
-            if (pingIntervalExceeded())
+            if (pingIntervalExceeded(now))
             {
                 // If it is not a 'ping' message of ping type, there is no need to judge whether
                 // pong will receive it
@@ -334,6 +417,265 @@ namespace ix
                 }
             }
         }
+    }
+
+    void WebSocketTransport::checkClosingDelay(
+        const std::chrono::time_point<std::chrono::steady_clock>& now)
+    {
+        if (_readyState == ReadyState::CLOSING && closingDelayExceeded(now))
+        {
+            _rxbuf.clear();
+            _rxbufOffset = 0;
+            // close code and reason were set when calling close()
+            closeSocket();
+            setReadyState(ReadyState::CLOSED);
+        }
+    }
+
+    std::chrono::seconds WebSocketTransport::getSendTimeout() const
+    {
+        if (_sendTimeoutSecs > 0)
+        {
+            return std::chrono::seconds(_sendTimeoutSecs);
+        }
+        else if (_pingIntervalSecs > 0)
+        {
+            // If a pingInterval is set, use it as a timeout because if we cannot
+            // send out any data for pingInterval seconds, we may as well disconnet
+            // the client.
+            return std::chrono::seconds(_pingIntervalSecs);
+        }
+        return std::chrono::seconds(0);
+    }
+
+    void WebSocketTransport::checkSendTimeout(
+        const std::chrono::time_point<std::chrono::steady_clock>& now)
+    {
+        auto timeoutSecs = getSendTimeout();
+        if (timeoutSecs.count() == 0 || _readyState == ReadyState::CLOSED) return;
+
+        uint64_t sentBytes = _sentBytes;
+
+        if (sentBytes != _lastSentBytes || isSendBufferEmpty())
+        {
+            _lastSentBytes = sentBytes;
+            _lastSendProgressTimePoint = now;
+        }
+        else if (now > _lastSendProgressTimePoint + timeoutSecs)
+        {
+            closeSocketAndSwitchToClosedState(WebSocketCloseConstants::kAbnormalCloseCode,
+                                              WebSocketCloseConstants::kSendTimeoutMessage,
+                                              0,
+                                              false);
+        }
+    }
+
+    std::chrono::time_point<std::chrono::steady_clock>
+    WebSocketTransport::getIdleMemoryReclaimDeadline(
+        const std::chrono::time_point<std::chrono::steady_clock>& now)
+    {
+        int idleSecs = _idleMemoryReclaimDelaySecs;
+        if (idleSecs <= 0 || _readyState != ReadyState::OPEN)
+        {
+            return std::chrono::time_point<std::chrono::steady_clock>::max();
+        }
+
+        uint64_t activityBytes = _sentBytes + _receivedBytes;
+        if (activityBytes != _lastActivityBytes)
+        {
+            _lastActivityBytes = activityBytes;
+            _lastActivityTimePoint = now;
+            _idleMemoryReclaimed = false;
+        }
+
+        // Nothing left to release until the connection is used again
+        if (_idleMemoryReclaimed)
+        {
+            return std::chrono::time_point<std::chrono::steady_clock>::max();
+        }
+
+        return _lastActivityTimePoint + std::chrono::seconds(idleSecs);
+    }
+
+    void WebSocketTransport::checkIdleMemory(
+        const std::chrono::time_point<std::chrono::steady_clock>& now)
+    {
+        if (now > getIdleMemoryReclaimDeadline(now))
+        {
+            reclaimIdleMemory();
+        }
+    }
+
+    void WebSocketTransport::reclaimIdleMemory()
+    {
+        _idleMemoryReclaimed = true;
+
+        // The receive path is only used by the poll thread. A partial frame, or the
+        // beginning of a fragmented message, is kept.
+        std::vector<uint8_t>().swap(_readbuf);
+        if (_rxbufOffset == _rxbuf.size())
+        {
+            std::vector<uint8_t>().swap(_rxbuf);
+            _rxbufOffset = 0;
+        }
+        std::string().swap(_decompressedMessage);
+
+        // The decompressor can start from a new state when the peer resets its context,
+        // otherwise its window is needed by the next message
+        if (_enablePerMessageDeflate && isPeerCompressionContextReset() && _chunks.empty() &&
+            !_streamingFragments)
+        {
+            _perMessageDeflate->parkDecompressor();
+        }
+
+        updateReceiveMemoryUsage();
+
+        {
+            std::lock_guard<std::mutex> lock(_txbufMutex);
+            _txbuf.shrink();
+        }
+
+        // A message sent with beginMessage() may be held by the compressor
+        std::lock_guard<std::mutex> lock(_compressedMessageMutex);
+        if (!_streamingSend)
+        {
+            std::string().swap(_compressedMessage);
+            if (_enablePerMessageDeflate)
+            {
+                _perMessageDeflate->parkCompressor();
+            }
+        }
+    }
+
+    void WebSocketTransport::updateReceiveMemoryUsage()
+    {
+        size_t memoryUsage =
+            _readbuf.capacity() + _rxbuf.capacity() + _decompressedMessage.capacity();
+        if (_perMessageDeflate)
+        {
+            memoryUsage += _perMessageDeflate->getDecompressorMemoryUsage();
+        }
+        _receiveMemoryUsage = memoryUsage;
+    }
+
+    void WebSocketTransport::setIdleMemoryReclaimDelay(int idleSecs)
+    {
+        _idleMemoryReclaimDelaySecs = idleSecs;
+    }
+
+    size_t WebSocketTransport::getMemoryUsage() const
+    {
+        size_t memoryUsage = _receiveMemoryUsage;
+
+        {
+            std::lock_guard<std::mutex> lock(_txbufMutex);
+            memoryUsage += _txbuf.getMemoryUsage() + _pendingSize;
+        }
+
+        std::lock_guard<std::mutex> lock(_compressedMessageMutex);
+        memoryUsage += _compressedMessage.capacity();
+        if (_perMessageDeflate)
+        {
+            memoryUsage += _perMessageDeflate->getCompressorMemoryUsage();
+        }
+        return memoryUsage;
+    }
+
+    void WebSocketTransport::checkTimers()
+    {
+        auto now = std::chrono::steady_clock::now();
+        checkPingInterval(now);
+        checkSendTimeout(now);
+        checkClosingDelay(now);
+        checkIdleMemory(now);
+    }
+
+    std::chrono::time_point<std::chrono::steady_clock> WebSocketTransport::getTimersDeadline(
+        const std::chrono::time_point<std::chrono::steady_clock>& now)
+    {
+        auto deadline = std::chrono::time_point<std::chrono::steady_clock>::max();
+
+        // Called after each poll, once the received messages were dispatched
+        updateReceiveMemoryUsage();
+
+        ReadyState readyState = _readyState;
+        if (readyState == ReadyState::CLOSED) return deadline;
+
+        // The checks consider that a deadline is passed once it is strictly exceeded
+        const std::chrono::milliseconds margin(1);
+
+        if (readyState == ReadyState::OPEN && _pingIntervalSecs > 0)
+        {
+            deadline = std::min(deadline, getNextPingTimePoint() + margin);
+        }
+        else if (readyState == ReadyState::CLOSING)
+        {
+            deadline = std::min(deadline, getClosingDeadline() + margin);
+        }
+
+        auto timeoutSecs = getSendTimeout();
+        if (timeoutSecs.count() > 0)
+        {
+            // Nothing can be stalled, the timeout starts when data is waiting again
+            if (isSendBufferEmpty())
+            {
+                _lastSentBytes = _sentBytes;
+                _lastSendProgressTimePoint = now;
+            }
+            else
+            {
+                deadline = std::min(deadline, _lastSendProgressTimePoint + timeoutSecs + margin);
+            }
+        }
+
+        auto idleDeadline = getIdleMemoryReclaimDeadline(now);
+        if (idleDeadline != std::chrono::time_point<std::chrono::steady_clock>::max())
+        {
+            deadline = std::min(deadline, idleDeadline + margin);
+        }
+
+        return deadline;
+    }
+
+    WebSocketTransport::PollResult WebSocketTransport::poll(bool readyToRead,
+                                                            bool readyToWrite,
+                                                            bool closeRequest)
+    {
+        if (closeRequest)
+        {
+            closeSocket();
+            return PollResult::Succeeded;
+        }
+
+        if (readyToWrite && !sendOnSocket())
+        {
+            return PollResult::CannotFlushSendBuffer;
+        }
+
+        if (readyToRead && !receiveFromSocket())
+        {
+            return PollResult::AbnormalClose;
+        }
+
+        return PollResult::Succeeded;
+    }
+
+    bool WebSocketTransport::isReceivePending() const
+    {
+        return _receivePending;
+    }
+
+    void WebSocketTransport::appendToReceiveBuffer(const char* data, size_t size)
+    {
+        _rxbuf.insert(_rxbuf.end(), data, data + size);
+    }
+
+    WebSocketTransport::PollResult WebSocketTransport::poll()
+    {
+        auto now = std::chrono::steady_clock::now();
+        updateReceiveMemoryUsage();
+        checkPingInterval(now);
+        checkIdleMemory(now);
 
         // No timeout if state is not OPEN, otherwise computed
         // pingIntervalOrTimeoutGCD (equals to -1 if no ping and no ping timeout are set)
@@ -342,11 +684,23 @@ namespace ix
         if (_pingIntervalSecs > 0)
         {
             // compute lasting delay to wait for next ping / timeout, if at least one set
-            auto now = std::chrono::steady_clock::now();
-            int timeSinceLastPingMs = (int) std::chrono::duration_cast<std::chrono::milliseconds>(
-                                          now - _lastSendPingTimePoint)
+            lastingTimeoutDelayInMs = (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+                                          getNextPingTimePoint() - now)
                                           .count();
-            lastingTimeoutDelayInMs = (1000 * _pingIntervalSecs) - timeSinceLastPingMs;
+        }
+
+        // Wake up to release the memory of the connection once it becomes idle
+        auto idleDeadline = getIdleMemoryReclaimDeadline(now);
+        if (idleDeadline != std::chrono::time_point<std::chrono::steady_clock>::max())
+        {
+            int idleDelayInMs = (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    idleDeadline - now)
+                                    .count() +
+                                1;
+            if (lastingTimeoutDelayInMs < 0 || idleDelayInMs < lastingTimeoutDelayInMs)
+            {
+                lastingTimeoutDelayInMs = idleDelayInMs;
+            }
         }
 
         // The platform may not have select interrupt capabilities, so wait with a small timeout
@@ -369,7 +723,10 @@ namespace ix
         // there can be a lot of it for large messages.
         if (pollResult == PollResultType::SendRequest)
         {
-            if (!flushSendBuffer())
+            // Drain the outbox even when nothing looks buffered: the messages of the
+            // producer which asked for this wake up may have been drained already, and
+            // only a drain lets the next message wake this thread up again
+            if (!sendOnSocket() || !flushSendBuffer())
             {
                 return PollResult::CannotFlushSendBuffer;
             }
@@ -390,13 +747,7 @@ namespace ix
             closeSocket();
         }
 
-        if (_readyState == ReadyState::CLOSING && closingDelayExceeded())
-        {
-            _rxbuf.clear();
-            // close code and reason were set when calling close()
-            closeSocket();
-            setReadyState(ReadyState::CLOSED);
-        }
+        checkClosingDelay(std::chrono::steady_clock::now());
 
         return PollResult::Succeeded;
     }
@@ -404,7 +755,7 @@ namespace ix
     bool WebSocketTransport::isSendBufferEmpty() const
     {
         std::lock_guard<std::mutex> lock(_txbufMutex);
-        return _txbuf.empty();
+        return _outbox.empty() && _pendingMessages.empty() && _txbuf.empty();
     }
 
     template<class Iterator>
@@ -416,15 +767,19 @@ namespace ix
     {
         std::lock_guard<std::mutex> lock(_txbufMutex);
 
-        _txbuf.insert(_txbuf.end(), header.begin(), header.end());
-        _txbuf.insert(_txbuf.end(), begin, end);
+        // Messages queued with async send go first
+        _outbox.drain(_txbuf);
+
+        _txbuf.append(header.data(), header.size());
+        if (begin == end) return;
 
         if (_useMask)
         {
-            for (size_t i = 0; i != (size_t) message_size; ++i)
-            {
-                *(_txbuf.end() - (size_t) message_size + i) ^= masking_key[i & 0x3];
-            }
+            _txbuf.appendMasked(&*begin, (size_t) message_size, masking_key);
+        }
+        else
+        {
+            _txbuf.append(&*begin, (size_t) message_size);
         }
     }
 
@@ -432,10 +787,8 @@ namespace ix
     {
         if (ws.mask)
         {
-            for (size_t j = 0; j != ws.N; ++j)
-            {
-                _rxbuf[j + ws.header_size] ^= ws.masking_key[j & 0x3];
-            }
+            applyWebSocketMask(
+                _rxbuf.data() + _rxbufOffset + ws.header_size, (size_t) ws.N, ws.masking_key);
         }
     }
 
@@ -467,8 +820,11 @@ namespace ix
         while (true)
         {
             wsheader_type ws;
-            if (_rxbuf.size() < 2) break;                /* Need at least 2 */
-            const uint8_t* data = (uint8_t*) &_rxbuf[0]; // peek, but don't consume
+
+            // Frames before _rxbufOffset were already processed
+            size_t rxbufSize = _rxbuf.size() - _rxbufOffset;
+            if (rxbufSize < 2) break;                           /* Need at least 2 */
+            const uint8_t* data = _rxbuf.data() + _rxbufOffset; // peek, but don't consume
             ws.fin = (data[0] & 0x80) == 0x80;
             ws.rsv1 = (data[0] & 0x40) == 0x40;
             ws.rsv2 = (data[0] & 0x20) == 0x20;
@@ -478,13 +834,13 @@ namespace ix
             ws.N0 = (data[1] & 0x7f);
             ws.header_size =
                 2 + (ws.N0 == 126 ? 2 : 0) + (ws.N0 == 127 ? 8 : 0) + (ws.mask ? 4 : 0);
-            if (_rxbuf.size() < ws.header_size) break; /* Need: ws.header_size - _rxbuf.size() */
+            if (rxbufSize < ws.header_size) break; /* Need: ws.header_size - rxbufSize */
 
             if ((ws.rsv1 && !_enablePerMessageDeflate) || ws.rsv2 || ws.rsv3)
             {
                 close(WebSocketCloseConstants::kProtocolErrorCode,
                       WebSocketCloseConstants::kProtocolErrorReservedBitUsed,
-                      _rxbuf.size());
+                      rxbufSize);
                 return;
             }
 
@@ -548,10 +904,10 @@ namespace ix
                 return;
             }
 
-            if (_rxbuf.size() < ws.header_size + ws.N)
+            if (rxbufSize < ws.header_size + ws.N)
             {
                 _rxbufWanted = ws.header_size + ws.N;
-                return; /* Need: ws.header_size+ws.N - _rxbuf.size() */
+                return; /* Need: ws.header_size+ws.N - rxbufSize */
             }
 
             _rxbufWanted = 0;
@@ -566,8 +922,8 @@ namespace ix
             }
 
             unmaskReceiveBuffer(ws);
-            std::string frameData(_rxbuf.begin() + ws.header_size,
-                                  _rxbuf.begin() + ws.header_size + (size_t) ws.N);
+            const char* payload = reinterpret_cast<const char*>(data) + ws.header_size;
+            size_t payloadSize = (size_t) ws.N;
 
             // We got a whole message, now do something with it:
             if (ws.opcode == wsheader_type::TEXT_FRAME ||
@@ -583,13 +939,13 @@ namespace ix
                     _receivedMessageCompressed = _enablePerMessageDeflate && ws.rsv1;
 
                     // Continuation message needs to follow a non-fin TEXT or BINARY message
-                    if (!_chunks.empty())
+                    if (!_chunks.empty() || _streamingFragments)
                     {
                         close(WebSocketCloseConstants::kProtocolErrorCode,
                               WebSocketCloseConstants::kProtocolErrorCodeDataOpcodeOutOfSequence);
                     }
                 }
-                else if (_chunks.empty())
+                else if (_chunks.empty() && !_streamingFragments)
                 {
                     // Continuation message need to follow a non-fin TEXT or BINARY message
                     close(
@@ -600,15 +956,42 @@ namespace ix
                 //
                 // Usual case. Small unfragmented messages
                 //
-                if (ws.fin && _chunks.empty())
+                if (ws.fin && _chunks.empty() && !_streamingFragments)
                 {
-                    emitMessage(_fragmentedMessageKind,
-                                frameData,
-                                _receivedMessageCompressed,
-                                onMessageCallback);
+                    if (_receivedMessageCompressed)
+                    {
+                        emitMessage(_fragmentedMessageKind,
+                                    std::string(payload, payloadSize),
+                                    _receivedMessageCompressed,
+                                    onMessageCallback);
+                    }
+                    else
+                    {
+                        emitMessage(_fragmentedMessageKind, payload, payloadSize, onMessageCallback);
+                    }
 
                     _receivedMessageCompressed = false;
                 }
+                else if (_onFragmentCallback && _chunks.empty())
+                {
+                    //
+                    // Streaming mode: hand each frame over as it arrives, so that very
+                    // large messages are never held in memory.
+                    //
+                    if (!_streamingFragments)
+                    {
+                        _streamingFragments = true;
+                        _fragmentsValidator.reset();
+                    }
+
+                    if (!emitFragment(payload, payloadSize, ws.fin)) return;
+
+                    if (ws.fin)
+                    {
+                        _streamingFragments = false;
+                        _receivedMessageCompressed = false;
+                    }
+                }
                 else
                 {
                     //
@@ -618,14 +1001,18 @@ namespace ix
                     // the internal buffer which is slow and can let the internal OS
                     // receive buffer fill out.
                     //
-                    _chunks.emplace_back(std::move(frameData));
+                    if (!appendChunk(payload, payloadSize, ws.fin)) return;
 
                     if (ws.fin)
                     {
-                        emitMessage(_fragmentedMessageKind,
-                                    getMergedChunks(),
-                                    _receivedMessageCompressed,
-                                    onMessageCallback);
+                        // The chunks are already decompressed and validated
+                        std::string message = getMergedChunks();
+                        onMessageCallback(message,
+                                          message.data(),
+                                          message.size(),
+                                          _chunksWireSize,
+                                          _chunksDecompressionError,
+                                          _fragmentedMessageKind);
 
                         _chunks.clear();
                         _receivedMessageCompressed = false;
@@ -639,7 +1026,7 @@ namespace ix
             else if (ws.opcode == wsheader_type::PING)
             {
                 // too large
-                if (frameData.size() > 125)
+                if (payloadSize > 125)
                 {
                     // Unexpected frame type
                     close(WebSocketCloseConstants::kProtocolErrorCode,
@@ -651,15 +1038,16 @@ namespace ix
                 {
                     // Reply back right away
                     bool compress = false;
-                    sendData(wsheader_type::PONG, frameData, compress);
+                    sendData(
+                        wsheader_type::PONG, IXWebSocketSendData(payload, payloadSize), compress);
                 }
 
-                emitMessage(MessageKind::PING, frameData, false, onMessageCallback);
+                emitMessage(MessageKind::PING, payload, payloadSize, onMessageCallback);
             }
             else if (ws.opcode == wsheader_type::PONG)
             {
                 _pongReceived = true;
-                emitMessage(MessageKind::PONG, frameData, false, onMessageCallback);
+                emitMessage(MessageKind::PONG, payload, payloadSize, onMessageCallback);
             }
             else if (ws.opcode == wsheader_type::CLOSE)
             {
@@ -669,13 +1057,13 @@ namespace ix
                 if (ws.N >= 2)
                 {
                     // Extract the close code first, available as the first 2 bytes
-                    code |= ((uint64_t) _rxbuf[ws.header_size]) << 8;
-                    code |= ((uint64_t) _rxbuf[ws.header_size + 1]) << 0;
+                    code |= ((uint64_t) data[ws.header_size]) << 8;
+                    code |= ((uint64_t) data[ws.header_size + 1]) << 0;
 
                     // Get the reason.
                     if (ws.N > 2)
                     {
-                        reason = frameData.substr(2, frameData.size());
+                        reason.assign(payload + 2, payloadSize - 2);
                     }
 
                     // Validate that the reason is proper utf-8. Autobahn 7.5.1
@@ -718,7 +1106,7 @@ namespace ix
                     wakeUpFromPoll(SelectInterrupt::kCloseRequest);
 
                     bool remote = true;
-                    closeSocketAndSwitchToClosedState(code, reason, _rxbuf.size(), remote);
+                    closeSocketAndSwitchToClosedState(code, reason, rxbufSize, remote);
                 }
                 else
                 {
@@ -729,7 +1117,7 @@ namespace ix
                     if (identicalReason)
                     {
                         bool remote = false;
-                        closeSocketAndSwitchToClosedState(code, reason, _rxbuf.size(), remote);
+                        closeSocketAndSwitchToClosedState(code, reason, rxbufSize, remote);
                     }
                 }
             }
@@ -738,11 +1126,13 @@ namespace ix
                 // Unexpected frame type
                 close(WebSocketCloseConstants::kProtocolErrorCode,
                       WebSocketCloseConstants::kProtocolErrorMessage,
-                      _rxbuf.size());
+                      rxbufSize);
             }
 
-            // Erase the message that has been processed from the input/read buffer
-            _rxbuf.erase(_rxbuf.begin(), _rxbuf.begin() + ws.header_size + (size_t) ws.N);
+            // Skip the message that has been processed. The input/read buffer is compacted
+            // once before the next socket read, instead of erasing every frame here, which
+            // would move the rest of the buffer for each small frame.
+            _rxbufOffset += ws.header_size + (size_t) ws.N;
         }
 
         // if an abnormal closure was raised in poll, and nothing else triggered a CLOSED state in
@@ -750,6 +1140,7 @@ namespace ix
         if (pollResult != PollResult::Succeeded)
         {
             _rxbuf.clear();
+            _rxbufOffset = 0;
 
             // if we previously closed the connection (CLOSING state), then set state to CLOSED
             // (code/reason were set before)
@@ -769,6 +1160,87 @@ namespace ix
         }
     }
 
+    bool WebSocketTransport::appendChunk(const char* data, size_t size, bool fin)
+    {
+        if (_chunks.empty())
+        {
+            _chunksWireSize = 0;
+            _chunksDecompressionError = false;
+            _fragmentsValidator.reset();
+        }
+        _chunksWireSize += size;
+
+        // After a decompression error the message is delivered as received so far,
+        // flagged with the error, like an unfragmented one would be
+        if (_chunksDecompressionError)
+        {
+            _chunks.emplace_back();
+            return true;
+        }
+
+        if (_receivedMessageCompressed)
+        {
+            // The inflate state carries over between frames
+            _chunks.emplace_back();
+            if (!_perMessageDeflate->decompress(data, size, fin, _chunks.back()))
+            {
+                _chunksDecompressionError = true;
+                return true;
+            }
+        }
+        else
+        {
+            _chunks.emplace_back(data, size);
+        }
+
+        const std::string& chunk = _chunks.back();
+        if (_fragmentedMessageKind == MessageKind::MSG_TEXT &&
+            (!_fragmentsValidator.decodeFragment(chunk.data(), chunk.size()) ||
+             (fin && !_fragmentsValidator.complete())))
+        {
+            _chunks.clear();
+            _receivedMessageCompressed = false;
+            close(WebSocketCloseConstants::kInvalidFramePayloadData,
+                  WebSocketCloseConstants::kInvalidFramePayloadDataMessage);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool WebSocketTransport::emitFragment(const char* data, size_t size, bool fin)
+    {
+        size_t wireSize = size;
+
+        if (_receivedMessageCompressed)
+        {
+            // Decompress incrementally, the inflate state carries over between frames
+            _decompressedMessage.clear();
+            if (!_perMessageDeflate->decompress(data, size, fin, _decompressedMessage))
+            {
+                _streamingFragments = false;
+                close(WebSocketCloseConstants::kInvalidFramePayloadData,
+                      WebSocketCloseConstants::kInvalidFramePayloadDataMessage);
+                return false;
+            }
+            data = _decompressedMessage.data();
+            size = _decompressedMessage.size();
+        }
+
+        bool binary = _fragmentedMessageKind == MessageKind::MSG_BINARY;
+        if (!binary && (!_fragmentsValidator.decodeFragment(data, size) ||
+                        (fin && !_fragmentsValidator.complete())))
+        {
+            _streamingFragments = false;
+            close(WebSocketCloseConstants::kInvalidFramePayloadData,
+                  WebSocketCloseConstants::kInvalidFramePayloadDataMessage);
+            return false;
+        }
+
+        _onFragmentCallback(data, size, wireSize, binary, fin);
+        return true;
+    }
+
     std::string WebSocketTransport::getMergedChunks() const
     {
         size_t length = 0;
@@ -807,7 +1279,12 @@ namespace ix
             }
             else
             {
-                onMessageCallback(_decompressedMessage, wireSize, !success, messageKind);
+                onMessageCallback(_decompressedMessage,
+                                  _decompressedMessage.data(),
+                                  _decompressedMessage.size(),
+                                  wireSize,
+                                  !success,
+                                  messageKind);
             }
         }
         else
@@ -819,19 +1296,41 @@ namespace ix
             }
             else
             {
-                onMessageCallback(message, wireSize, false, messageKind);
+                onMessageCallback(
+                    message, message.data(), message.size(), wireSize, false, messageKind);
             }
         }
     }
 
-    unsigned WebSocketTransport::getRandomUnsigned()
+    void WebSocketTransport::emitMessage(MessageKind messageKind,
+                                         const char* data,
+                                         size_t size,
+                                         const OnMessageCallback& onMessageCallback)
     {
-        auto now = std::chrono::system_clock::now();
-        auto seconds =
-            std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
-        return static_cast<unsigned>(seconds);
-    }
-
+        if (messageKind == MessageKind::MSG_TEXT && !validateUtf8(data, size))
+        {
+            close(WebSocketCloseConstants::kInvalidFramePayloadData,
+                  WebSocketCloseConstants::kInvalidFramePayloadDataMessage);
+        }
+        else if (_zeroCopyDelivery)
+        {
+            onMessageCallback(kZeroCopyEmptyPayload, data, size, size, false, messageKind);
+        }
+        else
+        {
+            std::string message(data, size);
+            onMessageCallback(message, message.data(), message.size(), size, false, messageKind);
+        }
+    }
+
+    unsigned WebSocketTransport::getRandomUnsigned()
+    {
+        auto now = std::chrono::system_clock::now();
+        auto seconds =
+            std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+        return static_cast<unsigned>(seconds);
+    }
+
     WebSocketSendInfo WebSocketTransport::sendData(wsheader_type::opcode_type type,
                                                    const IXWebSocketSendData& message,
                                                    bool compress,
@@ -842,6 +1341,590 @@ namespace ix
             return WebSocketSendInfo(false);
         }
 
+        // Data frames of other messages cannot be sent in the middle of a streamed one
+        if (_streamingSend && type != wsheader_type::PING && type != wsheader_type::PONG &&
+            type != wsheader_type::CLOSE)
+        {
+            return WebSocketSendInfo(false);
+        }
+
+        // With watermarks, Text and Binary messages are only queued here
+        if (_backpressureEnabled &&
+            (type == wsheader_type::TEXT_FRAME || type == wsheader_type::BINARY_FRAME))
+        {
+            return sendPendingMessage(type, message, compress, onProgressCallback, std::string());
+        }
+
+        auto compressedMessageLock = lockCompressor(compress);
+
+        // With async send, the frames of the message are built here and queued in one
+        // go, so that they cannot be interleaved with frames sent by other threads.
+        if (_asyncSend)
+        {
+            std::vector<uint8_t> frames;
+            WebSocketSendInfo info =
+                sendFragments(type, message, compress, onProgressCallback, &frames);
+            queueFrames(std::move(frames));
+            return info;
+        }
+
+        WebSocketSendInfo info = sendFragments(type, message, compress, onProgressCallback);
+        if (compressedMessageLock.owns_lock())
+        {
+            compressedMessageLock.unlock();
+        }
+        if (info.compressionError) return info;
+
+        if (!requestSendBufferFlush())
+        {
+            info.success = false;
+        }
+        return info;
+    }
+
+    WebSocketSendInfo WebSocketTransport::sendBatch(const IXWebSocketSendData* messages,
+                                                    size_t count,
+                                                    SendMessageKind sendMessageKind)
+    {
+        switch (sendMessageKind)
+        {
+            case SendMessageKind::Text:
+                return sendBatch(
+                    wsheader_type::TEXT_FRAME, messages, count, _enablePerMessageDeflate);
+            case SendMessageKind::Binary:
+                return sendBatch(
+                    wsheader_type::BINARY_FRAME, messages, count, _enablePerMessageDeflate);
+            default:
+                // Only data messages can be batched
+                return WebSocketSendInfo(false);
+        }
+    }
+
+    WebSocketSendInfo WebSocketTransport::sendBatch(wsheader_type::opcode_type type,
+                                                    const IXWebSocketSendData* messages,
+                                                    size_t count,
+                                                    bool compress)
+    {
+        if ((_readyState != ReadyState::OPEN && _readyState != ReadyState::CLOSING) ||
+            _streamingSend)
+        {
+            return WebSocketSendInfo(false);
+        }
+
+        // With watermarks the batch is accepted or refused as a whole, before the
+        // messages go through the compressor
+        BackpressureDecision decision = BackpressureDecision::Queue;
+        if (_backpressureEnabled)
+        {
+            decision = applyBackpressure(std::string());
+            if (decision == BackpressureDecision::Reject) return WebSocketSendInfo(false);
+        }
+
+        // Frame all the messages in a single buffer, written with a single send
+        // and a single wake up of the poll thread
+        std::vector<uint8_t> frames;
+        WebSocketSendInfo batchInfo(true);
+
+        size_t reservedSize = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            reservedSize += messages[i].size() + kMaxFrameHeaderSize;
+        }
+        frames.reserve(reservedSize);
+
+        // Held until the batch is queued, so that messages sent concurrently by other
+        // threads are not compressed in between
+        auto compressedMessageLock = lockCompressor(compress);
+        for (size_t i = 0; i < count; ++i)
+        {
+            WebSocketSendInfo info = sendFragments(type, messages[i], compress, nullptr, &frames);
+            batchInfo.payloadSize += info.payloadSize;
+            batchInfo.wireSize += info.wireSize;
+
+            // The messages that were framed are still sent, as they are already part
+            // of the compression context
+            if (!info.success)
+            {
+                batchInfo.success = false;
+                batchInfo.compressionError = info.compressionError;
+                break;
+            }
+        }
+
+        if (_backpressureEnabled)
+        {
+            if (!frames.empty())
+            {
+                PendingMessage pendingMessage;
+                pendingMessage.frames = std::move(frames);
+                pendingMessage.droppable = !compress || isCompressionContextReset();
+                queuePendingMessage(std::move(pendingMessage), decision);
+            }
+            return batchInfo;
+        }
+
+        if (_asyncSend)
+        {
+            queueFrames(std::move(frames));
+            return batchInfo;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_txbufMutex);
+            _outbox.drain(_txbuf);
+            _txbuf.append(std::move(frames));
+        }
+
+        if (compressedMessageLock.owns_lock())
+        {
+            compressedMessageLock.unlock();
+        }
+
+        if (!sendOnSocket() || !requestSendBufferFlush())
+        {
+            batchInfo.success = false;
+        }
+        return batchInfo;
+    }
+
+    bool WebSocketTransport::beginMessage(SendMessageKind sendMessageKind)
+    {
+        if (_readyState != ReadyState::OPEN || _streamingSend) return false;
+
+        if (sendMessageKind == SendMessageKind::Text)
+        {
+            _streamingSendOpcode = wsheader_type::TEXT_FRAME;
+        }
+        else if (sendMessageKind == SendMessageKind::Binary)
+        {
+            _streamingSendOpcode = wsheader_type::BINARY_FRAME;
+        }
+        else
+        {
+            return false;
+        }
+
+        _streamingSendCompressed = _enablePerMessageDeflate;
+        _streamingSend = true;
+        return true;
+    }
+
+    WebSocketSendInfo WebSocketTransport::appendFragment(const IXWebSocketSendData& data)
+    {
+        bool fin = false;
+        return sendStreamingFragment(data, fin);
+    }
+
+    WebSocketSendInfo WebSocketTransport::endMessage()
+    {
+        bool fin = true;
+        return sendStreamingFragment(IXWebSocketSendData(nullptr, 0), fin);
+    }
+
+    WebSocketSendInfo WebSocketTransport::sendStreamingFragment(const IXWebSocketSendData& data,
+                                                                bool fin)
+    {
+        if (!_streamingSend) return WebSocketSendInfo(false);
+
+        if (_readyState != ReadyState::OPEN && _readyState != ReadyState::CLOSING)
+        {
+            _streamingSend = false;
+            return WebSocketSendInfo(false);
+        }
+
+        size_t payloadSize = data.size();
+        const char* wire = data.data();
+        size_t wireSize = data.size();
+
+        // The compression context carries over between the fragments of the message
+        std::unique_lock<std::mutex> compressedMessageLock(_compressedMessageMutex,
+                                                          std::defer_lock);
+        if (_streamingSendCompressed)
+        {
+            compressedMessageLock.lock();
+
+            if (!_perMessageDeflate->compress(data, fin, _compressedMessage))
+            {
+                _streamingSend = false;
+                bool compressionError = true;
+                return WebSocketSendInfo(false, compressionError);
+            }
+            wire = _compressedMessage.data();
+            wireSize = _compressedMessage.size();
+        }
+
+        // deflate buffered everything, wait for more data before sending a frame
+        if (wireSize == 0 && !fin)
+        {
+            return WebSocketSendInfo(true, false, payloadSize, wireSize);
+        }
+
+        std::vector<uint8_t> queuedFrames;
+        std::vector<uint8_t>* frames = nullptr;
+        if (_asyncSend)
+        {
+            frames = &queuedFrames;
+        }
+
+        // Fragments larger than kChunkSize are split, like regular messages
+        bool success = true;
+        IXWebSocketSendData wireData(wire, wireSize);
+        auto begin = wireData.cbegin();
+        auto end = wireData.cend();
+        do
+        {
+            auto next = end;
+            if ((size_t) (end - begin) > kChunkSize)
+            {
+                next = begin + kChunkSize;
+            }
+
+            bool lastFrame = fin && next == end;
+            if (!sendFragment(
+                    _streamingSendOpcode, lastFrame, begin, next, _streamingSendCompressed, frames))
+            {
+                success = false;
+                break;
+            }
+
+            _streamingSendOpcode = wsheader_type::CONTINUATION;
+            begin = next;
+        } while (begin != end);
+
+        if (fin || !success)
+        {
+            _streamingSend = false;
+        }
+
+        if (compressedMessageLock.owns_lock())
+        {
+            compressedMessageLock.unlock();
+        }
+
+        if (frames != nullptr)
+        {
+            queueFrames(std::move(queuedFrames));
+        }
+        else if (!requestSendBufferFlush())
+        {
+            success = false;
+        }
+
+        return WebSocketSendInfo(success, false, payloadSize, wireSize);
+    }
+
+    void WebSocketTransport::queueFrames(std::vector<uint8_t>&& frames)
+    {
+        if (frames.empty()) return;
+
+        // Only the first message queued since the last drain wakes up the poll thread
+        if (_outbox.push(std::move(frames)))
+        {
+            wakeUpFromPoll(SelectInterrupt::kSendRequest);
+        }
+    }
+
+    bool WebSocketTransport::requestSendBufferFlush()
+    {
+        // Request to flush the send buffer on the background thread if it isn't empty
+        if (!isSendBufferEmpty())
+        {
+            wakeUpFromPoll(SelectInterrupt::kSendRequest);
+
+            // FIXME: we should have a timeout when sending large messages: see #131
+            if (_blockingSend && !_backpressureEnabled && !flushSendBuffer())
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    WebSocketSendInfo WebSocketTransport::sendConflatable(const std::string& key,
+                                                          const IXWebSocketSendData& message,
+                                                          SendMessageKind sendMessageKind)
+    {
+        wsheader_type::opcode_type type;
+        if (sendMessageKind == SendMessageKind::Text)
+        {
+            type = wsheader_type::TEXT_FRAME;
+        }
+        else if (sendMessageKind == SendMessageKind::Binary)
+        {
+            type = wsheader_type::BINARY_FRAME;
+        }
+        else
+        {
+            return WebSocketSendInfo(false);
+        }
+
+        if (!_backpressureEnabled)
+        {
+            return sendData(type, message, _enablePerMessageDeflate);
+        }
+
+        if ((_readyState != ReadyState::OPEN && _readyState != ReadyState::CLOSING) ||
+            _streamingSend)
+        {
+            return WebSocketSendInfo(false);
+        }
+
+        return sendPendingMessage(type, message, _enablePerMessageDeflate, nullptr, key);
+    }
+
+    WebSocketSendInfo WebSocketTransport::sendPendingMessage(
+        wsheader_type::opcode_type type,
+        const IXWebSocketSendData& message,
+        bool compress,
+        const OnProgressCallback& onProgressCallback,
+        const std::string& key)
+    {
+        // Refused messages must not go through the compressor, the peer would not be
+        // able to decompress the next ones
+        BackpressureDecision decision = applyBackpressure(key);
+        if (decision == BackpressureDecision::Reject) return WebSocketSendInfo(false);
+
+        PendingMessage pendingMessage;
+
+        // Held until the message is queued, behind the messages compressed before it
+        auto compressedMessageLock = lockCompressor(compress);
+        WebSocketSendInfo info =
+            sendFragments(type, message, compress, onProgressCallback, &pendingMessage.frames);
+        if (pendingMessage.frames.empty()) return info;
+
+        pendingMessage.key = key;
+        pendingMessage.droppable = !compress || isCompressionContextReset();
+        queuePendingMessage(std::move(pendingMessage), decision);
+
+        return info;
+    }
+
+    WebSocketTransport::BackpressureDecision WebSocketTransport::applyBackpressure(
+        const std::string& key)
+    {
+        BackpressureDecision decision = BackpressureDecision::Queue;
+        bool highWatermarkReached = false;
+        bool block = false;
+        bool disconnect = false;
+        size_t bufferedAmount = 0;
+        size_t lowWatermark = 0;
+        uint16_t disconnectCode = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(_txbufMutex);
+
+            bufferedAmount = getBufferedAmount();
+            if (bufferedAmount < _backpressureOptions.highWatermark) return decision;
+
+            if (!_aboveHighWatermark)
+            {
+                _aboveHighWatermark = true;
+                highWatermarkReached = true;
+            }
+            lowWatermark = _backpressureOptions.lowWatermark;
+            disconnectCode = _backpressureOptions.disconnectCode;
+
+            switch (_backpressureOptions.policy)
+            {
+                case BackpressurePolicy::Block:
+                {
+                    block = true;
+                }
+                break;
+
+                case BackpressurePolicy::DropNewest:
+                {
+                    decision = BackpressureDecision::Reject;
+                }
+                break;
+
+                case BackpressurePolicy::DropOldest:
+                {
+                    dropOldestPendingMessages();
+                    if (getBufferedAmount() >= _backpressureOptions.highWatermark)
+                    {
+                        decision = BackpressureDecision::Reject;
+                    }
+                }
+                break;
+
+                case BackpressurePolicy::Conflate:
+                {
+                    // At most one message per key is queued above the high watermark
+                    if (key.empty())
+                    {
+                        decision = BackpressureDecision::Reject;
+                    }
+                    else if (findPendingMessage(key) != _pendingMessages.end())
+                    {
+                        decision = BackpressureDecision::Replace;
+                    }
+                }
+                break;
+
+                case BackpressurePolicy::Disconnect:
+                {
+                    // Nothing queued will be read anyway, only the close frame is sent
+                    _pendingMessages.clear();
+                    _pendingSize = 0;
+                    disconnect = true;
+                    decision = BackpressureDecision::Reject;
+                }
+                break;
+            }
+        }
+
+        if (highWatermarkReached)
+        {
+            invokeBackpressureCallback(BackpressureEvent::HighWatermark, bufferedAmount);
+        }
+
+        if (block && !flushSendBuffer(lowWatermark))
+        {
+            decision = BackpressureDecision::Reject;
+        }
+
+        if (disconnect)
+        {
+            close(disconnectCode, WebSocketCloseConstants::kSendBufferFullMessage);
+        }
+
+        return decision;
+    }
+
+    void WebSocketTransport::queuePendingMessage(PendingMessage&& message,
+                                                 BackpressureDecision decision)
+    {
+        bool wasEmpty;
+        {
+            std::lock_guard<std::mutex> lock(_txbufMutex);
+            wasEmpty = _pendingMessages.empty();
+
+            // The message to replace may have been moved to _txbuf in the meantime
+            auto it = _pendingMessages.end();
+            if (decision == BackpressureDecision::Replace)
+            {
+                it = findPendingMessage(message.key);
+            }
+
+            _pendingSize += message.size();
+            if (it != _pendingMessages.end())
+            {
+                _pendingSize -= it->size();
+                *it = std::move(message);
+            }
+            else
+            {
+                _pendingMessages.push_back(std::move(message));
+            }
+        }
+
+        // When there already were pending messages the poll thread is already writing
+        if (wasEmpty)
+        {
+            wakeUpFromPoll(SelectInterrupt::kSendRequest);
+        }
+    }
+
+    size_t WebSocketTransport::PendingMessage::size() const
+    {
+        return sharedFrames ? sharedFrames->size() : frames.size();
+    }
+
+    size_t WebSocketTransport::getBufferedAmount() const
+    {
+        return _outbox.size() + _pendingSize + _txbuf.size();
+    }
+
+    void WebSocketTransport::feedSendBuffer(size_t maxSize)
+    {
+        while (!_pendingMessages.empty() && _txbuf.size() < maxSize)
+        {
+            PendingMessage& message = _pendingMessages.front();
+            _pendingSize -= message.size();
+            if (message.sharedFrames)
+            {
+                _txbuf.append(message.sharedFrames);
+            }
+            else
+            {
+                _txbuf.append(std::move(message.frames));
+            }
+            _pendingMessages.pop_front();
+        }
+    }
+
+    void WebSocketTransport::dropOldestPendingMessages()
+    {
+        auto it = _pendingMessages.begin();
+        while (it != _pendingMessages.end() &&
+               getBufferedAmount() >= _backpressureOptions.highWatermark)
+        {
+            if (it->droppable)
+            {
+                _pendingSize -= it->size();
+                it = _pendingMessages.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    std::deque<WebSocketTransport::PendingMessage>::iterator WebSocketTransport::findPendingMessage(
+        const std::string& key)
+    {
+        for (auto it = _pendingMessages.begin(); it != _pendingMessages.end(); ++it)
+        {
+            if (it->droppable && it->key == key) return it;
+        }
+        return _pendingMessages.end();
+    }
+
+    void WebSocketTransport::invokeBackpressureCallback(BackpressureEvent event,
+                                                        size_t bufferedAmount)
+    {
+        if (_onBackpressureCallback)
+        {
+            _onBackpressureCallback(event, bufferedAmount);
+        }
+    }
+
+    bool WebSocketTransport::isCompressionContextReset() const
+    {
+        return _perMessageDeflateOptions.getClientNoContextTakeover();
+    }
+
+    bool WebSocketTransport::isPeerCompressionContextReset() const
+    {
+        // WebSocketPerMessageDeflate resets the context in both directions when
+        // client_no_context_takeover is negotiated (see isCompressionContextReset), other
+        // implementations follow the parameter negotiated for the role of the peer.
+        // The peer may be either, so both must hold.
+        bool peerParameter = (_useMask) ? _perMessageDeflateOptions.getServerNoContextTakeover()
+                                        : _perMessageDeflateOptions.getClientNoContextTakeover();
+        return isCompressionContextReset() && peerParameter;
+    }
+
+    std::unique_lock<std::mutex> WebSocketTransport::lockCompressor(bool compress)
+    {
+        // The compressor and its output buffer are shared by the sending threads
+        std::unique_lock<std::mutex> lock(_compressedMessageMutex, std::defer_lock);
+        if (compress)
+        {
+            lock.lock();
+        }
+        return lock;
+    }
+
+    WebSocketSendInfo WebSocketTransport::sendFragments(wsheader_type::opcode_type type,
+                                                        const IXWebSocketSendData& message,
+                                                        bool compress,
+                                                        const OnProgressCallback& onProgressCallback,
+                                                        std::vector<uint8_t>* frames)
+    {
         size_t payloadSize = message.size();
         size_t wireSize = message.size();
         bool compressionError = false;
@@ -867,17 +1950,18 @@ namespace ix
             message_end = compressedSendData.cend();
         }
 
+        bool success = true;
+
+        if (frames != nullptr && frames->empty())
         {
-            std::lock_guard<std::mutex> lock(_txbufMutex);
-            _txbuf.reserve(wireSize);
+            // Payload plus the largest header for each fragment
+            frames->reserve(wireSize + kMaxFrameHeaderSize * (wireSize / kChunkSize + 1));
         }
 
-        bool success = true;
-
         // Common case for most message. No fragmentation required.
         if (wireSize < kChunkSize)
         {
-            success = sendFragment(type, true, message_begin, message_end, compress);
+            success = sendFragment(type, true, message_begin, message_end, compress, frames);
 
             if (onProgressCallback)
             {
@@ -918,7 +2002,7 @@ namespace ix
                 }
 
                 // Send message
-                if (!sendFragment(opcodeType, fin, begin, end, compress))
+                if (!sendFragment(opcodeType, fin, begin, end, compress, frames))
                 {
                     return WebSocketSendInfo(false);
                 }
@@ -932,18 +2016,6 @@ namespace ix
             }
         }
 
-        // Request to flush the send buffer on the background thread if it isn't empty
-        if (!isSendBufferEmpty())
-        {
-            wakeUpFromPoll(SelectInterrupt::kSendRequest);
-
-            // FIXME: we should have a timeout when sending large messages: see #131
-            if (_blockingSend && !flushSendBuffer())
-            {
-                success = false;
-            }
-        }
-
         return WebSocketSendInfo(success, compressionError, payloadSize, wireSize);
     }
 
@@ -952,7 +2024,8 @@ namespace ix
                                           bool fin,
                                           Iterator message_begin,
                                           Iterator message_end,
-                                          bool compress)
+                                          bool compress,
+                                          std::vector<uint8_t>* frames)
     {
         uint64_t message_size = static_cast<uint64_t>(message_end - message_begin);
 
@@ -963,77 +2036,199 @@ namespace ix
         masking_key[2] = (x >> 8) & 0xff;
         masking_key[3] = (x) &0xff;
 
+        if (frames != nullptr)
+        {
+            appendFrameHeader(*frames, type, fin, compress, message_size, _useMask, masking_key);
+            if (message_size == 0) return true;
+
+            size_t offset = frames->size();
+            frames->insert(frames->end(), message_begin, message_end);
+            if (_useMask)
+            {
+                applyWebSocketMask(frames->data() + offset, (size_t) message_size, masking_key);
+            }
+            return true;
+        }
+
         std::vector<uint8_t> header;
-        header.assign(2 + (message_size >= 126 ? 2 : 0) + (message_size >= 65536 ? 6 : 0) +
-                          (_useMask ? 4 : 0),
+        appendFrameHeader(header, type, fin, compress, message_size, _useMask, masking_key);
+
+        // Servers do not mask, and block until the data is sent. The payload can then
+        // go from the caller's buffer to the socket without being copied.
+        if (!_useMask && _blockingSend && !_backpressureEnabled && !compress &&
+            message_size >= kSendByReferenceMinSize)
+        {
+            return sendFragmentByReference(header, &*message_begin, (size_t) message_size);
+        }
+
+        // _txbuf will keep growing until it can be transmitted over the socket:
+        appendToSendBuffer(header, message_begin, message_end, message_size, masking_key);
+
+        // Now actually send this data
+        return sendOnSocket();
+    }
+
+    void WebSocketTransport::appendFrameHeader(std::vector<uint8_t>& header,
+                                               wsheader_type::opcode_type type,
+                                               bool fin,
+                                               bool compressed,
+                                               uint64_t size,
+                                               bool mask,
+                                               const uint8_t maskingKey[4])
+    {
+        size_t offset = header.size();
+        header.resize(offset + 2 + (size >= 126 ? 2 : 0) + (size >= 65536 ? 6 : 0) +
+                          (mask ? 4 : 0),
                       0);
-        header[0] = type;
+        uint8_t* h = header.data() + offset;
+        h[0] = type;
 
         // The fin bit indicate that this is the last fragment. Fin is French for end.
         if (fin)
         {
-            header[0] |= 0x80;
+            h[0] |= 0x80;
         }
 
         // The rsv1 bit indicate that the frame is compressed
         // continuation opcodes should not set it. Autobahn 12.2.10 and others 12.X
-        if (compress && type != wsheader_type::CONTINUATION)
+        if (compressed && type != wsheader_type::CONTINUATION)
         {
-            header[0] |= 0x40;
+            h[0] |= 0x40;
         }
 
-        if (message_size < 126)
+        size_t keyOffset;
+        if (size < 126)
         {
-            header[1] = (message_size & 0xff) | (_useMask ? 0x80 : 0);
-
-            if (_useMask)
-            {
-                header[2] = masking_key[0];
-                header[3] = masking_key[1];
-                header[4] = masking_key[2];
-                header[5] = masking_key[3];
-            }
+            h[1] = (size & 0xff) | (mask ? 0x80 : 0);
+            keyOffset = 2;
         }
-        else if (message_size < 65536)
+        else if (size < 65536)
         {
-            header[1] = 126 | (_useMask ? 0x80 : 0);
-            header[2] = (message_size >> 8) & 0xff;
-            header[3] = (message_size >> 0) & 0xff;
-
-            if (_useMask)
-            {
-                header[4] = masking_key[0];
-                header[5] = masking_key[1];
-                header[6] = masking_key[2];
-                header[7] = masking_key[3];
-            }
+            h[1] = 126 | (mask ? 0x80 : 0);
+            h[2] = (size >> 8) & 0xff;
+            h[3] = (size >> 0) & 0xff;
+            keyOffset = 4;
         }
         else
         { // TODO: run coverage testing here
-            header[1] = 127 | (_useMask ? 0x80 : 0);
-            header[2] = (message_size >> 56) & 0xff;
-            header[3] = (message_size >> 48) & 0xff;
-            header[4] = (message_size >> 40) & 0xff;
-            header[5] = (message_size >> 32) & 0xff;
-            header[6] = (message_size >> 24) & 0xff;
-            header[7] = (message_size >> 16) & 0xff;
-            header[8] = (message_size >> 8) & 0xff;
-            header[9] = (message_size >> 0) & 0xff;
+            h[1] = 127 | (mask ? 0x80 : 0);
+            h[2] = (size >> 56) & 0xff;
+            h[3] = (size >> 48) & 0xff;
+            h[4] = (size >> 40) & 0xff;
+            h[5] = (size >> 32) & 0xff;
+            h[6] = (size >> 24) & 0xff;
+            h[7] = (size >> 16) & 0xff;
+            h[8] = (size >> 8) & 0xff;
+            h[9] = (size >> 0) & 0xff;
+            keyOffset = 10;
+        }
 
-            if (_useMask)
-            {
-                header[10] = masking_key[0];
-                header[11] = masking_key[1];
-                header[12] = masking_key[2];
-                header[13] = masking_key[3];
-            }
+        if (mask)
+        {
+            memcpy(h + keyOffset, maskingKey, 4);
         }
+    }
 
-        // _txbuf will keep growing until it can be transmitted over the socket:
-        appendToSendBuffer(header, message_begin, message_end, message_size, masking_key);
+    void WebSocketTransport::frameServerMessage(SendMessageKind sendMessageKind,
+                                                const IXWebSocketSendData& payload,
+                                                bool compressed,
+                                                std::vector<uint8_t>& frames)
+    {
+        auto type = (sendMessageKind == SendMessageKind::Binary) ? wsheader_type::BINARY_FRAME
+                                                                 : wsheader_type::TEXT_FRAME;
+        size_t size = payload.size();
+        const char* data = payload.c_str();
 
-        // Now actually send this data
-        return sendOnSocket();
+        frames.reserve(frames.size() + size + kMaxFrameHeaderSize * (size / kChunkSize + 1));
+
+        // Same fragmentation as sendFragments(): chunks of kChunkSize bytes, the
+        // last one taking what is left
+        size_t steps = (size < kChunkSize) ? 1 : size / kChunkSize;
+        size_t offset = 0;
+
+        for (size_t i = 0; i < steps; ++i)
+        {
+            bool lastStep = (i + 1) == steps;
+            size_t chunkSize = lastStep ? size - offset : kChunkSize;
+
+            appendFrameHeader(frames,
+                              (i == 0) ? type : wsheader_type::CONTINUATION,
+                              lastStep,
+                              compressed,
+                              chunkSize,
+                              false,
+                              nullptr);
+            frames.insert(frames.end(), data + offset, data + offset + chunkSize);
+            offset += chunkSize;
+        }
+    }
+
+    WebSocketSendInfo WebSocketTransport::sendSharedFrames(
+        const std::shared_ptr<const std::vector<uint8_t>>& frames, size_t payloadSize)
+    {
+        if ((_readyState != ReadyState::OPEN && _readyState != ReadyState::CLOSING) ||
+            _streamingSend)
+        {
+            return WebSocketSendInfo(false);
+        }
+
+        // Shared frames are not masked, a server would close the connection
+        if (_useMask)
+        {
+            return WebSocketSendInfo(false);
+        }
+
+        if (_backpressureEnabled)
+        {
+            BackpressureDecision decision = applyBackpressure(std::string());
+            if (decision == BackpressureDecision::Reject) return WebSocketSendInfo(false);
+
+            // Shared compressed frames do not depend on the previous messages
+            PendingMessage pendingMessage;
+            pendingMessage.sharedFrames = frames;
+            queuePendingMessage(std::move(pendingMessage), decision);
+        }
+        // The frames go through the outbox even without async send, so that
+        // they are written by the poll thread and nothing blocks here
+        else if (_outbox.push(frames))
+        {
+            wakeUpFromPoll(SelectInterrupt::kSendRequest);
+        }
+
+        bool success = true;
+        bool compressionError = false;
+        return WebSocketSendInfo(success, compressionError, payloadSize, frames->size());
+    }
+
+    bool WebSocketTransport::canSendSharedCompressedFrames() const
+    {
+        return _enablePerMessageDeflate && isCompressionContextReset() &&
+               _perMessageDeflateOptions.getClientMaxWindowBits() ==
+                   WebSocketPerMessageDeflateOptions::kDefaultClientMaxWindowBits &&
+               _perMessageDeflateOptions.getServerMaxWindowBits() ==
+                   WebSocketPerMessageDeflateOptions::kDefaultServerMaxWindowBits;
+    }
+
+    bool WebSocketTransport::sendFragmentByReference(const std::vector<uint8_t>& header,
+                                                     const char* payload,
+                                                     size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_txbufMutex);
+            _outbox.drain(_txbuf);
+            _txbuf.append(header.data(), header.size());
+            _txbuf.appendReference(payload, size);
+        }
+
+        bool success = sendOnSocket() && flushSendBuffer();
+
+        // The payload belongs to the caller. If it could not be sent entirely (the flush
+        // can be interrupted by close()), keep a copy of what is left so that the frame
+        // is not cut short in the middle of the stream.
+        std::lock_guard<std::mutex> lock(_txbufMutex);
+        _txbuf.materializeReferences();
+
+        return success;
     }
 
     WebSocketSendInfo WebSocketTransport::sendPing(const IXWebSocketSendData& message)
@@ -1068,40 +2263,90 @@ namespace ix
 
     bool WebSocketTransport::sendOnSocket()
     {
-        std::lock_guard<std::mutex> lock(_txbufMutex);
-
-        while (_txbuf.size())
+        bool lowWatermarkReached = false;
+        size_t bufferedAmount = 0;
         {
-            std::ptrdiff_t ret = 0;
-            {
-                std::lock_guard<std::mutex> lock(_socketMutex);
-                ret = _socket->send((char*) &_txbuf[0], _txbuf.size());
-            }
+            std::lock_guard<std::mutex> lock(_txbufMutex);
+            _outbox.drain(_txbuf);
+            feedSendBuffer(kPendingFeedSize);
 
-            if (ret < 0 && Socket::isWaitNeeded())
-            {
-                break;
-            }
-            else if (ret <= 0)
+            while (!_txbuf.empty())
             {
-                closeSocket();
-                if (_readyState != ReadyState::CLOSING)
+                iovec iov[kMaxSendSegments];
+                int iovcnt = _txbuf.peek(iov, kMaxSendSegments);
+
+                std::ptrdiff_t ret = 0;
                 {
-                    setReadyState(ReadyState::CLOSED);
+                    std::lock_guard<std::mutex> lock(_socketMutex);
+                    if (iovcnt == 1)
+                    {
+                        ret = _socket->send(static_cast<char*>(iov[0].iov_base), iov[0].iov_len);
+                    }
+                    else
+                    {
+                        ret = _socket->sendv(iov, iovcnt);
+                    }
+                }
+
+                if (ret < 0 && Socket::isWaitNeeded())
+                {
+                    break;
+                }
+                else if (ret <= 0)
+                {
+                    closeSocket();
+                    if (_readyState != ReadyState::CLOSING)
+                    {
+                        setReadyState(ReadyState::CLOSED);
+                    }
+                    return false;
+                }
+                else
+                {
+                    _txbuf.consume((size_t) ret);
+                    _sentBytes += (uint64_t) ret;
+                    feedSendBuffer(kPendingFeedSize);
                 }
-                return false;
             }
-            else
+
+            if (_aboveHighWatermark)
             {
-                _txbuf.erase(_txbuf.begin(), _txbuf.begin() + ret);
+                bufferedAmount = getBufferedAmount();
+                if (bufferedAmount <= _backpressureOptions.lowWatermark)
+                {
+                    _aboveHighWatermark = false;
+                    lowWatermarkReached = true;
+                }
             }
         }
 
+        if (lowWatermarkReached)
+        {
+            invokeBackpressureCallback(BackpressureEvent::LowWatermark, bufferedAmount);
+        }
+
         return true;
     }
 
     bool WebSocketTransport::receiveFromSocket()
     {
+        // Drop the frames consumed by dispatch() since the last read, in one go
+        if (_rxbufOffset == _rxbuf.size())
+        {
+            _rxbuf.clear();
+        }
+        else if (_rxbufOffset > 0)
+        {
+            _rxbuf.erase(_rxbuf.begin(), _rxbuf.begin() + _rxbufOffset);
+        }
+        _rxbufOffset = 0;
+        _receivePending = true;
+
+        if (_readbuf.empty())
+        {
+            _readbuf.resize(kChunkSize);
+        }
+
         while (true)
         {
             // If _rxbufWanted isn't set, don't attempt to read more than kChunkSize
@@ -1120,10 +2365,13 @@ namespace ix
 
             if (ret < 0 && Socket::isWaitNeeded())
             {
+                _receivePending = false;
                 break;
             }
             else if (ret <= 0)
             {
+                _receivePending = false;
+
                 // if there are received data pending to be processed, then delay the abnormal
                 // closure to after dispatch (other close code/reason could be read from the
                 // buffer)
@@ -1134,6 +2382,7 @@ namespace ix
             else
             {
                 _rxbuf.insert(_rxbuf.end(), _readbuf.begin(), _readbuf.begin() + ret);
+                _receivedBytes += (uint64_t) ret;
             }
         }
 
@@ -1144,6 +2393,14 @@ namespace ix
     {
         bool compress = false;
 
+        // The messages still waiting to be queued go before the close frame
+        if (_backpressureEnabled)
+        {
+            std::lock_guard<std::mutex> lock(_txbufMutex);
+            _outbox.drain(_txbuf);
+            feedSendBuffer(std::numeric_limits<size_t>::max());
+        }
+
         // if a status is set/was read
         if (code != WebSocketCloseConstants::kNoStatusCodeErrorCode)
         {
@@ -1240,29 +2497,18 @@ namespace ix
     size_t WebSocketTransport::bufferedAmount() const
     {
         std::lock_guard<std::mutex> lock(_txbufMutex);
-        return _txbuf.size();
+        return getBufferedAmount();
     }
 
-    bool WebSocketTransport::flushSendBuffer()
+    bool WebSocketTransport::flushSendBuffer(size_t maxBufferedAmount)
     {
         auto start = std::chrono::steady_clock::now();
 
-        // timeoutMs tracks how long to wait before forcefully
+        // timeoutSecs tracks how long to wait before forcefully
         // closing the socket when sending runs into a timeout.
-        std::chrono::seconds timeoutSecs(0);
-        if (_sendTimeoutSecs > 0)
-        {
-            timeoutSecs = std::chrono::seconds(_sendTimeoutSecs);
-        }
-        else if (_pingIntervalSecs > 0)
-        {
-            // If a pingInterval is set, use it as a timeout because if we cannot
-            // send out any data for pingInterval seconds, we may as well disconnet
-            // the client.
-            timeoutSecs = std::chrono::seconds(_pingIntervalSecs);
-        }
+        std::chrono::seconds timeoutSecs = getSendTimeout();
 
-        while (!isSendBufferEmpty() && !_requestInitCancellation)
+        while (bufferedAmount() > maxBufferedAmount && !_requestInitCancellation)
         {
             // Wait with a 10ms timeout until the socket is ready to write.
             // This way we are not busy looping
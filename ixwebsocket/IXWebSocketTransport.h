@@ -13,15 +13,20 @@
 #include "IXCancellationRequest.h"
 #include "IXProgressCallback.h"
 #include "IXSocketTLSOptions.h"
+#include "IXUtf8Validator.h"
+#include "IXWebSocketBackpressure.h"
 #include "IXWebSocketCloseConstants.h"
 #include "IXWebSocketHandshake.h"
 #include "IXWebSocketHttpHeaders.h"
+#include "IXWebSocketOutbox.h"
 #include "IXWebSocketPerMessageDeflate.h"
 #include "IXWebSocketPerMessageDeflateOptions.h"
 #include "IXWebSocketSendData.h"
 #include "IXWebSocketSendInfo.h"
+#include "IXWebSocketSendQueue.h"
 #include <atomic>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <list>
 #include <memory>
@@ -67,10 +72,16 @@ namespace ix
             CannotFlushSendBuffer
         };
 
-        using OnMessageCallback =
-            std::function<void(const std::string&, size_t, bool, MessageKind)>;
+        // The payload is given by data and size. It points into str, or into the receive
+        // buffer when zero copy delivery is enabled, in which case str is empty.
+        using OnMessageCallback = std::function<void(
+            const std::string& str, const char* data, size_t size, size_t, bool, MessageKind)>;
         using OnCloseCallback = std::function<void(uint16_t, const std::string&, size_t, bool)>;
 
+        // Receives the frames of fragmented messages, decompressed, when streaming them
+        using OnFragmentCallback = std::function<void(
+            const char* data, size_t size, size_t wireSize, bool binary, bool fin)>;
+
         WebSocketTransport();
         ~WebSocketTransport();
 
@@ -89,14 +100,67 @@ namespace ix
                                             int timeoutSecs,
                                             bool enablePerMessageDeflate,
                                             HttpRequestPtr request = nullptr,
-                                            int sendTimeoutSecs = -1);
+                                            int sendTimeoutSecs = -1,
+                                            bool blockingSend = true);
 
         PollResult poll();
+
+        // Event loop mode, where the socket is polled by the caller which reports
+        // its readiness. The timers usually handled by poll() are checked with
+        // checkTimers(), which should run periodically.
+        PollResult poll(bool readyToRead, bool readyToWrite, bool closeRequest);
+        void checkTimers();
+
+        // When checkTimers() needs to run next, time_point::max() when there is nothing
+        // to check. Also restarts the send timeout when the send buffer is empty, and
+        // records the activity of the connection, so it should be called after each poll().
+        std::chrono::time_point<std::chrono::steady_clock> getTimersDeadline(
+            const std::chrono::time_point<std::chrono::steady_clock>& now);
+
+        // True when the last read stopped before the socket was drained
+        bool isReceivePending() const;
+
+        // Bytes read from the socket before the connection was handed to the transport
+        void appendToReceiveBuffer(const char* data, size_t size);
+
         WebSocketSendInfo sendBinary(const IXWebSocketSendData& message,
                                      const OnProgressCallback& onProgressCallback);
         WebSocketSendInfo sendText(const IXWebSocketSendData& message,
                                    const OnProgressCallback& onProgressCallback);
         WebSocketSendInfo sendPing(const IXWebSocketSendData& message);
+        WebSocketSendInfo sendBatch(const IXWebSocketSendData* messages,
+                                    size_t count,
+                                    SendMessageKind sendMessageKind);
+
+        // Queue frames built once with frameServerMessage() and shared with other
+        // connections. Never waits for the socket: the frames are written by the
+        // thread polling this connection. Fails on client connections, whose frames
+        // must be masked.
+        WebSocketSendInfo sendSharedFrames(const std::shared_ptr<const std::vector<uint8_t>>& frames,
+                                           size_t payloadSize);
+
+        // True when messages compressed on their own, with the default window size, can
+        // be sent on this connection: the peer accepts that window size, and the
+        // compressor of the connection resets its context after each message.
+        bool canSendSharedCompressedFrames() const;
+
+        // Frame a message sent by a server (not masked), fragmented like the messages
+        // sent with sendText() and sendBinary(). The frames are appended to frames.
+        static void frameServerMessage(SendMessageKind sendMessageKind,
+                                       const IXWebSocketSendData& payload,
+                                       bool compressed,
+                                       std::vector<uint8_t>& frames);
+
+        // Send a Text or Binary message which replaces the queued message sent with the
+        // same key, when the Conflate backpressure policy applies
+        WebSocketSendInfo sendConflatable(const std::string& key,
+                                          const IXWebSocketSendData& message,
+                                          SendMessageKind sendMessageKind);
+
+        // Send a Text or Binary message progressively, one fragment at a time
+        bool beginMessage(SendMessageKind sendMessageKind);
+        WebSocketSendInfo appendFragment(const IXWebSocketSendData& data);
+        WebSocketSendInfo endMessage();
 
         void close(uint16_t code = WebSocketCloseConstants::kNormalClosureCode,
                    const std::string& reason = WebSocketCloseConstants::kNormalClosureMessage,
@@ -108,12 +172,39 @@ namespace ix
         ReadyState getReadyState() const;
         void setReadyState(ReadyState readyState);
         void setOnCloseCallback(const OnCloseCallback& onCloseCallback);
+
+        // When set, fragmented messages are streamed to that callback frame by frame
+        // instead of being reassembled for the message callback
+        void setOnFragmentCallback(const OnFragmentCallback& onFragmentCallback);
         void dispatch(PollResult pollResult, const OnMessageCallback& onMessageCallback);
         size_t bufferedAmount() const;
 
         // set ping heartbeat message
         void setPingMessage(const std::string& message, SendMessageKind pingType);
 
+        // Deliver uncompressed messages without copying them out of the receive buffer
+        void setZeroCopyDelivery(bool enabled);
+
+        // Frame messages on the sending thread and queue them without locking,
+        // the poll thread writes them to the socket
+        void setAsyncSend(bool enabled);
+        bool isAsyncSendEnabled() const;
+
+        // Bound the amount of data queued for the peer, see WebSocketBackpressureOptions.
+        // With watermarks, sends never wait for the socket unless the Block policy
+        // applies, even for server connections. Set before connecting.
+        void setBackpressureOptions(const WebSocketBackpressureOptions& options);
+        void setOnBackpressureCallback(const OnBackpressureCallback& callback);
+
+        // Release the buffers of a connection which did not send nor receive anything for
+        // idleSecs, and the zlib states when the compression context is reset after each
+        // message. They are allocated again on the next activity. 0 (the default)
+        // disables it. Set before connecting.
+        void setIdleMemoryReclaimDelay(int idleSecs);
+
+        // Approximate number of bytes allocated for the buffers and the zlib states
+        size_t getMemoryUsage() const;
+
         // internal
         // send any type of ping packet, not only 'ping' type
         WebSocketSendInfo sendHeartBeat(SendMessageKind pingType);
@@ -157,7 +248,8 @@ namespace ix
         // and the server stalls on trying to send more data.
         int _sendTimeoutSecs = -1;
 
-        // Buffer for reading from our socket. That buffer is never resized.
+        // Buffer for reading from our socket. That buffer is never resized, it is
+        // allocated by the first read following its release by reclaimIdleMemory().
         std::vector<uint8_t> _readbuf;
 
         // Contains all messages that were fetched in the last socket read.
@@ -165,14 +257,72 @@ namespace ix
         // data messages. That buffer is resized
         std::vector<uint8_t> _rxbuf;
 
+        // Bytes before that offset in _rxbuf were already dispatched. They are
+        // removed in a single erase before the next socket read.
+        size_t _rxbufOffset = 0;
+
         // If set to a positive value, only read bytes from the socket until
         // _rxbuf has reached this size to avoid unnecessary erase churn.
         uint64_t _rxbufWanted = 0;
 
+        // Set when receiveFromSocket() stopped reading because _rxbuf was large enough
+        bool _receivePending = false;
+
         // Contains all messages that are waiting to be sent
-        std::vector<uint8_t> _txbuf;
+        WebSocketSendQueue _txbuf;
         mutable std::mutex _txbufMutex;
 
+        // Unmasked and uncompressed payloads of at least that size are sent by reference
+        static const size_t kSendByReferenceMinSize;
+
+        // Maximum number of queue segments given to a single vectored write
+        static const int kMaxSendSegments;
+
+        // Total number of bytes written to the socket, and the last time checkTimers()
+        // saw that count move or the send buffer empty. Used to detect stalled sends
+        // when nothing blocks in flushSendBuffer().
+        std::atomic<uint64_t> _sentBytes;
+        uint64_t _lastSentBytes;
+        std::chrono::time_point<std::chrono::steady_clock> _lastSendProgressTimePoint;
+
+        // 2 bytes, 8 bytes of extended payload length and the masking key
+        static const size_t kMaxFrameHeaderSize;
+
+        // When async send is enabled, framed messages are pushed here by the sending
+        // threads, and moved to _txbuf (with _txbufMutex held) before writing.
+        WebSocketOutbox _outbox;
+        std::atomic<bool> _asyncSend;
+
+        // With watermarks, the Text and Binary messages are framed by the sending thread
+        // and wait here until _txbuf runs low. They are kept whole, so that they can
+        // still be dropped or replaced. Guarded by _txbufMutex, like the options.
+        struct PendingMessage
+        {
+            std::vector<uint8_t> frames;
+            std::shared_ptr<const std::vector<uint8_t>> sharedFrames;
+            std::string key;
+            bool droppable = true;
+
+            size_t size() const;
+        };
+
+        enum class BackpressureDecision
+        {
+            Queue,
+            Replace,
+            Reject
+        };
+
+        std::atomic<bool> _backpressureEnabled;
+        WebSocketBackpressureOptions _backpressureOptions;
+        OnBackpressureCallback _onBackpressureCallback;
+        std::deque<PendingMessage> _pendingMessages;
+        size_t _pendingSize;
+        bool _aboveHighWatermark;
+
+        // Pending messages are moved to _txbuf while it holds less than that
+        static const size_t kPendingFeedSize;
+
         // Hold fragments for multi-fragments messages in a list. We support receiving very large
         // messages (tested messages up to 700M) and we cannot put them in a single
         // buffer that is resized, as this operation can be slow when a buffer has its
@@ -187,9 +337,38 @@ namespace ix
         // Ditto for whether a message is compressed
         bool _receivedMessageCompressed;
 
+        // The chunks of a fragmented message are decompressed and, for text, validated
+        // as they arrive, so that invalid messages are rejected before being buffered
+        // whole. _chunksWireSize is the size of the message on the wire.
+        size_t _chunksWireSize;
+        bool _chunksDecompressionError;
+
+        // Set while the frames of a fragmented message are streamed to _onFragmentCallback.
+        OnFragmentCallback _onFragmentCallback;
+        bool _streamingFragments;
+
+        // Validates the text of fragmented messages, frame by frame
+        Utf8Validator _fragmentsValidator;
+
+        // When set, uncompressed messages are passed to the message callback as a view
+        // into _rxbuf instead of being copied into a string first.
+        std::atomic<bool> _zeroCopyDelivery;
+
         // Fragments are 32K long
         static constexpr size_t kChunkSize = 1 << 15;
 
+        // Idle connections are detected from the number of bytes sent and received, which
+        // is compared with the last one seen each time the timers are checked, so that
+        // sends and receives do not have to read the clock. Used by the poll thread.
+        std::atomic<int> _idleMemoryReclaimDelaySecs;
+        uint64_t _receivedBytes;
+        uint64_t _lastActivityBytes;
+        std::chrono::time_point<std::chrono::steady_clock> _lastActivityTimePoint;
+        bool _idleMemoryReclaimed;
+
+        // Memory used by the receive path, updated by the poll thread
+        std::atomic<size_t> _receiveMemoryUsage;
+
         // Underlying TCP socket
         std::unique_ptr<Socket> _socket;
         std::mutex _socketMutex;
@@ -213,6 +392,13 @@ namespace ix
 
         std::string _decompressedMessage;
         std::string _compressedMessage;
+        mutable std::mutex _compressedMessageMutex;
+
+        // State of the message sent with beginMessage() / appendFragment() / endMessage().
+        // The opcode becomes CONTINUATION once the first frame has been sent.
+        std::atomic<bool> _streamingSend;
+        wsheader_type::opcode_type _streamingSendOpcode;
+        bool _streamingSendCompressed;
 
         // Used to control TLS connection behavior
         SocketTLSOptions _socketTLSOptions;
@@ -244,12 +430,27 @@ namespace ix
         std::chrono::time_point<std::chrono::steady_clock> _lastSendPingTimePoint;
 
         // If this function returns true, it is time to send a new ping
-        bool pingIntervalExceeded();
+        bool pingIntervalExceeded(const std::chrono::time_point<std::chrono::steady_clock>& now);
+        std::chrono::time_point<std::chrono::steady_clock> getNextPingTimePoint() const;
         void initTimePointsAfterConnect();
+        void checkPingInterval(const std::chrono::time_point<std::chrono::steady_clock>& now);
 
         // after calling close(), if no CLOSE frame answer is received back from the remote, we
         // should close the connexion
-        bool closingDelayExceeded();
+        bool closingDelayExceeded(const std::chrono::time_point<std::chrono::steady_clock>& now);
+        std::chrono::time_point<std::chrono::steady_clock> getClosingDeadline() const;
+        void checkClosingDelay(const std::chrono::time_point<std::chrono::steady_clock>& now);
+
+        // Close the connection when no data could be sent for the send timeout
+        void checkSendTimeout(const std::chrono::time_point<std::chrono::steady_clock>& now);
+        std::chrono::seconds getSendTimeout() const;
+
+        // Release the memory of the connection once it has been idle for the reclaim delay
+        std::chrono::time_point<std::chrono::steady_clock> getIdleMemoryReclaimDeadline(
+            const std::chrono::time_point<std::chrono::steady_clock>& now);
+        void checkIdleMemory(const std::chrono::time_point<std::chrono::steady_clock>& now);
+        void reclaimIdleMemory();
+        void updateReceiveMemoryUsage();
 
         void sendCloseFrame(uint16_t code, const std::string& reason);
 
@@ -260,7 +461,8 @@ namespace ix
 
         bool wakeUpFromPoll(uint64_t wakeUpCode);
 
-        bool flushSendBuffer();
+        // Returns once no more than maxBufferedAmount bytes are left to send
+        bool flushSendBuffer(size_t maxBufferedAmount = 0);
         bool sendOnSocket();
         bool receiveFromSocket();
 
@@ -269,15 +471,85 @@ namespace ix
                                    bool compress,
                                    const OnProgressCallback& onProgressCallback = nullptr);
 
+        WebSocketSendInfo sendBatch(wsheader_type::opcode_type type,
+                                    const IXWebSocketSendData* messages,
+                                    size_t count,
+                                    bool compress);
+
+        // Lock the compressor, when compress is set. The lock is held until the frames
+        // are queued, so that messages are queued in the order they were compressed.
+        std::unique_lock<std::mutex> lockCompressor(bool compress);
+
+        // Frame a message, and either send it or append it to frames. When compress is
+        // set, the caller holds the lock returned by lockCompressor().
+        WebSocketSendInfo sendFragments(wsheader_type::opcode_type type,
+                                        const IXWebSocketSendData& message,
+                                        bool compress,
+                                        const OnProgressCallback& onProgressCallback,
+                                        std::vector<uint8_t>* frames = nullptr);
+
+        WebSocketSendInfo sendStreamingFragment(const IXWebSocketSendData& data, bool fin);
+
+        // Push frames to the outbox, and wake up the poll thread if needed
+        void queueFrames(std::vector<uint8_t>&& frames);
+
+        // Frame a Text or Binary message and queue it as a pending message, once the
+        // backpressure policy accepted it
+        WebSocketSendInfo sendPendingMessage(wsheader_type::opcode_type type,
+                                             const IXWebSocketSendData& message,
+                                             bool compress,
+                                             const OnProgressCallback& onProgressCallback,
+                                             const std::string& key);
+
+        // Apply the policy when the high watermark is reached. May wait (Block) or
+        // close the connection (Disconnect).
+        BackpressureDecision applyBackpressure(const std::string& key);
+        void queuePendingMessage(PendingMessage&& message, BackpressureDecision decision);
+
+        // All the following must be called with _txbufMutex held
+        size_t getBufferedAmount() const;
+        void feedSendBuffer(size_t maxSize);
+        void dropOldestPendingMessages();
+        std::deque<PendingMessage>::iterator findPendingMessage(const std::string& key);
+
+        void invokeBackpressureCallback(BackpressureEvent event, size_t bufferedAmount);
+
+        // True when the compressor starts every message from an empty context
+        bool isCompressionContextReset() const;
+
+        // True when the compressor of the peer is known to start every message from an
+        // empty context, so that the decompressor does not need to keep its window
+        bool isPeerCompressionContextReset() const;
+
+        // Wake up the poll thread if there is data left to send, or flush it
+        // right away in blocking mode
+        bool requestSendBufferFlush();
+
+        // When frames is not null, the fragment is appended to it instead of _txbuf
         template<class Iterator>
-        bool sendFragment(
-            wsheader_type::opcode_type type, bool fin, Iterator begin, Iterator end, bool compress);
+        bool sendFragment(wsheader_type::opcode_type type,
+                          bool fin,
+                          Iterator begin,
+                          Iterator end,
+                          bool compress,
+                          std::vector<uint8_t>* frames);
+
+        bool sendFragmentByReference(const std::vector<uint8_t>& header,
+                                     const char* payload,
+                                     size_t size);
 
         void emitMessage(MessageKind messageKind,
                          const std::string& message,
                          bool compressedMessage,
                          const OnMessageCallback& onMessageCallback);
 
+        // Emit an uncompressed message from a view into the receive buffer, or from a copy
+        // of it when zero copy delivery is disabled.
+        void emitMessage(MessageKind messageKind,
+                         const char* data,
+                         size_t size,
+                         const OnMessageCallback& onMessageCallback);
+
         bool isSendBufferEmpty() const;
 
         template<class Iterator>
@@ -290,8 +562,22 @@ namespace ix
         unsigned getRandomUnsigned();
         void unmaskReceiveBuffer(const wsheader_type& ws);
 
+        // Append the header of a frame with a payload of size bytes to header. The
+        // masking key is only written when mask is set.
+        static void appendFrameHeader(std::vector<uint8_t>& header,
+                                      wsheader_type::opcode_type type,
+                                      bool fin,
+                                      bool compressed,
+                                      uint64_t size,
+                                      bool mask,
+                                      const uint8_t maskingKey[4]);
+
         std::string getMergedChunks() const;
 
+        // Both return false if the connection was closed because of an invalid frame
+        bool appendChunk(const char* data, size_t size, bool fin);
+        bool emitFragment(const char* data, size_t size, bool fin);
+
         void setCloseReason(const std::string& reason);
         const std::string& getCloseReason() const;
     };
@@ -0,0 +1,233 @@
+/*
+ *  IXHttpSendFileTest.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include <atomic>
+#include <catch_amalgamated.hpp>
+#include <cstdio>
+#include <fstream>
+#include <ixwebsocket/IXHttpClient.h>
+#include <ixwebsocket/IXHttpServer.h>
+#include <ixwebsocket/IXSocket.h>
+#include <ixwebsocket/IXSocketFactory.h>
+#include <thread>
+
+using namespace ix;
+
+namespace
+{
+    const std::string kFileName = "sendfile-test.bin";
+
+    // Larger than a socket buffer and than a TLS record, not a multiple of either
+    std::string makeFileContent()
+    {
+        std::string content;
+        for (int i = 0; content.size() < 3 * 1024 * 1024 + 17; ++i)
+        {
+            content += "line " + std::to_string(i) + "\n";
+        }
+        return content;
+    }
+
+    bool writeFile(const std::string& path, const std::string& content)
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << content;
+        return (bool) out;
+    }
+
+    // Peer verification is not what is being tested here
+    SocketTLSOptions makeTLSOptions(bool server, bool enableKernelTLS)
+    {
+        SocketTLSOptions tlsOptions = server ? makeServerTLSOptions(true) : SocketTLSOptions();
+        tlsOptions.caFile = "NONE";
+        tlsOptions.enable_ktls = enableKernelTLS;
+        return tlsOptions;
+    }
+
+    // With compress, the server reads the file and compresses it in memory instead
+    // of sending it from the file
+    HttpResponsePtr download(HttpClient& httpClient,
+                             const std::string& url,
+                             bool compress = false)
+    {
+        auto args = httpClient.createRequest(url);
+        args->connectTimeout = 10;
+        args->transferTimeout = 60;
+        args->compress = compress;
+
+        return httpClient.get(url, args);
+    }
+} // namespace
+
+TEST_CASE("http_send_file", "[httpd]")
+{
+    const std::string content = makeFileContent();
+    REQUIRE(writeFile(kFileName, content));
+
+    SECTION("Static files are sent from the file")
+    {
+        int port = getFreePort();
+        HttpServer server(port, "127.0.0.1");
+        REQUIRE(startTestServer(server));
+
+        HttpClient httpClient;
+        std::string url = "http://127.0.0.1:" + std::to_string(port) + "/";
+        auto response = download(httpClient, url + kFileName);
+        REQUIRE(response->errorCode == HttpErrorCode::Ok);
+        REQUIRE(response->statusCode == 200);
+        REQUIRE(response->headers["Content-Encoding"].empty());
+        REQUIRE(response->body == content);
+
+        response = download(httpClient, url + "missing.bin");
+        REQUIRE(response->statusCode == 404);
+
+        server.stop();
+    }
+
+    SECTION("Directories are not found")
+    {
+        int port = getFreePort();
+        HttpServer server(port, "127.0.0.1");
+        REQUIRE(startTestServer(server));
+
+        HttpClient httpClient;
+        std::string url = "http://127.0.0.1:" + std::to_string(port) + "/";
+        auto response = download(httpClient, url + ".certs");
+        REQUIRE(response->statusCode == 404);
+
+        response = download(httpClient, url + ".");
+        REQUIRE(response->statusCode == 404);
+
+        server.stop();
+    }
+
+    SECTION("Files removed before they are sent are server errors")
+    {
+        int port = getFreePort();
+        HttpServer server(port, "127.0.0.1");
+        server.setOnConnectionCallback(
+            [](HttpRequestPtr, std::shared_ptr<ConnectionState>) -> HttpResponsePtr
+            {
+                auto response = std::make_shared<HttpResponse>(200, "OK");
+                response->bodyFile = "removed-before-send.bin";
+                return response;
+            });
+        REQUIRE(startTestServer(server));
+
+        HttpClient httpClient;
+        std::string url = "http://127.0.0.1:" + std::to_string(port) + "/" + kFileName;
+        auto response = download(httpClient, url);
+        REQUIRE(response->errorCode == HttpErrorCode::Ok);
+        REQUIRE(response->statusCode == 500);
+
+        server.stop();
+    }
+
+#ifdef IXWEBSOCKET_USE_ZLIB
+    SECTION("Files removed while they are served compressed are not sent empty")
+    {
+        int port = getFreePort();
+        HttpServer server(port, "127.0.0.1");
+        REQUIRE(startTestServer(server));
+
+        // Requests race with the removal of the file. The file is replaced atomically,
+        // it is either complete or missing.
+        const std::string fileName = "removed-while-compressed.txt";
+        const std::string tmpFileName = fileName + ".tmp";
+        const std::string smallContent = "compressed content\n";
+        std::atomic<bool> running(true);
+        std::thread remover(
+            [&]
+            {
+                while (running)
+                {
+                    writeFile(tmpFileName, smallContent);
+                    std::rename(tmpFileName.c_str(), fileName.c_str());
+                    std::remove(fileName.c_str());
+                }
+            });
+
+        HttpClient httpClient;
+        std::string url = "http://127.0.0.1:" + std::to_string(port) + "/" + fileName;
+        bool valid = true;
+        for (int i = 0; i < 500; ++i)
+        {
+            bool compress = true;
+            auto response = download(httpClient, url, compress);
+            bool sent = response->statusCode == 200 && response->body == smallContent;
+            valid &= sent || response->statusCode == 404 || response->statusCode == 500;
+        }
+
+        running = false;
+        remover.join();
+        std::remove(tmpFileName.c_str());
+        std::remove(fileName.c_str());
+
+        REQUIRE(valid);
+
+        server.stop();
+    }
+#endif
+
+#if defined(IXWEBSOCKET_USE_OPEN_SSL) || defined(IXWEBSOCKET_USE_MBED_TLS)
+    SECTION("Static files are sent over TLS, by the kernel when it can")
+    {
+        int port = getFreePort();
+        HttpServer server(port, "127.0.0.1");
+        server.setTLSOptions(makeTLSOptions(true, true));
+        REQUIRE(startTestServer(server));
+
+        HttpClient httpClient;
+        httpClient.setTLSOptions(makeTLSOptions(false, true));
+        std::string url = "https://localhost:" + std::to_string(port) + "/" + kFileName;
+        auto response = download(httpClient, url);
+        REQUIRE(response->errorCode == HttpErrorCode::Ok);
+        REQUIRE(response->statusCode == 200);
+        REQUIRE(response->body == content);
+
+        server.stop();
+    }
+
+    SECTION("Kernel TLS is reported per connection")
+    {
+        int port = getFreePort();
+        HttpServer server(port, "127.0.0.1");
+        server.setTLSOptions(makeTLSOptions(true, true));
+        REQUIRE(startTestServer(server));
+
+        for (bool enableKernelTLS : {false, true})
+        {
+            std::string errorMsg;
+            auto socket = createSocket(true, -1, errorMsg, makeTLSOptions(false, enableKernelTLS));
+            REQUIRE(socket);
+
+            auto isCancellationRequested = []() -> bool { return false; };
+            REQUIRE(socket->connect("localhost", port, errorMsg, isCancellationRequested));
+
+            // Available when the kernel has the tls module, and supports the cipher
+            bool active = socket->isKernelTLSActive();
+            TLogger() << "kTLS " << (enableKernelTLS ? "enabled" : "disabled") << ", "
+                      << (active ? "active" : "not active");
+            if (!enableKernelTLS) REQUIRE(!active);
+
+            // Sent by the kernel or by OpenSSL, the request is the same
+            std::string request = "GET /" + kFileName + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+            REQUIRE(socket->writeBytes(request, isCancellationRequested));
+
+            auto line = socket->readLine(isCancellationRequested);
+            REQUIRE(line.first);
+            REQUIRE(line.second == "HTTP/1.1 200 OK\r\n");
+
+            socket->close();
+        }
+
+        server.stop();
+    }
+#endif
+
+    std::remove(kFileName.c_str());
+}
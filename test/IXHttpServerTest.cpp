@@ -4,11 +4,18 @@
  *  Copyright (c) 2019 Machine Zone. All rights reserved.
  */
 
+#include "IXTest.h"
 #include <catch_amalgamated.hpp>
+#include <condition_variable>
 #include <iostream>
 #include <ixwebsocket/IXGetFreePort.h>
 #include <ixwebsocket/IXHttpClient.h>
 #include <ixwebsocket/IXHttpServer.h>
+#include <ixwebsocket/IXSocketFactory.h>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
 
 using namespace ix;
 
@@ -112,6 +119,111 @@ TEST_CASE("http server", "[httpd]")
 
         server.stop();
     }
+
+    SECTION("Requests are served by a pool of worker threads")
+    {
+        int port = getFreePort();
+        ix::HttpServer server(port, "127.0.0.1");
+        REQUIRE(server.enableWorkerPool(4, 256 * 1024));
+
+        std::mutex mutex;
+        std::set<std::thread::id> threadIds;
+        server.setOnConnectionCallback(
+            [&mutex, &threadIds](HttpRequestPtr request,
+                                 std::shared_ptr<ConnectionState>) -> HttpResponsePtr {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    threadIds.insert(std::this_thread::get_id());
+                }
+                return std::make_shared<HttpResponse>(
+                    200, "OK", HttpErrorCode::Ok, WebSocketHttpHeaders(), request->body);
+            });
+
+        auto res = server.listen();
+        REQUIRE(res.first);
+        server.start();
+
+        HttpClient httpClient;
+        std::string url("http://127.0.0.1:");
+        url += std::to_string(port);
+        auto args = httpClient.createRequest(url);
+        args->connectTimeout = 60;
+        args->transferTimeout = 60;
+
+        for (int i = 0; i < 40; ++i)
+        {
+            std::string body = "request " + std::to_string(i);
+            auto response = httpClient.post(url, body, args);
+
+            REQUIRE(response->errorCode == HttpErrorCode::Ok);
+            REQUIRE(response->statusCode == 200);
+            REQUIRE(response->body == body);
+        }
+
+        server.stop();
+
+        // Each connection ran on one of the pre-spawned threads
+        REQUIRE(!threadIds.empty());
+        REQUIRE(threadIds.size() <= 4);
+    }
+
+    SECTION("Connections waiting for a worker count against the max connections")
+    {
+        int port = getFreePort();
+        size_t maxConnections = 2;
+        ix::HttpServer server(port, "127.0.0.1", SocketServer::kDefaultTcpBacklog, maxConnections);
+        REQUIRE(server.enableWorkerPool(1));
+
+        // The only worker is held by the first request until released
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool released = false;
+        server.setOnConnectionCallback(
+            [&](HttpRequestPtr request, std::shared_ptr<ConnectionState>) -> HttpResponsePtr
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&released] { return released; });
+                return std::make_shared<HttpResponse>(
+                    200, "OK", HttpErrorCode::Ok, WebSocketHttpHeaders(), request->body);
+            });
+
+        auto res = server.listen();
+        REQUIRE(res.first);
+        server.start();
+
+        auto isCancellationRequested = []() -> bool { return false; };
+        std::vector<std::unique_ptr<Socket>> sockets;
+        for (int i = 0; i < 5; ++i)
+        {
+            std::string errMsg;
+            SocketTLSOptions tlsOptions;
+            auto socket = createSocket(false, -1, errMsg, tlsOptions);
+            REQUIRE(socket->connect("127.0.0.1", port, errMsg, isCancellationRequested));
+            REQUIRE(socket->writeBytes("GET / HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n",
+                                       isCancellationRequested));
+            sockets.push_back(std::move(socket));
+
+            // Accepted in order: one handled, two queued, two refused
+            ix::msleep(100);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            released = true;
+        }
+        condition.notify_all();
+
+        int served = 0;
+        for (auto&& socket : sockets)
+        {
+            auto line = socket->readLine(isCancellationRequested);
+            if (line.first && line.second == "HTTP/1.1 200 OK\r\n") ++served;
+            socket->close();
+        }
+        REQUIRE(served == 1 + (int) maxConnections);
+
+        server.stop();
+    }
 }
 
 TEST_CASE("http server redirection", "[httpd_redirect]")
@@ -0,0 +1,150 @@
+/*
+ *  IXSocketTLSSessionCacheTest.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include <atomic>
+#include <catch_amalgamated.hpp>
+#include <ixwebsocket/IXSocket.h>
+#include <ixwebsocket/IXSocketFactory.h>
+#include <ixwebsocket/IXSocketTLSSessionCache.h>
+#include <ixwebsocket/IXWebSocket.h>
+#include <ixwebsocket/IXWebSocketServer.h>
+
+using namespace ix;
+
+namespace
+{
+    // Peer verification is not what is being tested here
+    SocketTLSOptions makeClientOptions()
+    {
+        SocketTLSOptions tlsOptions;
+        tlsOptions.caFile = "NONE";
+        return tlsOptions;
+    }
+
+    bool startServer(WebSocketServer& server)
+    {
+        SocketTLSOptions tlsOptions = makeServerTLSOptions(true);
+        tlsOptions.caFile = "NONE";
+        server.setTLSOptions(tlsOptions);
+        return startSelfEchoServer(server);
+    }
+
+    // Connect with a WebSocket, which reads the tickets sent after the handshake
+    bool connectWebSocket(int port)
+    {
+        WebSocket webSocket;
+        webSocket.setUrl("wss://localhost:" + std::to_string(port) + "/");
+        webSocket.setTLSOptions(makeClientOptions());
+        webSocket.disableAutomaticReconnection();
+
+        std::atomic<bool> open(false);
+        webSocket.setOnMessageCallback(
+            [&open](const WebSocketMessagePtr& msg)
+            {
+                if (msg->type == WebSocketMessageType::Open) open = true;
+            });
+        webSocket.start();
+
+        bool connected = waitFor([&open] { return open.load(); });
+        webSocket.stop();
+        return connected;
+    }
+
+    // Returns whether the handshake resumed a session, -1 when it failed
+    int connectSocket(int port, const SocketTLSOptions& tlsOptions)
+    {
+        std::string errorMsg;
+        auto socket = createSocket(true, -1, errorMsg, tlsOptions);
+        if (!socket) return -1;
+
+        auto isCancellationRequested = []() -> bool { return false; };
+        if (!socket->connect("localhost", port, errorMsg, isCancellationRequested))
+        {
+            TLogger() << errorMsg;
+            return -1;
+        }
+
+        int resumed = socket->isSessionResumed() ? 1 : 0;
+        socket->close();
+        return resumed;
+    }
+} // namespace
+
+TEST_CASE("tls_session_cache", "[tls]")
+{
+    SECTION("Sessions are replaced and evicted")
+    {
+        SocketTLSSessionCache cache(2);
+        std::string session;
+        REQUIRE(!cache.get("a", session));
+
+        cache.put("a", "session a");
+        cache.put("b", "session b");
+        cache.put("a", "session a2");
+        REQUIRE(cache.size() == 2);
+        REQUIRE(cache.get("a", session));
+        REQUIRE(session == "session a2");
+
+        // b is the least recently used
+        cache.put("c", "session c");
+        REQUIRE(cache.size() == 2);
+        REQUIRE(!cache.get("b", session));
+        REQUIRE(cache.get("a", session));
+        REQUIRE(cache.get("c", session));
+        REQUIRE(session == "session c");
+
+        cache.remove("a");
+        REQUIRE(!cache.get("a", session));
+        cache.clear();
+        REQUIRE(cache.size() == 0);
+    }
+
+    SECTION("Sessions are not shared between different peer verifications")
+    {
+        SocketTLSOptions verified;
+        SocketTLSOptions unverified;
+        unverified.caFile = "NONE";
+        SocketTLSOptions noHostname;
+        noHostname.disable_hostname_validation = true;
+
+        std::string key = SocketTLSSessionCache::makeKey("localhost", 8008, verified);
+        REQUIRE(key == SocketTLSSessionCache::makeKey("localhost", 8008, verified));
+        REQUIRE(key != SocketTLSSessionCache::makeKey("localhost", 8009, verified));
+        REQUIRE(key != SocketTLSSessionCache::makeKey("127.0.0.1", 8008, verified));
+        REQUIRE(key != SocketTLSSessionCache::makeKey("localhost", 8008, unverified));
+        REQUIRE(key != SocketTLSSessionCache::makeKey("localhost", 8008, noHostname));
+    }
+
+#if defined(IXWEBSOCKET_USE_OPEN_SSL)
+    SECTION("Reconnecting clients resume their session")
+    {
+        auto& cache = SocketTLSSessionCache::getClientCache();
+        cache.clear();
+
+        int port = getFreePort();
+        WebSocketServer server(port, "127.0.0.1");
+        REQUIRE(startServer(server));
+
+        REQUIRE(connectWebSocket(port));
+        REQUIRE(cache.size() == 1);
+
+        REQUIRE(connectSocket(port, makeClientOptions()) == 1);
+        REQUIRE(connectSocket(port, makeClientOptions()) == 1);
+
+        SocketTLSOptions disabled = makeClientOptions();
+        disabled.disable_session_resumption = true;
+        REQUIRE(connectSocket(port, disabled) == 0);
+
+        // The new context does not know the previous sessions, a full handshake is done
+        REQUIRE(server.reloadTLSContext().first);
+        REQUIRE(connectSocket(port, makeClientOptions()) == 0);
+
+        server.stop();
+        cache.clear();
+    }
+#endif
+}
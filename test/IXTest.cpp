@@ -55,6 +55,16 @@ namespace ix
         std::this_thread::sleep_for(duration);
     }
 
+    bool waitFor(const std::function<bool()>& condition, int timeoutMs)
+    {
+        for (int elapsed = 0; elapsed < timeoutMs; elapsed += 10)
+        {
+            if (condition()) return true;
+            msleep(10);
+        }
+        return condition();
+    }
+
     std::string generateSessionId()
     {
         auto now = std::chrono::system_clock::now();
@@ -117,6 +127,11 @@ namespace ix
                 }
             });
 
+        return startTestServer(server);
+    }
+
+    bool startTestServer(SocketServer& server)
+    {
         auto res = server.listen();
         if (!res.first)
         {
@@ -128,6 +143,54 @@ namespace ix
         return true;
     }
 
+    bool startSelfEchoServer(WebSocketServer& server,
+                             const std::function<void(WebSocket&)>& configure,
+                             const OnMessageCallback& onMessage)
+    {
+        server.setOnConnectionCallback(
+            [configure, onMessage](std::weak_ptr<WebSocket> webSocket,
+                                   std::shared_ptr<ConnectionState> /*connectionState*/)
+            {
+                auto ws = webSocket.lock();
+                if (!ws) return;
+
+                if (configure) configure(*ws);
+                ws->setOnMessageCallback(
+                    [webSocket, onMessage](const WebSocketMessagePtr& msg)
+                    {
+                        if (onMessage) onMessage(msg);
+                        if (msg->type != WebSocketMessageType::Message) return;
+
+                        auto ws = webSocket.lock();
+                        if (!ws) return;
+
+                        IXWebSocketSendData payload(msg->data(), msg->size());
+                        if (msg->binary)
+                        {
+                            ws->sendBinary(payload);
+                        }
+                        else
+                        {
+                            ws->sendUtf8Text(payload);
+                        }
+                    });
+            });
+
+        return startTestServer(server);
+    }
+
+    std::shared_ptr<WebSocket> getSingleClient(WebSocketServer& server)
+    {
+        if (!waitFor([&] { return server.getClients().size() == 1; })) return nullptr;
+
+        auto webSocket = *server.getClients().begin();
+        if (!waitFor([&] { return webSocket->getReadyState() == ReadyState::Open; }))
+        {
+            return nullptr;
+        }
+        return webSocket;
+    }
+
     std::vector<uint8_t> load(const std::string& path)
     {
         std::vector<uint8_t> memblock;
@@ -207,4 +270,99 @@ namespace ix
 #endif
         return scheme;
     }
+
+    TestWebSocketClient::TestWebSocketClient(const std::string& url)
+        : _open(false)
+        , _closed(false)
+        , _error(false)
+    {
+        _webSocket.setUrl(url);
+        _webSocket.disableAutomaticReconnection();
+        _webSocket.setOnMessageCallback(
+            [this](const WebSocketMessagePtr& msg)
+            {
+                if (msg->type == WebSocketMessageType::Open)
+                {
+                    _open = true;
+                }
+                else if (msg->type == WebSocketMessageType::Close)
+                {
+                    _closed = true;
+                }
+                else if (msg->type == WebSocketMessageType::Error)
+                {
+                    _error = true;
+                }
+                else if (msg->type == WebSocketMessageType::Message)
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _received.push_back(msg->str);
+                    _wireSizes.push_back(msg->wireSize);
+                }
+            });
+    }
+
+    TestWebSocketClient::~TestWebSocketClient()
+    {
+        _webSocket.stop();
+    }
+
+    void TestWebSocketClient::start()
+    {
+        _webSocket.start();
+    }
+
+    void TestWebSocketClient::stop()
+    {
+        _webSocket.stop();
+    }
+
+    bool TestWebSocketClient::waitForOpen()
+    {
+        waitFor([this] { return _open || _error; });
+        return _open;
+    }
+
+    bool TestWebSocketClient::isOpen() const
+    {
+        return _open;
+    }
+
+    bool TestWebSocketClient::isClosed() const
+    {
+        return _closed;
+    }
+
+    bool TestWebSocketClient::echo(const std::string& text)
+    {
+        size_t count = getReceivedCount();
+        if (!_webSocket.sendText(text).success) return false;
+        if (!waitFor([&] { return getReceivedCount() > count; })) return false;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _received[count] == text;
+    }
+
+    std::vector<std::string> TestWebSocketClient::getReceived()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _received;
+    }
+
+    std::vector<size_t> TestWebSocketClient::getWireSizes()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _wireSizes;
+    }
+
+    WebSocket& TestWebSocketClient::getWebSocket()
+    {
+        return _webSocket;
+    }
+
+    size_t TestWebSocketClient::getReceivedCount()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _received.size();
+    }
 } // namespace ix
@@ -6,10 +6,13 @@
 
 #pragma once
 
+#include <atomic>
 #include <common/IXLog.h>
+#include <functional>
 #include <iostream>
 #include <ixwebsocket/IXGetFreePort.h>
 #include <ixwebsocket/IXSocketTLSOptions.h>
+#include <ixwebsocket/IXWebSocket.h>
 #include <ixwebsocket/IXWebSocketServer.h>
 #include <mutex>
 #include <sstream>
@@ -24,6 +27,9 @@ namespace ix
     // Generate a relatively random string
     std::string generateSessionId();
 
+    // Poll condition every 10ms, returns whether it became true before the timeout
+    bool waitFor(const std::function<bool()>& condition, int timeoutMs = 10000);
+
     // Record and report websocket traffic
     void setupWebSocketTrafficTrackerCallback();
     void reportWebSocketTraffic();
@@ -50,8 +56,59 @@ namespace ix
 
     bool startWebSocketEchoServer(ix::WebSocketServer& server);
 
+    // Listen and start the server, logs why it could not listen
+    bool startTestServer(SocketServer& server);
+
+    // Every connection sends the messages it receives back to its peer, from the receive
+    // buffer so that zero copy delivery can be enabled. configure is called with each new
+    // connection, and onMessage with every message before it is sent back.
+    bool startSelfEchoServer(WebSocketServer& server,
+                             const std::function<void(WebSocket&)>& configure = nullptr,
+                             const OnMessageCallback& onMessage = nullptr);
+
+    // The connection of the only client of the server once it is open, nullptr when it
+    // did not show up before the timeout
+    std::shared_ptr<WebSocket> getSingleClient(WebSocketServer& server);
+
     SocketTLSOptions makeClientTLSOptions();
     SocketTLSOptions makeServerTLSOptions(bool preferTLS);
     std::string getHttpScheme();
     std::string getWsScheme(bool preferTLS);
+
+    // A client recording the messages it receives. The WebSocket can be configured
+    // with getWebSocket() before start().
+    class TestWebSocketClient
+    {
+    public:
+        explicit TestWebSocketClient(const std::string& url);
+        ~TestWebSocketClient();
+
+        void start();
+        void stop();
+
+        // Returns true once the connection is open, false when it failed or timed out
+        bool waitForOpen();
+
+        bool isOpen() const;
+        bool isClosed() const;
+
+        // Send a text message, and wait for the server to send it back
+        bool echo(const std::string& text);
+
+        std::vector<std::string> getReceived();
+        std::vector<size_t> getWireSizes();
+
+        WebSocket& getWebSocket();
+
+    private:
+        size_t getReceivedCount();
+
+        WebSocket _webSocket;
+        std::atomic<bool> _open;
+        std::atomic<bool> _closed;
+        std::atomic<bool> _error;
+        std::mutex _mutex;
+        std::vector<std::string> _received;
+        std::vector<size_t> _wireSizes;
+    };
 } // namespace ix
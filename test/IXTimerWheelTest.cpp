@@ -0,0 +1,187 @@
+/*
+ *  IXTimerWheelTest.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone. All rights reserved.
+ */
+
+#include <catch_amalgamated.hpp>
+#include <ixwebsocket/IXTimerWheel.h>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace ix;
+
+namespace
+{
+    using Clock = TimerWheel::Clock;
+    using TimePoint = TimerWheel::TimePoint;
+
+    struct TestTimer
+    {
+        TimerWheel::Timer timer;
+        TimePoint deadline;
+        TimePoint firedAt;
+        int fired = 0;
+    };
+} // namespace
+
+TEST_CASE("timer_wheel", "[timer]")
+{
+    const std::chrono::milliseconds resolution(10);
+    const TimePoint origin = Clock::now();
+
+    SECTION("Timers fire once their deadline passed")
+    {
+        TimerWheel wheel(resolution, origin);
+        REQUIRE(wheel.getTimeoutMs(origin) == -1);
+
+        TestTimer a, b;
+        int order = 0;
+        a.timer.setCallback([&] { a.fired = ++order; });
+        b.timer.setCallback([&] { b.fired = ++order; });
+
+        wheel.schedule(b.timer, origin + std::chrono::milliseconds(45));
+        wheel.schedule(a.timer, origin + std::chrono::milliseconds(25));
+        REQUIRE(wheel.size() == 2);
+
+        // Deadlines are rounded up to the tick
+        REQUIRE(wheel.getTimeoutMs(origin) == 30);
+        REQUIRE(wheel.advance(origin + std::chrono::milliseconds(29)) == 0);
+        REQUIRE(wheel.advance(origin + std::chrono::milliseconds(30)) == 1);
+        REQUIRE(a.fired == 1);
+        REQUIRE(!a.timer.isScheduled());
+
+        REQUIRE(wheel.advance(origin + std::chrono::milliseconds(100)) == 1);
+        REQUIRE(b.fired == 2);
+        REQUIRE(wheel.size() == 0);
+        REQUIRE(wheel.getTimeoutMs(origin) == -1);
+    }
+
+    SECTION("Timers expiring in the same tick fire together")
+    {
+        TimerWheel wheel(resolution, origin);
+
+        const int count = 100 * 1000;
+        std::vector<std::unique_ptr<TestTimer>> timers;
+        int fired = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            timers.emplace_back(new TestTimer);
+            timers.back()->timer.setCallback([&fired] { fired++; });
+
+            // Spread over a single tick, 30 seconds away
+            auto deadline =
+                origin + std::chrono::seconds(30) + std::chrono::microseconds(1 + i % 9999);
+            wheel.schedule(timers.back()->timer, deadline);
+        }
+        REQUIRE(wheel.size() == (size_t) count);
+
+        // Until then, the wheel only wakes up to move the timers down its levels
+        TimePoint now = origin;
+        int wakeUps = 0;
+        while (fired == 0)
+        {
+            now += std::chrono::milliseconds(wheel.getTimeoutMs(now));
+            wheel.advance(now);
+            wakeUps++;
+        }
+        REQUIRE(fired == count);
+        REQUIRE(wakeUps < 100);
+        REQUIRE(now - origin <= std::chrono::seconds(30) + resolution);
+    }
+
+    SECTION("Timers can be rescheduled and cancelled")
+    {
+        TimerWheel wheel(resolution, origin);
+
+        TestTimer a, b;
+        a.timer.setCallback([&] { a.fired++; });
+        b.timer.setCallback([&] { b.fired++; });
+
+        wheel.schedule(a.timer, origin + std::chrono::seconds(10));
+        wheel.schedule(b.timer, origin + std::chrono::seconds(10));
+        wheel.schedule(a.timer, origin + std::chrono::milliseconds(50));
+        b.timer.cancel();
+        REQUIRE(wheel.size() == 1);
+
+        wheel.advance(origin + std::chrono::seconds(20));
+        REQUIRE(a.fired == 1);
+        REQUIRE(b.fired == 0);
+
+        // Deadlines already passed expire with the next tick
+        wheel.schedule(b.timer, origin);
+        REQUIRE(wheel.advance(origin + std::chrono::seconds(20)) == 0);
+        REQUIRE(wheel.advance(origin + std::chrono::seconds(20) + resolution) == 1);
+        REQUIRE(b.fired == 1);
+
+        // Destroyed timers leave the wheel
+        {
+            TestTimer c;
+            wheel.schedule(c.timer, origin + std::chrono::seconds(30));
+            REQUIRE(wheel.size() == 1);
+        }
+        REQUIRE(wheel.size() == 0);
+    }
+
+    SECTION("Callbacks can reschedule their timer")
+    {
+        TimerWheel wheel(resolution, origin);
+
+        TestTimer heartbeat;
+        TimePoint now = origin;
+        heartbeat.timer.setCallback(
+            [&]
+            {
+                heartbeat.fired++;
+                wheel.schedule(heartbeat.timer, now + std::chrono::seconds(1));
+            });
+        wheel.schedule(heartbeat.timer, origin + std::chrono::seconds(1));
+
+        while (now < origin + std::chrono::seconds(60))
+        {
+            now += std::chrono::milliseconds(wheel.getTimeoutMs(now));
+            wheel.advance(now);
+        }
+        REQUIRE(heartbeat.fired >= 58);
+        REQUIRE(heartbeat.fired <= 60);
+    }
+
+    SECTION("Deadlines on every level fire within a tick")
+    {
+        TimerWheel wheel(resolution, origin);
+
+        std::mt19937 generator(12345);
+        std::uniform_int_distribution<int64_t> distribution(0, 24 * 3600 * 1000);
+
+        std::vector<std::unique_ptr<TestTimer>> timers;
+        TimePoint now = origin;
+        for (int i = 0; i < 10 * 1000; ++i)
+        {
+            timers.emplace_back(new TestTimer);
+            TestTimer* timer = timers.back().get();
+            timer->deadline =
+                origin + std::chrono::milliseconds(distribution(generator) >> (i % 24));
+            timer->timer.setCallback(
+                [timer, &now]
+                {
+                    timer->fired++;
+                    timer->firedAt = now;
+                });
+            wheel.schedule(timer->timer, timer->deadline);
+        }
+
+        while (wheel.size() != 0)
+        {
+            now += std::chrono::milliseconds(wheel.getTimeoutMs(now));
+            wheel.advance(now);
+        }
+
+        for (auto&& timer : timers)
+        {
+            REQUIRE(timer->fired == 1);
+            REQUIRE(timer->firedAt >= timer->deadline);
+            REQUIRE(timer->firedAt - timer->deadline <= resolution);
+        }
+    }
+}
@@ -0,0 +1,196 @@
+/*
+ *  IXUtf8ValidatorTest.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include <catch_amalgamated.hpp>
+#include <ixwebsocket/IXUtf8Validator.h>
+#include <string>
+#include <vector>
+
+using namespace ix;
+
+namespace
+{
+    // The byte per byte DFA that the vectorized kernels replace
+    bool referenceValidate(const std::string& s)
+    {
+        Utf8Validator validator;
+        return validator.decode(s.begin(), s.end()) && validator.complete();
+    }
+
+    std::vector<std::string> makeValidSequences()
+    {
+        return {
+            "a",
+            "\x7f",
+            "\xc2\x80",         // U+0080
+            "\xdf\xbf",         // U+07FF
+            "\xe0\xa0\x80",     // U+0800
+            "\xed\x9f\xbf",     // U+D7FF
+            "\xee\x80\x80",     // U+E000
+            "\xef\xbf\xbf",     // U+FFFF
+            "\xf0\x90\x80\x80", // U+10000
+            "\xf4\x8f\xbf\xbf", // U+10FFFF
+        };
+    }
+
+    std::vector<std::string> makeInvalidSequences()
+    {
+        return {
+            "\x80",             // lone continuation
+            "\xbf",
+            "\xc0\xaf",         // overlong
+            "\xc1\xbf",
+            "\xe0\x9f\xbf",
+            "\xf0\x8f\xbf\xbf",
+            "\xed\xa0\x80",     // surrogates
+            "\xed\xbf\xbf",
+            "\xf4\x90\x80\x80", // larger than U+10FFFF
+            "\xf5\x80\x80\x80",
+            "\xff",
+            "\xc2",             // truncated
+            "\xe0\xa0",
+            "\xf0\x90\x80",
+            "\xc2\x80\x80",     // too many continuations
+            "\xe0\xa0\x80\x80",
+        };
+    }
+} // namespace
+
+namespace ix
+{
+    TEST_CASE("utf8_validator", "[utf8_validator]")
+    {
+        SECTION("Matches the DFA for every sequence at every position of a block")
+        {
+            TLogger() << std::string("utf8 validator kernel: ") + getUtf8ValidatorKernelName();
+
+            auto valid = makeValidSequences();
+            auto invalid = makeInvalidSequences();
+
+            std::vector<std::string> sequences(valid);
+            sequences.insert(sequences.end(), invalid.begin(), invalid.end());
+
+            for (auto&& sequence : sequences)
+            {
+                // Cover both sides of 16 and 32 bytes block boundaries, and the
+                // padded last block
+                for (size_t prefix = 0; prefix < 70; ++prefix)
+                {
+                    for (size_t suffix : {0, 1, 2, 3, 17, 40})
+                    {
+                        std::string s = std::string(prefix, 'x') + sequence;
+                        s += std::string(suffix, 'y');
+
+                        REQUIRE(validateUtf8(s) == referenceValidate(s));
+                    }
+                }
+            }
+        }
+
+        SECTION("Invalid sequences are detected after multibyte characters")
+        {
+            auto valid = makeValidSequences();
+            auto invalid = makeInvalidSequences();
+
+            for (auto&& bad : invalid)
+            {
+                for (auto&& good : valid)
+                {
+                    std::string s;
+                    while (s.size() < 100)
+                    {
+                        s += good;
+                    }
+
+                    for (size_t pos = 0; pos < 64; ++pos)
+                    {
+                        std::string t = s + std::string(pos, 'z') + bad + s;
+                        REQUIRE(!validateUtf8(t));
+                        REQUIRE(!referenceValidate(t));
+                    }
+                }
+            }
+        }
+
+        SECTION("Long valid strings")
+        {
+            std::string ascii(100003, 'a');
+            REQUIRE(validateUtf8(ascii));
+
+            std::string mixed;
+            auto valid = makeValidSequences();
+            while (mixed.size() < 100000)
+            {
+                for (auto&& sequence : valid)
+                {
+                    mixed += sequence;
+                }
+            }
+            REQUIRE(validateUtf8(mixed));
+
+            // A character cut at the very end
+            mixed += "\xf0\x90";
+            REQUIRE(!validateUtf8(mixed));
+        }
+
+        SECTION("Fragments can split characters anywhere")
+        {
+            std::string text;
+            auto valid = makeValidSequences();
+            while (text.size() < 300)
+            {
+                for (auto&& sequence : valid)
+                {
+                    text += sequence;
+                }
+            }
+
+            std::string invalid = text;
+            invalid.insert(150, "\xed\xa0\x80");
+
+            for (size_t split = 0; split <= text.size(); ++split)
+            {
+                Utf8Validator validator;
+                REQUIRE(validator.decodeFragment(text.data(), split));
+                REQUIRE(validator.decodeFragment(text.data() + split, text.size() - split));
+                REQUIRE(validator.complete());
+
+                Utf8Validator invalidValidator;
+                bool ok = invalidValidator.decodeFragment(invalid.data(), split) &&
+                          invalidValidator.decodeFragment(invalid.data() + split,
+                                                          invalid.size() - split);
+                REQUIRE(!ok);
+            }
+
+            // A character cut at the end of the last fragment
+            Utf8Validator validator;
+            REQUIRE(validator.decodeFragment("abc\xe2\x82", 5));
+            REQUIRE(!validator.complete());
+        }
+
+        SECTION("Random bytes")
+        {
+            uint32_t seed = 1;
+            for (int i = 0; i < 2000; ++i)
+            {
+                std::string s;
+                size_t size = i % 200;
+                for (size_t j = 0; j < size; ++j)
+                {
+                    seed = seed * 1103515245 + 12345;
+                    // Mostly bytes from multibyte characters, so that some strings
+                    // are valid
+                    uint8_t byte = (uint8_t) (seed >> 16);
+                    if ((seed >> 8) % 4 == 0) byte &= 0x7f;
+                    s.push_back((char) byte);
+                }
+
+                REQUIRE(validateUtf8(s) == referenceValidate(s));
+            }
+        }
+    }
+} // namespace ix
@@ -0,0 +1,406 @@
+/*
+ *  IXWebSocketAsyncSendTest.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include <catch_amalgamated.hpp>
+#include <functional>
+#include <ixwebsocket/IXWebSocket.h>
+#include <ixwebsocket/IXWebSocketOutbox.h>
+#include <ixwebsocket/IXWebSocketSendQueue.h>
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace ix;
+
+namespace
+{
+    const int kProducers = 4;
+    const int kMessagesPerProducer = 2000;
+
+    std::string makeMessage(int producer, int index)
+    {
+        std::stringstream ss;
+        ss << producer << " " << index;
+
+        // Mix small and fragmented messages
+        if (index % 100 == 0)
+        {
+            ss << " " << std::string(100 * 1000, 'x');
+        }
+        return ss.str();
+    }
+
+    // Returns false if a producer's messages are not in order
+    bool checkMessage(const std::string& str, std::map<int, int>& nextIndex)
+    {
+        std::stringstream ss(str);
+        int producer = -1;
+        int index = -1;
+        ss >> producer >> index;
+
+        if (str != makeMessage(producer, index)) return false;
+        if (nextIndex[producer] != index) return false;
+
+        nextIndex[producer] = index + 1;
+        return true;
+    }
+
+    // Read all the bytes queued in the outbox
+    std::string drainToString(WebSocketOutbox& outbox)
+    {
+        WebSocketSendQueue queue;
+        outbox.drain(queue);
+
+        std::string out;
+        while (!queue.empty())
+        {
+            iovec iov[4];
+            int iovcnt = queue.peek(iov, 4);
+            size_t size = 0;
+            for (int i = 0; i < iovcnt; ++i)
+            {
+                out.append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+                size += iov[i].iov_len;
+            }
+            queue.consume(size);
+        }
+        return out;
+    }
+
+    std::vector<uint8_t> makeFrames(int producer, int index)
+    {
+        // Fixed size records so that the drained stream can be split
+        char record[16];
+        snprintf(record, sizeof(record), "%07d %07d", producer, index);
+        return std::vector<uint8_t>(record, record + 16);
+    }
+
+    // Several threads send on a client using deflate with context takeover, produce
+    // sends the messages of one producer. Returns false when the server lost a message,
+    // could not decompress one or received a producer's messages out of order.
+    bool sendFromProducersWithDeflate(const std::function<void(WebSocket&)>& configure,
+                                      const std::function<void(WebSocket&, int)>& produce)
+    {
+        int port = getFreePort();
+        WebSocketServer server(port, "127.0.0.1");
+
+        std::mutex mutex;
+        std::map<int, int> nextIndex;
+        std::atomic<int> received(0);
+        std::atomic<bool> ordered(true);
+
+        server.setOnClientMessageCallback(
+            [&](std::shared_ptr<ConnectionState>, WebSocket&, const WebSocketMessagePtr& msg)
+            {
+                if (msg->type != WebSocketMessageType::Message) return;
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!checkMessage(msg->str, nextIndex)) ordered = false;
+                received++;
+            });
+
+        if (!startTestServer(server)) return false;
+
+        TestWebSocketClient client("ws://127.0.0.1:" + std::to_string(port) + "/");
+        client.getWebSocket().enablePerMessageDeflate();
+        client.getWebSocket().enableAsyncSend();
+        configure(client.getWebSocket());
+        client.start();
+        if (!client.waitForOpen())
+        {
+            server.stop();
+            return false;
+        }
+
+        std::vector<std::thread> producers;
+        for (int p = 0; p < kProducers; ++p)
+        {
+            producers.emplace_back([&client, &produce, p] { produce(client.getWebSocket(), p); });
+        }
+        for (auto&& t : producers)
+        {
+            t.join();
+        }
+
+        bool done = waitFor([&] { return received == kProducers * kMessagesPerProducer; });
+
+        client.stop();
+        server.stop();
+
+        return done && ordered;
+    }
+} // namespace
+
+namespace ix
+{
+    TEST_CASE("websocket_outbox", "[async_send]")
+    {
+        SECTION("Wake ups are coalesced until the next drain")
+        {
+            WebSocketOutbox outbox;
+            REQUIRE(outbox.empty());
+
+            REQUIRE(outbox.push(makeFrames(0, 0)));
+            REQUIRE(!outbox.push(makeFrames(0, 1)));
+            REQUIRE(!outbox.push(makeFrames(0, 2)));
+            REQUIRE(outbox.size() == 3 * 16);
+
+            auto out = drainToString(outbox);
+            REQUIRE(out.size() == 3 * 16);
+            REQUIRE(outbox.empty());
+
+            REQUIRE(outbox.push(makeFrames(0, 3)));
+        }
+
+        SECTION("Messages of each producer are drained in order")
+        {
+            WebSocketOutbox outbox;
+            std::atomic<int> running(kProducers);
+            std::atomic<int> wakeUps(0);
+
+            std::vector<std::thread> producers;
+            for (int p = 0; p < kProducers; ++p)
+            {
+                producers.emplace_back(
+                    [&, p]
+                    {
+                        for (int i = 0; i < kMessagesPerProducer; ++i)
+                        {
+                            if (outbox.push(makeFrames(p, i))) wakeUps++;
+                        }
+                        running--;
+                    });
+            }
+
+            std::string out;
+            while (running > 0 || !outbox.empty())
+            {
+                out += drainToString(outbox);
+            }
+
+            for (auto&& t : producers)
+            {
+                t.join();
+            }
+
+            REQUIRE(out.size() == 16 * kProducers * kMessagesPerProducer);
+            REQUIRE(wakeUps > 0);
+            REQUIRE(wakeUps <= kProducers * kMessagesPerProducer);
+
+            std::map<int, int> nextIndex;
+            bool ordered = true;
+            for (size_t pos = 0; pos < out.size(); pos += 16)
+            {
+                int producer = atoi(out.substr(pos, 7).c_str());
+                int index = atoi(out.substr(pos + 8, 7).c_str());
+                ordered &= nextIndex[producer] == index;
+                nextIndex[producer] = index + 1;
+            }
+            REQUIRE(ordered);
+        }
+    }
+
+    TEST_CASE("websocket_async_send", "[async_send]")
+    {
+        int port = getFreePort();
+        WebSocketServer server(port, "127.0.0.1");
+
+        std::mutex mutex;
+        std::map<int, int> serverNextIndex;
+        std::atomic<int> serverReceived(0);
+        std::atomic<bool> serverOrdered(true);
+
+        server.setOnConnectionCallback(
+            [&](std::weak_ptr<WebSocket> webSocket,
+                std::shared_ptr<ConnectionState> /*connectionState*/)
+            {
+                auto ws = webSocket.lock();
+                if (!ws) return;
+
+                ws->enableAsyncSend();
+                ws->setOnMessageCallback(
+                    [&, webSocket](const WebSocketMessagePtr& msg)
+                    {
+                        if (msg->type != WebSocketMessageType::Message) return;
+
+                        {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            if (!checkMessage(msg->str, serverNextIndex))
+                            {
+                                serverOrdered = false;
+                            }
+                        }
+                        serverReceived++;
+
+                        // Fan out from several threads once the client is done
+                        if (serverReceived != kProducers * kMessagesPerProducer) return;
+
+                        std::thread(
+                            [webSocket]
+                            {
+                                auto ws = webSocket.lock();
+                                if (!ws) return;
+
+                                std::vector<std::thread> producers;
+                                for (int p = 0; p < kProducers; ++p)
+                                {
+                                    producers.emplace_back(
+                                        [ws, p]
+                                        {
+                                            for (int i = 0; i < kMessagesPerProducer; ++i)
+                                            {
+                                                ws->sendText(makeMessage(p, i));
+                                            }
+                                        });
+                                }
+                                for (auto&& t : producers)
+                                {
+                                    t.join();
+                                }
+                            })
+                            .detach();
+                    });
+            });
+
+        REQUIRE(startTestServer(server));
+
+        std::map<int, int> clientNextIndex;
+        std::atomic<int> clientReceived(0);
+        std::atomic<bool> clientOrdered(true);
+        std::atomic<bool> open(false);
+
+        WebSocket client;
+        client.setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+        client.disableAutomaticReconnection();
+        client.enableAsyncSend();
+        client.setOnMessageCallback(
+            [&](const WebSocketMessagePtr& msg)
+            {
+                if (msg->type == WebSocketMessageType::Open)
+                {
+                    open = true;
+                }
+                else if (msg->type == WebSocketMessageType::Message)
+                {
+                    if (!checkMessage(msg->str, clientNextIndex))
+                    {
+                        clientOrdered = false;
+                    }
+                    clientReceived++;
+                }
+            });
+        client.start();
+
+        int attempts = 0;
+        while (!open && attempts++ < 500)
+        {
+            msleep(10);
+        }
+        REQUIRE(open);
+
+        std::vector<std::thread> producers;
+        for (int p = 0; p < kProducers; ++p)
+        {
+            producers.emplace_back(
+                [&client, p]
+                {
+                    for (int i = 0; i < kMessagesPerProducer; ++i)
+                    {
+                        client.sendText(makeMessage(p, i));
+                    }
+                });
+        }
+        for (auto&& t : producers)
+        {
+            t.join();
+        }
+
+        attempts = 0;
+        while (clientReceived != kProducers * kMessagesPerProducer && attempts++ < 3000)
+        {
+            msleep(10);
+        }
+
+        client.stop();
+        server.stop();
+
+        REQUIRE(serverReceived == kProducers * kMessagesPerProducer);
+        REQUIRE(serverOrdered);
+        REQUIRE(clientReceived == kProducers * kMessagesPerProducer);
+        REQUIRE(clientOrdered);
+    }
+
+    TEST_CASE("websocket_async_send_deflate", "[async_send]")
+    {
+        // The messages must be queued in the order they went through the compressor
+        SECTION("sendText")
+        {
+            REQUIRE(sendFromProducersWithDeflate(
+                [](WebSocket&) {},
+                [](WebSocket& ws, int p)
+                {
+                    for (int i = 0; i < kMessagesPerProducer; ++i)
+                    {
+                        ws.sendText(makeMessage(p, i));
+                    }
+                }));
+        }
+
+        SECTION("sendBatch, mixed with sendText")
+        {
+            REQUIRE(sendFromProducersWithDeflate(
+                [](WebSocket&) {},
+                [](WebSocket& ws, int p)
+                {
+                    const int batchSize = 10;
+                    for (int i = 0; i < kMessagesPerProducer; i += batchSize)
+                    {
+                        if (p % 2 == 0)
+                        {
+                            for (int j = i; j < i + batchSize; ++j)
+                            {
+                                ws.sendText(makeMessage(p, j));
+                            }
+                            continue;
+                        }
+
+                        std::vector<std::string> messages;
+                        for (int j = i; j < i + batchSize; ++j)
+                        {
+                            messages.push_back(makeMessage(p, j));
+                        }
+                        std::vector<IXWebSocketSendData> batch(messages.begin(), messages.end());
+                        ws.sendBatch(batch, SendMessageKind::Text);
+                    }
+                }));
+        }
+
+        SECTION("sendText, with watermarks")
+        {
+            REQUIRE(sendFromProducersWithDeflate(
+                [](WebSocket& ws)
+                {
+                    // Low enough for the producers to wait for the poll thread
+                    WebSocketBackpressureOptions options;
+                    options.highWatermark = 1024;
+                    options.lowWatermark = 256;
+                    options.policy = BackpressurePolicy::Block;
+                    ws.setBackpressureOptions(options);
+                },
+                [](WebSocket& ws, int p)
+                {
+                    for (int i = 0; i < kMessagesPerProducer; ++i)
+                    {
+                        ws.sendText(makeMessage(p, i));
+                    }
+                }));
+        }
+    }
+} // namespace ix
@@ -0,0 +1,318 @@
+/*
+ *  IXWebSocketBackpressureTest.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include <atomic>
+#include <catch_amalgamated.hpp>
+#include <ixwebsocket/IXSocket.h>
+#include <ixwebsocket/IXSocketFactory.h>
+#include <ixwebsocket/IXWebSocket.h>
+#include <ixwebsocket/IXWebSocketBackpressure.h>
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <memory>
+#include <thread>
+
+using namespace ix;
+
+namespace
+{
+    const size_t kHighWatermark = 1024 * 1024;
+    const size_t kLowWatermark = 256 * 1024;
+    const size_t kMessageSize = 64 * 1024;
+
+    // A peer which completes the handshake, and then only reads when asked to
+    class SlowConsumer
+    {
+    public:
+        bool connect(int port)
+        {
+            auto isCancellationRequested = []() -> bool { return false; };
+            std::string errMsg;
+            _socket = createSocket(false, -1, errMsg, SocketTLSOptions());
+            if (!_socket->connect("127.0.0.1", port, errMsg, isCancellationRequested))
+            {
+                return false;
+            }
+
+            _socket->writeBytes("GET / HTTP/1.1\r\n"
+                                "Upgrade: websocket\r\n"
+                                "Sec-WebSocket-Version: 13\r\n"
+                                "Sec-WebSocket-Key: foobar\r\n"
+                                "\r\n",
+                                isCancellationRequested);
+
+            // Status line and headers
+            for (;;)
+            {
+                auto lineResult = _socket->readLine(isCancellationRequested);
+                if (!lineResult.first) return false;
+                if (lineResult.second == "\r\n") return true;
+            }
+        }
+
+        // Read what is available without waiting, returns false once the peer closed
+        bool read()
+        {
+            char buffer[64 * 1024];
+            for (;;)
+            {
+                std::ptrdiff_t ret = _socket->recv(buffer, sizeof(buffer));
+                if (ret < 0 && Socket::isWaitNeeded()) return true;
+                if (ret <= 0) return false;
+            }
+        }
+
+        void close()
+        {
+            _socket->close();
+        }
+
+    private:
+        std::unique_ptr<Socket> _socket;
+    };
+
+    struct BackpressureEvents
+    {
+        std::atomic<int> highWatermark {0};
+        std::atomic<int> lowWatermark {0};
+    };
+
+    bool startServer(WebSocketServer& server,
+                     const WebSocketBackpressureOptions& options,
+                     BackpressureEvents& events)
+    {
+        server.disablePerMessageDeflate();
+        return startSelfEchoServer(
+            server,
+            [options, &events](WebSocket& webSocket)
+            {
+                webSocket.setBackpressureOptions(options);
+                webSocket.setOnBackpressureCallback(
+                    [&events](BackpressureEvent event, size_t /*bufferedAmount*/)
+                    {
+                        if (event == BackpressureEvent::HighWatermark)
+                        {
+                            events.highWatermark++;
+                        }
+                        else
+                        {
+                            events.lowWatermark++;
+                        }
+                    });
+            });
+    }
+
+    WebSocketBackpressureOptions makeOptions(BackpressurePolicy policy)
+    {
+        WebSocketBackpressureOptions options;
+        options.highWatermark = kHighWatermark;
+        options.lowWatermark = kLowWatermark;
+        options.policy = policy;
+        return options;
+    }
+
+    // Send until a message is refused, the socket buffers fill up first
+    bool sendUntilRefused(WebSocket& webSocket, const std::string& payload)
+    {
+        for (int i = 0; i < 10 * 1000; ++i)
+        {
+            if (!webSocket.sendBinary(payload).success) return true;
+        }
+        return false;
+    }
+
+    // Same, with messages which do not count as refused while they replace each other
+    bool sendUntilAboveHighWatermark(WebSocket& webSocket, const std::string& payload)
+    {
+        for (int i = 0; i < 10 * 1000; ++i)
+        {
+            if (webSocket.bufferedAmount() >= kHighWatermark) return true;
+            webSocket.sendBinary(payload);
+        }
+        return false;
+    }
+} // namespace
+
+TEST_CASE("websocket_backpressure", "[backpressure]")
+{
+    std::string payload(kMessageSize, 'p');
+
+    SECTION("DropNewest refuses messages above the high watermark")
+    {
+        int port = getFreePort();
+        WebSocketServer server(port, "127.0.0.1");
+        BackpressureEvents events;
+        REQUIRE(startServer(server, makeOptions(BackpressurePolicy::DropNewest), events));
+
+        SlowConsumer consumer;
+        REQUIRE(consumer.connect(port));
+        auto webSocket = getSingleClient(server);
+        REQUIRE(webSocket);
+
+        // Sends only queue the message, so the queue grows past the high watermark
+        REQUIRE(sendUntilRefused(*webSocket, payload));
+        REQUIRE(webSocket->bufferedAmount() >= kHighWatermark);
+        REQUIRE(webSocket->bufferedAmount() < kHighWatermark + kMessageSize);
+        // The callback only runs when the high watermark is crossed
+        int highWatermarkEvents = events.highWatermark;
+        REQUIRE(highWatermarkEvents >= 1);
+        REQUIRE(!webSocket->sendBinary(payload).success);
+        REQUIRE(events.highWatermark == highWatermarkEvents);
+
+        // Control frames still go through
+        REQUIRE(webSocket->ping("ping").success);
+
+        // Reading lets the queue drain below the low watermark
+        REQUIRE(waitFor(
+            [&]
+            {
+                consumer.read();
+                return webSocket->bufferedAmount() == 0 &&
+                       events.lowWatermark == events.highWatermark;
+            }));
+        REQUIRE(webSocket->sendBinary(payload).success);
+
+        consumer.close();
+        server.stop();
+    }
+
+    SECTION("DropOldest makes room for the new messages")
+    {
+        int port = getFreePort();
+        WebSocketServer server(port, "127.0.0.1");
+        BackpressureEvents events;
+        REQUIRE(startServer(server, makeOptions(BackpressurePolicy::DropOldest), events));
+
+        SlowConsumer consumer;
+        REQUIRE(consumer.connect(port));
+        auto webSocket = getSingleClient(server);
+        REQUIRE(webSocket);
+
+        REQUIRE(sendUntilAboveHighWatermark(*webSocket, payload));
+        for (int i = 0; i < 100; ++i)
+        {
+            REQUIRE(webSocket->sendBinary(payload).success);
+            REQUIRE(webSocket->bufferedAmount() < kHighWatermark + kMessageSize);
+        }
+        REQUIRE(events.highWatermark >= 1);
+
+        consumer.close();
+        server.stop();
+    }
+
+    SECTION("Conflate replaces the queued message sent with the same key")
+    {
+        int port = getFreePort();
+        WebSocketServer server(port, "127.0.0.1");
+        BackpressureEvents events;
+        REQUIRE(startServer(server, makeOptions(BackpressurePolicy::Conflate), events));
+
+        SlowConsumer consumer;
+        REQUIRE(consumer.connect(port));
+        auto webSocket = getSingleClient(server);
+        REQUIRE(webSocket);
+
+        REQUIRE(sendUntilAboveHighWatermark(*webSocket, payload));
+        size_t bufferedAmount = webSocket->bufferedAmount();
+
+        // The first position is queued, the next ones replace it
+        for (int i = 0; i < 100; ++i)
+        {
+            std::string position = "x=" + std::to_string(i);
+            REQUIRE(webSocket->sendConflatable("position", position, false).success);
+            REQUIRE(webSocket->bufferedAmount() <= bufferedAmount + 16);
+        }
+        REQUIRE(webSocket->sendConflatable("speed", std::string("v=1"), false).success);
+        REQUIRE(webSocket->bufferedAmount() <= bufferedAmount + 32);
+
+        // Messages without a key are refused
+        REQUIRE(!webSocket->sendBinary(payload).success);
+        REQUIRE(events.highWatermark >= 1);
+
+        consumer.close();
+        server.stop();
+    }
+
+    SECTION("Disconnect closes the connection of the slow consumer")
+    {
+        int port = getFreePort();
+        int sendTimeoutSecs = 1;
+        WebSocketServer server(port,
+                               "127.0.0.1",
+                               SocketServer::kDefaultTcpBacklog,
+                               SocketServer::kDefaultMaxConnections,
+                               WebSocketServer::kDefaultHandShakeTimeoutSecs,
+                               SocketServer::kDefaultAddressFamily,
+                               -1,
+                               sendTimeoutSecs);
+        BackpressureEvents events;
+        REQUIRE(startServer(server, makeOptions(BackpressurePolicy::Disconnect), events));
+
+        SlowConsumer consumer;
+        REQUIRE(consumer.connect(port));
+        auto webSocket = getSingleClient(server);
+        REQUIRE(webSocket);
+
+        REQUIRE(sendUntilRefused(*webSocket, payload));
+        REQUIRE(events.highWatermark >= 1);
+        REQUIRE(waitFor([&] { return server.getClients().empty(); }));
+
+        consumer.close();
+        server.stop();
+    }
+
+    SECTION("Block waits for the low watermark")
+    {
+        int port = getFreePort();
+        WebSocketServer server(port, "127.0.0.1");
+        BackpressureEvents events;
+        REQUIRE(startServer(server, makeOptions(BackpressurePolicy::Block), events));
+
+        SlowConsumer consumer;
+        REQUIRE(consumer.connect(port));
+        auto webSocket = getSingleClient(server);
+        REQUIRE(webSocket);
+
+        REQUIRE(sendUntilAboveHighWatermark(*webSocket, payload));
+
+        // Much more than the socket buffers can hold
+        const int count = 200;
+        std::atomic<int> sent(0);
+        std::atomic<bool> success(true);
+        std::atomic<size_t> maxBufferedAmount(0);
+        std::thread sender(
+            [&]
+            {
+                for (int i = 0; i < count; ++i)
+                {
+                    if (!webSocket->sendBinary(payload).success) success = false;
+                    size_t bufferedAmount = webSocket->bufferedAmount();
+                    if (bufferedAmount > maxBufferedAmount) maxBufferedAmount = bufferedAmount;
+                    sent++;
+                }
+            });
+
+        msleep(200);
+        REQUIRE(sent < count);
+
+        REQUIRE(waitFor(
+            [&]
+            {
+                consumer.read();
+                return sent == count;
+            }));
+        sender.join();
+        REQUIRE(success);
+        REQUIRE(maxBufferedAmount < kHighWatermark + kMessageSize);
+
+        // The consumer catches up, and falls behind again
+        REQUIRE(events.highWatermark >= 1);
+        REQUIRE(events.lowWatermark >= 1);
+
+        consumer.close();
+        server.stop();
+    }
+}
@@ -0,0 +1,250 @@
+/*
+ *  IXWebSocketEventLoopTest.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include <catch_amalgamated.hpp>
+#include <ixwebsocket/IXSocket.h>
+#include <ixwebsocket/IXSocketFactory.h>
+#include <ixwebsocket/IXWebSocket.h>
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <memory>
+#include <vector>
+
+using namespace ix;
+
+namespace
+{
+    class EventLoopEchoServer
+    {
+    public:
+        EventLoopEchoServer(int port, bool preferTLS)
+            : _server(port, "127.0.0.1", SocketServer::kDefaultTcpBacklog, 1000)
+            , _connections(0)
+            , _closed(0)
+        {
+            SocketTLSOptions tlsOptions = makeServerTLSOptions(preferTLS);
+            tlsOptions.caFile = "NONE";
+            _server.setTLSOptions(tlsOptions);
+        }
+
+        bool start(size_t threads)
+        {
+            if (!_server.enableEventLoop(threads)) return false;
+
+            return startSelfEchoServer(
+                _server,
+                [this](WebSocket&) { _connections++; },
+                [this](const WebSocketMessagePtr& msg)
+                {
+                    if (msg->type == WebSocketMessageType::Close) _closed++;
+                });
+        }
+
+        void stop()
+        {
+            _server.stop();
+        }
+
+        WebSocketServer& getServer()
+        {
+            return _server;
+        }
+
+        int getConnections() const
+        {
+            return _connections;
+        }
+
+        int getClosed() const
+        {
+            return _closed;
+        }
+
+    private:
+        WebSocketServer _server;
+        std::atomic<int> _connections;
+        std::atomic<int> _closed;
+    };
+
+    std::unique_ptr<TestWebSocketClient> makeEchoClient(int port,
+                                                        bool enablePerMessageDeflate,
+                                                        bool preferTLS)
+    {
+        std::unique_ptr<TestWebSocketClient> client(new TestWebSocketClient(
+            getWsScheme(preferTLS) + "localhost:" + std::to_string(port) + "/"));
+
+        WebSocket& webSocket = client->getWebSocket();
+        if (preferTLS)
+        {
+            SocketTLSOptions tlsOptions;
+            tlsOptions.caFile = "NONE";
+            webSocket.setTLSOptions(tlsOptions);
+        }
+        if (enablePerMessageDeflate)
+        {
+            webSocket.enablePerMessageDeflate();
+        }
+        else
+        {
+            webSocket.disablePerMessageDeflate();
+        }
+        return client;
+    }
+
+    void runEcho(size_t clientsCount, bool enablePerMessageDeflate, bool preferTLS)
+    {
+        int port = getFreePort();
+        EventLoopEchoServer server(port, preferTLS);
+        REQUIRE(server.start(2));
+
+        std::vector<std::unique_ptr<TestWebSocketClient>> clients;
+        for (size_t i = 0; i < clientsCount; ++i)
+        {
+            clients.push_back(makeEchoClient(port, enablePerMessageDeflate, preferTLS));
+            clients.back()->start();
+        }
+
+        REQUIRE(waitFor(
+            [&]
+            {
+                for (auto&& client : clients)
+                {
+                    if (!client->isOpen()) return false;
+                }
+                return true;
+            }));
+        REQUIRE(server.getServer().getClients().size() == clientsCount);
+
+        // Small messages, and messages which do not fit in the socket buffers so that
+        // the server has to wait for the socket to be writable to send them back
+        std::vector<std::string> payloads;
+        payloads.push_back("hello");
+        payloads.push_back(std::string(100 * 1000, 'a'));
+        payloads.push_back(std::string(4 * 1000 * 1000, 'b'));
+
+        for (auto&& client : clients)
+        {
+            for (auto&& payload : payloads)
+            {
+                REQUIRE(client->getWebSocket().sendText(payload).success);
+            }
+        }
+
+        for (auto&& client : clients)
+        {
+            REQUIRE(waitFor([&] { return client->getReceived().size() == payloads.size(); }));
+            REQUIRE(client->getReceived() == payloads);
+        }
+
+        // Closing a client is reported to the server, which forgets about it
+        clients.front()->stop();
+        REQUIRE(waitFor([&] { return server.getClosed() == 1; }));
+        REQUIRE(waitFor([&] { return server.getServer().getClients().size() == clientsCount - 1; }));
+
+        // Stopping the server closes the other connections
+        server.stop();
+        for (size_t i = 1; i < clients.size(); ++i)
+        {
+            REQUIRE(waitFor([&] { return clients[i]->isClosed(); }));
+        }
+        REQUIRE(server.getConnections() == (int) clientsCount);
+        REQUIRE(server.getServer().getClients().empty());
+
+        for (auto&& client : clients)
+        {
+            client->stop();
+        }
+    }
+} // namespace
+
+namespace ix
+{
+    TEST_CASE("websocket_event_loop", "[event_loop]")
+    {
+        if (!WebSocketEventLoop::isSupported())
+        {
+            TLogger() << "The event loop is not supported on this platform";
+            return;
+        }
+
+        SECTION("Many connections are served by two threads")
+        {
+            runEcho(50, false, false);
+        }
+
+        SECTION("Compressed messages")
+        {
+            runEcho(8, true, false);
+        }
+
+#if defined(IXWEBSOCKET_USE_OPEN_SSL) || defined(IXWEBSOCKET_USE_MBED_TLS)
+        SECTION("TLS connections")
+        {
+            runEcho(8, false, true);
+        }
+#endif
+
+        SECTION("Connections which do not finish the handshake are dropped")
+        {
+            int port = getFreePort();
+            WebSocketServer server(port, "127.0.0.1", SocketServer::kDefaultTcpBacklog, 10, 1);
+            REQUIRE(server.enableEventLoop(1));
+            REQUIRE(startSelfEchoServer(server));
+
+            std::string errorMsg;
+            auto socket = createSocket(false, -1, errorMsg, SocketTLSOptions());
+            REQUIRE(socket);
+            REQUIRE(socket->connect("127.0.0.1", port, errorMsg, [] { return false; }));
+
+            // Half of a request
+            REQUIRE(socket->send(std::string("GET / HTTP/1.1\r\n")) > 0);
+            REQUIRE(waitFor([&] { return server.getClients().size() == 1; }));
+
+            // The handshake timeout is 1 second
+            REQUIRE(waitFor([&] { return server.getClients().empty(); }, 5000));
+
+            server.stop();
+        }
+
+        SECTION("Peers which do not answer pings are closed after the closing delay")
+        {
+            int port = getFreePort();
+            WebSocketServer server(port, "127.0.0.1");
+            REQUIRE(server.enableEventLoop(1));
+            REQUIRE(startSelfEchoServer(server,
+                                        [](WebSocket& webSocket) { webSocket.setPingInterval(1); }));
+
+            std::string errorMsg;
+            auto socket = createSocket(false, -1, errorMsg, SocketTLSOptions());
+            REQUIRE(socket);
+            REQUIRE(socket->connect("127.0.0.1", port, errorMsg, [] { return false; }));
+            REQUIRE(socket->send(std::string("GET / HTTP/1.1\r\n"
+                                             "Upgrade: websocket\r\n"
+                                             "Sec-WebSocket-Version: 13\r\n"
+                                             "Sec-WebSocket-Key: foobar\r\n"
+                                             "\r\n")) > 0);
+            REQUIRE(waitFor([&] { return server.getClients().size() == 1; }));
+
+            // A ping after 1 second, a close frame when the pong is still missing
+            // 1 second later, and the connection is dropped 300ms after that
+            std::string received;
+            REQUIRE(waitFor(
+                [&]
+                {
+                    char buffer[1024];
+                    std::ptrdiff_t ret = socket->recv(buffer, sizeof(buffer));
+                    if (ret > 0) received.append(buffer, (size_t) ret);
+                    return server.getClients().empty();
+                },
+                5000));
+            REQUIRE(received.find("\x89") != std::string::npos);
+            REQUIRE(received.find("\x88") != std::string::npos);
+
+            socket->close();
+            server.stop();
+        }
+    }
+} // namespace ix
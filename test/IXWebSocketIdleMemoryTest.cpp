@@ -0,0 +1,147 @@
+/*
+ *  IXWebSocketIdleMemoryTest.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include <catch_amalgamated.hpp>
+#include <ixwebsocket/IXWebSocket.h>
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <memory>
+#include <vector>
+
+using namespace ix;
+
+namespace
+{
+    const int kIdleSecs = 1;
+
+    // What is left once everything was released: empty strings and containers
+    const size_t kIdleMemoryUsage = 1024;
+
+    bool startEchoServer(WebSocketServer& server, bool useEventLoop)
+    {
+        if (useEventLoop && !server.enableEventLoop())
+        {
+            TLogger() << "Cannot enable the event loop";
+            return false;
+        }
+
+        return startSelfEchoServer(
+            server, [](WebSocket& webSocket) { webSocket.setIdleMemoryReclaimDelay(kIdleSecs); });
+    }
+
+    std::unique_ptr<TestWebSocketClient> makeEchoClient(
+        int port, const WebSocketPerMessageDeflateOptions& options)
+    {
+        std::unique_ptr<TestWebSocketClient> client(
+            new TestWebSocketClient("ws://127.0.0.1:" + std::to_string(port) + "/"));
+        client->getWebSocket().setPerMessageDeflateOptions(options);
+        client->getWebSocket().setIdleMemoryReclaimDelay(kIdleSecs);
+        return client;
+    }
+
+    std::string makeText(int seed)
+    {
+        std::string text;
+        for (int i = 0; i < 20 * 1000; ++i)
+        {
+            text += "position " + std::to_string(i * seed) + ";";
+        }
+        return text;
+    }
+
+    void runIdleConnection(const WebSocketPerMessageDeflateOptions& options,
+                           bool useEventLoop,
+                           bool compressionContextReset)
+    {
+        int port = getFreePort();
+        WebSocketServer server(port, "127.0.0.1");
+        REQUIRE(startEchoServer(server, useEventLoop));
+
+        auto client = makeEchoClient(port, options);
+        client->start();
+        REQUIRE(client->waitForOpen());
+        auto serverWebSocket = getSingleClient(server);
+        REQUIRE(serverWebSocket);
+
+        REQUIRE(client->echo(makeText(1)));
+        REQUIRE(client->echo(makeText(2)));
+
+        size_t activeClientUsage = client->getWebSocket().getMemoryUsage();
+        size_t activeServerUsage = serverWebSocket->getMemoryUsage();
+        TLogger() << "Active connection, client: " << activeClientUsage
+                  << " bytes, server: " << activeServerUsage << " bytes";
+
+        // At least the read buffer and the receive buffer holding the last message
+        REQUIRE(activeClientUsage > 64 * 1024);
+        REQUIRE(activeServerUsage > 64 * 1024);
+
+        // The zlib states are kept when the next message refers to the previous ones
+        size_t clientIdleUsage = kIdleMemoryUsage;
+        size_t serverIdleUsage = kIdleMemoryUsage;
+        if (!compressionContextReset && options.enabled())
+        {
+            clientIdleUsage = activeClientUsage - 64 * 1024;
+            serverIdleUsage = activeServerUsage - 64 * 1024;
+        }
+
+        REQUIRE(waitFor(
+            [&]
+            {
+                return client->getWebSocket().getMemoryUsage() < clientIdleUsage &&
+                       serverWebSocket->getMemoryUsage() < serverIdleUsage;
+            },
+            (kIdleSecs * 3 + 1) * 1000));
+
+        size_t idleClientUsage = client->getWebSocket().getMemoryUsage();
+        size_t idleServerUsage = serverWebSocket->getMemoryUsage();
+        TLogger() << "Idle connection, client: " << idleClientUsage
+                  << " bytes, server: " << idleServerUsage << " bytes";
+
+        // Everything is allocated again by the next messages, compressed with the same
+        // contexts as before
+        REQUIRE(client->echo(makeText(3)));
+        REQUIRE(client->echo(makeText(2)));
+        REQUIRE(client->getWebSocket().getMemoryUsage() > idleClientUsage);
+        REQUIRE(serverWebSocket->getMemoryUsage() > idleServerUsage);
+
+        server.stop();
+    }
+} // namespace
+
+TEST_CASE("websocket_idle_memory", "[idle_memory]")
+{
+    SECTION("Idle connections release their buffers")
+    {
+        WebSocketPerMessageDeflateOptions options(false);
+        runIdleConnection(options, false, false);
+    }
+
+    SECTION("Idle connections release their compression state")
+    {
+        WebSocketPerMessageDeflateOptions options(true, true, true);
+        runIdleConnection(options, false, true);
+    }
+
+    SECTION("Compression contexts taken over by the next message are kept")
+    {
+        WebSocketPerMessageDeflateOptions options(true);
+        runIdleConnection(options, false, false);
+    }
+
+    SECTION("Decompressors are kept when only the server resets its context")
+    {
+        // The server of this library resets its context on client_no_context_takeover
+        // only, the messages it sends after the idle period refer to the previous ones
+        WebSocketPerMessageDeflateOptions options(true, false, true);
+        runIdleConnection(options, false, false);
+    }
+
+    SECTION("Connections of the event loop release their memory too")
+    {
+        WebSocketPerMessageDeflateOptions options(true, true, true);
+        runIdleConnection(options, true, true);
+    }
+}
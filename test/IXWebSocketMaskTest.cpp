@@ -0,0 +1,111 @@
+/*
+ *  IXWebSocketMaskTest.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include <algorithm>
+#include <catch_amalgamated.hpp>
+#include <ixwebsocket/IXWebSocketMask.h>
+#include <vector>
+
+using namespace ix;
+
+namespace
+{
+    // The byte per byte loop that the vectorized kernels replace
+    size_t referenceMask(uint8_t* data, size_t size, const uint8_t maskingKey[4], size_t keyOffset)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            data[i] ^= maskingKey[(keyOffset + i) & 0x3];
+        }
+        return (keyOffset + size) & 0x3;
+    }
+
+    std::vector<uint8_t> makePayload(size_t size)
+    {
+        std::vector<uint8_t> payload(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            payload[i] = (uint8_t) (i * 31 + 7);
+        }
+        return payload;
+    }
+} // namespace
+
+namespace ix
+{
+    TEST_CASE("websocket_mask", "[websocket_mask]")
+    {
+        const uint8_t maskingKey[4] = {0x12, 0x9a, 0x5c, 0xe1};
+
+        SECTION("Matches the byte per byte reference for all sizes, offsets and alignments")
+        {
+            TLogger() << std::string("mask kernel: ") + getWebSocketMaskKernelName();
+
+            std::vector<size_t> sizes;
+            for (size_t size = 0; size <= 300; ++size)
+            {
+                sizes.push_back(size);
+            }
+            sizes.push_back(4096);
+            sizes.push_back(65535);
+            sizes.push_back(1 << 20);
+
+            for (auto size : sizes)
+            {
+                for (size_t misalignment = 0; misalignment < 32; misalignment += 3)
+                {
+                    for (size_t keyOffset = 0; keyOffset < 4; ++keyOffset)
+                    {
+                        auto expected = makePayload(size + misalignment);
+                        auto actual = expected;
+
+                        size_t expectedOffset = referenceMask(
+                            expected.data() + misalignment, size, maskingKey, keyOffset);
+                        size_t actualOffset = applyWebSocketMask(
+                            actual.data() + misalignment, size, maskingKey, keyOffset);
+
+                        REQUIRE(actualOffset == expectedOffset);
+                        REQUIRE(actual == expected);
+                    }
+                }
+            }
+        }
+
+        SECTION("Masking a payload in several pieces keeps the key rotation")
+        {
+            auto expected = makePayload(10007);
+            auto actual = expected;
+
+            referenceMask(expected.data(), expected.size(), maskingKey, 0);
+
+            size_t keyOffset = 0;
+            size_t pos = 0;
+            size_t pieceSize = 1;
+            while (pos < actual.size())
+            {
+                size_t size = std::min(pieceSize, actual.size() - pos);
+                keyOffset = applyWebSocketMask(actual.data() + pos, size, maskingKey, keyOffset);
+                pos += size;
+                pieceSize = pieceSize * 3 + 1;
+            }
+
+            REQUIRE(actual == expected);
+        }
+
+        SECTION("Masking twice gives back the original payload")
+        {
+            auto original = makePayload(100003);
+            auto payload = original;
+
+            applyWebSocketMask(payload.data(), payload.size(), maskingKey);
+            REQUIRE(payload != original);
+
+            applyWebSocketMask(payload.data(), payload.size(), maskingKey);
+            REQUIRE(payload == original);
+        }
+    }
+} // namespace ix
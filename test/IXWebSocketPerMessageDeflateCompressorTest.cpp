@@ -7,6 +7,7 @@
  */
 
 #include "IXTest.h"
+#include <algorithm>
 #include <catch_amalgamated.hpp>
 #include <iostream>
 #include <ixwebsocket/IXWebSocketPerMessageDeflateCodec.h>
@@ -48,6 +49,29 @@ namespace ix
         return c;
     }
 
+    // Compress a message in pieces of pieceSize bytes, and decompress it frame by frame
+    std::string compressAndDecompressPieces(const std::string& a, size_t pieceSize)
+    {
+        WebSocketPerMessageDeflateCompressor compressor;
+        compressor.init(11, false);
+
+        WebSocketPerMessageDeflateDecompressor decompressor;
+        decompressor.init(11, false);
+
+        std::string b, c;
+        size_t pos = 0;
+        do
+        {
+            size_t size = std::min(pieceSize, a.size() - pos);
+            bool fin = pos + size == a.size();
+            compressor.compress(IXWebSocketSendData(a.data() + pos, size), fin, b);
+            decompressor.decompress(b.data(), b.size(), fin, c);
+            pos += size;
+        } while (pos < a.size());
+
+        return c;
+    }
+
     TEST_CASE("per-message-deflate-codec", "[zlib]")
     {
         SECTION("string api")
@@ -60,6 +84,21 @@ namespace ix
                     "/usr/local/include/ixwebsocket/IXSocketAppleSSL.h");
         }
 
+        SECTION("streaming api")
+        {
+            std::string text;
+            for (int i = 0; i < 10000; ++i)
+            {
+                text += "/usr/local/include/ixwebsocket/IXSocketAppleSSL.h " + std::to_string(i);
+            }
+
+            REQUIRE(compressAndDecompressPieces("", 10) == "");
+            REQUIRE(compressAndDecompressPieces("foo", 1) == "foo");
+            REQUIRE(compressAndDecompressPieces(text, 7) == text);
+            REQUIRE(compressAndDecompressPieces(text, 1000) == text);
+            REQUIRE(compressAndDecompressPieces(text, text.size()) == text);
+        }
+
         SECTION("vector api")
         {
             REQUIRE(compressAndDecompressVector("") == "");
@@ -71,6 +110,41 @@ namespace ix
                 compressAndDecompressVector("/usr/local/include/ixwebsocket/IXSocketAppleSSL.h") ==
                 "/usr/local/include/ixwebsocket/IXSocketAppleSSL.h");
         }
+
+        SECTION("parked codecs are allocated again by the next message")
+        {
+            std::string text;
+            for (int i = 0; i < 1000; ++i)
+            {
+                text += "/usr/local/include/ixwebsocket/IXSocketAppleSSL.h " + std::to_string(i);
+            }
+
+            WebSocketPerMessageDeflateCompressor compressor;
+            REQUIRE(compressor.init(15, true));
+            WebSocketPerMessageDeflateDecompressor decompressor;
+            REQUIRE(decompressor.init(15, true));
+
+            std::string b, c;
+            for (int i = 0; i < 3; ++i)
+            {
+                REQUIRE(compressor.compress(text, b));
+                REQUIRE(decompressor.decompress(b, c));
+                REQUIRE(c == text);
+                REQUIRE(compressor.getMemoryUsage() > 0);
+                REQUIRE(decompressor.getMemoryUsage() > 0);
+
+                REQUIRE(compressor.park());
+                decompressor.park();
+                REQUIRE(compressor.getMemoryUsage() == 0);
+                REQUIRE(decompressor.getMemoryUsage() == 0);
+            }
+
+            // The next message depends on the context of the previous one
+            WebSocketPerMessageDeflateCompressor contextTakeoverCompressor;
+            REQUIRE(contextTakeoverCompressor.init(15, false));
+            REQUIRE(!contextTakeoverCompressor.park());
+            REQUIRE(contextTakeoverCompressor.getMemoryUsage() > 0);
+        }
     }
 
 } // namespace ix
@@ -0,0 +1,274 @@
+/*
+ *  IXWebSocketPubSubTest.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include <catch_amalgamated.hpp>
+#include <ixwebsocket/IXWebSocket.h>
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <ixwebsocket/IXWebSocketTopics.h>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+using namespace ix;
+
+namespace
+{
+    class PubSubClient
+    {
+    public:
+        PubSubClient(int port)
+            : _open(false)
+            , _subscriptions(0)
+        {
+            _webSocket.setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+            _webSocket.disableAutomaticReconnection();
+
+            _webSocket.setOnMessageCallback(
+                [this](const WebSocketMessagePtr& msg)
+                {
+                    if (msg->type == WebSocketMessageType::Open)
+                    {
+                        _open = true;
+                    }
+                    else if (msg->type == WebSocketMessageType::Message)
+                    {
+                        if (msg->str == "subscribed")
+                        {
+                            _subscriptions++;
+                            return;
+                        }
+
+                        std::lock_guard<std::mutex> lock(_mutex);
+                        _received.push_back(msg->str);
+                    }
+                });
+        }
+
+        void start()
+        {
+            _webSocket.start();
+        }
+
+        void stop()
+        {
+            _webSocket.stop();
+        }
+
+        bool isOpen() const
+        {
+            return _open;
+        }
+
+        int getSubscriptions() const
+        {
+            return _subscriptions;
+        }
+
+        // The server acknowledges the subscription once it is registered
+        void subscribe(const std::string& topic)
+        {
+            _webSocket.sendText("subscribe:" + topic);
+        }
+
+        std::vector<std::string> getReceived()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _received;
+        }
+
+    private:
+        WebSocket _webSocket;
+        std::atomic<bool> _open;
+        std::atomic<int> _subscriptions;
+        std::mutex _mutex;
+        std::vector<std::string> _received;
+    };
+
+    bool startPubSubServer(WebSocketServer& server)
+    {
+        server.setOnClientMessageCallback(
+            [&server](std::shared_ptr<ConnectionState> /*connectionState*/,
+                      WebSocket& webSocket,
+                      const WebSocketMessagePtr& msg)
+            {
+                if (msg->type != WebSocketMessageType::Message) return;
+
+                const std::string prefix("subscribe:");
+                if (msg->str.compare(0, prefix.size(), prefix) == 0)
+                {
+                    server.subscribe(webSocket, msg->str.substr(prefix.size()));
+                    webSocket.sendText("subscribed");
+                }
+            });
+
+        return startTestServer(server);
+    }
+} // namespace
+
+namespace ix
+{
+    TEST_CASE("websocket_topics", "[pubsub]")
+    {
+        SECTION("Subscriptions are indexed by topic and by connection")
+        {
+            WebSocketTopics topics;
+            auto webSocket = std::make_shared<WebSocket>();
+
+            const int topicsCount = 100 * 1000;
+            for (int i = 0; i < topicsCount; ++i)
+            {
+                REQUIRE(topics.subscribe(webSocket, "topic" + std::to_string(i)));
+            }
+            REQUIRE(!topics.subscribe(webSocket, "topic0"));
+            REQUIRE(topics.getTopicsCount() == (size_t) topicsCount);
+            REQUIRE(topics.getTopics(webSocket.get()).size() == (size_t) topicsCount);
+
+            REQUIRE(topics.unsubscribe(webSocket.get(), "topic0"));
+            REQUIRE(!topics.unsubscribe(webSocket.get(), "topic0"));
+            REQUIRE(topics.getSubscribers("topic0") == nullptr);
+            REQUIRE(topics.getSubscribers("topic1")->size() == 1);
+
+            REQUIRE(topics.unsubscribeAll(webSocket.get()) == (size_t) topicsCount - 1);
+            REQUIRE(topics.getTopicsCount() == 0);
+            REQUIRE(topics.getTopics(webSocket.get()).empty());
+            REQUIRE(webSocket.use_count() == 1);
+        }
+
+        SECTION("Publishers keep the subscribers list they got")
+        {
+            WebSocketTopics topics;
+
+            std::vector<std::shared_ptr<WebSocket>> webSockets;
+            for (int i = 0; i < 3000; ++i)
+            {
+                webSockets.push_back(std::make_shared<WebSocket>());
+                REQUIRE(topics.subscribe(webSockets.back(), "news"));
+            }
+
+            auto subscribers = topics.getSubscribers("news");
+            REQUIRE(subscribers->size() == webSockets.size());
+
+            REQUIRE(topics.unsubscribeAll(webSockets.front().get()) == 1);
+            REQUIRE(topics.getSubscribers("news")->size() == webSockets.size() - 1);
+            REQUIRE(subscribers->size() == webSockets.size());
+            REQUIRE(subscribers->front() == webSockets.front());
+        }
+
+        SECTION("Large topics are updated in place")
+        {
+            WebSocketTopics topics;
+
+            const size_t subscribersCount = 50 * 1000;
+            std::vector<std::shared_ptr<WebSocket>> webSockets;
+            for (size_t i = 0; i < subscribersCount; ++i)
+            {
+                webSockets.push_back(std::make_shared<WebSocket>());
+                REQUIRE(topics.subscribe(webSockets.back(), "crowded"));
+            }
+
+            // The snapshot is only rebuilt after a change
+            auto subscribers = topics.getSubscribers("crowded");
+            REQUIRE(subscribers->size() == subscribersCount);
+            REQUIRE(topics.getSubscribers("crowded") == subscribers);
+
+            for (size_t i = 0; i < subscribersCount; i += 2)
+            {
+                REQUIRE(topics.unsubscribe(webSockets[i].get(), "crowded"));
+            }
+            REQUIRE(!topics.unsubscribe(webSockets[0].get(), "crowded"));
+
+            auto remaining = topics.getSubscribers("crowded");
+            REQUIRE(remaining != subscribers);
+            REQUIRE(remaining->size() == subscribersCount / 2);
+            std::set<WebSocket*> remainingSet;
+            for (auto&& subscriber : *remaining)
+            {
+                remainingSet.insert(subscriber.get());
+            }
+            for (size_t i = 0; i < subscribersCount; ++i)
+            {
+                REQUIRE(remainingSet.count(webSockets[i].get()) == i % 2);
+            }
+
+            for (size_t i = 1; i < subscribersCount; i += 2)
+            {
+                REQUIRE(topics.unsubscribeAll(webSockets[i].get()) == 1);
+            }
+            REQUIRE(topics.getSubscribers("crowded") == nullptr);
+            REQUIRE(topics.getTopicsCount() == 0);
+        }
+    }
+
+    TEST_CASE("websocket_server_pubsub", "[pubsub]")
+    {
+        SECTION("Messages are published to the subscribers of the topic")
+        {
+            int port = getFreePort();
+            WebSocketServer server(port, "127.0.0.1");
+            REQUIRE(startPubSubServer(server));
+
+            std::vector<std::unique_ptr<PubSubClient>> clients;
+            for (int i = 0; i < 4; ++i)
+            {
+                clients.emplace_back(new PubSubClient(port));
+                clients.back()->start();
+            }
+            REQUIRE(waitFor(
+                [&]
+                {
+                    for (auto&& client : clients)
+                    {
+                        if (!client->isOpen()) return false;
+                    }
+                    return true;
+                }));
+
+            // Clients 0 and 1 listen to sports, 1 and 2 to news, 3 to nothing
+            clients[0]->subscribe("sports");
+            clients[1]->subscribe("sports");
+            clients[1]->subscribe("news");
+            clients[2]->subscribe("news");
+            REQUIRE(waitFor([&] { return clients[0]->getSubscriptions() == 1; }));
+            REQUIRE(waitFor([&] { return clients[1]->getSubscriptions() == 2; }));
+            REQUIRE(waitFor([&] { return clients[2]->getSubscriptions() == 1; }));
+            REQUIRE(server.getSubscribersCount("sports") == 2);
+            REQUIRE(server.getSubscribersCount("news") == 2);
+
+            REQUIRE(server.publish("sports", std::string("goal")) == 2);
+            REQUIRE(server.publish("news", std::string("rain")) == 2);
+            REQUIRE(server.publish("weather", std::string("sun")) == 0);
+
+            REQUIRE(waitFor([&] { return clients[0]->getReceived().size() == 1; }));
+            REQUIRE(waitFor([&] { return clients[1]->getReceived().size() == 2; }));
+            REQUIRE(waitFor([&] { return clients[2]->getReceived().size() == 1; }));
+            REQUIRE(clients[0]->getReceived() == std::vector<std::string> {"goal"});
+            REQUIRE(clients[1]->getReceived() == (std::vector<std::string> {"goal", "rain"}));
+            REQUIRE(clients[2]->getReceived() == std::vector<std::string> {"rain"});
+            REQUIRE(clients[3]->getReceived().empty());
+
+            // Closed connections are removed from their topics
+            clients[1]->stop();
+            REQUIRE(waitFor([&] { return server.getSubscribersCount("news") == 1; }));
+            REQUIRE(server.getSubscribersCount("sports") == 1);
+            REQUIRE(server.publish("news", std::string("snow")) == 1);
+            REQUIRE(waitFor([&] { return clients[2]->getReceived().size() == 2; }));
+
+            // Sockets which are not clients of the server cannot subscribe
+            WebSocket stranger;
+            REQUIRE(!server.subscribe(stranger, "news"));
+            REQUIRE(server.getSubscribersCount("news") == 1);
+
+            for (auto&& client : clients)
+            {
+                client->stop();
+            }
+            REQUIRE(waitFor([&] { return server.getSubscribersCount("sports") == 0; }));
+            server.stop();
+        }
+    }
+} // namespace ix
@@ -0,0 +1,180 @@
+/*
+ *  IXWebSocketSendBatchTest.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include <catch_amalgamated.hpp>
+#include <ixwebsocket/IXWebSocket.h>
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <mutex>
+#include <vector>
+
+using namespace ix;
+
+namespace
+{
+    const size_t kBatchSize = 500;
+
+    std::vector<std::string> makeMessages()
+    {
+        std::vector<std::string> messages;
+        for (size_t i = 0; i < kBatchSize; ++i)
+        {
+            messages.push_back("update " + std::to_string(i));
+        }
+        // One message large enough to be fragmented
+        messages.push_back(std::string(100 * 1000, 'z'));
+        return messages;
+    }
+
+    void runBatch(bool enablePerMessageDeflate, bool asyncSend)
+    {
+        auto messages = makeMessages();
+        std::vector<IXWebSocketSendData> batch;
+        for (auto&& message : messages)
+        {
+            batch.emplace_back(message);
+        }
+
+        int port = getFreePort();
+        WebSocketServer server(port, "127.0.0.1");
+
+        std::mutex mutex;
+        std::vector<std::string> serverReceived;
+        std::vector<std::string> clientReceived;
+        std::atomic<bool> serverBatchSent(false);
+
+        server.setOnConnectionCallback(
+            [&](std::weak_ptr<WebSocket> webSocket,
+                std::shared_ptr<ConnectionState> /*connectionState*/)
+            {
+                auto ws = webSocket.lock();
+                if (!ws) return;
+
+                if (asyncSend) ws->enableAsyncSend();
+                ws->setOnMessageCallback(
+                    [&, webSocket](const WebSocketMessagePtr& msg)
+                    {
+                        if (msg->type != WebSocketMessageType::Message) return;
+
+                        bool done = false;
+                        {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            serverReceived.push_back(msg->str);
+                            done = serverReceived.size() == messages.size();
+                        }
+
+                        // Send the same batch back, as binary messages
+                        auto ws = webSocket.lock();
+                        if (done && ws)
+                        {
+                            serverBatchSent = ws->sendBatch(batch).success;
+                        }
+                    });
+            });
+
+        REQUIRE(startTestServer(server));
+
+        std::atomic<bool> open(false);
+        std::atomic<bool> binaryMismatch(false);
+
+        WebSocket client;
+        client.setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+        client.disableAutomaticReconnection();
+        if (asyncSend) client.enableAsyncSend();
+        if (enablePerMessageDeflate)
+        {
+            client.enablePerMessageDeflate();
+        }
+        else
+        {
+            client.disablePerMessageDeflate();
+        }
+        client.setOnMessageCallback(
+            [&](const WebSocketMessagePtr& msg)
+            {
+                if (msg->type == WebSocketMessageType::Open)
+                {
+                    open = true;
+                }
+                else if (msg->type == WebSocketMessageType::Message)
+                {
+                    if (!msg->binary) binaryMismatch = true;
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    clientReceived.push_back(msg->str);
+                }
+            });
+        client.start();
+
+        int attempts = 0;
+        while (!open && attempts++ < 500)
+        {
+            msleep(10);
+        }
+        REQUIRE(open);
+
+        auto info = client.sendBatch(batch, SendMessageKind::Text);
+        REQUIRE(info.success);
+
+        size_t payloadSize = 0;
+        for (auto&& message : messages)
+        {
+            payloadSize += message.size();
+        }
+        REQUIRE(info.payloadSize == payloadSize);
+        if (!enablePerMessageDeflate)
+        {
+            REQUIRE(info.wireSize == payloadSize);
+        }
+
+        // Only data messages can be batched
+        REQUIRE(!client.sendBatch(batch, SendMessageKind::Ping).success);
+
+        attempts = 0;
+        while (attempts++ < 500)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (clientReceived.size() == messages.size()) break;
+            }
+            msleep(10);
+        }
+
+        client.stop();
+        server.stop();
+
+        REQUIRE(serverReceived == messages);
+        REQUIRE(serverBatchSent);
+        REQUIRE(clientReceived == messages);
+        REQUIRE(!binaryMismatch);
+    }
+} // namespace
+
+namespace ix
+{
+    TEST_CASE("websocket_send_batch", "[send_batch]")
+    {
+        SECTION("Uncompressed batch")
+        {
+            runBatch(false, false);
+        }
+
+        SECTION("Compressed batch")
+        {
+            runBatch(true, false);
+        }
+
+        SECTION("Batch with async send")
+        {
+            runBatch(false, true);
+        }
+
+        SECTION("Compressed batch with async send")
+        {
+            runBatch(true, true);
+        }
+    }
+} // namespace ix
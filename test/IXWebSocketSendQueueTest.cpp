@@ -0,0 +1,178 @@
+/*
+ *  IXWebSocketSendQueueTest.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include <catch_amalgamated.hpp>
+#include <ixwebsocket/IXWebSocketMask.h>
+#include <ixwebsocket/IXWebSocketSendQueue.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace ix;
+
+namespace
+{
+    // Drain the queue, a few bytes at a time, the way a socket doing short writes would
+    std::string drain(WebSocketSendQueue& queue, size_t writeSize)
+    {
+        std::string out;
+        while (!queue.empty())
+        {
+            iovec iov[4];
+            int iovcnt = queue.peek(iov, 4);
+
+            size_t budget = writeSize;
+            for (int i = 0; i < iovcnt && budget > 0; ++i)
+            {
+                size_t n = std::min(budget, (size_t) iov[i].iov_len);
+                out.append(static_cast<const char*>(iov[i].iov_base), n);
+                budget -= n;
+            }
+
+            queue.consume(writeSize - budget);
+        }
+        return out;
+    }
+
+    std::string makePayload(size_t size)
+    {
+        std::string payload(size, '\0');
+        for (size_t i = 0; i < size; ++i)
+        {
+            payload[i] = (char) (i * 13 + 5);
+        }
+        return payload;
+    }
+} // namespace
+
+namespace ix
+{
+    TEST_CASE("websocket_send_queue", "[websocket_send_queue]")
+    {
+        SECTION("Data spanning several segments comes out in order")
+        {
+            WebSocketSendQueue queue(64, 2);
+            std::string expected;
+
+            for (size_t size = 0; size < 300; size += 7)
+            {
+                auto payload = makePayload(size);
+                queue.append(payload.data(), payload.size());
+                expected += payload;
+                REQUIRE(queue.size() == expected.size());
+            }
+
+            REQUIRE(drain(queue, 50) == expected);
+            REQUIRE(queue.size() == 0);
+            REQUIRE(queue.empty());
+        }
+
+        SECTION("Masked data keeps the key rotation across segment boundaries")
+        {
+            const uint8_t maskingKey[4] = {0x12, 0x9a, 0x5c, 0xe1};
+            WebSocketSendQueue queue(37, 2);
+
+            auto payload = makePayload(1001);
+            queue.append("ab", 2);
+            queue.appendMasked(payload.data(), payload.size(), maskingKey);
+
+            auto out = drain(queue, 100);
+            REQUIRE(out.size() == 2 + payload.size());
+            REQUIRE(out.substr(0, 2) == "ab");
+
+            auto masked = out.substr(2);
+            applyWebSocketMask(reinterpret_cast<uint8_t*>(&masked[0]), masked.size(), maskingKey);
+            REQUIRE(masked == payload);
+        }
+
+        SECTION("Referenced data is sent in place until it is materialized")
+        {
+            WebSocketSendQueue queue(16, 2);
+
+            std::string header("header");
+            std::string payload = makePayload(100);
+            std::string trailer("trailer");
+
+            queue.append(header.data(), header.size());
+            queue.appendReference(payload.data(), payload.size());
+            queue.append(trailer.data(), trailer.size());
+            REQUIRE(queue.size() == header.size() + payload.size() + trailer.size());
+
+            iovec iov[8];
+            int iovcnt = queue.peek(iov, 8);
+            REQUIRE(iovcnt == 3);
+            REQUIRE(iov[1].iov_base == payload.data());
+
+            // Partially send the reference, then copy what is left of it
+            queue.consume(header.size() + 10);
+            queue.materializeReferences();
+            std::string expected = payload.substr(10) + trailer;
+            payload.assign(payload.size(), 'x');
+
+            REQUIRE(queue.size() == expected.size());
+            REQUIRE(drain(queue, 1000) == expected);
+        }
+
+        SECTION("Shared buffers are sent without copies and released once sent")
+        {
+            std::string payload = makePayload(1000);
+            auto shared = std::make_shared<const std::vector<uint8_t>>(payload.begin(),
+                                                                        payload.end());
+
+            WebSocketSendQueue first;
+            WebSocketSendQueue second;
+            first.append(shared);
+            second.append(shared);
+            REQUIRE(shared.use_count() == 3);
+
+            iovec iov[4];
+            REQUIRE(first.peek(iov, 4) == 1);
+            REQUIRE(iov[0].iov_base == shared->data());
+
+            // Shared buffers are not references, they are kept alive by the queue
+            first.materializeReferences();
+            REQUIRE(first.peek(iov, 4) == 1);
+            REQUIRE(iov[0].iov_base == shared->data());
+
+            REQUIRE(drain(first, 300) == payload);
+            REQUIRE(shared.use_count() == 2);
+            REQUIRE(drain(second, 7) == payload);
+            REQUIRE(shared.use_count() == 1);
+        }
+
+        SECTION("Segments are recycled once sent")
+        {
+            WebSocketSendQueue queue(32, 4);
+            auto payload = makePayload(32 * 4);
+
+            for (int i = 0; i < 10; ++i)
+            {
+                queue.append(payload.data(), payload.size());
+
+                iovec iov[8];
+                REQUIRE(queue.peek(iov, 8) == 4);
+                if (i == 0)
+                {
+                    queue.consume(payload.size());
+                    continue;
+                }
+
+                // Storage is taken from the pool, no data is moved when consuming
+                const void* first = iov[0].iov_base;
+                queue.consume(10);
+                REQUIRE(queue.peek(iov, 8) == 4);
+                REQUIRE(iov[0].iov_base == static_cast<const char*>(first) + 10);
+                REQUIRE(drain(queue, 17) == payload.substr(10));
+            }
+
+            queue.append(payload.data(), payload.size());
+            queue.clear();
+            REQUIRE(queue.empty());
+            REQUIRE(queue.size() == 0);
+        }
+    }
+} // namespace ix
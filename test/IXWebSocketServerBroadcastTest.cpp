@@ -0,0 +1,272 @@
+/*
+ *  IXWebSocketServerBroadcastTest.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include <atomic>
+#include <catch_amalgamated.hpp>
+#include <chrono>
+#include <ixwebsocket/IXSocket.h>
+#include <ixwebsocket/IXSocketFactory.h>
+#include <ixwebsocket/IXWebSocket.h>
+#include <ixwebsocket/IXWebSocketBroadcastMessage.h>
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <memory>
+#include <vector>
+
+using namespace ix;
+
+namespace
+{
+    std::unique_ptr<TestWebSocketClient> makeBroadcastClient(
+        int port, const WebSocketPerMessageDeflateOptions& options)
+    {
+        std::unique_ptr<TestWebSocketClient> client(
+            new TestWebSocketClient("ws://127.0.0.1:" + std::to_string(port) + "/"));
+        client->getWebSocket().setPerMessageDeflateOptions(options);
+        return client;
+    }
+
+    bool startServer(WebSocketServer& server)
+    {
+        server.setOnConnectionCallback(
+            [](std::weak_ptr<WebSocket> webSocket, std::shared_ptr<ConnectionState>)
+            {
+                auto ws = webSocket.lock();
+                if (ws) ws->setOnMessageCallback([](const WebSocketMessagePtr&) {});
+            });
+
+        return startTestServer(server);
+    }
+
+    bool allOpen(const std::vector<std::unique_ptr<TestWebSocketClient>>& clients)
+    {
+        for (auto&& client : clients)
+        {
+            if (!client->isOpen()) return false;
+        }
+        return true;
+    }
+} // namespace
+
+TEST_CASE("websocket_server_broadcast", "[broadcast]")
+{
+    SECTION("A broadcast message is framed once and shared by the clients")
+    {
+        std::string payload(100 * 1000, 'a');
+        WebSocketBroadcastMessage message(payload, false, true);
+
+        REQUIRE(message.getFrames());
+        REQUIRE(message.getPayloadSize() == payload.size());
+        REQUIRE(!message.isBinary());
+
+        // Fragmented like the messages sent with sendText()
+        REQUIRE(message.getFrames()->size() > payload.size());
+        REQUIRE(message.getFrames()->size() < payload.size() + 64);
+        REQUIRE((message.getFrames()->at(0) & 0x0f) == 0x1);
+        REQUIRE((message.getFrames()->at(0) & 0x80) == 0);
+
+#ifdef IXWEBSOCKET_USE_ZLIB
+        REQUIRE(message.getCompressedFrames());
+        REQUIRE(message.getCompressedFrames()->size() < 1000);
+        REQUIRE((message.getCompressedFrames()->at(0) & 0x40) == 0x40);
+#endif
+
+        WebSocketBroadcastMessage uncompressed(payload, true, false);
+        REQUIRE(!uncompressed.getCompressedFrames());
+        REQUIRE((uncompressed.getFrames()->at(0) & 0x0f) == 0x2);
+    }
+
+    SECTION("Clients cannot send broadcast messages, they are not masked")
+    {
+        int port = getFreePort();
+        WebSocketServer server(port);
+        std::atomic<int> received(0);
+        server.setOnClientMessageCallback(
+            [&](std::shared_ptr<ConnectionState>, WebSocket&, const WebSocketMessagePtr& msg)
+            {
+                if (msg->type == WebSocketMessageType::Message) received++;
+            });
+        REQUIRE(startTestServer(server));
+
+        auto client = makeBroadcastClient(port, WebSocketPerMessageDeflateOptions(false));
+        client->start();
+        REQUIRE(client->waitForOpen());
+
+        std::string payload("not masked");
+        WebSocketBroadcastMessage message(payload, false, false);
+        REQUIRE(!client->getWebSocket().sendBroadcastMessage(message).success);
+
+        // The connection is still usable
+        REQUIRE(client->getWebSocket().sendText("masked").success);
+        REQUIRE(waitFor([&] { return received == 1; }));
+        REQUIRE(!client->isClosed());
+
+        client->stop();
+        server.stop();
+    }
+
+    SECTION("Every client but the sender gets the messages, in order")
+    {
+        int port = getFreePort();
+        WebSocketServer server(port);
+        server.makeBroadcastServer();
+        REQUIRE(startTestServer(server));
+
+        WebSocketPerMessageDeflateOptions options(false);
+        std::vector<std::unique_ptr<TestWebSocketClient>> clients;
+        for (int i = 0; i < 5; ++i)
+        {
+            clients.push_back(makeBroadcastClient(port, options));
+            clients.back()->start();
+        }
+        REQUIRE(waitFor([&] { return allOpen(clients); }));
+        REQUIRE(waitFor([&] { return server.getClients().size() == clients.size(); }));
+
+        std::vector<std::string> payloads;
+        for (int i = 0; i < 20; ++i)
+        {
+            std::string payload = "message " + std::to_string(i);
+            if (i % 5 == 0) payload += std::string(100 * 1000, 'x');
+            payloads.push_back(payload);
+
+            REQUIRE(clients.front()->getWebSocket().sendText(payload).success);
+        }
+
+        for (size_t i = 1; i < clients.size(); ++i)
+        {
+            REQUIRE(waitFor([&] { return clients[i]->getReceived().size() == payloads.size(); }));
+            REQUIRE(clients[i]->getReceived() == payloads);
+        }
+        REQUIRE(clients.front()->getReceived().empty());
+
+        for (auto&& client : clients)
+        {
+            client->stop();
+        }
+        server.stop();
+    }
+
+#ifdef IXWEBSOCKET_USE_ZLIB
+    SECTION("Compressed frames only go to clients without context takeover")
+    {
+        int port = getFreePort();
+        WebSocketServer server(port);
+        REQUIRE(startServer(server));
+
+        // No compression, compression with context takeover, and without
+        std::vector<WebSocketPerMessageDeflateOptions> allOptions;
+        allOptions.push_back(WebSocketPerMessageDeflateOptions(false));
+        allOptions.push_back(WebSocketPerMessageDeflateOptions(true));
+        allOptions.push_back(WebSocketPerMessageDeflateOptions(true, true));
+
+        std::vector<std::unique_ptr<TestWebSocketClient>> clients;
+        for (auto&& options : allOptions)
+        {
+            clients.push_back(makeBroadcastClient(port, options));
+            clients.back()->start();
+        }
+        REQUIRE(waitFor([&] { return allOpen(clients); }));
+        REQUIRE(waitFor([&] { return server.getClients().size() == clients.size(); }));
+
+        // Broadcasts are interleaved with messages sent to each client, which are
+        // compressed with the context of the connection
+        std::vector<std::string> payloads;
+        for (int i = 0; i < 10; ++i)
+        {
+            std::string payload = "broadcast " + std::to_string(i) + std::string(10 * 1000, 'b');
+            payloads.push_back(payload);
+            REQUIRE(server.broadcast(payload) == clients.size());
+
+            payload = "direct " + std::to_string(i) + std::string(10 * 1000, 'd');
+            payloads.push_back(payload);
+            for (auto&& client : server.getClients())
+            {
+                REQUIRE(client->sendText(payload).success);
+            }
+        }
+
+        for (auto&& client : clients)
+        {
+            REQUIRE(waitFor([&] { return client->getReceived().size() == payloads.size(); }));
+            REQUIRE(client->getReceived() == payloads);
+        }
+
+        // Only the client without context takeover got the broadcasts compressed
+        REQUIRE(clients[0]->getWireSizes()[0] > 10 * 1000);
+        REQUIRE(clients[1]->getWireSizes()[0] > 10 * 1000);
+        REQUIRE(clients[2]->getWireSizes()[0] < 1000);
+
+        for (auto&& client : clients)
+        {
+            client->stop();
+        }
+        server.stop();
+    }
+#endif
+
+    SECTION("A client which does not read does not hold up the others")
+    {
+        int port = getFreePort();
+        int sendTimeoutSecs = 1;
+        WebSocketServer server(port,
+                               SocketServer::kDefaultHost,
+                               SocketServer::kDefaultTcpBacklog,
+                               SocketServer::kDefaultMaxConnections,
+                               WebSocketServer::kDefaultHandShakeTimeoutSecs,
+                               SocketServer::kDefaultAddressFamily,
+                               -1,
+                               sendTimeoutSecs);
+        server.disablePerMessageDeflate();
+        REQUIRE(startServer(server));
+
+        // Upgrade a raw socket, which never reads anything after that
+        auto isCancellationRequested = []() -> bool { return false; };
+        std::string errMsg;
+        std::shared_ptr<Socket> socket = createSocket(false, -1, errMsg, SocketTLSOptions());
+        REQUIRE(socket->connect("127.0.0.1", port, errMsg, isCancellationRequested));
+        socket->writeBytes("GET / HTTP/1.1\r\n"
+                           "Upgrade: websocket\r\n"
+                           "Sec-WebSocket-Version: 13\r\n"
+                           "Sec-WebSocket-Key: foobar\r\n"
+                           "\r\n",
+                           isCancellationRequested);
+        auto lineResult = socket->readLine(isCancellationRequested);
+        REQUIRE(lineResult.first);
+
+        WebSocketPerMessageDeflateOptions options(false);
+        std::vector<std::unique_ptr<TestWebSocketClient>> clients;
+        for (int i = 0; i < 4; ++i)
+        {
+            clients.push_back(makeBroadcastClient(port, options));
+            clients.back()->start();
+        }
+        REQUIRE(waitFor([&] { return allOpen(clients); }));
+        REQUIRE(waitFor([&] { return server.getClients().size() == clients.size() + 1; }));
+
+        // Much more than the socket buffers of the stuck client can hold
+        std::string payload(4 * 1000 * 1000, 'p');
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 8; ++i)
+        {
+            REQUIRE(server.broadcast(payload) == clients.size() + 1);
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        REQUIRE(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() < 1000);
+
+        for (auto&& client : clients)
+        {
+            REQUIRE(waitFor([&] { return client->getReceived().size() == 8; }));
+        }
+
+        for (auto&& client : clients)
+        {
+            client->stop();
+        }
+        socket->close();
+        server.stop();
+        REQUIRE(server.getClients().empty());
+    }
+}
@@ -5,12 +5,16 @@
  */
 
 #include "IXTest.h"
+#include <algorithm>
 #include <catch_amalgamated.hpp>
 #include <iostream>
 #include <ixwebsocket/IXSocket.h>
 #include <ixwebsocket/IXSocketFactory.h>
 #include <ixwebsocket/IXWebSocket.h>
 #include <ixwebsocket/IXWebSocketServer.h>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 using namespace ix;
 
@@ -196,6 +200,196 @@ TEST_CASE("Websocket_server", "[websocket_server]")
         REQUIRE(server.getClients().size() == 0);
     }
 
+    SECTION("Several acceptors listen on the same port with SO_REUSEPORT")
+    {
+        int port = getFreePort();
+        ix::WebSocketServer server(port);
+        if (!server.enableReusePort(4))
+        {
+            TLogger() << "SO_REUSEPORT is not supported on this platform";
+            return;
+        }
+
+        std::string connectionId;
+        REQUIRE(startServer(server, connectionId));
+
+        auto isCancellationRequested = []() -> bool { return false; };
+        std::vector<std::shared_ptr<Socket>> sockets;
+        for (int i = 0; i < 20; ++i)
+        {
+            std::string errMsg;
+            bool tls = false;
+            SocketTLSOptions tlsOptions;
+            std::shared_ptr<Socket> socket = createSocket(tls, -1, errMsg, tlsOptions);
+            REQUIRE(socket->connect("127.0.0.1", port, errMsg, isCancellationRequested));
+
+            socket->writeBytes("GET / HTTP/1.1\r\n"
+                               "Upgrade: websocket\r\n"
+                               "Sec-WebSocket-Version: 13\r\n"
+                               "Sec-WebSocket-Key: foobar\r\n"
+                               "\r\n",
+                               isCancellationRequested);
+
+            auto lineResult = socket->readLine(isCancellationRequested);
+            REQUIRE(lineResult.first);
+
+            int status = -1;
+            REQUIRE(sscanf(lineResult.second.c_str(), "HTTP/1.1 %d", &status) == 1);
+            REQUIRE(status == 101);
+
+            sockets.push_back(socket);
+        }
+
+        REQUIRE(server.getClients().size() == 20);
+
+        // The kernel hashes the connections between the acceptors, the odds of all of
+        // them landing on the same one are negligible
+        auto counts = server.getAcceptedConnectionsCounts();
+        REQUIRE(counts.size() == 4);
+        uint64_t total = 0;
+        size_t busyAcceptors = 0;
+        for (auto count : counts)
+        {
+            total += count;
+            if (count > 0) ++busyAcceptors;
+        }
+        REQUIRE(total == 20);
+        REQUIRE(busyAcceptors > 1);
+
+        // Give the connection threads time to start handling their sockets
+        ix::msleep(500);
+        server.stop();
+        REQUIRE(server.getClients().size() == 0);
+    }
+
+    SECTION("A burst of connections is accepted and set up")
+    {
+        int port = getFreePort();
+        int backlog = 64;
+        ix::WebSocketServer server(port, "127.0.0.1", backlog);
+
+        std::string connectionId;
+        REQUIRE(startServer(server, connectionId));
+
+        // All the clients connect before any of them sends its upgrade request,
+        // so that they are waiting together in the tcp backlog
+        auto isCancellationRequested = []() -> bool { return false; };
+        std::vector<std::shared_ptr<Socket>> sockets;
+        for (int i = 0; i < 32; ++i)
+        {
+            std::string errMsg;
+            bool tls = false;
+            SocketTLSOptions tlsOptions;
+            std::shared_ptr<Socket> socket = createSocket(tls, -1, errMsg, tlsOptions);
+            REQUIRE(socket->connect("127.0.0.1", port, errMsg, isCancellationRequested));
+            sockets.push_back(socket);
+        }
+
+        for (auto&& socket : sockets)
+        {
+            socket->writeBytes("GET / HTTP/1.1\r\n"
+                               "Upgrade: websocket\r\n"
+                               "Sec-WebSocket-Version: 13\r\n"
+                               "Sec-WebSocket-Key: foobar\r\n"
+                               "\r\n",
+                               isCancellationRequested);
+        }
+
+        for (auto&& socket : sockets)
+        {
+            auto lineResult = socket->readLine(isCancellationRequested);
+            REQUIRE(lineResult.first);
+
+            int status = -1;
+            REQUIRE(sscanf(lineResult.second.c_str(), "HTTP/1.1 %d", &status) == 1);
+            REQUIRE(status == 101);
+        }
+
+        REQUIRE(server.getClients().size() == 32);
+
+        // Give the connection threads time to start handling their sockets
+        ix::msleep(500);
+        server.stop();
+        REQUIRE(server.getClients().size() == 0);
+    }
+
+    SECTION("Clients are found by connection id, snapshots are not changed by disconnections")
+    {
+        int port = getFreePort();
+        ix::WebSocketServer server(port, "127.0.0.1");
+
+        std::mutex mutex;
+        std::vector<std::string> connectionIds;
+        server.setOnConnectionCallback(
+            [&mutex, &connectionIds](std::weak_ptr<WebSocket> webSocket,
+                                     std::shared_ptr<ConnectionState> connectionState)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    connectionIds.push_back(connectionState->getId());
+                }
+
+                auto ws = webSocket.lock();
+                if (ws) ws->setOnMessageCallback([](const ix::WebSocketMessagePtr&) {});
+            });
+        REQUIRE(server.listen().first);
+        server.start();
+
+        std::atomic<int> opened(0);
+        std::vector<std::unique_ptr<ix::WebSocket>> clients;
+        for (int i = 0; i < 3; ++i)
+        {
+            clients.emplace_back(new ix::WebSocket);
+            clients.back()->setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+            clients.back()->disableAutomaticReconnection();
+            clients.back()->setOnMessageCallback(
+                [&opened](const ix::WebSocketMessagePtr& msg)
+                {
+                    if (msg->type == ix::WebSocketMessageType::Open) opened++;
+                });
+            clients.back()->start();
+        }
+
+        for (int i = 0; i < 500 && opened != 3; ++i)
+        {
+            ix::msleep(10);
+        }
+        REQUIRE(opened == 3);
+
+        auto snapshot = server.getClientsSnapshot();
+        REQUIRE(snapshot->size() == 3);
+
+        std::vector<std::string> ids;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ids = connectionIds;
+        }
+        REQUIRE(ids.size() == 3);
+        for (auto&& id : ids)
+        {
+            auto client = server.getClient(id);
+            REQUIRE(client);
+            REQUIRE(std::find(snapshot->begin(), snapshot->end(), client) != snapshot->end());
+        }
+        REQUIRE(server.getClient("not a connection id") == nullptr);
+
+        for (auto&& client : clients)
+        {
+            client->stop();
+        }
+        for (int i = 0; i < 500 && !server.getClientsSnapshot()->empty(); ++i)
+        {
+            ix::msleep(10);
+        }
+        REQUIRE(server.getClientsSnapshot()->empty());
+        REQUIRE(server.getClient(ids.front()) == nullptr);
+
+        // The old snapshot still holds the clients it was taken with
+        REQUIRE(snapshot->size() == 3);
+
+        server.stop();
+    }
+
 #if defined(IXWEBSOCKET_USE_OPEN_SSL) || defined(IXWEBSOCKET_USE_MBED_TLS)
     SECTION("TLS server: a failed TLS handshake is reported through the log callback")
     {
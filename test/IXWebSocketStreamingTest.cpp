@@ -0,0 +1,423 @@
+/*
+ *  IXWebSocketStreamingTest.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include <algorithm>
+#include <catch_amalgamated.hpp>
+#include <ixwebsocket/IXWebSocket.h>
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <mutex>
+#include <vector>
+
+using namespace ix;
+
+namespace
+{
+    struct StreamedMessage
+    {
+        std::string payload;
+        bool binary;
+        int fragments;
+    };
+
+    class StreamingServer
+    {
+    public:
+        // Without streaming, fragmented messages are delivered whole to the message callback
+        StreamingServer(int port, bool streaming = true)
+            : _server(port, "127.0.0.1")
+            , _current({std::string(), false, 0})
+        {
+            _server.setOnConnectionCallback(
+                [this, streaming](std::weak_ptr<WebSocket> webSocket,
+                                  std::shared_ptr<ConnectionState> /*connectionState*/)
+                {
+                    auto ws = webSocket.lock();
+                    if (!ws) return;
+
+                    if (streaming)
+                    {
+                        ws->setOnFragmentCallback(
+                            [this](const char* data, size_t size, bool binary, bool fin)
+                            {
+                                std::lock_guard<std::mutex> lock(_mutex);
+                                _current.payload.append(data, size);
+                                _current.binary = binary;
+                                _current.fragments++;
+
+                                if (fin)
+                                {
+                                    _streamed.push_back(_current);
+                                    _current = {std::string(), false, 0};
+                                }
+                            });
+                    }
+
+                    ws->setOnMessageCallback(
+                        [this](const WebSocketMessagePtr& msg)
+                        {
+                            if (msg->type != WebSocketMessageType::Message) return;
+
+                            std::lock_guard<std::mutex> lock(_mutex);
+                            _messages.push_back(msg->str);
+                        });
+                });
+        }
+
+        bool start()
+        {
+            return startTestServer(_server);
+        }
+
+        void stop()
+        {
+            _server.stop();
+        }
+
+        std::vector<StreamedMessage> getStreamed()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _streamed;
+        }
+
+        std::vector<std::string> getMessages()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _messages;
+        }
+
+    private:
+        WebSocketServer _server;
+        std::mutex _mutex;
+        StreamedMessage _current;
+        std::vector<StreamedMessage> _streamed;
+        std::vector<std::string> _messages;
+    };
+
+    // Pseudo random content, so that compressed messages are still fragmented
+    uint32_t nextRandom(uint32_t& seed)
+    {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 16;
+    }
+
+    std::string makeText(size_t size)
+    {
+        // Multi bytes characters end up split across fragments
+        const char* words[] = {"abc ", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "z"};
+        uint32_t seed = 1;
+        std::string text;
+        while (text.size() < size)
+        {
+            text += words[nextRandom(seed) % 5];
+        }
+        return text;
+    }
+
+    std::string makeBinary(size_t size)
+    {
+        uint32_t seed = 2;
+        std::string binary(size, '\0');
+        for (size_t i = 0; i < size; ++i)
+        {
+            binary[i] = (char) nextRandom(seed);
+        }
+        return binary;
+    }
+
+    void runStreaming(bool enablePerMessageDeflate)
+    {
+        int port = getFreePort();
+        StreamingServer server(port);
+        REQUIRE(server.start());
+
+        std::atomic<bool> open(false);
+        std::atomic<int> closeCode(0);
+
+        WebSocket client;
+        client.setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+        client.disableAutomaticReconnection();
+        if (enablePerMessageDeflate)
+        {
+            client.enablePerMessageDeflate();
+        }
+        else
+        {
+            client.disablePerMessageDeflate();
+        }
+        client.setOnMessageCallback(
+            [&](const WebSocketMessagePtr& msg)
+            {
+                if (msg->type == WebSocketMessageType::Open)
+                {
+                    open = true;
+                }
+                else if (msg->type == WebSocketMessageType::Close)
+                {
+                    closeCode = msg->closeInfo.code;
+                }
+            });
+        client.start();
+
+        int attempts = 0;
+        while (!open && attempts++ < 500)
+        {
+            msleep(10);
+        }
+        REQUIRE(open);
+
+        std::string text = makeText(1000 * 1000);
+        std::string binary = makeBinary(300 * 1000);
+
+        REQUIRE(client.sendText("small").success);
+        REQUIRE(client.sendText(text).success);
+        REQUIRE(client.sendBinary(binary).success);
+
+        attempts = 0;
+        while (server.getStreamed().size() < 2 && attempts++ < 500)
+        {
+            msleep(10);
+        }
+
+        auto streamed = server.getStreamed();
+        REQUIRE(streamed.size() == 2);
+        REQUIRE(streamed[0].payload == text);
+        REQUIRE(!streamed[0].binary);
+        REQUIRE(streamed[0].fragments > 1);
+        REQUIRE(streamed[1].payload == binary);
+        REQUIRE(streamed[1].binary);
+        REQUIRE(streamed[1].fragments > 1);
+
+        // Single frame messages still go to the message callback
+        auto messages = server.getMessages();
+        REQUIRE(messages.size() == 1);
+        REQUIRE(messages[0] == "small");
+
+        // Invalid text is rejected while streaming
+        std::string invalid = makeText(200 * 1000);
+        invalid[100 * 1000] = '\xff';
+        client.sendUtf8Text(invalid);
+
+        attempts = 0;
+        while (closeCode == 0 && attempts++ < 500)
+        {
+            msleep(10);
+        }
+        REQUIRE(closeCode == WebSocketCloseConstants::kInvalidFramePayloadData);
+        REQUIRE(server.getStreamed().size() == 2);
+
+        client.stop();
+        server.stop();
+    }
+
+    void runFragmented(bool enablePerMessageDeflate)
+    {
+        int port = getFreePort();
+        StreamingServer server(port, false);
+        REQUIRE(server.start());
+
+        std::atomic<bool> open(false);
+        std::atomic<int> closeCode(0);
+
+        WebSocket client;
+        client.setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+        client.disableAutomaticReconnection();
+        if (enablePerMessageDeflate)
+        {
+            client.enablePerMessageDeflate();
+        }
+        else
+        {
+            client.disablePerMessageDeflate();
+        }
+        client.setOnMessageCallback(
+            [&](const WebSocketMessagePtr& msg)
+            {
+                if (msg->type == WebSocketMessageType::Open)
+                {
+                    open = true;
+                }
+                else if (msg->type == WebSocketMessageType::Close)
+                {
+                    closeCode = msg->closeInfo.code;
+                }
+            });
+        client.start();
+
+        int attempts = 0;
+        while (!open && attempts++ < 500)
+        {
+            msleep(10);
+        }
+        REQUIRE(open);
+
+        // Multi bytes characters are split across fragments, and validated frame by frame
+        std::string text = makeText(1000 * 1000);
+        std::string binary = makeBinary(300 * 1000);
+
+        REQUIRE(client.sendText(text).success);
+        REQUIRE(client.sendBinary(binary).success);
+
+        attempts = 0;
+        while (server.getMessages().size() < 2 && attempts++ < 500)
+        {
+            msleep(10);
+        }
+
+        auto messages = server.getMessages();
+        REQUIRE(messages.size() == 2);
+        REQUIRE(messages[0] == text);
+        REQUIRE(messages[1] == binary);
+
+        // Invalid text is rejected. It is placed in the last fragment, as closing the
+        // connection while the client is still sending can reset it before the close
+        // frame is read.
+        std::string invalid = makeText(200 * 1000);
+        invalid[invalid.size() - 10] = '\xff';
+        client.sendUtf8Text(invalid);
+
+        attempts = 0;
+        while (closeCode == 0 && attempts++ < 500)
+        {
+            msleep(10);
+        }
+        REQUIRE(closeCode == WebSocketCloseConstants::kInvalidFramePayloadData);
+        REQUIRE(server.getMessages().size() == 2);
+
+        client.stop();
+        server.stop();
+    }
+
+    void runStreamingSend(bool enablePerMessageDeflate)
+    {
+        int port = getFreePort();
+        StreamingServer server(port);
+        REQUIRE(server.start());
+
+        std::atomic<bool> open(false);
+
+        WebSocket client;
+        client.setUrl("ws://127.0.0.1:" + std::to_string(port) + "/");
+        client.disableAutomaticReconnection();
+        if (enablePerMessageDeflate)
+        {
+            client.enablePerMessageDeflate();
+        }
+        else
+        {
+            client.disablePerMessageDeflate();
+        }
+        client.setOnMessageCallback(
+            [&](const WebSocketMessagePtr& msg)
+            {
+                if (msg->type == WebSocketMessageType::Open)
+                {
+                    open = true;
+                }
+            });
+        client.start();
+
+        int attempts = 0;
+        while (!open && attempts++ < 500)
+        {
+            msleep(10);
+        }
+        REQUIRE(open);
+
+        // Pieces of various sizes, some larger than a frame
+        std::string text = makeText(500 * 1000);
+        REQUIRE(client.beginMessage(false));
+        REQUIRE(!client.beginMessage(true));
+
+        size_t pos = 0;
+        size_t pieceSize = 1;
+        while (pos < text.size())
+        {
+            size_t size = std::min(pieceSize, text.size() - pos);
+            REQUIRE(client.appendFragment(IXWebSocketSendData(text.data() + pos, size)).success);
+            pos += size;
+            pieceSize = pieceSize * 2 + 1;
+
+            // Other data messages have to wait for the end of the streamed one
+            REQUIRE(!client.sendText("not now").success);
+        }
+        REQUIRE(client.endMessage().success);
+        REQUIRE(!client.endMessage().success);
+
+        std::string binary = makeBinary(200 * 1000);
+        REQUIRE(client.beginMessage(true));
+        REQUIRE(client.appendFragment(binary).success);
+        REQUIRE(client.endMessage().success);
+
+        // An empty streamed message is a single frame
+        REQUIRE(client.beginMessage(false));
+        REQUIRE(client.endMessage().success);
+        REQUIRE(client.sendText("after").success);
+
+        attempts = 0;
+        while (server.getMessages().size() < 2 && attempts++ < 500)
+        {
+            msleep(10);
+        }
+
+        client.stop();
+        server.stop();
+
+        auto streamed = server.getStreamed();
+        REQUIRE(streamed.size() == 2);
+        REQUIRE(streamed[0].payload == text);
+        REQUIRE(!streamed[0].binary);
+        REQUIRE(streamed[1].payload == binary);
+        REQUIRE(streamed[1].binary);
+
+        auto messages = server.getMessages();
+        REQUIRE(messages.size() == 2);
+        REQUIRE(messages[0].empty());
+        REQUIRE(messages[1] == "after");
+    }
+} // namespace
+
+namespace ix
+{
+    TEST_CASE("websocket_streaming_fragments", "[streaming]")
+    {
+        SECTION("Uncompressed fragments are streamed")
+        {
+            runStreaming(false);
+        }
+
+        SECTION("Compressed fragments are decompressed incrementally")
+        {
+            runStreaming(true);
+        }
+    }
+
+    TEST_CASE("websocket_fragmented_text_validation", "[streaming]")
+    {
+        SECTION("Uncompressed fragments are validated as they arrive")
+        {
+            runFragmented(false);
+        }
+
+        SECTION("Compressed fragments are decompressed and validated as they arrive")
+        {
+            runFragmented(true);
+        }
+    }
+
+    TEST_CASE("websocket_streaming_send", "[streaming]")
+    {
+        SECTION("Uncompressed message sent progressively")
+        {
+            runStreamingSend(false);
+        }
+
+        SECTION("Compressed message sent progressively")
+        {
+            runStreamingSend(true);
+        }
+    }
+} // namespace ix
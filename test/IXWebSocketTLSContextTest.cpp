@@ -0,0 +1,240 @@
+/*
+ *  IXWebSocketTLSContextTest.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include <catch_amalgamated.hpp>
+#include <cstdio>
+#include <fstream>
+#include <ixwebsocket/IXWebSocket.h>
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+using namespace ix;
+
+namespace
+{
+    // Renewed certificates are written over the files the server was given
+    const std::string kCertFile = "tls-context-server-crt.pem";
+    const std::string kKeyFile = "tls-context-server-key.pem";
+
+    bool copyFile(const std::string& from, const std::string& to)
+    {
+        std::ifstream in(from, std::ios::binary);
+        std::ofstream out(to, std::ios::binary | std::ios::trunc);
+        if (!in || !out) return false;
+
+        out << in.rdbuf();
+        return (bool) out;
+    }
+
+    std::string readFile(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        return ss.str();
+    }
+
+    bool writeFile(const std::string& path, const std::string& content)
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << content;
+        return (bool) out;
+    }
+
+    bool startEchoServer(WebSocketServer& server, SocketTLSOptions tlsOptions)
+    {
+        // Peer verification is not what is being tested here
+        tlsOptions.caFile = "NONE";
+        server.setTLSOptions(tlsOptions);
+        return startSelfEchoServer(server);
+    }
+
+    std::unique_ptr<TestWebSocketClient> makeEchoClient(int port)
+    {
+        std::unique_ptr<TestWebSocketClient> client(
+            new TestWebSocketClient("wss://localhost:" + std::to_string(port) + "/"));
+        SocketTLSOptions tlsOptions;
+        tlsOptions.caFile = "NONE";
+        client->getWebSocket().setTLSOptions(tlsOptions);
+        return client;
+    }
+
+    // Returns true once the handshakes succeeded, false when the server refused them
+    bool startEchoClient(TestWebSocketClient& client)
+    {
+        client.start();
+        return client.waitForOpen();
+    }
+
+    bool connectAndEcho(int port, const std::string& text)
+    {
+        auto client = makeEchoClient(port);
+        return startEchoClient(*client) && client->echo(text);
+    }
+
+    SocketTLSOptions makeRenewableTLSOptions()
+    {
+        SocketTLSOptions tlsOptions = makeServerTLSOptions(true);
+        tlsOptions.certFile = kCertFile;
+        tlsOptions.keyFile = kKeyFile;
+        return tlsOptions;
+    }
+
+    bool installServerCertificate()
+    {
+        SocketTLSOptions tlsOptions = makeServerTLSOptions(true);
+        return copyFile(tlsOptions.certFile, kCertFile) && copyFile(tlsOptions.keyFile, kKeyFile);
+    }
+
+    void removeServerCertificate()
+    {
+        std::remove(kCertFile.c_str());
+        std::remove(kKeyFile.c_str());
+    }
+} // namespace
+
+TEST_CASE("websocket_tls_context", "[tls]")
+{
+#if defined(IXWEBSOCKET_USE_OPEN_SSL) || defined(IXWEBSOCKET_USE_MBED_TLS)
+    SECTION("Accepted connections share the server context")
+    {
+        int port = getFreePort();
+        WebSocketServer server(port, "127.0.0.1");
+        REQUIRE(startEchoServer(server, makeServerTLSOptions(true)));
+
+        // Connected at the same time, to handshake concurrently with the same context
+        std::vector<std::unique_ptr<TestWebSocketClient>> clients;
+        for (int i = 0; i < 8; ++i)
+        {
+            clients.push_back(makeEchoClient(port));
+            REQUIRE(startEchoClient(*clients.back()));
+        }
+
+        for (size_t i = 0; i < clients.size(); ++i)
+        {
+            REQUIRE(clients[i]->echo("hello " + std::to_string(i)));
+        }
+
+        clients.clear();
+        server.stop();
+    }
+
+    SECTION("Renewed certificates are picked up by a reload")
+    {
+        REQUIRE(installServerCertificate());
+
+        int port = getFreePort();
+        WebSocketServer server(port, "127.0.0.1");
+        REQUIRE(startEchoServer(server, makeRenewableTLSOptions()));
+
+        auto established = makeEchoClient(port);
+        REQUIRE(startEchoClient(*established));
+
+        // A broken key does not replace the current context
+        REQUIRE(writeFile(kKeyFile, "not a key"));
+        auto res = server.reloadTLSContext();
+        REQUIRE(!res.first);
+        TLogger() << res.second;
+        REQUIRE(connectAndEcho(port, "before the renewal"));
+
+        REQUIRE(installServerCertificate());
+        res = server.reloadTLSContext();
+        REQUIRE(res.first);
+        REQUIRE(connectAndEcho(port, "after the renewal"));
+
+        // Established connections keep the context they were accepted with
+        REQUIRE(established->echo("still there"));
+
+        server.stop();
+        removeServerCertificate();
+    }
+
+    SECTION("Connections are refused until the certificate can be loaded")
+    {
+        REQUIRE(writeFile(kCertFile, "not a certificate"));
+
+        int port = getFreePort();
+        WebSocketServer server(port, "127.0.0.1");
+        REQUIRE(startEchoServer(server, makeRenewableTLSOptions()));
+
+        {
+            auto client = makeEchoClient(port);
+            REQUIRE(!startEchoClient(*client));
+        }
+
+        REQUIRE(installServerCertificate());
+        REQUIRE(connectAndEcho(port, "hello"));
+
+        server.stop();
+        removeServerCertificate();
+    }
+
+    SECTION("Certificates and keys can be given in memory")
+    {
+        SocketTLSOptions tlsOptions = makeServerTLSOptions(true);
+        tlsOptions.certFile = readFile(tlsOptions.certFile);
+        tlsOptions.keyFile = readFile(tlsOptions.keyFile);
+        REQUIRE(tlsOptions.isUsingInMemoryCertAndKey());
+        REQUIRE(tlsOptions.isValid());
+
+        int port = getFreePort();
+        WebSocketServer server(port, "127.0.0.1");
+        REQUIRE(startEchoServer(server, tlsOptions));
+        REQUIRE(connectAndEcho(port, "hello"));
+
+        server.stop();
+    }
+
+    SECTION("Renewed certificates are taken from the provider by a reload")
+    {
+        SocketTLSOptions files = makeServerTLSOptions(true);
+        std::mutex mutex;
+        std::string certChain = "not a certificate";
+        std::string key = readFile(files.keyFile);
+
+        SocketTLSOptions tlsOptions = files;
+        tlsOptions.certFile.clear();
+        tlsOptions.keyFile.clear();
+        tlsOptions.certAndKeyProvider =
+            [&](std::string& providedCertChain, std::string& providedKey, std::string&)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            providedCertChain = certChain;
+            providedKey = key;
+            return true;
+        };
+
+        int port = getFreePort();
+        WebSocketServer server(port, "127.0.0.1");
+        REQUIRE(startEchoServer(server, tlsOptions));
+
+        {
+            auto client = makeEchoClient(port);
+            REQUIRE(!startEchoClient(*client));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            certChain = readFile(files.certFile);
+        }
+        auto res = server.reloadTLSContext();
+        REQUIRE(res.first);
+        REQUIRE(connectAndEcho(port, "from the provider"));
+
+        server.stop();
+    }
+#endif
+
+    SECTION("Servers without TLS have nothing to reload")
+    {
+        WebSocketServer server(getFreePort(), "127.0.0.1");
+        REQUIRE(!server.reloadTLSContext().first);
+    }
+}
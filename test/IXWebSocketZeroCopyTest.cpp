@@ -0,0 +1,214 @@
+/*
+ *  IXWebSocketZeroCopyTest.cpp
+ *  Author: Benjamin Sergeant
+ *  Copyright (c) 2024 Machine Zone. All rights reserved.
+ */
+
+#include "IXTest.h"
+#include <catch_amalgamated.hpp>
+#include <ixwebsocket/IXWebSocket.h>
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <mutex>
+#include <vector>
+
+using namespace ix;
+
+namespace
+{
+    struct ReceivedMessage
+    {
+        std::string payload;
+        bool binary;
+        bool strWasEmpty;
+    };
+
+    class ZeroCopyEchoServer
+    {
+    public:
+        ZeroCopyEchoServer(int port, bool preferTLS)
+            : _server(port, "127.0.0.1")
+        {
+            // Peer verification is not what is being tested here
+            SocketTLSOptions tlsOptions = makeServerTLSOptions(preferTLS);
+            tlsOptions.caFile = "NONE";
+            _server.setTLSOptions(tlsOptions);
+        }
+
+        // Messages are sent back straight from the receive buffer
+        bool start()
+        {
+            return startSelfEchoServer(
+                _server,
+                [](WebSocket& webSocket) { webSocket.enableZeroCopyDelivery(); },
+                [this](const WebSocketMessagePtr& msg)
+                {
+                    if (msg->type != WebSocketMessageType::Message) return;
+
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _received.push_back(
+                        {std::string(msg->data(), msg->size()), msg->binary, msg->str.empty()});
+                });
+        }
+
+        void stop()
+        {
+            _server.stop();
+        }
+
+        std::vector<ReceivedMessage> getReceived()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _received;
+        }
+
+    private:
+        WebSocketServer _server;
+        std::mutex _mutex;
+        std::vector<ReceivedMessage> _received;
+    };
+
+    std::vector<std::string> makePayloads()
+    {
+        std::vector<std::string> payloads;
+        payloads.push_back("");
+        payloads.push_back("hello");
+        payloads.push_back(std::string(1000, 'a'));
+        // Larger than a fragment, so it is received in several frames. The server echoes
+        // it back with several writes, sending the payload by reference.
+        payloads.push_back(std::string(100 * 1000, 'b'));
+        payloads.push_back(std::string(4 * 1000 * 1000, 'c'));
+        return payloads;
+    }
+
+    void runEcho(bool enablePerMessageDeflate, bool preferTLS)
+    {
+        int port = getFreePort();
+        ZeroCopyEchoServer server(port, preferTLS);
+        REQUIRE(server.start());
+
+        std::mutex mutex;
+        std::vector<ReceivedMessage> echoed;
+        std::atomic<bool> open(false);
+        std::atomic<bool> viewMismatch(false);
+
+        WebSocket client;
+        client.setUrl(getWsScheme(preferTLS) + "localhost:" + std::to_string(port) + "/");
+        if (preferTLS)
+        {
+            SocketTLSOptions tlsOptions;
+            tlsOptions.caFile = "NONE";
+            client.setTLSOptions(tlsOptions);
+        }
+        client.disableAutomaticReconnection();
+        if (enablePerMessageDeflate)
+        {
+            client.enablePerMessageDeflate();
+        }
+        else
+        {
+            client.disablePerMessageDeflate();
+        }
+
+        client.setOnMessageCallback(
+            [&](const WebSocketMessagePtr& msg)
+            {
+                if (msg->type == WebSocketMessageType::Open)
+                {
+                    open = true;
+                }
+                else if (msg->type == WebSocketMessageType::Error)
+                {
+                    TLogger() << "Connection error: " << msg->errorInfo.reason;
+                }
+                else if (msg->type == WebSocketMessageType::Message)
+                {
+                    // Without zero copy delivery, the payload view refers to str
+                    if (msg->data() != msg->str.data() || msg->size() != msg->str.size())
+                    {
+                        viewMismatch = true;
+                    }
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    echoed.push_back({msg->str, msg->binary, false});
+                }
+            });
+        client.start();
+
+        int attempts = 0;
+        while (!open && attempts++ < 500)
+        {
+            msleep(10);
+        }
+        REQUIRE(open);
+
+        auto payloads = makePayloads();
+        for (auto&& payload : payloads)
+        {
+            REQUIRE(client.sendText(payload).success);
+            REQUIRE(client.sendBinary(payload).success);
+        }
+
+        attempts = 0;
+        while (attempts++ < 500)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (echoed.size() == 2 * payloads.size()) break;
+            }
+            msleep(10);
+        }
+
+        client.stop();
+        server.stop();
+
+        REQUIRE(!viewMismatch);
+
+        auto received = server.getReceived();
+        REQUIRE(received.size() == 2 * payloads.size());
+        REQUIRE(echoed.size() == 2 * payloads.size());
+
+        for (size_t i = 0; i < payloads.size(); ++i)
+        {
+            for (size_t j = 0; j < 2; ++j)
+            {
+                size_t k = 2 * i + j;
+                bool binary = j == 1;
+
+                REQUIRE(received[k].payload == payloads[i]);
+                REQUIRE(received[k].binary == binary);
+                REQUIRE(echoed[k].payload == payloads[i]);
+                REQUIRE(echoed[k].binary == binary);
+
+                // Uncompressed single frame messages are not copied into str
+                bool singleFrame = payloads[i].size() < 32 * 1024;
+                if (!enablePerMessageDeflate && singleFrame)
+                {
+                    REQUIRE(received[k].strWasEmpty);
+                }
+            }
+        }
+    }
+} // namespace
+
+namespace ix
+{
+    TEST_CASE("Websocket_zero_copy_delivery", "[zero_copy]")
+    {
+        SECTION("Uncompressed messages are delivered as a view into the receive buffer")
+        {
+            runEcho(false, false);
+        }
+
+        SECTION("Compressed messages are delivered through the same accessors")
+        {
+            runEcho(true, false);
+        }
+
+#if defined(IXWEBSOCKET_USE_OPEN_SSL) || defined(IXWEBSOCKET_USE_MBED_TLS)
+        SECTION("Payloads sent by reference over TLS")
+        {
+            runEcho(false, true);
+        }
+#endif
+    }
+} // namespace ix
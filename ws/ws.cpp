@@ -9,6 +9,7 @@
 //
 
 #include <CLI11.hpp>
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <common/IXLog.h>
@@ -29,6 +30,7 @@
 #include <ixwebsocket/IXUuid.h>
 #include <ixwebsocket/IXWebSocket.h>
 #include <ixwebsocket/IXWebSocketHttpHeaders.h>
+#include <ixwebsocket/IXWebSocketMask.h>
 #include <ixwebsocket/IXWebSocketProxyServer.h>
 #include <ixwebsocket/IXWebSocketServer.h>
 #include <mutex>
@@ -1003,6 +1005,56 @@ namespace ix
         return 0;
     }
 
+    int ws_mask(int payloadSize, int runCount)
+    {
+        if (payloadSize <= 0 || runCount <= 0)
+        {
+            ix::logError("payload size and run count must be positive");
+            return 1;
+        }
+
+        std::vector<uint8_t> payload(payloadSize);
+        for (size_t i = 0; i < payload.size(); ++i)
+        {
+            payload[i] = (uint8_t) i;
+        }
+        const uint8_t maskingKey[4] = {0x37, 0xfa, 0x21, 0x3d};
+
+        ix::logInfo("masking {} bytes {} times with the {} kernel",
+                    payloadSize,
+                    runCount,
+                    ix::getWebSocketMaskKernelName());
+
+        std::vector<uint64_t> durations;
+        {
+            Bench bench("masking payload");
+            bench.setReported();
+
+            for (int i = 0; i < runCount; ++i)
+            {
+                bench.reset();
+                applyWebSocketMask(payload.data(), payload.size(), maskingKey);
+                bench.record();
+                durations.push_back(bench.getDuration());
+            }
+        }
+
+        std::sort(durations.begin(), durations.end());
+        uint64_t medianRuntime = durations[durations.size() / 2];
+        ix::logInfo("median runtime to mask payload: {} us", medianRuntime);
+
+        if (medianRuntime > 0)
+        {
+            // bytes per microsecond is MB/s, divide by 1000 for GB/s
+            std::stringstream ss;
+            ss.precision(2);
+            ss << std::fixed << (double) payloadSize / (double) medianRuntime / 1000.;
+            ix::logInfo("throughput: {} GB/s", ss.str());
+        }
+
+        return 0;
+    }
+
     int ws_autoroute(const std::string& url,
                      bool disablePerMessageDeflate,
                      const ix::SocketTLSOptions& tlsOptions,
@@ -2652,6 +2704,12 @@ int main(int argc, char** argv)
     gunzipApp->fallthrough();
     gunzipApp->add_option("filename", filename, "Filename")->required();
 
+    int payloadSize = 16 * 1024 * 1024;
+    CLI::App* maskApp = app.add_subcommand("mask", "WebSocket payload masking benchmark");
+    maskApp->fallthrough();
+    maskApp->add_option("--size", payloadSize, "Payload size in bytes");
+    maskApp->add_option("--run_count", runCount, "Number of time to mask the payload");
+
     CLI11_PARSE(app, argc, argv);
 
     // pid file handling
@@ -2857,6 +2915,10 @@ int main(int argc, char** argv)
     {
         ret = ix::ws_gunzip(filename);
     }
+    else if (app.got_subcommand("mask"))
+    {
+        ret = ix::ws_mask(payloadSize, runCount);
+    }
     else if (version)
     {
         std::cout << "ws " << ix::userAgent() << std::endl;